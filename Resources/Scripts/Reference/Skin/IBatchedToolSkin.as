@@ -0,0 +1,61 @@
+/*
+ Copyright (c) 2013 yvt
+ 
+ This file is part of OpenSpades.
+ 
+ OpenSpades is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+ 
+ OpenSpades is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with OpenSpades.  If not, see <http://www.gnu.org/licenses/>.
+ 
+ */
+ 
+namespace spades {
+	
+	/** Per-frame parameters of a tool, filled by the client. Only the
+	 * fields relevant to the tool the skin is for have meaningful values. */
+	class SkinParameters {
+		// IToolSkin
+		float sprintState;
+		float raiseState;
+		bool isMuted;
+		
+		// IWeaponSkin, IBlockSkin, IGrenadeSkin
+		float readyState;
+		
+		// IWeaponSkin
+		float aimDownSightState;
+		bool isReloading;
+		float reloadProgress;
+		int ammo;
+		int clipSize;
+		
+		// IBlockSkin
+		Vector3 blockColor;
+		
+		// IGrenadeSkin
+		float cookTime;
+		
+		// ISpadeSkin
+		SpadeActionType actionType;
+		float actionProgress;
+	}
+	
+	/** A skin which receives its per-frame parameters with a single call.
+	 * Implementing this is optional; when a skin implements this, the client
+	 * calls SetParameters instead of setting the properties of IToolSkin and
+	 * the tool-specific skin interface one by one. TeamColor and the
+	 * view/third-person specific properties are still set separately. */
+	interface IBatchedToolSkin {
+		void SetParameters(const SkinParameters&in params);
+	}
+	
+}
@@ -20,7 +20,7 @@
 
 namespace spades {
 	class BasicViewWeapon: 
-	IToolSkin, IViewToolSkin, IWeaponSkin {
+	IToolSkin, IViewToolSkin, IWeaponSkin, IBatchedToolSkin {
 		// IToolSkin
 		private float sprintState;
 		private float raiseState;
@@ -95,6 +95,20 @@ namespace spades {
 			get { return readyState; }
 		}
 		
+		// IBatchedToolSkin
+		
+		void SetParameters(const SkinParameters&in p) {
+			SprintState = p.sprintState;
+			RaiseState = p.raiseState;
+			IsMuted = p.isMuted;
+			ReadyState = p.readyState;
+			AimDownSightState = p.aimDownSightState;
+			IsReloading = p.isReloading;
+			ReloadProgress = p.reloadProgress;
+			Ammo = p.ammo;
+			ClipSize = p.clipSize;
+		}
+		
 		// IViewToolSkin
 		
 		private Matrix4 eyeMatrix;
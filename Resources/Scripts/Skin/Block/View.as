@@ -20,7 +20,7 @@
  
  namespace spades {
 	class ViewBlockSkin: 
-	IToolSkin, IViewToolSkin, IBlockSkin {
+	IToolSkin, IViewToolSkin, IBlockSkin, IBatchedToolSkin {
 		private float sprintState;
 		private float raiseState;
 		private Vector3 teamColor;
@@ -76,6 +76,14 @@
 			set { readyState = value; }
 		}
 		
+		void SetParameters(const SkinParameters&in p) {
+			SprintState = p.sprintState;
+			RaiseState = p.raiseState;
+			IsMuted = p.isMuted;
+			ReadyState = p.readyState;
+			BlockColor = p.blockColor;
+		}
+		
 		private Renderer@ renderer;
 		private AudioDevice@ audioDevice;
 		private Model@ model;
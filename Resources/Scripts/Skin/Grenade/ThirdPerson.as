@@ -20,7 +20,7 @@
  
  namespace spades {
 	class ThirdPersonGrenadeSkin: 
-	IToolSkin, IThirdPersonToolSkin, IGrenadeSkin {
+	IToolSkin, IThirdPersonToolSkin, IGrenadeSkin, IBatchedToolSkin {
 		private float sprintState;
 		private float raiseState;
 		private Vector3 teamColor;
@@ -62,6 +62,14 @@
 			set { readyState = value; }
 		}
 		
+		void SetParameters(const SkinParameters&in p) {
+			SprintState = p.sprintState;
+			RaiseState = p.raiseState;
+			IsMuted = p.isMuted;
+			ReadyState = p.readyState;
+			CookTime = p.cookTime;
+		}
+		
 		private Renderer@ renderer;
 		private AudioDevice@ audioDevice;
 		private Model@ model;
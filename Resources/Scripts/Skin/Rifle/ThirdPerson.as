@@ -20,7 +20,7 @@
  
  namespace spades {
 	class ThirdPersonRifleSkin: 
-	IToolSkin, IThirdPersonToolSkin, IWeaponSkin {
+	IToolSkin, IThirdPersonToolSkin, IWeaponSkin, IBatchedToolSkin {
 		private float sprintState;
 		private float raiseState;
 		private Vector3 teamColor;
@@ -77,6 +77,18 @@
 			set { readyState = value; }
 		}
 		
+		void SetParameters(const SkinParameters&in p) {
+			SprintState = p.sprintState;
+			RaiseState = p.raiseState;
+			IsMuted = p.isMuted;
+			ReadyState = p.readyState;
+			AimDownSightState = p.aimDownSightState;
+			IsReloading = p.isReloading;
+			ReloadProgress = p.reloadProgress;
+			Ammo = p.ammo;
+			ClipSize = p.clipSize;
+		}
+		
 		private Renderer@ renderer;
 		private AudioDevice@ audioDevice;
 		private Model@ model;
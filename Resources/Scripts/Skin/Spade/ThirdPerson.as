@@ -20,7 +20,7 @@
  
  namespace spades {
 	class ThirdPersonSpadeSkin: 
-	IToolSkin, IThirdPersonToolSkin, ISpadeSkin {
+	IToolSkin, IThirdPersonToolSkin, ISpadeSkin, IBatchedToolSkin {
 		private float sprintState;
 		private float raiseState;
 		private Vector3 teamColor;
@@ -69,6 +69,14 @@
 			set { actionProgress = value; }
 		}
 		
+		void SetParameters(const SkinParameters&in p) {
+			SprintState = p.sprintState;
+			RaiseState = p.raiseState;
+			IsMuted = p.isMuted;
+			ActionType = p.actionType;
+			ActionProgress = p.actionProgress;
+		}
+		
 		private Renderer@ renderer;
 		private AudioDevice@ audioDevice;
 		private Model@ model;
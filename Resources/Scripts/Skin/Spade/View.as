@@ -20,7 +20,7 @@
  
  namespace spades {
 	class ViewSpadeSkin: 
-	IToolSkin, IViewToolSkin, ISpadeSkin {
+	IToolSkin, IViewToolSkin, ISpadeSkin, IBatchedToolSkin {
 		private float sprintState;
 		private float raiseState;
 		private Vector3 teamColor;
@@ -76,6 +76,14 @@
 			set { actionProgress = value; }
 		}
 		
+		void SetParameters(const SkinParameters&in p) {
+			SprintState = p.sprintState;
+			RaiseState = p.raiseState;
+			IsMuted = p.isMuted;
+			ActionType = p.actionType;
+			ActionProgress = p.actionProgress;
+		}
+		
 		private Renderer@ renderer;
 		private AudioDevice@ audioDevice;
 		private Model@ model;
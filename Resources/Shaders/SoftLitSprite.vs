@@ -32,6 +32,7 @@ uniform float fogDistance;
 attribute vec4 positionAttribute;
 attribute vec3 spritePosAttribute;
 attribute vec4 colorAttribute;
+attribute vec2 texCoordAttribute;
 attribute vec3 emissionAttribute;
 attribute vec4 dlRAttribute;
 attribute vec4 dlGAttribute;
@@ -94,7 +95,7 @@ void main() {
 	dlB = dlBAttribute;
 	
 	// sprite texture coord
-	texCoord.xy = spritePosAttribute.xy * .5 + .5;
+	texCoord.xy = texCoordAttribute;
 	
 	// depth texture coord
 	texCoord.zw = vec2(.5) + (gl_Position.xy / gl_Position.w) * .5;
@@ -32,6 +32,7 @@ uniform float fogDistance;
 attribute vec4 positionAttribute;
 attribute vec3 spritePosAttribute;
 attribute vec4 colorAttribute;
+attribute vec2 texCoordAttribute;
 
 varying vec4 color;
 varying vec4 texCoord;
@@ -78,7 +79,7 @@ void main() {
 	color = colorAttribute;
 	
 	// sprite texture coord
-	texCoord.xy = spritePosAttribute.xy * .5 + .5;
+	texCoord.xy = texCoordAttribute;
 	
 	// depth texture coord
 	texCoord.zw = vec2(.5) + (gl_Position.xy / gl_Position.w) * .5;
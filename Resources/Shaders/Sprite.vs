@@ -29,6 +29,7 @@ uniform float fogDistance;
 attribute vec4 positionAttribute;
 attribute vec3 spritePosAttribute;
 attribute vec4 colorAttribute;
+attribute vec2 texCoordAttribute;
 
 varying vec4 color;
 varying vec2 texCoord;
@@ -56,7 +57,7 @@ void main() {
 	
 	color = colorAttribute;
 	
-	texCoord = spritePosAttribute.xy * .5 + .5;
+	texCoord = texCoordAttribute;
 	
 	// fog.
 	// cannot gamma correct because sprite may be
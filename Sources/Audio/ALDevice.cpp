@@ -20,6 +20,8 @@
 
 #include "ALDevice.h"
 #include "ALFuncs.h"
+#include "AcousticQueryService.h"
+#include "AudioSampleCache.h"
 #include <exception>
 #include <stdio.h>
 #include <Client/IAudioChunk.h>
@@ -55,9 +57,6 @@ namespace spades {
 			return MakeVector3(v.x, v.y, v.z);
 		}
 		
-		static float NextRandom() {
-			return (float)rand() /(float)RAND_MAX;
-		}
 		
 		class ALAudioChunk: public client::IAudioChunk {
 			ALuint handle;
@@ -150,6 +149,9 @@ namespace spades {
 			
 			client::GameMap *map;
 			
+			AcousticQueryService acoustics;
+			Vector3 listenerPosition;
+			int obstructionPhase;
 			
 			struct ALSrc {
 				Internal *internal;
@@ -159,7 +161,14 @@ namespace spades {
 				bool local;
 				client::AudioParam param;
 				
-				ALSrc(Internal *i): internal(i) {
+				// cached to avoid querying AL
+				Vector3 position;
+				
+				// last state applied by UpdateObstruction
+				bool obstructed;
+				bool filterValid;
+				
+				ALSrc(Internal *i): internal(i), filterValid(false) {
 					SPADES_MARK_FUNCTION();
 					
 					al::qalGenSources(1, &handle);
@@ -233,6 +242,8 @@ namespace spades {
 					}
 					eaxSource = true;
 					this->local = local;
+					position = v;
+					filterValid = false;
 					ALCheckError();
 				}
 				
@@ -260,6 +271,8 @@ namespace spades {
 					ALCheckError();
 					eaxSource = false;
 					local = true;
+					position = MakeVector3(0, 0, 0);
+					filterValid = false;
 				}
 				
 				// after calling Set2D/Set3D, must be called
@@ -269,15 +282,8 @@ namespace spades {
 					// update stereo source's volume (not spatialized by AL)
 					// FIXME: move to another function?
 					if(stereo && !local){
-						ALfloat v3[3];
-						al::qalGetListenerfv(AL_POSITION, v3);
-						Vector3 eye = {v3[0], v3[1], v3[2]};
-						ALCheckErrorPrecise();
-						al::qalGetSourcefv(handle, AL_POSITION, v3);
-						Vector3 pos = {v3[0], v3[1], v3[2]};
-						ALCheckErrorPrecise();
-						
-						float dist = (pos - eye).GetLength();
+						Vector3 eye = internal->listenerPosition;
+						float dist = (position - eye).GetLength();
 						dist /= param.referenceDistance;
 						if(dist < 1.f)
 							dist = 1.f;
@@ -289,44 +295,19 @@ namespace spades {
 					if(!internal->useEAX)
 						return;
 					
-					ALint value;
-					
-					al::qalGetSourcei(handle, AL_SOURCE_RELATIVE, &value);
-					ALCheckErrorPrecise();
-					
-					bool enableObstruction = true;
-					if(value)
-						enableObstruction = false;
-					
-					// raytrace
-					client::GameMap *map = internal->map;
-					if(map && enableObstruction){
-						ALfloat v3[3];
-						al::qalGetListenerfv(AL_POSITION, v3);
-						Vector3 eye = {v3[0], v3[1], v3[2]};
-						ALCheckErrorPrecise();
-						al::qalGetSourcefv(handle, AL_POSITION, v3);
-						Vector3 pos = {v3[0], v3[1], v3[2]};
-						ALCheckErrorPrecise();
-						Vector3 checkPos;
-						eye = TransformVectorFromAL(eye);
-						pos = TransformVectorFromAL(pos);
-						for(int x = -1; x <= 1; x++)
-							for(int y = -1; y <= 1; y++)
-								for(int z = -1; z <= 1; z++){
-									IntVector3 hitPos;
-									checkPos.x = pos.x + (float)x * .2f;
-									checkPos.y = pos.y + (float)y * .2f;
-									checkPos.z = pos.z + (float)z * .2f;
-									if(!map->CastRay(eye, (checkPos-eye).Normalize(),
-													(checkPos-eye).GetLength(), hitPos)){
-										enableObstruction = false;
-									}
-								}
-					}else{
-						enableObstruction = false;
+					// raytrace (results are computed by the acoustic query
+					// service and might be a few frames late)
+					bool enableObstruction = false;
+					if(!local) {
+						Vector3 pos = TransformVectorFromAL(position);
+						enableObstruction = internal->acoustics.GetDirectGain(pos) < 1.f;
 					}
 					
+					if(filterValid && obstructed == enableObstruction)
+						return;
+					obstructed = enableObstruction;
+					filterValid = true;
+					
 					ALuint fx = AL_EFFECTSLOT_NULL;
 					ALuint flt = AL_FILTER_NULL;
 					
@@ -362,11 +343,6 @@ namespace spades {
 			
 			std::vector<ALSrc *> srcs;
 			
-			// reverb simulator
-			int roomHistoryPos;
-			std::vector<float> roomHistory;
-			std::vector<float> roomFeedbackHistory;
-			
 			void updateEFXReverb(LPEFXEAXREVERBPROPERTIES reverb){
 				SPADES_MARK_FUNCTION_DEBUG();
 				
@@ -419,7 +395,9 @@ namespace spades {
 			}
 
 			
-			Internal() {
+			Internal():
+			acoustics(.2f),
+			obstructionPhase(0) {
 				SPADES_MARK_FUNCTION();
 				
 				if(al::qalGetString(AL_EXTENSIONS)){
@@ -484,7 +462,7 @@ namespace spades {
 				al::qalcMakeContextCurrent(alContext);
 				
 				map = NULL;
-				roomHistoryPos = 0;
+				listenerPosition = MakeVector3(0, 0, 0);
 				
 				if(s_eax){
 					try{
@@ -543,11 +521,6 @@ namespace spades {
 					ALCheckErrorPrecise();
 					al::qalFilterf(obstructionFilter, AL_LOWPASS_GAINHF, 0.1f);
 					ALCheckErrorPrecise();
-					
-					for(int i = 0; i < 128; i++){
-						roomHistory.push_back(20000.f);
-						roomFeedbackHistory.push_back(0.f);
-					}
 				}
 			}
 			~Internal() {
@@ -626,88 +599,19 @@ namespace spades {
 				ALCheckError();
 				al::qalListenerfv(AL_ORIENTATION, orient);
 				ALCheckError();
+				
+				listenerPosition = eye;
 			
 				// do reverb simulation
 				if(useEAX){
-					float maxDistance = 40.f;
-					float reflections;
-					float roomVolume;
-					float roomArea;
-					float roomSize;
-					float feedbackness = 0.f;
-					if(map == NULL){
-						reflections = 0.f;
-						roomVolume = 1.f;
-						roomArea = 1.f;
-						roomSize = 10.f;
-					}else{
-						// do raycast
-						Vector3 rayFrom = TransformVectorFromAL(eye);
-						Vector3 rayTo;
-						
-						for(int rays = 0; rays < 4; rays++){
-							rayTo.x = NextRandom() - NextRandom();
-							rayTo.y = NextRandom() - NextRandom();
-							rayTo.z = NextRandom() - NextRandom();
-							rayTo = rayTo.Normalize();
-							
-							IntVector3 hitPos;
-							bool hit = map->CastRay(rayFrom, rayTo, maxDistance, hitPos);
-							if(hit){
-								Vector3 hitPosf = {(float)hitPos.x, (float)hitPos.y, (float)hitPos.z};
-								roomHistory[roomHistoryPos] = (hitPosf - rayFrom).GetLength();
-							}else{
-								roomHistory[roomHistoryPos] = maxDistance * 2.f;
-							}
-							
-							if(hit){
-								bool hit2 = map->CastRay(rayFrom, -rayTo, maxDistance, hitPos);
-								if(hit2)
-									roomFeedbackHistory[roomHistoryPos] = 1.f;
-								else
-									roomFeedbackHistory[roomHistoryPos] = 0.f;
-							}
-							
-							roomHistoryPos++;
-							if(roomHistoryPos == (int)roomHistory.size())
-								roomHistoryPos = 0;
-						}
-						
-						// monte-carlo integration 
-						unsigned int rayHitCount = 0;
-						roomVolume = 0.f;
-						roomArea = 0.f;
-						roomSize = 0.f;
-						feedbackness = 0.f;
-						for(size_t i = 0; i < roomHistory.size(); i++){
-							float dist = roomHistory[i];
-							if(dist < maxDistance){
-								rayHitCount++;
-								roomVolume += dist * dist;
-								roomArea += dist;
-								roomSize += dist;
-							}
-							
-							feedbackness += roomFeedbackHistory[i];
-						}
-						
-						if(rayHitCount > roomHistory.size() / 4){
-							roomVolume /= (float)rayHitCount;
-							roomVolume *= 4.f / 3.f * static_cast<float>(M_PI);
-							roomArea /= (float)rayHitCount;
-							roomArea *= 4.f * static_cast<float>(M_PI);
-							roomSize /= (float)rayHitCount;
-							reflections = (float)rayHitCount / (float)roomHistory.size();
-						}else{
-							roomVolume = 8.f;
-							reflections = 0.2f;
-							roomArea = 100.f;
-							roomSize = 100.f;
-						}
-						
-						feedbackness /= (float)roomHistory.size();
-						
-					}
+					acoustics.Update(TransformVectorFromAL(eye));
+					
+					RoomParam room = acoustics.GetRoomParam();
+					float reflections = room.reflections;
+					float roomVolume = room.roomVolume;
+					float roomArea = room.roomArea;
+					float roomSize = room.roomSize;
+					float feedbackness = room.feedbackness;
 					
 					//printf("room size: %f, ref: %f, fb: %f\n", roomSize, reflections, feedbackness);
 					
@@ -738,9 +642,11 @@ namespace spades {
 					ALCheckError();
 				}
 				
-				for(size_t i = 0; i < srcs.size(); i++){
+				// update a quarter of the sources every frame
+				obstructionPhase = (obstructionPhase + 1) & 3;
+				for(size_t i = obstructionPhase; i < srcs.size(); i += 4){
 					ALSrc *s = srcs[i];
-					if((rand() % 8 == 0) && s->IsPlaying())
+					if(s->IsPlaying())
 						s->UpdateObstruction();
 				}
 			}
@@ -779,16 +685,7 @@ namespace spades {
 		ALAudioChunk *ALDevice::CreateChunk(const char *name) {
 			SPADES_MARK_FUNCTION();
 			
-			IStream *stream = NULL;
-			IAudioStream *as = NULL;
-			try{
-				stream = FileManager::OpenForReading(name);
-				as = new WavAudioStream(stream, true);
-			}catch(...){
-				if(stream)
-					delete stream;
-				throw;
-			}
+			IAudioStream *as = AudioSampleCache::GetInstance().OpenStream(name);
 			
 			try{
 				ALAudioChunk *ch = new ALAudioChunk(as);
@@ -800,6 +697,13 @@ namespace spades {
 			}
 		}
 		
+		void ALDevice::PreloadSound(const char *name) {
+			SPADES_MARK_FUNCTION();
+			
+			if(chunks.find(name) == chunks.end())
+				AudioSampleCache::GetInstance().Preload(name);
+		}
+		
 		client::IAudioChunk *ALDevice::RegisterSound(const char *name) {
 			SPADES_MARK_FUNCTION();
 			
@@ -845,6 +749,7 @@ namespace spades {
 			d->map = mp;
             if(mp) mp->AddRef();
             if(oldMap) oldMap->Release();
+			d->acoustics.SetGameMap(mp);
 		}
 	}
 }
\ No newline at end of file
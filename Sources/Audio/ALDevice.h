@@ -42,6 +42,7 @@ namespace spades {
 			static bool TryLoad();
 			
 			virtual client::IAudioChunk *RegisterSound(const char *name);
+			virtual void PreloadSound(const char *name);
 			
 			virtual void SetGameMap(client::GameMap *);
 			
@@ -0,0 +1,256 @@
+/*
+ Copyright (c) 2013 yvt
+ 
+ This file is part of OpenSpades.
+ 
+ OpenSpades is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+ 
+ OpenSpades is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with OpenSpades.  If not, see <http://www.gnu.org/licenses/>.
+ 
+ */
+
+
+#include "AcousticQueryService.h"
+#include <Client/GameMap.h>
+#include <Core/AutoLocker.h>
+#include <Core/ConcurrentDispatch.h>
+#include <Core/Debug.h>
+#include <Core/Settings.h>
+#include <cmath>
+
+SPADES_SETTING(s_acousticStatistics, "0");
+
+namespace spades {
+	namespace audio {
+		
+		namespace {
+			// results older than this are queried again even if
+			// the listener didn't move (the map might have changed)
+			const int StaleFrames = 30;
+			
+			// entries not used for this many frames are discarded
+			const int PurgeFrames = 120;
+			
+			const float CellSize = .25f;
+			const float EyeTolerance = .5f;
+		}
+		
+		AcousticQueryService::AcousticQueryService(float openAirReflections):
+		frame(0),
+		roomEstimator(openAirReflections),
+		batchNumRays(0),
+		batchTime(0.),
+		batchRunning(false),
+		lastNumRays(0),
+		lastNumQueries(0),
+		lastBatchTime(0.),
+		statNumBatches(0),
+		statNumRays(0),
+		statTime(0.) {
+			eye = MakeVector3(0, 0, 0);
+			room.reflections = 0.f;
+			room.roomVolume = 1.f;
+			room.roomArea = 1.f;
+			room.roomSize = 10.f;
+			room.feedbackness = 0.f;
+		}
+		
+		AcousticQueryService::~AcousticQueryService() {
+			SPADES_MARK_FUNCTION();
+			if(dispatch)
+				dispatch->Join();
+		}
+		
+		uint64_t AcousticQueryService::MakeKey(const Vector3& v) {
+			uint64_t x = static_cast<uint64_t>(static_cast<int64_t>(floorf(v.x / CellSize))) & 0x1fffff;
+			uint64_t y = static_cast<uint64_t>(static_cast<int64_t>(floorf(v.y / CellSize))) & 0x1fffff;
+			uint64_t z = static_cast<uint64_t>(static_cast<int64_t>(floorf(v.z / CellSize))) & 0x1fffff;
+			return x | (y << 21) | (z << 42);
+		}
+		
+		void AcousticQueryService::SetGameMap(client::GameMap *m) {
+			SPADES_MARK_FUNCTION();
+			AutoLocker lock(&mutex);
+			map = m;
+			entries.clear();
+			pendingQueries.clear();
+		}
+		
+		RoomParam AcousticQueryService::GetRoomParam() {
+			AutoLocker lock(&mutex);
+			return room;
+		}
+		
+		float AcousticQueryService::GetDirectGain(const Vector3& origin) {
+			AutoLocker lock(&mutex);
+			if(!map)
+				return 1.f;
+			
+			uint64_t key = MakeKey(origin);
+			auto it = entries.find(key);
+			if(it == entries.end()) {
+				ObstructionEntry e;
+				e.origin = origin;
+				e.eye = eye;
+				e.directGain = 1.f;
+				e.updatedFrame = frame;
+				e.usedFrame = frame;
+				e.valid = false;
+				e.pending = false;
+				it = entries.insert(std::make_pair(key, e)).first;
+			}
+			
+			ObstructionEntry& e = it->second;
+			e.usedFrame = frame;
+			
+			bool stale = !e.valid ||
+			(e.eye - eye).GetPoweredLength() > EyeTolerance * EyeTolerance ||
+			frame - e.updatedFrame > StaleFrames;
+			if(stale && !e.pending) {
+				ObstructionQuery q;
+				q.key = key;
+				q.origin = origin;
+				q.directGain = 1.f;
+				q.done = false;
+				pendingQueries.push_back(q);
+				e.pending = true;
+			}
+			
+			return e.directGain;
+		}
+		
+		void AcousticQueryService::Update(const Vector3& eye) {
+			SPADES_MARK_FUNCTION();
+			
+			{
+				AutoLocker lock(&mutex);
+				this->eye = eye;
+				frame++;
+			}
+			
+			if(dispatch) {
+				if(batchRunning) {
+					// still busy; try again in the next frame
+					return;
+				}
+				dispatch->Join();
+				dispatch.reset();
+				FinishBatch();
+			}
+			
+			{
+				AutoLocker lock(&mutex);
+				batchQueries.swap(pendingQueries);
+				pendingQueries.clear();
+				batchEye = eye;
+				batchMap = map;
+				
+				for(auto it = entries.begin(); it != entries.end();) {
+					const ObstructionEntry& e = it->second;
+					if(!e.pending && frame - e.usedFrame > PurgeFrames)
+						it = entries.erase(it);
+					else
+						++it;
+				}
+			}
+			
+			batchRunning = true;
+			auto f = [this]() {
+				RunBatch();
+				batchRunning = false;
+			};
+			dispatch.reset(new FunctionDispatch<decltype(f)>(f));
+			dispatch->Start();
+		}
+		
+		void AcousticQueryService::RunBatch() {
+			SPADES_MARK_FUNCTION();
+			
+			Stopwatch sw;
+			client::GameMap *m = batchMap;
+			
+			batchRoom = roomEstimator.Update(m, batchEye);
+			int numRays = roomEstimator.GetLastNumRays();
+			
+			for(auto& q: batchQueries) {
+				q.done = true;
+				if(m == nullptr) {
+					q.directGain = 1.f;
+					continue;
+				}
+				
+				// the source is audible directly if any of the rays
+				// around it reaches the listener
+				Vector3 pos = q.origin;
+				Vector3 checkPos;
+				q.directGain = 0.4f;
+				for(int i = 0; i < 27; i++) {
+					int x = i % 3 - 1, y = (i / 3) % 3 - 1, z = i / 9 - 1;
+					IntVector3 hitPos;
+					checkPos.x = pos.x + (float)x * .2f;
+					checkPos.y = pos.y + (float)y * .2f;
+					checkPos.z = pos.z + (float)z * .2f;
+					numRays++;
+					if(!m->CastRay(batchEye, (checkPos-batchEye).Normalize(),
+								   (checkPos-batchEye).GetLength(), hitPos)){
+						q.directGain = 1.f;
+						break;
+					}
+				}
+			}
+			
+			batchNumRays = numRays;
+			batchTime = sw.GetTime();
+		}
+		
+		void AcousticQueryService::FinishBatch() {
+			SPADES_MARK_FUNCTION();
+			
+			{
+				AutoLocker lock(&mutex);
+				room = batchRoom;
+				for(const auto& q: batchQueries) {
+					auto it = entries.find(q.key);
+					if(it == entries.end())
+						continue;
+					ObstructionEntry& e = it->second;
+					e.directGain = q.directGain;
+					e.eye = batchEye;
+					e.updatedFrame = frame;
+					e.valid = true;
+					e.pending = false;
+				}
+			}
+			
+			lastNumRays = batchNumRays;
+			lastNumQueries = static_cast<int>(batchQueries.size());
+			lastBatchTime = batchTime;
+			batchQueries.clear();
+			batchMap = nullptr;
+			
+			statNumBatches++;
+			statNumRays += lastNumRays;
+			statTime += lastBatchTime;
+			if(statStopwatch.GetTime() >= 1.) {
+				if(s_acousticStatistics && statNumBatches > 0) {
+					SPLog("Acoustic queries: %.1f ray(s)/frame, %.3fms/frame",
+						  (double)statNumRays / statNumBatches,
+						  statTime * 1000. / statNumBatches);
+				}
+				statStopwatch.Reset();
+				statNumBatches = 0;
+				statNumRays = 0;
+				statTime = 0.;
+			}
+		}
+	}
+}
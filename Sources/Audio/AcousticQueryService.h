@@ -0,0 +1,125 @@
+/*
+ Copyright (c) 2013 yvt
+ 
+ This file is part of OpenSpades.
+ 
+ OpenSpades is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+ 
+ OpenSpades is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with OpenSpades.  If not, see <http://www.gnu.org/licenses/>.
+ 
+ */
+
+
+#pragma once
+
+#include <Core/Math.h>
+#include <Core/Mutex.h>
+#include <Core/RefCountedObject.h>
+#include <Core/Stopwatch.h>
+#include <atomic>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+#include "RoomEstimator.h"
+
+namespace spades {
+	class ConcurrentDispatch;
+	namespace client {
+		class GameMap;
+	}
+	namespace audio {
+		
+		/** Collects the ray queries audio devices need (room estimation
+		 * and obstruction of sound sources), runs them as one batch per
+		 * frame on a dispatch thread and caches the results.
+		 *
+		 * Obstruction results are keyed by the quantized source position
+		 * and reused until the listener moves or they get old, so
+		 * a query might return a result that is a few frames late. */
+		class AcousticQueryService {
+			struct ObstructionEntry {
+				Vector3 origin;
+				Vector3 eye; // listener position used for the last result
+				float directGain;
+				int updatedFrame;
+				int usedFrame;
+				bool valid;
+				bool pending;
+			};
+			
+			struct ObstructionQuery {
+				uint64_t key;
+				Vector3 origin;
+				float directGain;
+				bool done;
+			};
+			
+			Mutex mutex;
+			std::unordered_map<uint64_t, ObstructionEntry> entries;
+			std::vector<ObstructionQuery> pendingQueries;
+			RoomParam room;
+			Vector3 eye;
+			int frame;
+			
+			Handle<client::GameMap> map;
+			
+			// only accessed by the running batch
+			RoomEstimator roomEstimator;
+			std::vector<ObstructionQuery> batchQueries;
+			Vector3 batchEye;
+			Handle<client::GameMap> batchMap;
+			RoomParam batchRoom;
+			int batchNumRays;
+			double batchTime;
+			
+			std::unique_ptr<ConcurrentDispatch> dispatch;
+			std::atomic<bool> batchRunning;
+			
+			// statistics of the last completed batch
+			int lastNumRays;
+			int lastNumQueries;
+			double lastBatchTime;
+			
+			Stopwatch statStopwatch;
+			int statNumBatches;
+			int statNumRays;
+			double statTime;
+			
+			static uint64_t MakeKey(const Vector3&);
+			
+			void RunBatch();
+			void FinishBatch();
+		public:
+			AcousticQueryService(float openAirReflections = 0.1f);
+			~AcousticQueryService();
+			
+			void SetGameMap(client::GameMap *);
+			
+			/** Collects the result of the previous batch (if it has
+			 * completed) and starts a new batch for the listener at `eye`.
+			 * Should be called once per frame. */
+			void Update(const Vector3& eye);
+			
+			/** Returns the latest room estimation. */
+			RoomParam GetRoomParam();
+			
+			/** Returns the gain of the direct path from `origin` to
+			 * the listener (1 when not obstructed). Thread-safe.
+			 * Missing or stale results are scheduled for the next batch. */
+			float GetDirectGain(const Vector3& origin);
+			
+			int GetLastNumRays() const { return lastNumRays; }
+			int GetLastNumQueries() const { return lastNumQueries; }
+			double GetLastBatchTime() const { return lastBatchTime; }
+		};
+	}
+}
@@ -0,0 +1,238 @@
+/*
+ Copyright (c) 2013 yvt
+ 
+ This file is part of OpenSpades.
+ 
+ OpenSpades is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+ 
+ OpenSpades is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with OpenSpades.  If not, see <http://www.gnu.org/licenses/>.
+ 
+ */
+
+
+#include "AudioSampleCache.h"
+#include <Core/AutoLocker.h>
+#include <Core/ConcurrentDispatch.h>
+#include <Core/Debug.h>
+#include <Core/Exception.h>
+#include <Core/FileManager.h>
+#include <Core/MemoryStream.h>
+#include <Core/Settings.h>
+#include <Core/WavAudioStream.h>
+#include <algorithm>
+#include <cstring>
+
+SPADES_SETTING(s_sampleCacheSize, "32");
+SPADES_SETTING(s_samplePreload, "1");
+
+namespace spades {
+	namespace audio {
+		
+		/** IAudioStream that reads a cached AudioSample. */
+		class CachedAudioStream: public IAudioStream {
+			std::shared_ptr<AudioSample> sample;
+			uint64_t position;
+		public:
+			CachedAudioStream(std::shared_ptr<AudioSample> sample):
+			sample(sample), position(0) {}
+			
+			virtual uint64_t GetLength() { return sample->data.size(); }
+			virtual int GetSamplingFrequency() { return sample->samplingFrequency; }
+			virtual SampleFormat GetSampleFormat() { return sample->sampleFormat; }
+			virtual int GetNumChannels() { return sample->numChannels; }
+			
+			virtual int ReadByte() {
+				if(position >= sample->data.size())
+					return -1;
+				return static_cast<unsigned char>(sample->data[position++]);
+			}
+			virtual size_t Read(void *buf, size_t bytes) {
+				uint64_t len = sample->data.size();
+				if(position >= len)
+					return 0;
+				if(bytes > len - position)
+					bytes = static_cast<size_t>(len - position);
+				std::memcpy(buf, sample->data.data() + position, bytes);
+				position += bytes;
+				return bytes;
+			}
+			
+			virtual uint64_t GetPosition() { return position; }
+			virtual void SetPosition(uint64_t pos) { position = pos; }
+		};
+		
+		AudioSampleCache::AudioSampleCache():
+		totalBytes(0),
+		useCounter(0) {
+		}
+		
+		AudioSampleCache::~AudioSampleCache() {
+		}
+		
+		AudioSampleCache& AudioSampleCache::GetInstance() {
+			// never destroyed because loaders might still be running
+			// while static objects are destroyed
+			static AudioSampleCache *instance = new AudioSampleCache();
+			return *instance;
+		}
+		
+		std::shared_ptr<AudioSample> AudioSampleCache::Load(const std::string& name) {
+			SPADES_MARK_FUNCTION();
+			
+			// loaders read one file at a time; reading the pak from
+			// several threads at once only makes the disk seek
+			std::string bytes;
+			{
+				static Mutex readMutex;
+				AutoLocker lock(&readMutex);
+				bytes = FileManager::ReadAllBytes(name.c_str());
+			}
+			MemoryStream stream(bytes.data(), bytes.size());
+			WavAudioStream wav(&stream, false);
+			
+			std::shared_ptr<AudioSample> sample = std::make_shared<AudioSample>();
+			sample->samplingFrequency = wav.GetSamplingFrequency();
+			sample->sampleFormat = wav.GetSampleFormat();
+			sample->numChannels = wav.GetNumChannels();
+			sample->data.resize(static_cast<std::size_t>(wav.GetLength()));
+			wav.SetPosition(0);
+			if(wav.Read(sample->data.data(), sample->data.size()) < sample->data.size()) {
+				SPRaise("Failed to read audio data: %s", name.c_str());
+			}
+			return sample;
+		}
+		
+		void AudioSampleCache::Trim() {
+			std::size_t budget = static_cast<std::size_t>(std::max((int)s_sampleCacheSize, 0)) << 20;
+			while(totalBytes > budget) {
+				auto victim = entries.end();
+				for(auto it = entries.begin(); it != entries.end(); ++it) {
+					const Entry& e = it->second;
+					if(e.loading || !e.sample)
+						continue;
+					if(victim == entries.end() || e.lastUsed < victim->second.lastUsed)
+						victim = it;
+				}
+				if(victim == entries.end())
+					break;
+				totalBytes -= victim->second.sample->data.size();
+				if(victim->second.loader)
+					retiredLoaders.push_back(victim->second.loader);
+				entries.erase(victim);
+			}
+		}
+		
+		void AudioSampleCache::ReleaseRetiredLoaders() {
+			std::vector<std::shared_ptr<ConcurrentDispatch>> loaders;
+			{
+				AutoLocker lock(&mutex);
+				loaders.swap(retiredLoaders);
+			}
+			// destroying them joins the loaders, which might be
+			// waiting for `mutex`
+			loaders.clear();
+		}
+		
+		void AudioSampleCache::Preload(const std::string& name) {
+			SPADES_MARK_FUNCTION();
+			
+			if(!s_samplePreload)
+				return;
+			ReleaseRetiredLoaders();
+			
+			AutoLocker lock(&mutex);
+			if(entries.find(name) != entries.end())
+				return;
+			
+			Entry& entry = entries[name];
+			entry.lastUsed = ++useCounter;
+			entry.loading = true;
+			
+			auto f = [this, name]() {
+				std::shared_ptr<AudioSample> sample;
+				std::string error;
+				try {
+					sample = Load(name);
+				}catch(const std::exception& ex) {
+					error = ex.what();
+				}
+				
+				AutoLocker lock(&mutex);
+				Entry& e = entries[name];
+				e.sample = sample;
+				e.error = error;
+				e.loading = false;
+				if(sample) {
+					totalBytes += sample->data.size();
+					Trim();
+				}
+			};
+			entry.loader = std::make_shared<FunctionDispatch<decltype(f)>>(f);
+			entry.loader->Start();
+			
+			Trim();
+		}
+		
+		std::shared_ptr<AudioSample> AudioSampleCache::Take(const std::string& name) {
+			SPADES_MARK_FUNCTION();
+			
+			ReleaseRetiredLoaders();
+			
+			while(true) {
+				std::shared_ptr<ConcurrentDispatch> loader;
+				{
+					AutoLocker lock(&mutex);
+					auto it = entries.find(name);
+					if(it == entries.end())
+						break;
+					
+					Entry& e = it->second;
+					if(e.loading) {
+						loader = e.loader;
+					}else{
+						// the device copies the sample into its own chunk,
+						// so the cache lets go of it now
+						std::shared_ptr<AudioSample> sample = e.sample;
+						std::string error = e.error;
+						if(e.loader)
+							retiredLoaders.push_back(e.loader);
+						if(sample)
+							totalBytes -= sample->data.size();
+						entries.erase(it);
+						if(!sample)
+							SPRaise("Failed to load %s: %s", name.c_str(), error.c_str());
+						return sample;
+					}
+				}
+				
+				// wait for the preload to complete
+				AutoLocker lock(&joinMutex);
+				loader->Join();
+			}
+			
+			// not preloaded; decode on this thread
+			return Load(name);
+		}
+		
+		IAudioStream *AudioSampleCache::OpenStream(const std::string& name) {
+			return new CachedAudioStream(Take(name));
+		}
+		
+		void AudioSampleCache::LogStatistics() {
+			AutoLocker lock(&mutex);
+			SPLog("Sample cache: %d sample(s), %.1f MB decoded (budget: %d MB)",
+				  static_cast<int>(entries.size()),
+				  static_cast<double>(totalBytes) / (1024. * 1024.),
+				  (int)s_sampleCacheSize);
+		}
+	}
+}
@@ -0,0 +1,98 @@
+/*
+ Copyright (c) 2013 yvt
+ 
+ This file is part of OpenSpades.
+ 
+ OpenSpades is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+ 
+ OpenSpades is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with OpenSpades.  If not, see <http://www.gnu.org/licenses/>.
+ 
+ */
+
+
+#pragma once
+
+#include <Core/IAudioStream.h>
+#include <Core/Mutex.h>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace spades {
+	class ConcurrentDispatch;
+	
+	namespace audio {
+		
+		/** Decoded PCM data of a sound file. */
+		struct AudioSample {
+			int samplingFrequency;
+			IAudioStream::SampleFormat sampleFormat;
+			int numChannels;
+			std::vector<char> data;
+		};
+		
+		/** Cache of decoded sound files shared by the audio devices.
+		 * A sample stays here until a device opens it, since devices
+		 * copy it into their own chunks. The total size is limited by
+		 * `s_sampleCacheSize` (in megabytes); least recently used samples
+		 * are discarded first.
+		 * Sound files can be decoded ahead of time on the dispatch threads
+		 * with `Preload` (disabled by `s_samplePreload = 0`, for comparing
+		 * load times). */
+		class AudioSampleCache {
+			struct Entry {
+				std::shared_ptr<AudioSample> sample;
+				std::shared_ptr<ConcurrentDispatch> loader;
+				std::string error;
+				uint64_t lastUsed;
+				bool loading;
+			};
+			
+			Mutex mutex;
+			Mutex joinMutex;
+			std::map<std::string, Entry> entries;
+			std::size_t totalBytes;
+			uint64_t useCounter;
+			
+			// loaders of evicted entries. Trim can run on a loader thread,
+			// which must not join (destroy) itself, so they are released
+			// by the next Preload or Take call.
+			std::vector<std::shared_ptr<ConcurrentDispatch>> retiredLoaders;
+			
+			AudioSampleCache();
+			~AudioSampleCache();
+			
+			static std::shared_ptr<AudioSample> Load(const std::string& name);
+			void Trim();
+			void ReleaseRetiredLoaders();
+		public:
+			static AudioSampleCache& GetInstance();
+			
+			/** Starts decoding the specified sound file in background. */
+			void Preload(const std::string& name);
+			
+			/** Removes the decoded sound file from the cache and returns
+			 * it, waiting for the preload to complete or decoding it on
+			 * the calling thread. */
+			std::shared_ptr<AudioSample> Take(const std::string& name);
+			
+			/** Opens a stream that reads the decoded sound file, which is
+			 * removed from the cache.
+			 * The caller must delete the returned stream. */
+			IAudioStream *OpenStream(const std::string& name);
+			
+			/** Logs the number of cached samples and their total size. */
+			void LogStatistics();
+		};
+	}
+}
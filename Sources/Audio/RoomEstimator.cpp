@@ -0,0 +1,136 @@
+/*
+ Copyright (c) 2013 yvt
+ 
+ This file is part of OpenSpades.
+ 
+ OpenSpades is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+ 
+ OpenSpades is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with OpenSpades.  If not, see <http://www.gnu.org/licenses/>.
+ 
+ */
+
+
+#include "RoomEstimator.h"
+#include <Client/GameMap.h>
+#include <Core/Debug.h>
+#include <algorithm>
+#include <cstdlib>
+
+namespace spades {
+	namespace audio {
+		
+		static float NextRandom() {
+			return (float)std::rand() /(float)RAND_MAX;
+		}
+		
+		RoomEstimator::RoomEstimator(float openAirReflections):
+		historyPos(0),
+		openAirReflections(openAirReflections),
+		lastNumRays(0) {
+			std::fill(history.begin(), history.end(),
+					  20000.f);
+			std::fill(feedbackHistory.begin(), feedbackHistory.end(),
+					  0.f);
+		}
+		
+		RoomParam RoomEstimator::Update(client::GameMap *map,
+										const Vector3& eye) {
+			SPADES_MARK_FUNCTION();
+			
+			RoomParam param;
+			float maxDistance = 40.f;
+			param.feedbackness = 0.f;
+			lastNumRays = 0;
+			
+			if(map == NULL){
+				param.reflections = 0.f;
+				param.roomVolume = 1.f;
+				param.roomArea = 1.f;
+				param.roomSize = 10.f;
+				return param;
+			}
+			
+			// do raycast
+			Vector3 rayFrom = eye;
+			Vector3 rayTo;
+			
+			for(int rays = 0; rays < 4; rays++){
+				rayTo.x = NextRandom() - NextRandom();
+				rayTo.y = NextRandom() - NextRandom();
+				rayTo.z = NextRandom() - NextRandom();
+				rayTo = rayTo.Normalize();
+				
+				IntVector3 hitPos;
+				bool hit = map->CastRay(rayFrom, rayTo, maxDistance, hitPos);
+				lastNumRays++;
+				if(hit){
+					Vector3 hitPosf = {(float)hitPos.x, (float)hitPos.y, (float)hitPos.z};
+					history[historyPos] = (hitPosf - rayFrom).GetLength();
+				}else{
+					history[historyPos] = maxDistance * 2.f;
+				}
+				
+				if(hit){
+					bool hit2 = map->CastRay(rayFrom, -rayTo, maxDistance, hitPos);
+					lastNumRays++;
+					if(hit2)
+						feedbackHistory[historyPos] = 1.f;
+					else
+						feedbackHistory[historyPos] = 0.f;
+				}
+				
+				historyPos++;
+				if(historyPos == (int)history.size())
+					historyPos = 0;
+			}
+			
+			// monte-carlo integration
+			unsigned int rayHitCount = 0;
+			float roomVolume = 0.f;
+			float roomArea = 0.f;
+			float roomSize = 0.f;
+			float feedbackness = 0.f;
+			for(size_t i = 0; i < history.size(); i++){
+				float dist = history[i];
+				if(dist < maxDistance){
+					rayHitCount++;
+					roomVolume += dist * dist;
+					roomArea += dist;
+					roomSize += dist;
+				}
+				
+				feedbackness += feedbackHistory[i];
+			}
+			
+			if(rayHitCount > history.size() / 4){
+				roomVolume /= (float)rayHitCount;
+				roomVolume *= 4.f / 3.f * static_cast<float>(M_PI);
+				roomArea /= (float)rayHitCount;
+				roomArea *= 4.f * static_cast<float>(M_PI);
+				roomSize /= (float)rayHitCount;
+				param.reflections = (float)rayHitCount / (float)history.size();
+			}else{
+				roomVolume = 8.f;
+				param.reflections = openAirReflections;
+				roomArea = 100.f;
+				roomSize = 100.f;
+			}
+			
+			param.roomVolume = roomVolume;
+			param.roomArea = roomArea;
+			param.roomSize = roomSize;
+			param.feedbackness = feedbackness / (float)history.size();
+			
+			return param;
+		}
+	}
+}
@@ -0,0 +1,62 @@
+/*
+ Copyright (c) 2013 yvt
+ 
+ This file is part of OpenSpades.
+ 
+ OpenSpades is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+ 
+ OpenSpades is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with OpenSpades.  If not, see <http://www.gnu.org/licenses/>.
+ 
+ */
+
+
+#pragma once
+
+#include <Core/Math.h>
+#include <array>
+
+namespace spades {
+	namespace client {
+		class GameMap;
+	}
+	namespace audio {
+		
+		struct RoomParam {
+			float reflections;
+			float roomVolume;
+			float roomArea;
+			float roomSize;
+			float feedbackness;
+		};
+		
+		/** Estimates the acoustic properties of the room around the listener
+		 * by casting a few random rays every frame and integrating the
+		 * results over the recent frames. */
+		class RoomEstimator {
+			int historyPos;
+			enum { HistorySize = 128 };
+			std::array<float, HistorySize> history;
+			std::array<float, HistorySize> feedbackHistory;
+			float openAirReflections;
+			int lastNumRays;
+		public:
+			/** @param openAirReflections reflections reported when
+			 *        most of the rays don't hit anything. */
+			RoomEstimator(float openAirReflections = 0.1f);
+			
+			RoomParam Update(client::GameMap *, const Vector3& eye);
+			
+			/** Returns the number of rays cast by the last `Update`. */
+			int GetLastNumRays() const { return lastNumRays; }
+		};
+	}
+}
@@ -0,0 +1,59 @@
+/*
+ Copyright (c) 2013 yvt
+ 
+ This file is part of OpenSpades.
+ 
+ OpenSpades is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+ 
+ OpenSpades is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with OpenSpades.  If not, see <http://www.gnu.org/licenses/>.
+ 
+ */
+
+
+#pragma once
+
+#include "../Imports/SDL.h"
+#include <Core/Debug.h>
+
+namespace spades {
+	namespace audio {
+		
+		/** RAII wrapper of an SDL audio device. */
+		struct SdlAudioDevice {
+			SDL_AudioDeviceID id;
+			SDL_AudioSpec spec;
+			
+			SdlAudioDevice(const char *deviceId,
+						   int isCapture,
+						   const SDL_AudioSpec& spec,
+						   int allowedChanges):
+			id(0){
+				SDL_InitSubSystem(SDL_INIT_AUDIO);
+				id = SDL_OpenAudioDevice(deviceId, isCapture,
+										 &spec, &this->spec,
+										 allowedChanges);
+				if(id == 0){
+					SPRaise("Failed to initialize the audio device: %s", SDL_GetError());
+				}
+			}
+			
+			~SdlAudioDevice() {
+				if(id != 0)
+					SDL_CloseAudioDevice(id);
+			}
+			
+			SDL_AudioDeviceID operator()() const {
+				return id;
+			}
+		};
+	}
+}
@@ -0,0 +1,965 @@
+/*
+ Copyright (c) 2013 yvt
+ 
+ This file is part of OpenSpades.
+ 
+ OpenSpades is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+ 
+ OpenSpades is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with OpenSpades.  If not, see <http://www.gnu.org/licenses/>.
+ 
+ */
+
+
+#include "SoftDevice.h"
+#include "SdlAudioDevice.h"
+#include "AudioSampleCache.h"
+#include <Client/IAudioChunk.h>
+#include <Client/GameMap.h>
+#include <Core/Settings.h>
+#include <Core/FileManager.h>
+#include <Core/IAudioStream.h>
+#include <Core/WavAudioStream.h>
+#include <Core/IStream.h>
+#include <Core/Mutex.h>
+#include <Core/AutoLocker.h>
+#include <Core/Thread.h>
+#include <Core/Stopwatch.h>
+#include <Core/RefCountedObject.h>
+#include <algorithm>
+#include <array>
+#include <vector>
+#include <cmath>
+#include <cstring>
+#include <utility>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SOFT_USE_SSE2 1
+#else
+#define SOFT_USE_SSE2 0
+#endif
+
+SPADES_SETTING(s_maxPolyphonics, "");
+SPADES_SETTING(s_softBufferSize, "1024");
+SPADES_SETTING(s_softOutputFile, "");
+SPADES_SETTING(s_softReverb, "1");
+SPADES_SETTING(s_softStatistics, "0");
+
+namespace spades {
+	namespace audio {
+		
+#pragma mark - Chunk
+		
+		/** Sound decoded into floating point samples. */
+		class SoftAudioChunk: public client::IAudioChunk {
+			// interleaved, followed by one silent frame so that
+			// the interpolation never reads past the end.
+			std::vector<float> samples;
+			int numChannels;
+			std::size_t numFrames;
+			float samplingRate;
+		protected:
+			virtual ~SoftAudioChunk() {}
+		public:
+			SoftAudioChunk(IAudioStream *stream) {
+				SPADES_MARK_FUNCTION();
+				
+				numChannels = stream->GetNumChannels();
+				if(numChannels < 1 || numChannels > 2) {
+					SPRaise("Unsupported channel count");
+				}
+				if(stream->GetNumSamples() > 128 * 1024 * 1024) {
+					SPRaise("Audio data too long");
+				}
+				numFrames = static_cast<std::size_t>(stream->GetNumSamples());
+				samplingRate = static_cast<float>(stream->GetSamplingFrequency());
+				
+				std::vector<char> bytes(numFrames * stream->GetStride());
+				stream->SetPosition(0);
+				if(stream->Read(bytes.data(), bytes.size()) < bytes.size()) {
+					SPRaise("Failed to read audio data");
+				}
+				
+				std::size_t count = numFrames * numChannels;
+				samples.resize(count + numChannels, 0.f);
+				switch(stream->GetSampleFormat()) {
+					case IAudioStream::UnsignedByte:
+						for(std::size_t i = 0; i < count; i++) {
+							uint8_t v = static_cast<uint8_t>(bytes[i]);
+							samples[i] = static_cast<float>(static_cast<int>(v) - 128) * (1.f / 128.f);
+						}
+						break;
+					case IAudioStream::SignedShort:
+						for(std::size_t i = 0; i < count; i++) {
+							uint8_t lo = static_cast<uint8_t>(bytes[i * 2]);
+							uint8_t hi = static_cast<uint8_t>(bytes[i * 2 + 1]);
+							int16_t v = static_cast<int16_t>(lo | (hi << 8));
+							samples[i] = static_cast<float>(v) * (1.f / 32768.f);
+						}
+						break;
+					case IAudioStream::SingleFloat:
+						std::memcpy(samples.data(), bytes.data(), count * sizeof(float));
+						break;
+					default:
+						SPRaise("Unsupported audio format");
+				}
+			}
+			
+			/** Creates a chunk from interleaved samples; used by the benchmark. */
+			SoftAudioChunk(std::vector<float> data, int numChannels, float samplingRate):
+			samples(std::move(data)),
+			numChannels(numChannels),
+			samplingRate(samplingRate) {
+				numFrames = samples.size() / numChannels;
+				samples.resize(numFrames * numChannels + numChannels, 0.f);
+			}
+			
+			const float *GetSamples() const { return samples.data(); }
+			int GetNumChannels() const { return numChannels; }
+			std::size_t GetNumFrames() const { return numFrames; }
+			float GetSamplingRate() const { return samplingRate; }
+		};
+		
+#pragma mark - DSP
+		
+		/** Resamples `src` (`numChannels` interleaved channels) with linear
+		 * interpolation and adds it to the interleaved stereo `out` with
+		 * linearly ramped gains. When `send` is given, the average of both
+		 * channels is added to it as well. Mono sources are mixed as if
+		 * both channels carried the same signal. */
+		static void ResampleAndMix(const float *src, int numChannels,
+								   double position, double step,
+								   float *out, float *send, int count,
+								   float gainLeft, float gainRight, float gainSend,
+								   float deltaLeft, float deltaRight, float deltaSend) {
+			int i = 0;
+			gainSend *= .5f;
+			deltaSend *= .5f;
+#if SOFT_USE_SSE2
+			// two output frames per iteration; lanes are (l0, r0, l1, r1).
+			// positions are computed in double precision so that the result
+			// matches the scalar path bit-for-bit.
+			__m128d posv = _mm_set1_pd(position);
+			__m128d stepv = _mm_set1_pd(step);
+			__m128d offs = _mm_setr_pd(0., 1.);
+			__m128 gain = _mm_setr_ps(gainLeft, gainRight,
+									  gainLeft + deltaLeft, gainRight + deltaRight);
+			__m128 gainDelta = _mm_setr_ps(deltaLeft * 2.f, deltaRight * 2.f,
+										   deltaLeft * 2.f, deltaRight * 2.f);
+			__m128 sendGain = _mm_setr_ps(gainSend, gainSend,
+										  gainSend + deltaSend, gainSend + deltaSend);
+			__m128 sendDelta = _mm_set1_ps(deltaSend * 2.f);
+			for(; i + 2 <= count; i += 2) {
+				__m128d n = _mm_add_pd(_mm_set1_pd(static_cast<double>(i)), offs);
+				__m128d p = _mm_add_pd(posv, _mm_mul_pd(stepv, n));
+				__m128i idx = _mm_cvttpd_epi32(p);
+				__m128 t = _mm_cvtpd_ps(_mm_sub_pd(p, _mm_cvtepi32_pd(idx)));
+				t = _mm_unpacklo_ps(t, t); // t0, t0, t1, t1
+				
+				int idx0 = _mm_cvtsi128_si32(idx);
+				int idx1 = _mm_cvtsi128_si32(_mm_shuffle_epi32(idx, _MM_SHUFFLE(1, 1, 1, 1)));
+				__m128 a, b;
+				if(numChannels == 2) {
+					// one load fetches both channels of both neighbours
+					__m128 v0 = _mm_loadu_ps(src + idx0 * 2);
+					__m128 v1 = _mm_loadu_ps(src + idx1 * 2);
+					a = _mm_movelh_ps(v0, v1);
+					b = _mm_movehl_ps(v1, v0);
+				}else{
+					__m128 v = _mm_loadl_pi(_mm_setzero_ps(), reinterpret_cast<const __m64 *>(src + idx0));
+					v = _mm_loadh_pi(v, reinterpret_cast<const __m64 *>(src + idx1));
+					a = _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 2, 0, 0));
+					b = _mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 3, 1, 1));
+				}
+				__m128 s = _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(b, a), t));
+				
+				__m128 o = _mm_loadu_ps(out + i * 2);
+				_mm_storeu_ps(out + i * 2, _mm_add_ps(o, _mm_mul_ps(s, gain)));
+				gain = _mm_add_ps(gain, gainDelta);
+				
+				if(send) {
+					__m128 w = _mm_mul_ps(s, sendGain);
+					w = _mm_add_ps(w, _mm_shuffle_ps(w, w, _MM_SHUFFLE(2, 3, 0, 1)));
+					w = _mm_shuffle_ps(w, w, _MM_SHUFFLE(2, 0, 2, 0));
+					__m128 d = _mm_loadl_pi(_mm_setzero_ps(), reinterpret_cast<const __m64 *>(send + i));
+					_mm_storel_pi(reinterpret_cast<__m64 *>(send + i), _mm_add_ps(d, w));
+					sendGain = _mm_add_ps(sendGain, sendDelta);
+				}
+			}
+			gainLeft += deltaLeft * static_cast<float>(i);
+			gainRight += deltaRight * static_cast<float>(i);
+			gainSend += deltaSend * static_cast<float>(i);
+#endif
+			for(; i < count; i++) {
+				double p = position + step * static_cast<double>(i);
+				std::size_t idx = static_cast<std::size_t>(p);
+				float t = static_cast<float>(p - static_cast<double>(idx));
+				float l, r;
+				if(numChannels == 2) {
+					const float *s = src + idx * 2;
+					l = s[0] + (s[2] - s[0]) * t;
+					r = s[1] + (s[3] - s[1]) * t;
+				}else{
+					l = r = src[idx] + (src[idx + 1] - src[idx]) * t;
+				}
+				out[i * 2] += l * gainLeft;
+				out[i * 2 + 1] += r * gainRight;
+				gainLeft += deltaLeft;
+				gainRight += deltaRight;
+				if(send) {
+					send[i] += l * gainSend + r * gainSend;
+					gainSend += deltaSend;
+				}
+			}
+		}
+		
+		static void Clip(float *buffer, int count) {
+			int i = 0;
+#if SOFT_USE_SSE2
+			__m128 maxv = _mm_set1_ps(1.f);
+			__m128 minv = _mm_set1_ps(-1.f);
+			for(; i + 4 <= count; i += 4) {
+				__m128 v = _mm_loadu_ps(buffer + i);
+				v = _mm_min_ps(_mm_max_ps(v, minv), maxv);
+				_mm_storeu_ps(buffer + i, v);
+			}
+#endif
+			for(; i < count; i++) {
+				buffer[i] = std::max(std::min(buffer[i], 1.f), -1.f);
+			}
+		}
+		
+		/** Schroeder-Moorer reverberator whose parameters are driven by
+		 * the room estimation. */
+		class SoftReverb {
+			struct Comb {
+				std::vector<float> buffer;
+				std::size_t pos;
+				float filterState;
+				float feedback;
+			};
+			struct Allpass {
+				std::vector<float> buffer;
+				std::size_t pos;
+			};
+			
+			// [0, 4) for the left channel and [4, 8) for the right one
+			std::array<Comb, 8> combs;
+			std::array<Allpass, 4> allpasses;
+			
+			std::vector<float> preDelay;
+			std::size_t preDelayPos;
+			std::size_t preDelayLength;
+			
+			int samplingRate;
+			float wetGain;
+			float damping;
+		public:
+			SoftReverb(int samplingRate):
+			preDelayPos(0),
+			preDelayLength(1),
+			samplingRate(samplingRate),
+			wetGain(0.f),
+			damping(0.2f) {
+				static const int combDelays[] = {1116, 1188, 1277, 1356};
+				static const int allpassDelays[] = {556, 441};
+				static const int stereoSpread = 23;
+				float scale = static_cast<float>(samplingRate) / 44100.f;
+				
+				for(int i = 0; i < 8; i++) {
+					int delay = combDelays[i & 3] + (i >= 4 ? stereoSpread : 0);
+					auto& comb = combs[i];
+					comb.buffer.resize(std::max(static_cast<int>(delay * scale), 1), 0.f);
+					comb.pos = 0;
+					comb.filterState = 0.f;
+					comb.feedback = 0.f;
+				}
+				for(int i = 0; i < 4; i++) {
+					int delay = allpassDelays[i & 1] + (i >= 2 ? stereoSpread : 0);
+					auto& ap = allpasses[i];
+					ap.buffer.resize(std::max(static_cast<int>(delay * scale), 1), 0.f);
+					ap.pos = 0;
+				}
+				
+				preDelay.resize(static_cast<std::size_t>(samplingRate * 0.3f) + 1, 0.f);
+			}
+			
+			void SetRoom(const RoomParam& room) {
+				// same mapping as the EAX reverb of ALDevice
+				float decayTime = .161f * room.roomVolume / std::max(room.roomArea, 1.e-3f) / .4f;
+				decayTime = std::max(std::min(decayTime, 20.f), .1f);
+				
+				for(auto& comb: combs) {
+					float delay = static_cast<float>(comb.buffer.size()) /
+					static_cast<float>(samplingRate);
+					comb.feedback = powf(10.f, -3.f * delay / decayTime);
+					comb.feedback = std::min(comb.feedback, .98f);
+				}
+				
+				float reflections = room.reflections;
+				float feedbackness = room.feedbackness;
+				wetGain = reflections * .25f +
+				reflections * reflections * reflections * reflections *
+				feedbackness * feedbackness * feedbackness * .34f;
+				
+				float delay = std::min(room.roomSize / 324.f, .3f);
+				preDelayLength = static_cast<std::size_t>(delay * samplingRate);
+				preDelayLength = std::max<std::size_t>(preDelayLength, 1);
+				preDelayLength = std::min(preDelayLength, preDelay.size());
+			}
+			
+			void Process(const float *input, float *out, int count) {
+				const float inputGain = .045f;
+				float wet = wetGain;
+				float damp1 = damping, damp2 = 1.f - damping;
+				
+				for(int i = 0; i < count; i++) {
+					// pre-delay
+					std::size_t readPos = preDelayPos + preDelay.size() - preDelayLength;
+					if(readPos >= preDelay.size())
+						readPos -= preDelay.size();
+					float in = preDelay[readPos] * inputGain;
+					preDelay[preDelayPos] = input[i];
+					if(++preDelayPos == preDelay.size())
+						preDelayPos = 0;
+					
+					float outs[2] = {0.f, 0.f};
+					for(int ch = 0; ch < 2; ch++) {
+						float acc = 0.f;
+						for(int k = 0; k < 4; k++) {
+							auto& comb = combs[ch * 4 + k];
+							float o = comb.buffer[comb.pos];
+							comb.filterState = o * damp2 + comb.filterState * damp1;
+							comb.buffer[comb.pos] = in + comb.filterState * comb.feedback;
+							if(++comb.pos == comb.buffer.size())
+								comb.pos = 0;
+							acc += o;
+						}
+						for(int k = 0; k < 2; k++) {
+							auto& ap = allpasses[ch * 2 + k];
+							float b = ap.buffer[ap.pos];
+							float o = b - acc;
+							ap.buffer[ap.pos] = acc + b * .5f;
+							if(++ap.pos == ap.buffer.size())
+								ap.pos = 0;
+							acc = o;
+						}
+						outs[ch] = acc;
+					}
+					
+					out[i * 2] += outs[0] * wet;
+					out[i * 2 + 1] += outs[1] * wet;
+				}
+			}
+		};
+		
+#pragma mark - Mixer
+		
+		struct SoftListener {
+			Vector3 eye, front, up, right;
+		};
+		
+		struct SoftVoice {
+			enum class Mode {
+				Absolute,
+				Relative,
+				Local
+			};
+			
+			Handle<SoftAudioChunk> chunk;
+			Mode mode;
+			Vector3 origin;
+			client::AudioParam param;
+			uint64_t serial;
+			
+			double position;
+			
+			// current gains (ramped toward the targets in every block)
+			float gainLeft, gainRight, send;
+			float targetLeft, targetRight, targetSend;
+			bool fresh;
+			
+		};
+		
+		class SoftMixer {
+			AcousticQueryService& acoustics;
+			
+			Mutex mutex;
+			std::vector<SoftVoice> pendingVoices;
+			SoftListener pendingListener;
+			RoomParam pendingRoom;
+			bool pendingReverb;
+			bool pendingStatistics;
+			
+			// following fields are only accessed by the rendering thread
+			std::vector<SoftVoice> voices;
+			SoftListener listener;
+			SoftReverb reverb;
+			bool reverbEnabled;
+			bool statistics;
+			
+			std::vector<float> sendBuffer;
+			
+			int samplingRate;
+			std::size_t maxVoices;
+			uint64_t nextSerial;
+			
+			Stopwatch statStopwatch;
+			double statMixTime;
+			uint64_t statVoiceFrames;
+			uint64_t statFrames;
+			
+			void Spatialize(SoftVoice&);
+			bool Mix(SoftVoice&, float *out, int numFrames);
+			void ReportStatistics();
+		public:
+			SoftMixer(int samplingRate, AcousticQueryService&);
+			
+			int GetSamplingRate() const { return samplingRate; }
+			
+			void Play(SoftVoice&);
+			void SetListener(const SoftListener&, const RoomParam&,
+							 bool reverb, bool statistics);
+			
+			/** Renders `numFrames` frames of interleaved stereo samples. */
+			void Render(float *out, int numFrames);
+			
+			static void RunBenchmark();
+		};
+		
+		SoftMixer::SoftMixer(int samplingRate, AcousticQueryService& acoustics):
+		acoustics(acoustics),
+		pendingReverb(true),
+		pendingStatistics(false),
+		reverb(samplingRate),
+		reverbEnabled(true),
+		statistics(false),
+		samplingRate(samplingRate),
+		nextSerial(0),
+		statMixTime(0.),
+		statVoiceFrames(0),
+		statFrames(0) {
+			int maxPoly = s_maxPolyphonics;
+			if(maxPoly <= 0)
+				maxPoly = 96;
+			maxVoices = static_cast<std::size_t>(maxPoly);
+			
+			SoftListener l;
+			l.eye = MakeVector3(0, 0, 0);
+			l.front = MakeVector3(0, 1, 0);
+			l.up = MakeVector3(0, 0, -1);
+			l.right = Vector3::Cross(l.front, l.up);
+			pendingListener = l;
+			listener = l;
+			
+			pendingRoom.reflections = 0.f;
+			pendingRoom.roomVolume = 1.f;
+			pendingRoom.roomArea = 1.f;
+			pendingRoom.roomSize = 10.f;
+			pendingRoom.feedbackness = 0.f;
+			reverb.SetRoom(pendingRoom);
+			
+			voices.reserve(maxVoices);
+		}
+		
+		void SoftMixer::Play(SoftVoice& voice) {
+			AutoLocker lock(&mutex);
+			voice.serial = nextSerial++;
+			pendingVoices.push_back(voice);
+		}
+		
+		void SoftMixer::SetListener(const SoftListener& l, const RoomParam& room,
+									bool reverb, bool statistics) {
+			AutoLocker lock(&mutex);
+			pendingListener = l;
+			pendingRoom = room;
+			pendingReverb = reverb;
+			pendingStatistics = statistics;
+		}
+		
+		void SoftMixer::Spatialize(SoftVoice& voice) {
+			float gain = voice.param.volume;
+			float pan = 0.f;
+			float send = 0.f;
+			
+			switch(voice.mode) {
+				case SoftVoice::Mode::Absolute:
+				{
+					Vector3 rel = voice.origin - listener.eye;
+					float dist = rel.GetLength();
+					
+					// AL_INVERSE_DISTANCE_CLAMPED
+					float ref = std::max(voice.param.referenceDistance, 1.e-3f);
+					gain *= ref / std::max(dist, ref);
+					if(dist > 1.e-3f) {
+						pan = Vector3::Dot(rel, listener.right) / dist;
+					}
+					send = gain;
+					
+					gain *= acoustics.GetDirectGain(voice.origin);
+					break;
+				}
+				case SoftVoice::Mode::Relative:
+				{
+					// x: right, y: up, z: front
+					float dist = voice.origin.GetLength();
+					if(dist > 1.e-3f) {
+						pan = voice.origin.x / dist;
+					}
+					send = gain;
+					break;
+				}
+				case SoftVoice::Mode::Local:
+					break;
+			}
+			
+			if(voice.chunk->GetNumChannels() == 2) {
+				// stereo sounds are not panned
+				voice.targetLeft = gain;
+				voice.targetRight = gain;
+			}else{
+				// equal power panning
+				float angle = (std::max(std::min(pan, 1.f), -1.f) + 1.f) *
+				static_cast<float>(M_PI) * .25f;
+				voice.targetLeft = gain * cosf(angle);
+				voice.targetRight = gain * sinf(angle);
+			}
+			voice.targetSend = reverbEnabled ? send : 0.f;
+			
+			if(voice.fresh) {
+				voice.gainLeft = voice.targetLeft;
+				voice.gainRight = voice.targetRight;
+				voice.send = voice.targetSend;
+				voice.fresh = false;
+			}
+		}
+		
+		bool SoftMixer::Mix(SoftVoice& voice, float *out, int numFrames) {
+			const SoftAudioChunk& chunk = *voice.chunk;
+			double numChunkFrames = static_cast<double>(chunk.GetNumFrames());
+			double step = static_cast<double>(chunk.GetSamplingRate()) /
+			static_cast<double>(samplingRate) *
+			static_cast<double>(std::max(voice.param.pitch, 1.e-3f));
+			
+			double remaining = (numChunkFrames - voice.position) / step;
+			int count = static_cast<int>(std::min(ceil(remaining), static_cast<double>(numFrames)));
+			if(count <= 0)
+				return false;
+			
+			float invFrames = 1.f / static_cast<float>(numFrames);
+			float deltaLeft = (voice.targetLeft - voice.gainLeft) * invFrames;
+			float deltaRight = (voice.targetRight - voice.gainRight) * invFrames;
+			float deltaSend = (voice.targetSend - voice.send) * invFrames;
+			
+			bool useSend = voice.send > 0.f || voice.targetSend > 0.f;
+			ResampleAndMix(chunk.GetSamples(), chunk.GetNumChannels(),
+						   voice.position, step,
+						   out, useSend ? sendBuffer.data() : nullptr, count,
+						   voice.gainLeft, voice.gainRight, voice.send,
+						   deltaLeft, deltaRight, deltaSend);
+			
+			voice.gainLeft = voice.targetLeft;
+			voice.gainRight = voice.targetRight;
+			voice.send = voice.targetSend;
+			voice.position += step * static_cast<double>(count);
+			
+			statVoiceFrames += static_cast<uint64_t>(count);
+			
+			return voice.position < numChunkFrames;
+		}
+		
+		void SoftMixer::Render(float *out, int numFrames) {
+			SPADES_MARK_FUNCTION();
+			
+			{
+				AutoLocker lock(&mutex);
+				for(auto& voice: pendingVoices) {
+					if(voices.size() >= maxVoices) {
+						// steal the oldest voice
+						auto oldest = std::min_element(voices.begin(), voices.end(),
+													   [](const SoftVoice& a, const SoftVoice& b) {
+														   return a.serial < b.serial;
+													   });
+						*oldest = voice;
+					}else{
+						voices.push_back(voice);
+					}
+				}
+				pendingVoices.clear();
+				
+				listener = pendingListener;
+				reverbEnabled = pendingReverb;
+				statistics = pendingStatistics;
+				reverb.SetRoom(pendingRoom);
+			}
+			
+			Stopwatch sw;
+			
+			std::fill(out, out + numFrames * 2, 0.f);
+			sendBuffer.assign(numFrames, 0.f);
+			
+			for(auto& voice: voices)
+				Spatialize(voice);
+			
+			for(std::size_t i = 0; i < voices.size();) {
+				if(Mix(voices[i], out, numFrames)) {
+					i++;
+				}else{
+					voices[i] = voices.back();
+					voices.pop_back();
+				}
+			}
+			
+			if(reverbEnabled) {
+				reverb.Process(sendBuffer.data(), out, numFrames);
+			}
+			
+			Clip(out, numFrames * 2);
+			
+			statMixTime += sw.GetTime();
+			statFrames += static_cast<uint64_t>(numFrames);
+			if(statStopwatch.GetTime() >= 1.) {
+				ReportStatistics();
+			}
+		}
+		
+		void SoftMixer::ReportStatistics() {
+			if(statistics && statMixTime > 0.) {
+				// one "voice" here is a voice playing for one millisecond
+				double voiceMs = static_cast<double>(statVoiceFrames) * 1000. /
+				static_cast<double>(samplingRate);
+				double audioMs = static_cast<double>(statFrames) * 1000. /
+				static_cast<double>(samplingRate);
+				SPLog("Soft mixer: %d voice(s), %.1f voices/ms (mixed %.1fms of audio in %.3fms)",
+					  static_cast<int>(voices.size()),
+					  voiceMs / (statMixTime * 1000.),
+					  audioMs, statMixTime * 1000.);
+			}
+			statStopwatch.Reset();
+			statMixTime = 0.;
+			statVoiceFrames = 0;
+			statFrames = 0;
+		}
+		
+		void SoftMixer::RunBenchmark() {
+			SPADES_MARK_FUNCTION();
+			
+			const int samplingRate = 44100;
+			const int blockSize = 1024;
+			const int numVoices = 64;
+			const int numBlocks = 200;
+			AcousticQueryService acoustics;
+			std::vector<float> out(blockSize * 2);
+			
+			SPLog("Soft mixer benchmark: %d voice(s), %d-frame blocks",
+				  numVoices, blockSize);
+			for(int channels = 1; channels <= 2; channels++) {
+				for(int rate: {22050, 44100, 48000}) {
+					// long enough that no voice finishes during the run
+					std::size_t numFrames = static_cast<std::size_t>(rate) * 8;
+					std::vector<float> data(numFrames * channels);
+					for(std::size_t i = 0; i < data.size(); i++)
+						data[i] = sinf(static_cast<float>(i) * .01f) * .1f;
+					Handle<SoftAudioChunk> chunk
+					(new SoftAudioChunk(std::move(data), channels,
+										static_cast<float>(rate)), false);
+					
+					SoftMixer mixer(samplingRate, acoustics);
+					mixer.maxVoices = numVoices;
+					for(int i = 0; i < numVoices; i++) {
+						SoftVoice voice;
+						voice.chunk = chunk;
+						voice.mode = SoftVoice::Mode::Relative;
+						voice.origin = MakeVector3(static_cast<float>(i % 7) - 3.f, 0.f, 1.f);
+						voice.param.pitch = 1.f + static_cast<float>(i % 5) * .03f;
+						voice.position = 0.;
+						voice.fresh = true;
+						mixer.Play(voice);
+					}
+					
+					// the first block also spatializes the pending voices
+					mixer.Render(out.data(), blockSize);
+					Stopwatch sw;
+					for(int i = 0; i < numBlocks; i++)
+						mixer.Render(out.data(), blockSize);
+					double time = sw.GetTime();
+					
+					double voiceMs = static_cast<double>(numVoices) * blockSize * numBlocks *
+					1000. / static_cast<double>(samplingRate);
+					SPLog("  %s %5d Hz: %.1f voices/ms (%.3fms per block)",
+						  channels == 2 ? "stereo" : "mono  ", rate,
+						  voiceMs / (time * 1000.), time * 1000. / numBlocks);
+				}
+			}
+		}
+		
+#pragma mark - File Output
+		
+		/** Renders the mixer output into a 16-bit stereo WAV file
+		 * in real time. Used by headless clients. */
+		class SoftFileRenderer: public Thread {
+			std::shared_ptr<SoftMixer> mixer;
+			IStream *stream;
+			int bufferSize;
+			uint64_t numFrames;
+			volatile bool exiting;
+			
+			void WriteInt(uint32_t v) {
+				char buf[4] = {
+					static_cast<char>(v), static_cast<char>(v >> 8),
+					static_cast<char>(v >> 16), static_cast<char>(v >> 24)
+				};
+				stream->Write(buf, 4);
+			}
+			void WriteShort(uint16_t v) {
+				char buf[2] = {static_cast<char>(v), static_cast<char>(v >> 8)};
+				stream->Write(buf, 2);
+			}
+			
+			void WriteHeader() {
+				uint32_t dataSize = static_cast<uint32_t>(numFrames * 4);
+				int rate = mixer->GetSamplingRate();
+				stream->SetPosition(0);
+				stream->Write("RIFF", 4);
+				WriteInt(36 + dataSize);
+				stream->Write("WAVEfmt ", 8);
+				WriteInt(16);
+				WriteShort(1); // PCM
+				WriteShort(2); // channels
+				WriteInt(static_cast<uint32_t>(rate));
+				WriteInt(static_cast<uint32_t>(rate * 4));
+				WriteShort(4); // block align
+				WriteShort(16); // bits
+				stream->Write("data", 4);
+				WriteInt(dataSize);
+			}
+		public:
+			SoftFileRenderer(std::shared_ptr<SoftMixer> mixer,
+							 const char *fileName,
+							 int bufferSize):
+			mixer(mixer),
+			stream(nullptr),
+			bufferSize(bufferSize),
+			numFrames(0),
+			exiting(false) {
+				stream = FileManager::OpenForWriting(fileName);
+				WriteHeader();
+			}
+			
+			virtual ~SoftFileRenderer() {
+				exiting = true;
+				Join();
+				try {
+					WriteHeader();
+				}catch(const std::exception& ex) {
+					SPLog("Failed to finalize the audio output: %s", ex.what());
+				}
+				delete stream;
+			}
+			
+			virtual void Run() {
+				SPADES_MARK_FUNCTION();
+				
+				std::vector<float> buffer(bufferSize * 2);
+				std::vector<char> bytes(bufferSize * 4);
+				double rate = static_cast<double>(mixer->GetSamplingRate());
+				Stopwatch sw;
+				
+				try {
+					while(!exiting) {
+						// keep pace with the wall clock
+						double ahead = static_cast<double>(numFrames) / rate - sw.GetTime();
+						if(ahead > .01) {
+							SDL_Delay(static_cast<Uint32>(ahead * 1000.));
+							continue;
+						}
+						
+						mixer->Render(buffer.data(), bufferSize);
+						for(int i = 0; i < bufferSize * 2; i++) {
+							int16_t v = static_cast<int16_t>(buffer[i] * 32767.f);
+							bytes[i * 2] = static_cast<char>(v);
+							bytes[i * 2 + 1] = static_cast<char>(v >> 8);
+						}
+						stream->Write(bytes.data(), bytes.size());
+						numFrames += static_cast<uint64_t>(bufferSize);
+					}
+				}catch(const std::exception& ex) {
+					SPLog("Audio output failed: %s", ex.what());
+				}
+			}
+		};
+		
+#pragma mark - Device
+		
+		SoftDevice::SoftDevice():
+		gameMap(nullptr) {
+			SPADES_MARK_FUNCTION();
+			
+			int bufferSize = s_softBufferSize;
+			bufferSize = std::max(std::min(bufferSize, 16384), 64);
+			
+			std::string outputFile = s_softOutputFile;
+			if(!outputFile.empty()) {
+				mixer = std::make_shared<SoftMixer>(44100, acoustics);
+				fileRenderer.reset(new SoftFileRenderer(mixer, outputFile.c_str(), bufferSize));
+				fileRenderer->Start();
+				SPLog("Software audio: rendering to '%s'", outputFile.c_str());
+			}else{
+				SDL_AudioSpec spec;
+				spec.callback = reinterpret_cast<SDL_AudioCallback>(RenderCallback);
+				spec.userdata = this;
+				spec.format = AUDIO_F32SYS;
+				spec.freq = 44100;
+				spec.samples = bufferSize;
+				spec.channels = 2;
+				
+				sdlAudioDevice.reset(new SdlAudioDevice(nullptr, SDL_FALSE,
+														spec, SDL_AUDIO_ALLOW_FREQUENCY_CHANGE));
+				mixer = std::make_shared<SoftMixer>(sdlAudioDevice->spec.freq, acoustics);
+				SPLog("Software audio: %d Hz, %d frame(s) per buffer",
+					  sdlAudioDevice->spec.freq, (int)sdlAudioDevice->spec.samples);
+				
+				SDL_PauseAudioDevice((*sdlAudioDevice)(), 0);
+			}
+		}
+		
+		void SoftDevice::RunBenchmark() {
+			SoftMixer::RunBenchmark();
+		}
+		
+		SoftDevice::~SoftDevice() {
+			SPADES_MARK_FUNCTION();
+			
+			// stop the output before destroying the mixer
+			sdlAudioDevice.reset();
+			fileRenderer.reset();
+			
+			for(auto chunk = chunks.begin(); chunk != chunks.end(); ++chunk){
+				chunk->second->Release();
+			}
+			if(this->gameMap)
+				this->gameMap->Release();
+		}
+		
+		void SoftDevice::RenderCallback(SoftDevice *self,
+										float *stream,
+										int numBytes) {
+			self->mixer->Render(stream, numBytes / 8);
+		}
+		
+		auto SoftDevice::CreateChunk(const char *name) -> SoftAudioChunk * {
+			SPADES_MARK_FUNCTION();
+			
+			IAudioStream *as = AudioSampleCache::GetInstance().OpenStream(name);
+			
+			try{
+				SoftAudioChunk *ch = new SoftAudioChunk(as);
+				delete as;
+				return ch;
+			}catch(...){
+				delete as;
+				throw;
+			}
+		}
+		
+		void SoftDevice::PreloadSound(const char *name) {
+			SPADES_MARK_FUNCTION();
+			
+			if(chunks.find(name) == chunks.end())
+				AudioSampleCache::GetInstance().Preload(name);
+		}
+		
+		client::IAudioChunk *SoftDevice::RegisterSound(const char *name) {
+			SPADES_MARK_FUNCTION();
+			
+			auto it = chunks.find(name);
+			if(it == chunks.end()){
+				auto *c = CreateChunk(name);
+				chunks[name] = c;
+				c->AddRef();
+				return c;
+			}
+			it->second->AddRef();
+			return it->second;
+		}
+		
+		void SoftDevice::SetGameMap(client::GameMap *gameMap) {
+			SPADES_MARK_FUNCTION();
+			auto *old = this->gameMap;
+			this->gameMap = gameMap;
+			if(this->gameMap) this->gameMap->AddRef();
+			if(old) old->Release();
+			
+			acoustics.SetGameMap(gameMap);
+		}
+		
+		void SoftDevice::Respatialize(const spades::Vector3 &eye,
+									  const spades::Vector3 &front,
+									  const spades::Vector3 &up) {
+			SPADES_MARK_FUNCTION();
+			
+			SoftListener listener;
+			listener.eye = eye;
+			listener.front = front;
+			listener.up = up;
+			listener.right = Vector3::Cross(front, up);
+			
+			acoustics.Update(eye);
+			RoomParam room = acoustics.GetRoomParam();
+			
+			mixer->SetListener(listener, room, s_softReverb, s_softStatistics);
+		}
+		
+		static SoftVoice MakeVoice(client::IAudioChunk *c,
+								   const client::AudioParam& param) {
+			auto *chunk = dynamic_cast<SoftAudioChunk *>(c);
+			if(chunk == nullptr) SPRaise("Invalid chunk: null or invalid type.");
+			
+			SoftVoice voice;
+			voice.chunk = chunk;
+			voice.param = param;
+			voice.origin = MakeVector3(0, 0, 0);
+			voice.position = 0.;
+			voice.gainLeft = voice.gainRight = voice.send = 0.f;
+			voice.targetLeft = voice.targetRight = voice.targetSend = 0.f;
+			voice.fresh = true;
+			return voice;
+		}
+		
+		void SoftDevice::Play(client::IAudioChunk *c, const Vector3& origin, const client::AudioParam& param) {
+			SPADES_MARK_FUNCTION();
+			
+			SoftVoice voice = MakeVoice(c, param);
+			voice.mode = SoftVoice::Mode::Absolute;
+			voice.origin = origin;
+			mixer->Play(voice);
+		}
+		
+		void SoftDevice::PlayLocal(client::IAudioChunk *c, const Vector3& origin, const client::AudioParam& param) {
+			SPADES_MARK_FUNCTION();
+			
+			SoftVoice voice = MakeVoice(c, param);
+			voice.mode = SoftVoice::Mode::Relative;
+			voice.origin = origin;
+			mixer->Play(voice);
+		}
+		
+		void SoftDevice::PlayLocal(client::IAudioChunk *c, const client::AudioParam& param) {
+			SPADES_MARK_FUNCTION();
+			
+			SoftVoice voice = MakeVoice(c, param);
+			voice.mode = SoftVoice::Mode::Local;
+			mixer->Play(voice);
+		}
+		
+	}
+}
@@ -0,0 +1,74 @@
+/*
+ Copyright (c) 2013 yvt
+ 
+ This file is part of OpenSpades.
+ 
+ OpenSpades is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+ 
+ OpenSpades is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with OpenSpades.  If not, see <http://www.gnu.org/licenses/>.
+ 
+ */
+
+
+#pragma once
+
+#include <Client/IAudioDevice.h>
+#include <map>
+#include <memory>
+#include "AcousticQueryService.h"
+
+namespace spades {
+	namespace audio {
+		
+		class SoftMixer;
+		class SoftAudioChunk;
+		class SoftFileRenderer;
+		struct SdlAudioDevice;
+		
+		/** Audio device that mixes sounds on the CPU without any external
+		 * library. Renders to SDL audio, or to a WAV file when
+		 * `s_softOutputFile` is set. */
+		class SoftDevice: public client::IAudioDevice {
+			AcousticQueryService acoustics;
+			
+			std::shared_ptr<SoftMixer> mixer;
+			client::GameMap *gameMap;
+			std::unique_ptr<SdlAudioDevice> sdlAudioDevice;
+			std::unique_ptr<SoftFileRenderer> fileRenderer;
+			
+			std::map<std::string, SoftAudioChunk *> chunks;
+			SoftAudioChunk *CreateChunk(const char *name);
+			
+			static void RenderCallback(SoftDevice *, float *, int);
+		protected:
+			virtual ~SoftDevice();
+		public:
+			SoftDevice();
+			
+			/** Measures the mixing throughput in voices/ms and logs it. */
+			static void RunBenchmark();
+			
+			virtual client::IAudioChunk *RegisterSound(const char *name);
+			virtual void PreloadSound(const char *name);
+			
+			virtual void SetGameMap(client::GameMap *);
+			
+			virtual void Play(client::IAudioChunk *, const Vector3& origin, const client::AudioParam&);
+			virtual void PlayLocal(client::IAudioChunk *, const Vector3& origin, const client::AudioParam&);
+			virtual void PlayLocal(client::IAudioChunk *, const client::AudioParam&);
+			
+			virtual void Respatialize(const Vector3& eye,
+									  const Vector3& front,
+									  const Vector3& up);
+		};
+	}
+}
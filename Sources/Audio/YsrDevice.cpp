@@ -19,6 +19,7 @@
  */
 
 #include "YsrDevice.h"
+#include "AudioSampleCache.h"
 #include <Client/IAudioChunk.h>
 #include <Client/GameMap.h>
 #include <Core/Settings.h>
@@ -29,6 +30,7 @@
 #include <cstdlib>
 #include "../Imports/SDL.h"
 #include <Core/IStream.h>
+#include "SdlAudioDevice.h"
 
 #if defined(__APPLE__)
 SPADES_SETTING(s_ysrDriver, "libysrspades.dylib");
@@ -354,34 +356,6 @@ namespace spades {
 			
 		};
 		
-		struct SdlAudioDevice {
-			SDL_AudioDeviceID id;
-			SDL_AudioSpec spec;
-			
-			SdlAudioDevice(const char *deviceId,
-						   int isCapture,
-						   const SDL_AudioSpec& spec,
-						   int allowedChanges):
-			id(0){
-				SDL_InitSubSystem(SDL_INIT_AUDIO);
-				id = SDL_OpenAudioDevice(deviceId, isCapture,
-										 &spec, &this->spec,
-										 allowedChanges);
-				if(id == 0){
-					SPRaise("Failed to initialize the audio device: %s", SDL_GetError());
-				}
-			}
-			
-			~SdlAudioDevice() {
-				if(id != 0)
-					SDL_CloseAudioDevice(id);
-			}
-			
-			SDL_AudioDeviceID operator()() const {
-				return id;
-			}
-		};
-		
 		static void DebugLog(const char *msg,
 							 void *) {
 			SPLog("YSR Debug: %s", msg);
@@ -389,9 +363,7 @@ namespace spades {
 		
 		YsrDevice::YsrDevice():
 		gameMap(nullptr),
-		driver(new YsrDriver()),
-		roomHistoryPos(0),
-		listenerPosition(MakeVector3(0, 0, 0))
+		driver(new YsrDriver())
 		{
 			SDL_AudioSpec spec;
 			spec.callback = reinterpret_cast<SDL_AudioCallback>(RenderCallback);
@@ -419,11 +391,6 @@ namespace spades {
 			
 			driver->Init(param);
 			
-			std::fill(roomHistory.begin(), roomHistory.end(),
-					  20000.f);
-			std::fill(roomFeedbackHistory.begin(), roomFeedbackHistory.end(),
-					  0.f);
-			
 			SDL_PauseAudioDevice((*sdlAudioDevice)(), 0);
 		}
 		
@@ -455,43 +422,13 @@ namespace spades {
 			Vector3 origin(*reinterpret_cast<const YsrContext::YVec3 *>(yorigin));
 			auto& result = *reinterpret_cast<YsrContext::SpatializeResult *>(_result);
 			
-			// check obstruction
-			if(gameMap) {
-				Vector3 eye = listenerPosition;
-				Vector3 pos = origin;
-				Vector3 checkPos;
-				result.directGain = 0.4f;
-				for(int x = -1; x <= 1; x++)
-					for(int y = -1; y <= 1; y++)
-						for(int z = -1; z <= 1; z++){
-							IntVector3 hitPos;
-							checkPos.x = pos.x + (float)x * .2f;
-							checkPos.y = pos.y + (float)y * .2f;
-							checkPos.z = pos.z + (float)z * .2f;
-							if(!gameMap->CastRay(eye, (checkPos-eye).Normalize(),
-												 (checkPos-eye).GetLength(), hitPos)){
-								result.directGain = 1.f;
-							}
-						}
-			} else {
-				result.directGain = 1.f;
-			}
-			
+			result.directGain = acoustics.GetDirectGain(origin);
 		}
 		
 		auto YsrDevice::CreateChunk(const char *name) -> YsrAudioChunk * {
 			SPADES_MARK_FUNCTION();
 			
-			IStream *stream = NULL;
-			IAudioStream *as = NULL;
-			try{
-				stream = FileManager::OpenForReading(name);
-				as = new WavAudioStream(stream, true);
-			}catch(...){
-				if(stream)
-					delete stream;
-				throw;
-			}
+			IAudioStream *as = AudioSampleCache::GetInstance().OpenStream(name);
 			
 			try{
 				YsrAudioChunk *ch =new YsrAudioChunk(driver, as);
@@ -503,6 +440,13 @@ namespace spades {
 			}
 		}
 		
+		void YsrDevice::PreloadSound(const char *name) {
+			SPADES_MARK_FUNCTION();
+			
+			if(chunks.find(name) == chunks.end())
+				AudioSampleCache::GetInstance().Preload(name);
+		}
+		
 		client::IAudioChunk *YsrDevice::RegisterSound(const char *name) {
 			SPADES_MARK_FUNCTION();
 			
@@ -523,10 +467,8 @@ namespace spades {
 			this->gameMap = gameMap;
 			if(this->gameMap) this->gameMap->AddRef();
 			if(old) old->Release();
-		}
-		
-		static float NextRandom() {
-			return (float)std::rand() /(float)RAND_MAX;
+			
+			acoustics.SetGameMap(gameMap);
 		}
 		
 		void YsrDevice::Respatialize(const spades::Vector3 &eye,
@@ -534,95 +476,15 @@ namespace spades {
 									 const spades::Vector3 &up) {
 			SPADES_MARK_FUNCTION();
 			
-			listenerPosition = eye;
+			acoustics.Update(eye);
+			RoomParam room = acoustics.GetRoomParam();
 			
 			YsrContext::ReverbParam reverbParam;
-			float maxDistance = 40.f;
-			float reflections;
-			float roomVolume;
-			float roomArea;
-			float roomSize;
-			float feedbackness = 0.f;
-			auto *map = gameMap;
-			if(map == NULL){
-				reflections = 0.f;
-				roomVolume = 1.f;
-				roomArea = 1.f;
-				roomSize = 10.f;
-			}else{
-				// do raycast
-				Vector3 rayFrom = eye;
-				Vector3 rayTo;
-				
-				for(int rays = 0; rays < 4; rays++){
-					rayTo.x = NextRandom() - NextRandom();
-					rayTo.y = NextRandom() - NextRandom();
-					rayTo.z = NextRandom() - NextRandom();
-					rayTo = rayTo.Normalize();
-					
-					IntVector3 hitPos;
-					bool hit = map->CastRay(rayFrom, rayTo, maxDistance, hitPos);
-					if(hit){
-						Vector3 hitPosf = {(float)hitPos.x, (float)hitPos.y, (float)hitPos.z};
-						roomHistory[roomHistoryPos] = (hitPosf - rayFrom).GetLength();
-					}else{
-						roomHistory[roomHistoryPos] = maxDistance * 2.f;
-					}
-					
-					if(hit){
-						bool hit2 = map->CastRay(rayFrom, -rayTo, maxDistance, hitPos);
-						if(hit2)
-							roomFeedbackHistory[roomHistoryPos] = 1.f;
-						else
-							roomFeedbackHistory[roomHistoryPos] = 0.f;
-					}
-					
-					roomHistoryPos++;
-					if(roomHistoryPos == (int)roomHistory.size())
-						roomHistoryPos = 0;
-				}
-				
-				// monte-carlo integration
-				unsigned int rayHitCount = 0;
-				roomVolume = 0.f;
-				roomArea = 0.f;
-				roomSize = 0.f;
-				feedbackness = 0.f;
-				for(size_t i = 0; i < roomHistory.size(); i++){
-					float dist = roomHistory[i];
-					if(dist < maxDistance){
-						rayHitCount++;
-						roomVolume += dist * dist;
-						roomArea += dist;
-						roomSize += dist;
-					}
-					
-					feedbackness += roomFeedbackHistory[i];
-				}
-				
-				if(rayHitCount > roomHistory.size() / 4){
-					roomVolume /= (float)rayHitCount;
-					roomVolume *= 4.f / 3.f * static_cast<float>(M_PI);
-					roomArea /= (float)rayHitCount;
-					roomArea *= 4.f * static_cast<float>(M_PI);
-					roomSize /= (float)rayHitCount;
-					reflections = (float)rayHitCount / (float)roomHistory.size();
-				}else{
-					roomVolume = 8.f;
-					reflections = 0.1f;
-					roomArea = 100.f;
-					roomSize = 100.f;
-				}
-				
-				feedbackness /= (float)roomHistory.size();
-				
-			}
-			
-			reverbParam.feedbackness = feedbackness;
-			reverbParam.reflections = reflections;
-			reverbParam.roomArea = roomArea;
-			reverbParam.roomSize = roomSize;
-			reverbParam.roomVolume = roomVolume;
+			reverbParam.feedbackness = room.feedbackness;
+			reverbParam.reflections = room.reflections;
+			reverbParam.roomArea = room.roomArea;
+			reverbParam.roomSize = room.roomSize;
+			reverbParam.roomVolume = room.roomVolume;
 			
 			driver->Respatialize(eye, front, up, reverbParam);
 		}
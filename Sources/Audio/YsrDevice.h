@@ -24,6 +24,7 @@
 #include <map>
 #include <memory>
 #include <array>
+#include "AcousticQueryService.h"
 
 namespace spades {
 	namespace audio {
@@ -33,15 +34,12 @@ namespace spades {
 		struct SdlAudioDevice;
 		
 		class YsrDevice: public client::IAudioDevice {
+			// declared first so it outlives the mixer threads
+			AcousticQueryService acoustics;
+			
 			std::shared_ptr<YsrDriver> driver;
 			client::GameMap *gameMap;
 			std::unique_ptr<SdlAudioDevice> sdlAudioDevice;
-			Vector3 listenerPosition;
-			
-			int roomHistoryPos;
-			enum { RoomHistorySize = 128 };
-			std::array<float, RoomHistorySize> roomHistory;
-			std::array<float, RoomHistorySize> roomFeedbackHistory;
 			
 			std::map<std::string, YsrAudioChunk *> chunks;
 			YsrAudioChunk *CreateChunk(const char *name);
@@ -59,6 +57,7 @@ namespace spades {
 			static bool TryLoadYsr();
 			
 			virtual client::IAudioChunk *RegisterSound(const char *name);
+			virtual void PreloadSound(const char *name);
 			
 			virtual void SetGameMap(client::GameMap *);
 			
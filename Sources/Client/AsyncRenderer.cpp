@@ -26,7 +26,12 @@
 #include "../Core/AutoLocker.h"
 #include "IImage.h"
 #include "IModel.h"
+#include "../Core/Settings.h"
+#include "../Core/Stopwatch.h"
 #include <stdint.h>
+#include <algorithm>
+
+SPADES_SETTING(r_asyncBenchmark, "0");
 
 namespace spades {
 	namespace client {
@@ -35,262 +40,363 @@ namespace spades {
 		
 #pragma mark - Commands
 		
-		class Command {
-		public:
+		// Commands are plain structs stored back to back in a command
+		// buffer and replayed with a switch, so nothing has to be
+		// constructed, copied, or virtually dispatched on either side.
+		
+		enum class CommandType: uint16_t {
+			Init,
+			Shutdown,
+			SetGameMap,
+			SetFogDistance,
+			SetFogColor,
+			StartScene,
+			AddLight,
+			RenderModel,
+			AddDebugLine,
+			AddSprite,
+			AddLongSprite,
+			AddSprites,
+			EndScene,
+			MultiplyScreenColor,
+			SetColor,
+			SetColorAlphaPremultiplied,
+			DrawImage,
+			DrawFlatGameMap,
+			FrameDone,
+			Flip
+		};
+		
+		struct Command {
+			CommandType type;
 			uint16_t cmdSize;
-			
-			virtual void Execute(IRenderer *) = 0;
 		};
 		
 		namespace rcmds {
-			class Init: public Command {
-			public:
-				virtual void Execute(IRenderer *r) {
-					SPADES_MARK_FUNCTION();
-					r->Init();
-				}
+			struct Init: public Command {
+				static const CommandType Type = CommandType::Init;
 			};
-			class Shutdown: public Command {
-			public:
-				virtual void Execute(IRenderer *r) {
-					SPADES_MARK_FUNCTION();
-					r->Shutdown();
-				}
+			struct Shutdown: public Command {
+				static const CommandType Type = CommandType::Shutdown;
 			};
-			class SetGameMap: public Command {
-			public:
+			struct SetGameMap: public Command {
+				static const CommandType Type = CommandType::SetGameMap;
 				GameMap *map;
-				virtual void Execute(IRenderer *r) {
-					SPADES_MARK_FUNCTION();
-					r->SetGameMap(map);
-				}
 			};
-			class SetFogDistance: public Command {
-			public:
+			struct SetFogDistance: public Command {
+				static const CommandType Type = CommandType::SetFogDistance;
 				float v;
-				virtual void Execute(IRenderer *r){
-					SPADES_MARK_FUNCTION();
-					r->SetFogDistance(v);
-				}
 			};
-			class SetFogColor: public Command {
-			public:
+			struct SetFogColor: public Command {
+				static const CommandType Type = CommandType::SetFogColor;
 				Vector3 v;
-				virtual void Execute(IRenderer *r){
-					SPADES_MARK_FUNCTION();
-					r->SetFogColor(v);
-				}
 			};
-			class StartScene: public Command {
-			public:
+			struct StartScene: public Command {
+				static const CommandType Type = CommandType::StartScene;
 				SceneDefinition def;
-				virtual void Execute(IRenderer *r){
-					SPADES_MARK_FUNCTION();
-					r->StartScene(def);
-				}
 			};
-			class AddLight: public Command {
-			public:
-				IImage *img;
+			struct AddLight: public Command {
+				static const CommandType Type = CommandType::AddLight;
 				DynamicLightParam def;
-				virtual void Execute(IRenderer *r){
-					SPADES_MARK_FUNCTION();
-					if(img){
-						def.image = img; img = NULL;
-					}
-					try{
-						r->AddLight(def);
-					}catch(...){
-						if(img) img->Release();
-						throw;
-					}
-					if(img){
-						img->Release();
-					}
-				}
 			};
-			class RenderModel: public Command {
-			public:
+			struct RenderModel: public Command {
+				static const CommandType Type = CommandType::RenderModel;
 				IModel *model;
 				ModelRenderParam param;
-				virtual void Execute(IRenderer *r){
-					try {
-						r->RenderModel(model, param);
-					}catch(...){
-						model->Release(); model = NULL;
-						throw;
-					}
-					model->Release(); model = NULL;
-				}
 			};
-			class AddDebugLine: public Command {
-			public:
+			struct AddDebugLine: public Command {
+				static const CommandType Type = CommandType::AddDebugLine;
 				Vector3 a, b;
 				Vector4 color;
-				virtual void Execute(IRenderer *r){
-					SPADES_MARK_FUNCTION();
-					r->AddDebugLine(a, b, color);
-				}
 			};
-			class AddSprite: public Command {
-			public:
+			struct AddSprite: public Command {
+				static const CommandType Type = CommandType::AddSprite;
 				IImage *img;
 				Vector3 center;
 				float radius, rotation;
-				virtual void Execute(IRenderer *r){
-					SPADES_MARK_FUNCTION();
-					try {
-						r->AddSprite(img, center, radius, rotation);
-					}catch(...){
-						img->Release(); img = NULL;
-						throw;
-					}
-					img->Release(); img = NULL;
-				}
 			};
-			class AddLongSprite: public Command {
-			public:
+			struct AddLongSprite: public Command {
+				static const CommandType Type = CommandType::AddLongSprite;
 				IImage *img;
 				Vector3 p1, p2;
 				float radius;
-				virtual void Execute(IRenderer *r){
-					SPADES_MARK_FUNCTION();
-					try {
-						r->AddLongSprite(img, p1, p2, radius);
-					}catch(...){
-						img->Release(); img = NULL;
-						throw;
-					}
-					img->Release(); img = NULL;
-				}
 			};
-			class EndScene: public Command {
-			public:
-				virtual void Execute(IRenderer *r){
-					SPADES_MARK_FUNCTION();
-					r->EndScene();
+			/** followed by `count` images, colors, centers, radii
+			 * and rotations, in this order. */
+			struct AddSprites: public Command {
+				static const CommandType Type = CommandType::AddSprites;
+				uint32_t count;
+				
+				enum {
+					// keeps the command within the 16-bit size
+					MaxCount = 1024
+				};
+				
+				static size_t GetPayloadSize(size_t count) {
+					return count * (sizeof(IImage *) + sizeof(Vector4) +
+									sizeof(Vector3) + sizeof(float) * 2);
+				}
+				IImage **GetImages() const {
+					return reinterpret_cast<IImage **>(const_cast<AddSprites *>(this + 1));
+				}
+				Vector4 *GetColors() const {
+					return reinterpret_cast<Vector4 *>(GetImages() + count);
+				}
+				Vector3 *GetCenters() const {
+					return reinterpret_cast<Vector3 *>(GetColors() + count);
+				}
+				float *GetRadii() const {
+					return reinterpret_cast<float *>(GetCenters() + count);
+				}
+				float *GetRotations() const {
+					return GetRadii() + count;
 				}
 			};
-			class MultiplyScreenColor: public Command {
-			public:
+			struct EndScene: public Command {
+				static const CommandType Type = CommandType::EndScene;
+			};
+			struct MultiplyScreenColor: public Command {
+				static const CommandType Type = CommandType::MultiplyScreenColor;
 				Vector3 v;
-				virtual void Execute(IRenderer *r){
-					SPADES_MARK_FUNCTION();
-					r->MultiplyScreenColor(v);
-				}
 			};
-			class SetColor: public Command {
-			public:
+			struct SetColor: public Command {
+				static const CommandType Type = CommandType::SetColor;
 				Vector4 v;
-				virtual void Execute(IRenderer *r){
-					SPADES_MARK_FUNCTION();
-					r->SetColor(v);
-				}
 			};
-			class SetColorAlphaPremultiplied: public Command {
-			public:
+			struct SetColorAlphaPremultiplied: public Command {
+				static const CommandType Type = CommandType::SetColorAlphaPremultiplied;
 				Vector4 v;
-				virtual void Execute(IRenderer *r){
-					SPADES_MARK_FUNCTION();
-					r->SetColorAlphaPremultiplied(v);
-				}
 			};
-			class DrawImage: public Command {
-			public:
+			struct DrawImage: public Command {
+				static const CommandType Type = CommandType::DrawImage;
 				IImage *img;
 				Vector2 outTopLeft;
 				Vector2 outTopRight;
 				Vector2 outBottomLeft;
 				AABB2 inRect;
-				virtual void Execute(IRenderer *r){
-					SPADES_MARK_FUNCTION();
-					try{
-						r->DrawImage(img, outTopLeft, outTopRight, outBottomLeft,
-									 inRect);
-					}catch(...){
-						if(img) img->Release(); img = NULL;
-						throw;
-					}
-					if(img) img->Release(); img = NULL;
-				}
 			};
-			class DrawFlatGameMap: public Command {
-			public:
+			struct DrawFlatGameMap: public Command {
+				static const CommandType Type = CommandType::DrawFlatGameMap;
 				AABB2 outRect, inRect;
-				virtual void Execute(IRenderer *r){
-					SPADES_MARK_FUNCTION();
-					r->DrawFlatGameMap(outRect, inRect);
-				}
 			};
-			class FrameDone: public Command {
-			public:
-				AsyncRenderer *arenderer;
-				virtual void Execute(IRenderer *r){
-					SPADES_MARK_FUNCTION();
-					r->FrameDone();
-				}
+			struct FrameDone: public Command {
+				static const CommandType Type = CommandType::FrameDone;
 			};
-			class Flip: public Command {
-			public:
-				virtual void Execute(IRenderer *r){
-					SPADES_MARK_FUNCTION();
-					r->Flip();
-				}
+			struct Flip: public Command {
+				static const CommandType Type = CommandType::Flip;
 			};
 		};
 		
 #pragma mark - Command Buffer
 		
+		/** Recorded commands and the objects they refer to. Two of these
+		 * are swapped between the client and the render thread, so the
+		 * storage is reused every frame. */
+		struct AsyncRenderer::CmdBuffer {
+			std::vector<char> data;
+			/** objects kept alive until the commands are executed.
+			 * each object appears here (mostly) once per frame instead
+			 * of being retained by every command. */
+			std::vector<RefCountedObject *> retained;
+			size_t numCommands;
+			
+			CmdBuffer(): numCommands(0) {}
+			
+			bool IsEmpty() const { return data.empty(); }
+			
+			/** releases the retained objects and clears the commands,
+			 * keeping the allocated storage. */
+			void Reset() {
+				for(auto *obj: retained)
+					obj->Release();
+				retained.clear();
+				data.clear();
+				numCommands = 0;
+			}
+		};
+		
 		class AsyncRenderer::CmdBufferGenerator {
+			enum {
+				// alignment of every command in the buffer
+				CommandAlignment = 8,
+				RetainCacheSize = 64
+			};
+			RefCountedObject *retainCache[RetainCacheSize];
 		public:
-			std::vector<char> buffer;
+			CmdBuffer buffer;
 			
-			void Clear(){
-				buffer.clear();
+			CmdBufferGenerator() {
+				ClearRetainCache();
 			}
 			
+			void ClearRetainCache() {
+				std::fill(retainCache, retainCache + RetainCacheSize, nullptr);
+			}
+			
+			/** @param payloadSize number of bytes to reserve right
+			 * after the command, for variable-length commands. */
 			template<typename T>
-			T *AllocCommand() {
-				SPADES_MARK_FUNCTION();
+			T *AllocCommand(size_t payloadSize = 0) {
+				static_assert(sizeof(T) <= 0xffff, "command too large");
+				SPAssert(sizeof(T) + payloadSize <= 0xffff - CommandAlignment);
 				
-				size_t size = sizeof(T);
-				size_t pos = buffer.size();
-				buffer.resize(buffer.size() + size);
+				size_t size = (sizeof(T) + payloadSize + CommandAlignment - 1) &
+				~(size_t)(CommandAlignment - 1);
+				size_t pos = buffer.data.size();
+				buffer.data.resize(pos + size);
+				buffer.numCommands++;
 				
-				void *dat = buffer.data() + pos;
+				void *dat = buffer.data.data() + pos;
 				T *cmd = new(dat) T;
-				cmd->cmdSize = sizeof(T);
+				cmd->type = T::Type;
+				cmd->cmdSize = static_cast<uint16_t>(size);
 				return cmd;
 			}
+			
+			/** keeps obj alive until the current buffer is executed. */
+			void Retain(RefCountedObject *obj) {
+				if(obj == nullptr) return;
+				size_t slot = (reinterpret_cast<uintptr_t>(obj) >> 4) & (RetainCacheSize - 1);
+				if(retainCache[slot] == obj)
+					return;
+				retainCache[slot] = obj;
+				obj->AddRef();
+				buffer.retained.push_back(obj);
+			}
 		};
 		
 		class AsyncRenderer::CmdBufferReader {
-			std::vector<char> buffer;
+			const std::vector<char>& buffer;
 			size_t pos;
 		public:
 			CmdBufferReader(const std::vector<char>& buf):
 			buffer(buf), pos(0){
 			}
-			Command *NextCommand() {
-				SPADES_MARK_FUNCTION();
-				
+			const Command *NextCommand() {
 				if(pos >= buffer.size()){
 					return NULL;
 				}
-				Command *cmd = reinterpret_cast<Command *>(buffer.data() + pos);
+				const Command *cmd = reinterpret_cast<const Command *>(buffer.data() + pos);
 				pos += cmd->cmdSize;
-				if(pos > buffer.size()) {
+				if(pos > buffer.size() || cmd->cmdSize == 0) {
 					SPRaise("Truncated render command buffer");
 				}
 				return cmd;
 			}
+			
+			static void Execute(const Command *cmd, IRenderer *r);
+			
+			/** executes all commands in the buffer. */
+			void ExecuteAll(IRenderer *r) {
+				SPADES_MARK_FUNCTION();
+				
+				const Command *cmd;
+				while((cmd = NextCommand()) != NULL){
+					Execute(cmd, r);
+				}
+			}
 		};
 		
+		void AsyncRenderer::CmdBufferReader::Execute(const Command *cmd, IRenderer *r) {
+#define SPADES_RCMD_CASE(name) \
+			case CommandType::name: { \
+				const rcmds::name& c = *static_cast<const rcmds::name *>(cmd); \
+				(void)c;
+			
+			switch(cmd->type) {
+				SPADES_RCMD_CASE(Init)
+					r->Init();
+					break;
+				}
+				SPADES_RCMD_CASE(Shutdown)
+					r->Shutdown();
+					break;
+				}
+				SPADES_RCMD_CASE(SetGameMap)
+					r->SetGameMap(c.map);
+					break;
+				}
+				SPADES_RCMD_CASE(SetFogDistance)
+					r->SetFogDistance(c.v);
+					break;
+				}
+				SPADES_RCMD_CASE(SetFogColor)
+					r->SetFogColor(c.v);
+					break;
+				}
+				SPADES_RCMD_CASE(StartScene)
+					r->StartScene(c.def);
+					break;
+				}
+				SPADES_RCMD_CASE(AddLight)
+					r->AddLight(c.def);
+					break;
+				}
+				SPADES_RCMD_CASE(RenderModel)
+					r->RenderModel(c.model, c.param);
+					break;
+				}
+				SPADES_RCMD_CASE(AddDebugLine)
+					r->AddDebugLine(c.a, c.b, c.color);
+					break;
+				}
+				SPADES_RCMD_CASE(AddSprite)
+					r->AddSprite(c.img, c.center, c.radius, c.rotation);
+					break;
+				}
+				SPADES_RCMD_CASE(AddLongSprite)
+					r->AddLongSprite(c.img, c.p1, c.p2, c.radius);
+					break;
+				}
+				SPADES_RCMD_CASE(AddSprites)
+					r->AddSprites(c.GetImages(), c.GetColors(), c.GetCenters(),
+								  c.GetRadii(), c.GetRotations(), c.count);
+					break;
+				}
+				SPADES_RCMD_CASE(EndScene)
+					r->EndScene();
+					break;
+				}
+				SPADES_RCMD_CASE(MultiplyScreenColor)
+					r->MultiplyScreenColor(c.v);
+					break;
+				}
+				SPADES_RCMD_CASE(SetColor)
+					r->SetColor(c.v);
+					break;
+				}
+				SPADES_RCMD_CASE(SetColorAlphaPremultiplied)
+					r->SetColorAlphaPremultiplied(c.v);
+					break;
+				}
+				SPADES_RCMD_CASE(DrawImage)
+					r->DrawImage(c.img, c.outTopLeft, c.outTopRight, c.outBottomLeft,
+								 c.inRect);
+					break;
+				}
+				SPADES_RCMD_CASE(DrawFlatGameMap)
+					r->DrawFlatGameMap(c.outRect, c.inRect);
+					break;
+				}
+				SPADES_RCMD_CASE(FrameDone)
+					r->FrameDone();
+					break;
+				}
+				SPADES_RCMD_CASE(Flip)
+					r->Flip();
+					break;
+				}
+				default:
+					SPRaise("Invalid render command: %d", static_cast<int>(cmd->type));
+			}
+#undef SPADES_RCMD_CASE
+		}
+		
 		class AsyncRenderer::RenderDispatch:
 		public ConcurrentDispatch{
 			AsyncRenderer *renderer;
 		public:
-			std::vector<char> buffer;
+			CmdBuffer buffer;
 			
 			RenderDispatch(AsyncRenderer *renderer):
 			renderer(renderer){
@@ -299,11 +405,15 @@ namespace spades {
 			virtual void Run() {
 				SPADES_MARK_FUNCTION();
 				
-				CmdBufferReader reader(buffer);
-				Command *cmd;
-				while((cmd = reader.NextCommand()) != NULL){
-					cmd->Execute(renderer->base);
-				}
+				// executes commands in place
+				CmdBufferReader reader(buffer.data);
+				try{
+					reader.ExecuteAll(renderer->base);
+				}catch(...){
+					buffer.Reset();
+					throw;
+				}
+				buffer.Reset();
 			}
 		};
 		
@@ -312,6 +422,10 @@ namespace spades {
 		base(base), queue(queue){
 			generator = new CmdBufferGenerator();
 			dispatch = new RenderDispatch(this);
+			
+			if(r_asyncBenchmark) {
+				RunBenchmark();
+			}
 		}
 		
 		AsyncRenderer::~AsyncRenderer(){
@@ -322,12 +436,16 @@ namespace spades {
 		}
 		
 		void AsyncRenderer::FlushCommands(){
-			if(generator->buffer.empty())
+			if(generator->buffer.IsEmpty())
 				return;
 			
 			dispatch->Join();
-			dispatch->buffer = std::move(generator->buffer);
-			generator->Clear();
+			
+			// the dispatch's buffer was reset after execution, so
+			// swapping gives the generator back empty, allocated storage
+			SPAssert(dispatch->buffer.IsEmpty());
+			std::swap(dispatch->buffer, generator->buffer);
+			generator->ClearRetainCache();
 			dispatch->StartOn(queue);
 		}
 		
@@ -336,6 +454,103 @@ namespace spades {
 			dispatch->Join();
 		}
 		
+#pragma mark - Benchmark
+		
+		namespace {
+			class NullImage: public IImage {
+			public:
+				virtual float GetWidth() { return 1.f; }
+				virtual float GetHeight() { return 1.f; }
+			};
+			
+			class NullRenderer: public IRenderer {
+			public:
+				uint64_t numSprites;
+				NullRenderer(): numSprites(0) {}
+				virtual void Init() {}
+				virtual void Shutdown() {}
+				virtual IImage *RegisterImage(const char *) { return nullptr; }
+				virtual IModel *RegisterModel(const char *) { return nullptr; }
+				virtual IImage *CreateImage(Bitmap *) { return nullptr; }
+				virtual IModel *CreateModel(VoxelModel *) { return nullptr; }
+				virtual void SetGameMap(GameMap *) {}
+				virtual void SetFogDistance(float) {}
+				virtual void SetFogColor(Vector3) {}
+				virtual void StartScene(const SceneDefinition&) {}
+				virtual void AddLight(const client::DynamicLightParam&) {}
+				virtual void RenderModel(IModel *, const ModelRenderParam&) {}
+				virtual void AddDebugLine(Vector3, Vector3, Vector4) {}
+				virtual void AddSprite(IImage *, Vector3, float, float) { numSprites++; }
+				virtual void AddLongSprite(IImage *, Vector3, Vector3, float) {}
+				virtual void EndScene() {}
+				virtual void MultiplyScreenColor(Vector3) {}
+				virtual void SetColor(Vector4) {}
+				virtual void SetColorAlphaPremultiplied(Vector4) {}
+				virtual void DrawImage(IImage *, const Vector2&) {}
+				virtual void DrawImage(IImage *, const AABB2&) {}
+				virtual void DrawImage(IImage *, const Vector2&, const AABB2&) {}
+				virtual void DrawImage(IImage *, const AABB2&, const AABB2&) {}
+				virtual void DrawImage(IImage *, const Vector2&, const Vector2&, const Vector2&, const AABB2&) {}
+				virtual void DrawFlatGameMap(const AABB2&, const AABB2&) {}
+				virtual void FrameDone() {}
+				virtual void Flip() {}
+				virtual Bitmap *ReadBitmap() { return nullptr; }
+				virtual float ScreenWidth() { return 640.f; }
+				virtual float ScreenHeight() { return 480.f; }
+			};
+		}
+		
+		void AsyncRenderer::RunBenchmark() {
+			SPADES_MARK_FUNCTION();
+			
+			const int numSprites = 20000;
+			const int numImages = 16;
+			const int numFrames = 50;
+			
+			Handle<NullRenderer> renderer(new NullRenderer(), false);
+			std::vector<Handle<IImage>> images;
+			for(int i = 0; i < numImages; i++)
+				images.push_back(Handle<IImage>(new NullImage(), false));
+			
+			CmdBufferGenerator gen;
+			double recordTime = 0., replayTime = 0.;
+			size_t numCommands = 0;
+			Stopwatch sw;
+			
+			for(int frame = 0; frame < numFrames; frame++) {
+				sw.Reset();
+				gen.AllocCommand<rcmds::StartScene>();
+				for(int i = 0; i < numSprites; i++) {
+					// same as AsyncRenderer::AddSprite
+					IImage *img = images[(i / 64) % numImages];
+					rcmds::AddSprite *cmd = gen.AllocCommand<rcmds::AddSprite>();
+					cmd->img = img;
+					gen.Retain(img);
+					cmd->center = MakeVector3((float)i, 0.f, 0.f);
+					cmd->radius = 1.f;
+					cmd->rotation = 0.f;
+				}
+				gen.AllocCommand<rcmds::EndScene>();
+				recordTime += sw.GetTime();
+				
+				sw.Reset();
+				CmdBufferReader reader(gen.buffer.data);
+				reader.ExecuteAll(renderer);
+				numCommands += gen.buffer.numCommands;
+				gen.buffer.Reset();
+				gen.ClearRetainCache();
+				replayTime += sw.GetTime();
+			}
+			
+			SPLog("AsyncRenderer benchmark (%d sprites/frame, %d frames): "
+				  "record %.2f Mcmds/s, replay %.2f Mcmds/s (%.3f ms/frame total)",
+				  numSprites, numFrames,
+				  (double)numCommands / recordTime / 1.e6,
+				  (double)numCommands / replayTime / 1.e6,
+				  (recordTime + replayTime) * 1000. / (double)numFrames);
+			SPAssert(renderer->numSprites == (uint64_t)numSprites * numFrames);
+		}
+		
 #pragma mark - General COmmands
 		
 		IImage *AsyncRenderer::RegisterImage(const char *filename) {
@@ -530,12 +745,7 @@ namespace spades {
 		void AsyncRenderer::AddLight(const client::DynamicLightParam& light) {
 			SPADES_MARK_FUNCTION();
 			rcmds::AddLight *cmd = generator->AllocCommand<rcmds::AddLight>();
-			if(light.image){
-				cmd->img = light.image;
-				cmd->img->AddRef();
-			}else{
-				cmd->img = NULL;
-			}
+			generator->Retain(light.image);
 			cmd->def = light;
 		}
 		
@@ -543,7 +753,7 @@ namespace spades {
 			SPADES_MARK_FUNCTION();
 			rcmds::RenderModel *cmd = generator->AllocCommand<rcmds::RenderModel>();
 			cmd->model = m;
-			m->AddRef();
+			generator->Retain(m);
 			cmd->param = p;
 		}
 		
@@ -559,7 +769,7 @@ namespace spades {
 			SPADES_MARK_FUNCTION();
 			rcmds::AddSprite *cmd = generator->AllocCommand<rcmds::AddSprite>();
 			cmd->img = img;
-			img->AddRef();
+			generator->Retain(img);
 			cmd->center = center;
 			cmd->radius = radius;
 			cmd->rotation = rotation;
@@ -570,12 +780,39 @@ namespace spades {
 			SPADES_MARK_FUNCTION();
 			rcmds::AddLongSprite *cmd = generator->AllocCommand<rcmds::AddLongSprite>();
 			cmd->img = img;
-			img->AddRef();
+			generator->Retain(img);
 			cmd->p1 = p1;
 			cmd->p2 = p2;
 			cmd->radius = radius;
 		}
 		
+		void AsyncRenderer::AddSprites(IImage *const *images, const Vector4 *colors,
+									   const Vector3 *centers, const float *radii,
+									   const float *rotations, size_t count) {
+			SPADES_MARK_FUNCTION();
+			
+			while(count > 0) {
+				size_t num = std::min<size_t>(count, rcmds::AddSprites::MaxCount);
+				rcmds::AddSprites *cmd = generator->AllocCommand<rcmds::AddSprites>
+				(rcmds::AddSprites::GetPayloadSize(num));
+				cmd->count = static_cast<uint32_t>(num);
+				
+				IImage **outImages = cmd->GetImages();
+				for(size_t i = 0; i < num; i++) {
+					outImages[i] = images[i];
+					generator->Retain(images[i]);
+				}
+				std::copy(colors, colors + num, cmd->GetColors());
+				std::copy(centers, centers + num, cmd->GetCenters());
+				std::copy(radii, radii + num, cmd->GetRadii());
+				std::copy(rotations, rotations + num, cmd->GetRotations());
+				
+				images += num; colors += num; centers += num;
+				radii += num; rotations += num;
+				count -= num;
+			}
+		}
+		
 		void AsyncRenderer::EndScene() {
 			SPADES_MARK_FUNCTION();
 			generator->AllocCommand<rcmds::EndScene>();
@@ -655,7 +892,7 @@ namespace spades {
 			
 			rcmds::DrawImage *cmd = generator->AllocCommand<rcmds::DrawImage>();
 			cmd->img = image;
-			if(image) image->AddRef();
+			generator->Retain(image);
 			cmd->outTopLeft = outTopLeft;
 			cmd->outTopRight = outTopRight;
 			cmd->outBottomLeft = outBottomLeft;
@@ -671,7 +908,7 @@ namespace spades {
 		}
 		
 		void AsyncRenderer::FrameDone() {
-			generator->AllocCommand<rcmds::FrameDone>()->arenderer = this;
+			generator->AllocCommand<rcmds::FrameDone>();
 		}
 		
 		void AsyncRenderer::Flip() {
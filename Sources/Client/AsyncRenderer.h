@@ -30,6 +30,7 @@ namespace spades {
 		class TemporaryAsyncModel;
 		class AsyncRenderer: public IRenderer {
 			class RenderDispatch;
+			struct CmdBuffer;
 			class CmdBufferGenerator;
 			class CmdBufferReader;
 			friend class TemporaryAsyncImage;
@@ -46,6 +47,9 @@ namespace spades {
 			
 			void FlushCommands();
 			void Sync();
+			
+			/** measures recording and replaying a 20,000-sprite scene. */
+			static void RunBenchmark();
 		public:
 			AsyncRenderer(IRenderer *base,
 						  DispatchQueue *renderQueue);
@@ -75,6 +79,9 @@ namespace spades {
 			
 			virtual void AddSprite(IImage *, Vector3 center, float radius, float rotation);
 			virtual void AddLongSprite(IImage *, Vector3 p1, Vector3 p2, float radius);
+			virtual void AddSprites(IImage *const *images, const Vector4 *colors,
+									const Vector3 *centers, const float *radii,
+									const float *rotations, size_t count);
 			
 			/** Finalizes a scene. 2D drawing follows. */
 			virtual void EndScene();
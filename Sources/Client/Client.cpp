@@ -27,6 +27,9 @@
 #include "Fonts.h"
 #include <Core/FileManager.h>
 #include <Core/IStream.h>
+#include <Core/AssetCache.h>
+#include <Core/AssetPreloader.h>
+#include <Core/IBitmapCodec.h>
 #include <ctime>
 
 #include "IAudioChunk.h"
@@ -44,18 +47,33 @@
 #include "ClientPlayer.h"
 
 #include "ILocalEntity.h"
-#include "SmokeSpriteEntity.h"
+#include "ParticlePool.h"
 #include "Corpse.h"
+#include "CorpseSolver.h"
 
 #include "World.h"
 #include "Weapon.h"
 #include "GameMap.h"
 #include "GameMapWrapper.h"
+#include "SnapshotSaver.h"
+#include "PlayerBVH.h"
 
 #include "NetClient.h"
+#include <Audio/AudioSampleCache.h>
+
+#ifdef __APPLE__
+#include <mach/mach.h>
+#elif defined(__unix)
+#include <unistd.h>
+#endif
 
 
 SPADES_SETTING(cg_chatBeep, "1");
+SPADES_SETTING(cg_hitTestBenchmark, "0");
+SPADES_SETTING(cg_particleBenchmark, "0");
+SPADES_SETTING(cg_corpseBenchmark, "0");
+SPADES_SETTING(cg_netBenchmark, "0");
+SPADES_SETTING(cg_demoRecord, "0");
 
 
 SPADES_SETTING(cg_serverAlert, "1");
@@ -79,6 +97,8 @@ namespace spades {
 		scoreboardVisible(false),
 		flashlightOn(false),
 		inGameLimbo(false),
+		lastNumScriptCalls(0),
+		lastNumScriptContexts(0),
 		
 		frameToRendererInit(5),
 		time(0.f),
@@ -116,6 +136,23 @@ namespace spades {
 			renderer->SetFogDistance(128.f);
 			renderer->SetFogColor(MakeVector3(.8f, 1.f, 1.f));
 			
+			snapshotSaver.reset(new SnapshotSaver());
+			particles.reset(new ParticlePool());
+			corpseSolver.reset(new CorpseSolver());
+			
+			if(cg_hitTestBenchmark) {
+				PlayerRayQuery::RunBenchmark();
+			}
+			if(cg_particleBenchmark) {
+				ParticlePool::RunBenchmark();
+			}
+			if(cg_corpseBenchmark) {
+				CorpseSolver::RunBenchmark();
+			}
+			if(cg_netBenchmark) {
+				NetClient::RunBenchmark();
+			}
+			
 			chatWindow.reset(new ChatWindow(this, GetRenderer(), textFont, false));
 			killfeedWindow.reset(new ChatWindow(this, GetRenderer(), textFont, true));
 			
@@ -162,6 +199,7 @@ namespace spades {
 				world->SetListener(nullptr);
 				renderer->SetGameMap(nullptr);
 				audioDevice->SetGameMap(nullptr);
+				corpseSolver->SetGameMap(nullptr);
 				world = nullptr;
 				map = nullptr;
 			}
@@ -184,6 +222,7 @@ namespace spades {
 				map = world->GetMap();
 				renderer->SetGameMap(map);
 				audioDevice->SetGameMap(map);
+				corpseSolver->SetGameMap(map);
 				NetLog("------ World Loaded ------");
 			}else{
 				
@@ -216,11 +255,17 @@ namespace spades {
 			
 			SPLog("Disconnected");
 			
+			if(snapshotSaver->GetNumPendingJobs() > 0) {
+				SPLog("Waiting for screenshots/mapshots to be saved");
+			}
+			snapshotSaver.reset();
+			
 			RemoveAllLocalEntities();
 			RemoveAllCorpses();
 			
 			renderer->SetGameMap(nullptr);
             audioDevice->SetGameMap(nullptr);
+			corpseSolver->SetGameMap(nullptr);
 			
 			for(size_t i = 0; i < clientPlayers.size(); i++) {
 				if(clientPlayers[i]) {
@@ -247,101 +292,210 @@ namespace spades {
 			world.reset();
 		}
 		
+		/** Returns the resident set size of the process in bytes, or
+		 * zero if it is not available on this platform. */
+		static uint64_t GetResidentMemorySize() {
+#ifdef __APPLE__
+			mach_task_basic_info_data_t info;
+			mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+			if(task_info(mach_task_self(), MACH_TASK_BASIC_INFO,
+						 reinterpret_cast<task_info_t>(&info), &count) != KERN_SUCCESS)
+				return 0;
+			return info.resident_size;
+#elif defined(__unix)
+			FILE *f = fopen("/proc/self/statm", "r");
+			if(!f)
+				return 0;
+			unsigned long size, resident;
+			int ret = fscanf(f, "%lu %lu", &size, &resident);
+			fclose(f);
+			if(ret != 2)
+				return 0;
+			return static_cast<uint64_t>(resident) *
+			static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+#else
+			return 0;
+#endif
+		}
+		
+		/** Sounds registered by DoInit. */
+		static const char * const initialSounds[] = {
+			"Sounds/Weapons/Block/Build.wav",
+			"Sounds/Weapons/Impacts/FleshLocal1.wav",
+			"Sounds/Weapons/Impacts/FleshLocal2.wav",
+			"Sounds/Weapons/Impacts/FleshLocal3.wav",
+			"Sounds/Weapons/Impacts/FleshLocal4.wav",
+			"Sounds/Misc/SwitchMapZoom.wav",
+			"Sounds/Misc/OpenMap.wav",
+			"Sounds/Misc/CloseMap.wav",
+			"Sounds/Player/Flashlight.wav",
+			"Sounds/Player/Footstep1.wav",
+			"Sounds/Player/Footstep2.wav",
+			"Sounds/Player/Footstep3.wav",
+			"Sounds/Player/Footstep4.wav",
+			"Sounds/Player/Footstep5.wav",
+			"Sounds/Player/Footstep6.wav",
+			"Sounds/Player/Footstep7.wav",
+			"Sounds/Player/Footstep8.wav",
+			"Sounds/Player/Wade1.wav",
+			"Sounds/Player/Wade2.wav",
+			"Sounds/Player/Wade3.wav",
+			"Sounds/Player/Wade4.wav",
+			"Sounds/Player/Wade5.wav",
+			"Sounds/Player/Wade6.wav",
+			"Sounds/Player/Wade7.wav",
+			"Sounds/Player/Wade8.wav",
+			"Sounds/Player/Run1.wav",
+			"Sounds/Player/Run2.wav",
+			"Sounds/Player/Run3.wav",
+			"Sounds/Player/Run4.wav",
+			"Sounds/Player/Run5.wav",
+			"Sounds/Player/Run6.wav",
+			"Sounds/Player/Run7.wav",
+			"Sounds/Player/Run8.wav",
+			"Sounds/Player/Run9.wav",
+			"Sounds/Player/Run10.wav",
+			"Sounds/Player/Run11.wav",
+			"Sounds/Player/Run12.wav",
+			"Sounds/Player/Jump.wav",
+			"Sounds/Player/Land.wav",
+			"Sounds/Player/WaterJump.wav",
+			"Sounds/Player/WaterLand.wav",
+			"Sounds/Weapons/SwitchLocal.wav",
+			"Sounds/Weapons/Switch.wav",
+			"Sounds/Weapons/Restock.wav",
+			"Sounds/Weapons/RestockLocal.wav",
+			"Sounds/Weapons/AimDownSightLocal.wav",
+			"Sounds/Feedback/Chat.wav"
+		};
+		
+		/** Images registered by DoInit. */
+		static const char * const initialImages[] = {
+			"Textures/Fluid.png",
+			"Textures/WaterExpl.png",
+			"Gfx/White.tga",
+			"Gfx/Ball.png",
+			"Gfx/Spotlight.tga",
+			"Gfx/Glare.tga",
+			"Gfx/Sight.tga",
+			"Gfx/Bullet/7.62mm.tga",
+			"Gfx/Bullet/9mm.tga",
+			"Gfx/Bullet/12gauge.tga",
+			"Gfx/CircleGradient.png",
+			"Gfx/HurtSprite.png",
+			"Gfx/HurtRing2.png"
+		};
+		
+		/** Models registered by DoInit. */
+		static const char * const initialModels[] = {
+			"Models/Player/Dead.kv6",
+			"Models/Weapons/Spade/Spade.kv6",
+			"Models/Weapons/Block/Block2.kv6",
+			"Models/Weapons/Grenade/Grenade.kv6",
+			"Models/Weapons/SMG/Weapon.kv6",
+			"Models/Weapons/SMG/WeaponNoMagazine.kv6",
+			"Models/Weapons/SMG/Magazine.kv6",
+			"Models/Weapons/Rifle/Weapon.kv6",
+			"Models/Weapons/Rifle/WeaponNoMagazine.kv6",
+			"Models/Weapons/Rifle/Magazine.kv6",
+			"Models/Weapons/Shotgun/Weapon.kv6",
+			"Models/Weapons/Shotgun/WeaponNoPump.kv6",
+			"Models/Weapons/Shotgun/Pump.kv6",
+			"Models/Player/Arm.kv6",
+			"Models/Player/UpperArm.kv6",
+			"Models/Player/LegCrouch.kv6",
+			"Models/Player/TorsoCrouch.kv6",
+			"Models/Player/Leg.kv6",
+			"Models/Player/Torso.kv6",
+			"Models/Player/Arms.kv6",
+			"Models/Player/Head.kv6",
+			"Models/MapObjects/Intel.kv6",
+			"Models/MapObjects/CheckPoint.kv6"
+		};
+		
+		/** Lists the assets used by the bundled skins, which would
+		 * otherwise be loaded when the first player spawns. */
+		static const char *skinAssetManifest = "Scripts/Skin/Preload.txt";
+		
+		/** Starts decoding the asset in background if `preload` is set,
+		 * or registers it to the renderer or the audio device otherwise.
+		 * The kind of the asset is determined by its extension. */
+		void Client::RegisterAsset(const std::string& name, bool preload) {
+			if(IBitmapCodec::EndsWith(name, ".kv6")) {
+				if(preload)
+					AssetPreloader::GetInstance().PreloadModel(name);
+				else
+					renderer->RegisterModel(name.c_str());
+			}else if(IBitmapCodec::EndsWith(name, ".wav")) {
+				if(preload)
+					audioDevice->PreloadSound(name.c_str());
+				else
+					audioDevice->RegisterSound(name.c_str());
+			}else{
+				if(preload)
+					AssetPreloader::GetInstance().PreloadBitmap(name);
+				else
+					renderer->RegisterImage(name.c_str());
+			}
+		}
+		
 		/** Initiate an initialization which likely to take some time */
 		void Client::DoInit() {
+			Stopwatch initStopwatch;
+			uint64_t initialMemory = GetResidentMemorySize();
+			
+			// decode assets on the worker threads while the renderer
+			// is being initialized
+			for(const char *name: initialSounds)
+				audioDevice->PreloadSound(name);
+			for(const char *name: initialImages)
+				AssetPreloader::GetInstance().PreloadBitmap(name);
+			for(const char *name: initialModels)
+				AssetPreloader::GetInstance().PreloadModel(name);
+			
+			std::vector<std::string> skinAssets;
+			if(FileManager::FileExists(skinAssetManifest)) {
+				try{
+					skinAssets = AssetPreloader::ReadManifest(skinAssetManifest);
+				}catch(const std::exception& ex) {
+					SPLog("Failed to read '%s': %s", skinAssetManifest, ex.what());
+				}
+			}
+			for(const std::string& name: skinAssets)
+				RegisterAsset(name, true);
+			
 			renderer->Init();
-			SmokeSpriteEntity::Preload(renderer);
-			
-			renderer->RegisterImage("Textures/Fluid.png");
-			renderer->RegisterImage("Textures/WaterExpl.png");
-			renderer->RegisterImage("Gfx/White.tga");
-			audioDevice->RegisterSound("Sounds/Weapons/Block/Build.wav");
-			audioDevice->RegisterSound("Sounds/Weapons/Impacts/FleshLocal1.wav");
-			audioDevice->RegisterSound("Sounds/Weapons/Impacts/FleshLocal2.wav");
-			audioDevice->RegisterSound("Sounds/Weapons/Impacts/FleshLocal3.wav");
-			audioDevice->RegisterSound("Sounds/Weapons/Impacts/FleshLocal4.wav");
-			audioDevice->RegisterSound("Sounds/Misc/SwitchMapZoom.wav");
-			audioDevice->RegisterSound("Sounds/Misc/OpenMap.wav");
-			audioDevice->RegisterSound("Sounds/Misc/CloseMap.wav");
-			audioDevice->RegisterSound("Sounds/Player/Flashlight.wav");
-			audioDevice->RegisterSound("Sounds/Player/Footstep1.wav");
-			audioDevice->RegisterSound("Sounds/Player/Footstep2.wav");
-			audioDevice->RegisterSound("Sounds/Player/Footstep3.wav");
-			audioDevice->RegisterSound("Sounds/Player/Footstep4.wav");
-			audioDevice->RegisterSound("Sounds/Player/Footstep5.wav");
-			audioDevice->RegisterSound("Sounds/Player/Footstep6.wav");
-			audioDevice->RegisterSound("Sounds/Player/Footstep7.wav");
-			audioDevice->RegisterSound("Sounds/Player/Footstep8.wav");
-			audioDevice->RegisterSound("Sounds/Player/Wade1.wav");
-			audioDevice->RegisterSound("Sounds/Player/Wade2.wav");
-			audioDevice->RegisterSound("Sounds/Player/Wade3.wav");
-			audioDevice->RegisterSound("Sounds/Player/Wade4.wav");
-			audioDevice->RegisterSound("Sounds/Player/Wade5.wav");
-			audioDevice->RegisterSound("Sounds/Player/Wade6.wav");
-			audioDevice->RegisterSound("Sounds/Player/Wade7.wav");
-			audioDevice->RegisterSound("Sounds/Player/Wade8.wav");
-			audioDevice->RegisterSound("Sounds/Player/Run1.wav");
-			audioDevice->RegisterSound("Sounds/Player/Run2.wav");
-			audioDevice->RegisterSound("Sounds/Player/Run3.wav");
-			audioDevice->RegisterSound("Sounds/Player/Run4.wav");
-			audioDevice->RegisterSound("Sounds/Player/Run5.wav");
-			audioDevice->RegisterSound("Sounds/Player/Run6.wav");
-			audioDevice->RegisterSound("Sounds/Player/Run7.wav");
-			audioDevice->RegisterSound("Sounds/Player/Run8.wav");
-			audioDevice->RegisterSound("Sounds/Player/Run9.wav");
-			audioDevice->RegisterSound("Sounds/Player/Run10.wav");
-			audioDevice->RegisterSound("Sounds/Player/Run11.wav");
-			audioDevice->RegisterSound("Sounds/Player/Run12.wav");
-			audioDevice->RegisterSound("Sounds/Player/Jump.wav");
-			audioDevice->RegisterSound("Sounds/Player/Land.wav");
-			audioDevice->RegisterSound("Sounds/Player/WaterJump.wav");
-			audioDevice->RegisterSound("Sounds/Player/WaterLand.wav");
-			audioDevice->RegisterSound("Sounds/Weapons/SwitchLocal.wav");
-			audioDevice->RegisterSound("Sounds/Weapons/Switch.wav");
-			audioDevice->RegisterSound("Sounds/Weapons/Restock.wav");
-			audioDevice->RegisterSound("Sounds/Weapons/RestockLocal.wav");
-			audioDevice->RegisterSound("Sounds/Weapons/AimDownSightLocal.wav");
-			renderer->RegisterImage("Gfx/Ball.png");
-			renderer->RegisterModel("Models/Player/Dead.kv6");
-			renderer->RegisterImage("Gfx/Spotlight.tga");
-			renderer->RegisterImage("Gfx/Glare.tga");
-			renderer->RegisterModel("Models/Weapons/Spade/Spade.kv6");
-			renderer->RegisterModel("Models/Weapons/Block/Block2.kv6");
-			renderer->RegisterModel("Models/Weapons/Grenade/Grenade.kv6");
-			renderer->RegisterModel("Models/Weapons/SMG/Weapon.kv6");
-			renderer->RegisterModel("Models/Weapons/SMG/WeaponNoMagazine.kv6");
-			renderer->RegisterModel("Models/Weapons/SMG/Magazine.kv6");
-			renderer->RegisterModel("Models/Weapons/Rifle/Weapon.kv6");
-			renderer->RegisterModel("Models/Weapons/Rifle/WeaponNoMagazine.kv6");
-			renderer->RegisterModel("Models/Weapons/Rifle/Magazine.kv6");
-			renderer->RegisterModel("Models/Weapons/Shotgun/Weapon.kv6");
-			renderer->RegisterModel("Models/Weapons/Shotgun/WeaponNoPump.kv6");
-			renderer->RegisterModel("Models/Weapons/Shotgun/Pump.kv6");
-			renderer->RegisterModel("Models/Player/Arm.kv6");
-			renderer->RegisterModel("Models/Player/UpperArm.kv6");
-			renderer->RegisterModel("Models/Player/LegCrouch.kv6");
-			renderer->RegisterModel("Models/Player/TorsoCrouch.kv6");
-			renderer->RegisterModel("Models/Player/Leg.kv6");
-			renderer->RegisterModel("Models/Player/Torso.kv6");
-			renderer->RegisterModel("Models/Player/Arms.kv6");
-			renderer->RegisterModel("Models/Player/Head.kv6");
-			renderer->RegisterModel("Models/MapObjects/Intel.kv6");
-			renderer->RegisterModel("Models/MapObjects/CheckPoint.kv6");
-			renderer->RegisterImage("Gfx/Sight.tga");
-			renderer->RegisterImage("Gfx/Bullet/7.62mm.tga");
-			renderer->RegisterImage("Gfx/Bullet/9mm.tga");
-			renderer->RegisterImage("Gfx/Bullet/12gauge.tga");
-			renderer->RegisterImage("Gfx/CircleGradient.png");
-			renderer->RegisterImage("Gfx/HurtSprite.png");
-			renderer->RegisterImage("Gfx/HurtRing2.png");
-			audioDevice->RegisterSound("Sounds/Feedback/Chat.wav");
-			
-			SPLog("Started connecting to '%s'", hostname.asString(true).c_str());
+			ParticlePool::Preload(renderer);
+			
+			for(const char *name: initialImages)
+				renderer->RegisterImage(name);
+			for(const char *name: initialSounds)
+				audioDevice->RegisterSound(name);
+			for(const char *name: initialModels)
+				renderer->RegisterModel(name);
+			for(const std::string& name: skinAssets)
+				RegisterAsset(name, false);
+			AssetCache::LogStatistics();
+			audio::AudioSampleCache::GetInstance().LogStatistics();
+			{
+				uint64_t memory = GetResidentMemorySize();
+				SPLog("Assets loaded in %.1f ms; resident memory %.1f MB -> %.1f MB",
+					  initStopwatch.GetTime() * 1000.,
+					  static_cast<double>(initialMemory) / (1024. * 1024.),
+					  static_cast<double>(memory) / (1024. * 1024.));
+			}
+			
 			net.reset(new NetClient(this));
-			net->Connect(hostname);
+			if(!demoFileName.empty()){
+				SPLog("Started playing demo '%s'", demoFileName.c_str());
+				net->PlayDemo(FileManager::OpenForReading(demoFileName.c_str()));
+			}else{
+				SPLog("Started connecting to '%s'", hostname.asString(true).c_str());
+				net->Connect(hostname);
+			}
 			
 			// decide log file name
-			std::string fn = hostname.asString(false);
+			std::string fn = demoFileName.empty() ? hostname.asString(false) : demoFileName;
 			std::string fn2;
 			{
 				time_t t;
@@ -368,6 +522,17 @@ namespace spades {
 					fn2 += '_';
 				}
 			}
+			
+			if(cg_demoRecord && demoFileName.empty()){
+				std::string demoFn = "Demos/" + fn2 + ".demo";
+				try{
+					net->StartDemoRecording(FileManager::OpenForWriting(demoFn.c_str()));
+					SPLog("Demo recording started at '%s'", demoFn.c_str());
+				}catch(const std::exception& ex){
+					SPLog("Failed to open demo file '%s' (%s)", demoFn.c_str(), ex.what());
+				}
+			}
+			
 			fn2 = "NetLogs/" + fn2 + ".log";
 			
 			try{
@@ -378,6 +543,15 @@ namespace spades {
 			}
 		}
 		
+		void Client::PlayDemo(const std::string &fileName) {
+			SPAssert(!net);
+			demoFileName = fileName;
+		}
+		
+		bool Client::IsDemoFinished() {
+			return net && net->IsDemoFinished();
+		}
+		
 		void Client::RunFrame(float dt) {
 			SPADES_MARK_FUNCTION();
 			
@@ -399,6 +573,12 @@ namespace spades {
 			
 			timeSinceInit += std::min(dt, .03f);
 			
+			// report screenshots/mapshots saved in background
+			for(const auto& result: snapshotSaver->TakeResults()) {
+				ShowAlert(result.message,
+						  result.failed ? AlertType::Error : AlertType::Notice);
+			}
+			
 			// update network
 			try{
 				if(net->GetStatus() == NetClientStatusConnected)
@@ -571,25 +751,26 @@ namespace spades {
 #pragma mark - Snapshots
 		
 		void Client::TakeMapShot(){
+			Stopwatch sw;
 			
 			try{
-				std::string name = MapShotPath();
-				{
-					std::unique_ptr<IStream> stream(FileManager::OpenForWriting(name.c_str()));
-					try{
-						GameMap *map = GetWorld()->GetMap();
-						if(map == nullptr){
-							SPRaise("No map loaded");
-						}
-						map->Save(stream.get());
-					}catch(...){
-						throw;
-					}
+				GameMap *map = GetWorld()->GetMap();
+				if(map == nullptr){
+					SPRaise("No map loaded");
 				}
 				
-				std::string msg;
-				msg = _Tr("Client", "Map saved: {0}", name);
-				ShowAlert(msg, AlertType::Notice);
+				std::string name = MapShotPath();
+				
+				// columns modified while the map is being saved are
+				// copied by the snapshot before modification
+				std::shared_ptr<GameMapSnapshot> snapshot(new GameMapSnapshot(map));
+				snapshotSaver->Enqueue(name, [snapshot, name]() {
+					std::unique_ptr<IStream> stream(FileManager::OpenForWriting(name.c_str()));
+					snapshot->Save(stream.get());
+					SPLog("%d column(s) were modified while saving %s",
+						  snapshot->GetNumPreservedColumns(), name.c_str());
+				}, _Tr("Client", "Map saved: {0}", name),
+				_Tr("Client", "Saving map failed: "));
 			}catch(const Exception& ex){
 				std::string msg;
 				msg = _Tr("Client", "Saving map failed: ");
@@ -603,19 +784,27 @@ namespace spades {
 				ShowAlert(msg, AlertType::Error);
 				SPLog("Saving map failed: %s", ex.what());
 			}
+			
+			SPLog("Mapshot took %.2f ms on the game thread",
+				  sw.GetTime() * 1000.);
 		}
 		
 		std::string Client::MapShotPath() {
 			char buf[256];
 			for(int i = 0; i < 10000;i++){
-				sprintf(buf, "Mapshots/shot%04d.vxl", nextScreenShotIndex);
+				sprintf(buf, "Mapshots/shot%04d.vxl", nextMapShotIndex);
 				if(FileManager::FileExists(buf)){
-					nextScreenShotIndex++;
-					if(nextScreenShotIndex >= 10000)
-						nextScreenShotIndex = 0;
+					nextMapShotIndex++;
+					if(nextMapShotIndex >= 10000)
+						nextMapShotIndex = 0;
 					continue;
 				}
 				
+				// the file is written later, so reserve the index now
+				nextMapShotIndex++;
+				if(nextMapShotIndex >= 10000)
+					nextMapShotIndex = 0;
+				
 				return buf;
 			}
 			
@@ -41,6 +41,9 @@ namespace spades {
 		struct SceneDefinition;
 		class GameMap;
 		class GameMapWrapper;
+		class ParticlePool;
+		class ParticleSprite;
+		class SnapshotSaver;
 		class World;
 		struct PlayerInput;
 		struct WeaponInput;
@@ -51,6 +54,7 @@ namespace spades {
 		class ChatWindow;
 		class CenterMessageView;
 		class Corpse;
+		class CorpseSolver;
 		class HurtRingView;
 		class MapView;
 		class ScoreboardView;
@@ -94,6 +98,8 @@ namespace spades {
 			};
 			
 			FPSCounter fpsCounter;
+			uint64_t lastNumScriptCalls;
+			uint64_t lastNumScriptContexts;
 			
 			std::unique_ptr<NetClient> net;
 			std::string playerName;
@@ -102,6 +108,7 @@ namespace spades {
 			Handle<ClientUI> scriptedUI;
 			
 			ServerAddress hostname;
+			std::string demoFileName;
 			
 			std::unique_ptr<World> world;
 			Handle<GameMap> map;
@@ -218,6 +225,8 @@ namespace spades {
 			float alertAppearTime;
 			
 			std::list<std::unique_ptr<ILocalEntity>> localEntities;
+			std::unique_ptr<ParticlePool> particles;
+			std::unique_ptr<CorpseSolver> corpseSolver;
 			std::list<std::unique_ptr<Corpse>> corpses;
 			Corpse *lastMyCorpse;
 			float corpseSoftTimeLimit;
@@ -229,12 +238,14 @@ namespace spades {
 			
 			int nextScreenShotIndex;
 			int nextMapShotIndex;
+			std::unique_ptr<SnapshotSaver> snapshotSaver;
 			
 			Vector3 Project(Vector3);
 			
 			void DrawSplash();
 			void DrawStartupScreen();
 			void DoInit();
+			void RegisterAsset(const std::string& name, bool preload);
 			
 			void ShowAlert(const std::string& contents,
 						   AlertType type);
@@ -304,11 +315,19 @@ namespace spades {
 			virtual AABB2 GetTextInputRect();
 			virtual bool NeedsAbsoluteMouseCoordinate();
 			
+			/** replays the given demo file instead of connecting.
+			 * Must be called before the first frame. */
+			void PlayDemo(const std::string& fileName);
+			bool IsDemoFinished();
+			
+			float GetTime() const { return time; }
+			
 			void SetWorld(World *);
 			World *GetWorld() const { return world.get(); }
 			void AddLocalEntity(ILocalEntity *ent){
 				localEntities.emplace_back(ent);
 			}
+			void AddParticle(const ParticleSprite&);
 			
 			IRenderer *GetRenderer() {return renderer;}
 			SceneDefinition GetLastSceneDef() { return lastSceneDef; }
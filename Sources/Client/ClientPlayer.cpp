@@ -39,6 +39,7 @@
 #include <ScriptBindings/IBlockSkin.h>
 #include <ScriptBindings/IGrenadeSkin.h>
 #include <ScriptBindings/IWeaponSkin.h>
+#include <ScriptBindings/IBatchedToolSkin.h>
 #include "IAudioDevice.h"
 #include "GunCasing.h"
 #include "IAudioChunk.h"
@@ -50,6 +51,7 @@ namespace spades {
 	namespace client {
 		ClientPlayer::ClientPlayer(Player *p,
 								   Client *c):
+		RefCountedObject(RefCountMode::SingleThreaded),
 		player(p), client(c){
 			SPADES_MARK_FUNCTION();
 			
@@ -65,6 +67,20 @@ namespace spades {
 			IRenderer *renderer = client->GetRenderer();
 			IAudioDevice *audio = client->GetAudioDevice();
 			
+			// Register* returns a new reference; adopt it
+			armModel.Set(renderer->RegisterModel("Models/Player/Arm.kv6"), false);
+			upperArmModel.Set(renderer->RegisterModel("Models/Player/UpperArm.kv6"), false);
+			deadModel.Set(renderer->RegisterModel("Models/Player/Dead.kv6"), false);
+			legModel.Set(renderer->RegisterModel("Models/Player/Leg.kv6"), false);
+			legCrouchModel.Set(renderer->RegisterModel("Models/Player/LegCrouch.kv6"), false);
+			torsoModel.Set(renderer->RegisterModel("Models/Player/Torso.kv6"), false);
+			torsoCrouchModel.Set(renderer->RegisterModel("Models/Player/TorsoCrouch.kv6"), false);
+			armsModel.Set(renderer->RegisterModel("Models/Player/Arms.kv6"), false);
+			headModel.Set(renderer->RegisterModel("Models/Player/Head.kv6"), false);
+			intelModel.Set(renderer->RegisterModel("Models/MapObjects/Intel.kv6"), false);
+			spotlightImage.Set(renderer->RegisterImage("Gfx/Spotlight.tga"), false);
+			glareImage.Set(renderer->RegisterImage("Gfx/Glare.tga"), false);
+			
 			static ScriptFunction spadeFactory("ISpadeSkin@ CreateThirdPersonSpadeSkin(Renderer@, AudioDevice@)");
 			spadeSkin = initScriptFactory( spadeFactory, renderer, audio );
 			
@@ -296,70 +312,67 @@ namespace spades {
 			return Matrix4::FromAxis(-p->GetRight(), p->GetFront(), -p->GetUp(), p->GetEye());
 		}
 		
-		void ClientPlayer::SetSkinParameterForTool(Player::ToolType type,
-												   asIScriptObject *skin) {
+		void ClientPlayer::GetSkinParameterForTool(Player::ToolType type,
+												   SkinParameters& params) {
 			Player *p = player;
 			if(currentTool == Player::ToolSpade) {
 				
-				ScriptISpadeSkin interface(skin);
 				WeaponInput inp = p->GetWeaponInput();
 				if(p->GetTool() != Player::ToolSpade){
-					interface.SetActionType(SpadeActionTypeIdle);
-					interface.SetActionProgress(0.f);
+					params.actionType = SpadeActionTypeIdle;
+					params.actionProgress = 0.f;
 				}else if(inp.primary) {
-					interface.SetActionType(SpadeActionTypeBash);
-					interface.SetActionProgress(p->GetSpadeAnimationProgress());
+					params.actionType = SpadeActionTypeBash;
+					params.actionProgress = p->GetSpadeAnimationProgress();
 				}else if(inp.secondary) {
-					interface.SetActionType(p->IsFirstDig() ?
-											SpadeActionTypeDigStart:
-											SpadeActionTypeDig);
-					interface.SetActionProgress(p->GetDigAnimationProgress());
+					params.actionType = p->IsFirstDig() ?
+					SpadeActionTypeDigStart:
+					SpadeActionTypeDig;
+					params.actionProgress = p->GetDigAnimationProgress();
 				}else{
-					interface.SetActionType(SpadeActionTypeIdle);
-					interface.SetActionProgress(0.f);
+					params.actionType = SpadeActionTypeIdle;
+					params.actionProgress = 0.f;
 				}
 			}else if(currentTool == Player::ToolBlock) {
 				
 				// TODO: smooth ready state
-				ScriptIBlockSkin interface(skin);
 				if(p->GetTool() != Player::ToolBlock){
 					// FIXME: use block's IsReadyToUseTool
 					// for smoother transition
-					interface.SetReadyState(0.f);
+					params.readyState = 0.f;
 				}else if(p->IsReadyToUseTool()) {
-					interface.SetReadyState(1.f);
+					params.readyState = 1.f;
 				}else{
-					interface.SetReadyState(0.f);
+					params.readyState = 0.f;
 				}
 				
-				interface.SetBlockColor(MakeVector3(p->GetBlockColor()) / 255.f);
+				params.blockColor = MakeVector3(p->GetBlockColor()) / 255.f;
 			}else if(currentTool == Player::ToolGrenade) {
 				
-				ScriptIGrenadeSkin interface(skin);
-				interface.SetReadyState(1.f - p->GetTimeToNextGrenade() / 0.5f);
+				params.readyState = 1.f - p->GetTimeToNextGrenade() / 0.5f;
 				
 				WeaponInput inp = p->GetWeaponInput();
 				if(inp.primary) {
-					interface.SetCookTime(p->GetGrenadeCookTime());
+					params.cookTime = p->GetGrenadeCookTime();
 				}else{
-					interface.SetCookTime(0.f);
+					params.cookTime = 0.f;
 				}
 			}else if(currentTool == Player::ToolWeapon) {
 				
 				Weapon *w = p->GetWeapon();
-				ScriptIWeaponSkin interface(skin);
-				interface.SetReadyState(1.f - w->TimeToNextFire() / w->GetDelay());
-				interface.SetAimDownSightState(aimDownState);
-				interface.SetAmmo(w->GetAmmo());
-				interface.SetClipSize(w->GetClipSize());
-				interface.SetReloading(w->IsReloading());
-				interface.SetReloadProgress(w->GetReloadProgress());
+				params.readyState = 1.f - w->TimeToNextFire() / w->GetDelay();
+				params.aimDownSightState = aimDownState;
+				params.ammo = w->GetAmmo();
+				params.clipSize = w->GetClipSize();
+				params.isReloading = w->IsReloading();
+				params.reloadProgress = w->GetReloadProgress();
 			}else{
 				SPInvalidEnum("currentTool", currentTool);
 			}
 		}
 		
-		void ClientPlayer::SetCommonSkinParameter(asIScriptObject *skin){
+		void ClientPlayer::GetCommonSkinParameter(asIScriptObject *skin,
+												  SkinParameters& params){
 			asIScriptObject *curSkin;
 			if(ShouldRenderInThirdPersonView()){
 				if(currentTool == Player::ToolSpade) {
@@ -391,13 +404,55 @@ namespace spades {
 			float putdown = 1.f - toolRaiseState;
 			putdown *= putdown;
 			putdown = std::min(1.f, putdown * 1.5f);
+			params.raiseState = (skin == curSkin)?
+			(1.f - putdown):
+			0.f;
+			params.sprintState = sprint;
+			params.isMuted = client->IsMuted();
+		}
+		
+		void ClientPlayer::SetSkinParameters(asIScriptObject *skin) {
+			SkinParameters params;
+			GetSkinParameterForTool(currentTool, params);
+			GetCommonSkinParameter(skin, params);
+			
+			// skins implementing IBatchedToolSkin receive everything
+			// with one script call
+			{
+				ScriptIBatchedToolSkin interface(skin);
+				if(interface.IsImplemented()) {
+					interface.SetParameters(params);
+					return;
+				}
+			}
+			
+			if(currentTool == Player::ToolSpade) {
+				ScriptISpadeSkin interface(skin);
+				interface.SetActionType(static_cast<SpadeActionType>(params.actionType));
+				interface.SetActionProgress(params.actionProgress);
+			}else if(currentTool == Player::ToolBlock) {
+				ScriptIBlockSkin interface(skin);
+				interface.SetReadyState(params.readyState);
+				interface.SetBlockColor(params.blockColor);
+			}else if(currentTool == Player::ToolGrenade) {
+				ScriptIGrenadeSkin interface(skin);
+				interface.SetReadyState(params.readyState);
+				interface.SetCookTime(params.cookTime);
+			}else if(currentTool == Player::ToolWeapon) {
+				ScriptIWeaponSkin interface(skin);
+				interface.SetReadyState(params.readyState);
+				interface.SetAimDownSightState(params.aimDownSightState);
+				interface.SetAmmo(params.ammo);
+				interface.SetClipSize(params.clipSize);
+				interface.SetReloading(params.isReloading);
+				interface.SetReloadProgress(params.reloadProgress);
+			}
+			
 			{
 				ScriptIToolSkin interface(skin);
-				interface.SetRaiseState((skin == curSkin)?
-										(1.f - putdown):
-										0.f);
-				interface.SetSprintState(sprint);
-				interface.SetMuted(client->IsMuted());
+				interface.SetRaiseState(params.raiseState);
+				interface.SetSprintState(params.sprintState);
+				interface.SetMuted(params.isMuted);
 			}
 		}
 		
@@ -422,7 +477,7 @@ namespace spades {
 				light.spotAxis[0] = p->GetRight();
 				light.spotAxis[1] = p->GetUp();
 				light.spotAxis[2] = p->GetFront();
-				light.image = renderer->RegisterImage("Gfx/Spotlight.tga");
+				light.image = spotlightImage;
 				renderer->AddLight(light);
 				
 				light.color *= .3f;
@@ -433,7 +488,7 @@ namespace spades {
 				
 				// add glare
 				renderer->SetColorAlphaPremultiplied(MakeVector4(1, .7f, .5f, 0) * brightness * .3f);
-				renderer->AddSprite(renderer->RegisterImage("Gfx/Glare.tga"), (eyeMatrix * MakeVector3(0, 0.3f, -0.3f)).GetXYZ(), .8f, 0.f);
+				renderer->AddSprite(glareImage, (eyeMatrix * MakeVector3(0, 0.3f, -0.3f)).GetXYZ(), .8f, 0.f);
 			}
 			
 			Vector3 leftHand, rightHand;
@@ -479,9 +534,7 @@ namespace spades {
 				SPInvalidEnum("currentTool", currentTool);
 			}
 			
-			SetSkinParameterForTool(currentTool, skin);
-			
-			SetCommonSkinParameter(skin);
+			SetSkinParameters(skin);
 			
 			// common process
 			{
@@ -507,8 +560,8 @@ namespace spades {
 				ModelRenderParam param;
 				param.depthHack = true;
 				
-				IModel *model = renderer->RegisterModel("Models/Player/Arm.kv6");
-				IModel *model2 = renderer->RegisterModel("Models/Player/UpperArm.kv6");
+				IModel *model = armModel;
+				IModel *model2 = upperArmModel;
 				
 				IntVector3 col = p->GetColor();
 				param.customColor = MakeVector3(col.x/255.f, col.y/255.f, col.z/255.f);
@@ -591,7 +644,7 @@ namespace spades {
 					IntVector3 col = p->GetColor();
 					param.customColor = MakeVector3(col.x/255.f, col.y/255.f, col.z/255.f);
 					
-					IModel *model = renderer->RegisterModel("Models/Player/Dead.kv6");
+					IModel *model = deadModel;
 					renderer->RenderModel(model, param);
 				}
 				return;
@@ -612,9 +665,7 @@ namespace spades {
 				SPInvalidEnum("currentTool", currentTool);
 			}
 			
-			SetSkinParameterForTool(currentTool, skin);
-			
-			SetCommonSkinParameter(skin);
+			SetSkinParameters(skin);
 			
 			float pitchBias;
 			{
@@ -658,7 +709,7 @@ namespace spades {
 				leg1 = lower * leg1;
 				leg2 = lower * leg2;
 				
-				model = renderer->RegisterModel("Models/Player/LegCrouch.kv6");
+				model = legCrouchModel;
 				param.matrix = leg1 * scaler;
 				renderer->RenderModel(model, param);
 				param.matrix = leg2 * scaler;
@@ -667,7 +718,7 @@ namespace spades {
 				torso = Matrix4::Translate(0.f,0.f,-0.55f);
 				torso = lower * torso;
 				
-				model = renderer->RegisterModel("Models/Player/TorsoCrouch.kv6");
+				model = torsoCrouchModel;
 				param.matrix = torso * scaler;
 				renderer->RenderModel(model, param);
 				
@@ -692,7 +743,7 @@ namespace spades {
 				leg1 = lower * leg1;
 				leg2 = lower * leg2;
 				
-				model = renderer->RegisterModel("Models/Player/Leg.kv6");
+				model = legModel;
 				param.matrix = leg1 * scaler;
 				renderer->RenderModel(model, param);
 				param.matrix = leg2 * scaler;
@@ -701,7 +752,7 @@ namespace spades {
 				torso = Matrix4::Translate(0.f,0.f,-1.0f);
 				torso = lower * torso;
 				
-				model = renderer->RegisterModel("Models/Player/Torso.kv6");
+				model = torsoModel;
 				param.matrix = torso * scaler;
 				renderer->RenderModel(model, param);
 				
@@ -724,14 +775,14 @@ namespace spades {
 			
 			arms = arms * Matrix4::Rotate(MakeVector3(1,0,0), armPitch);
 			
-			model = renderer->RegisterModel("Models/Player/Arms.kv6");
+			model = armsModel;
 			param.matrix = arms * scaler;
 			renderer->RenderModel(model, param);
 			
 			
 			head = head * Matrix4::Rotate(MakeVector3(1,0,0), pitch);
 			
-			model = renderer->RegisterModel("Models/Player/Head.kv6");
+			model = headModel;
 			param.matrix = head * scaler;
 			renderer->RenderModel(model, param);
 			
@@ -759,7 +810,7 @@ namespace spades {
 						param.customColor = MakeVector3(col2.x/255.f, col2.y/255.f, col2.z/255.f);
 						Matrix4 mIntel = torso * Matrix4::Translate(0,0.6f,0.5f);
 						
-						model = renderer->RegisterModel("Models/MapObjects/Intel.kv6");
+						model = intelModel;
 						param.matrix = mIntel * scaler;
 						renderer->RenderModel(model, param);
 						
@@ -819,9 +870,7 @@ namespace spades {
 					SPInvalidEnum("currentTool", currentTool);
 				}
 				
-				SetSkinParameterForTool(currentTool, skin);
-				
-				SetCommonSkinParameter(skin);
+				SetSkinParameters(skin);
 				
 				// common process
 				{
@@ -32,8 +32,11 @@ namespace spades {
 	namespace client {
 		
 		class Client;
+		struct SkinParameters;
 		class IRenderer;
 		class IAudioDevice;
+		class IModel;
+		class IImage;
 		
 		/** Representation of player which is used by
 		 * drawing/view layer of game client. */
@@ -60,13 +63,30 @@ namespace spades {
 			asIScriptObject *weaponViewSkin;
 			asIScriptObject *grenadeViewSkin;
 			
+			// resources drawn every frame; registered once so that
+			// rendering doesn't look them up by name each time
+			Handle<IModel> armModel;
+			Handle<IModel> upperArmModel;
+			Handle<IModel> deadModel;
+			Handle<IModel> legModel;
+			Handle<IModel> legCrouchModel;
+			Handle<IModel> torsoModel;
+			Handle<IModel> torsoCrouchModel;
+			Handle<IModel> armsModel;
+			Handle<IModel> headModel;
+			Handle<IModel> intelModel;
+			Handle<IImage> spotlightImage;
+			Handle<IImage> glareImage;
+			
 			Matrix4 GetEyeMatrix();
 			void AddToSceneThirdPersonView();
 			void AddToSceneFirstPersonView();
 			
-			void SetSkinParameterForTool(Player::ToolType,
-										 asIScriptObject *);
-			void SetCommonSkinParameter(asIScriptObject *);
+			void GetSkinParameterForTool(Player::ToolType,
+										 SkinParameters&);
+			void GetCommonSkinParameter(asIScriptObject *,
+										SkinParameters&);
+			void SetSkinParameters(asIScriptObject *);
 			
 			float GetLocalFireVibration();
 			
@@ -27,6 +27,8 @@
 #include <Core/Strings.h>
 #include <Core/Bitmap.h>
 #include <Core/FileManager.h>
+#include <Core/Stopwatch.h>
+#include <Draw/SWFeatureLevel.h>
 
 #include "IAudioChunk.h"
 #include "IAudioDevice.h"
@@ -43,8 +45,7 @@
 #include "Tracer.h"
 #include "FallingBlock.h"
 #include "HurtRingView.h"
-#include "ParticleSpriteEntity.h"
-#include "SmokeSpriteEntity.h"
+#include "ParticlePool.h"
 #include "IFont.h"
 #include "ScoreboardView.h"
 #include "TCProgressView.h"
@@ -53,8 +54,11 @@
 #include "Weapon.h"
 #include "GameMap.h"
 #include "Grenade.h"
+#include "SnapshotSaver.h"
 
 #include "NetClient.h"
+#include <ScriptBindings/ScriptManager.h>
+#include <Core/Profiler.h>
 
 SPADES_SETTING(cg_hitIndicator, "1");
 SPADES_SETTING(cg_debugAim, "0");
@@ -82,9 +86,32 @@ namespace spades {
 					SPRaise("Invalid screenshot format: %s", cg_screenshotFormat.CString());
 				}
 			}
+			
+			/** sets the alpha of every pixel to 255. */
+			void ForceOpaque(uint32_t *pixels, size_t count) {
+#if ENABLE_SSE2
+				const __m128i alpha = _mm_set1_epi32((int)0xff000000);
+				for(; count >= 16; count -= 16, pixels += 16) {
+					__m128i *p = reinterpret_cast<__m128i *>(pixels);
+					__m128i a = _mm_loadu_si128(p);
+					__m128i b = _mm_loadu_si128(p + 1);
+					__m128i c = _mm_loadu_si128(p + 2);
+					__m128i d = _mm_loadu_si128(p + 3);
+					_mm_storeu_si128(p,     _mm_or_si128(a, alpha));
+					_mm_storeu_si128(p + 1, _mm_or_si128(b, alpha));
+					_mm_storeu_si128(p + 2, _mm_or_si128(c, alpha));
+					_mm_storeu_si128(p + 3, _mm_or_si128(d, alpha));
+				}
+#endif
+				for(; count > 0; count--) {
+					*(pixels++) |= 0xff000000UL;
+				}
+			}
 		}
 		
 		void Client::TakeScreenShot(bool sceneOnly){
+			Stopwatch sw;
+			
 			SceneDefinition sceneDef = CreateSceneDefinition();
 			lastSceneDef = sceneDef;
 			
@@ -100,23 +127,22 @@ namespace spades {
 			renderer->FrameDone();
 			
 			Handle<Bitmap> bmp(renderer->ReadBitmap(), false);
-			// force 100% opacity
-			
-			uint32_t *pixels = bmp->GetPixels();
-			for(size_t i = bmp->GetWidth() * bmp->GetHeight(); i > 0; i--) {
-				*(pixels++) |= 0xff000000UL;
-			}
 			
 			try{
 				std::string name = ScreenShotPath();
-				bmp->Save(name);
 				
 				std::string msg;
 				if(sceneOnly)
 					msg = _Tr("Client", "Sceneshot saved: {0}", name);
 				else
 					msg = _Tr("Client", "Screenshot saved: {0}", name);
-				ShowAlert(msg, AlertType::Notice);
+				
+				// post-processing and encoding are done in background
+				snapshotSaver->Enqueue(name, [bmp, name]() mutable {
+					ForceOpaque(bmp->GetPixels(),
+								(size_t)bmp->GetWidth() * bmp->GetHeight());
+					bmp->Save(name);
+				}, msg, _Tr("Client", "Screenshot failed: "));
 			}catch(const Exception& ex){
 				std::string msg;
 				msg = _Tr("Client", "Screenshot failed: ");
@@ -130,6 +156,9 @@ namespace spades {
 				ShowAlert(msg, AlertType::Error);
 				SPLog("Screenshot failed: %s", ex.what());
 			}
+			
+			SPLog("Screenshot took %.2f ms on the game thread",
+				  sw.GetTime() * 1000.);
 		}
 		
 		std::string Client::ScreenShotPath() {
@@ -149,7 +178,13 @@ namespace spades {
 					continue;
 				}
 				
-				switch(GetScreenshotFormat()) {
+				// the file is written later, so reserve the index now
+				ScreenshotFormat format = GetScreenshotFormat();
+				nextScreenShotIndex++;
+				if(nextScreenShotIndex >= 10000)
+					nextScreenShotIndex = 0;
+				
+				switch(format) {
 					case ScreenshotFormat::Jpeg:
 						return bufJpeg;
 					case ScreenshotFormat::Targa:
@@ -857,6 +892,20 @@ namespace spades {
 				str += buf;
 			}
 			
+			{
+				uint64_t numCalls = ScriptManager::GetNumScriptCalls();
+				sprintf(buf, ", script calls: %d/frame",
+						static_cast<int>(numCalls - lastNumScriptCalls));
+				str += buf;
+				lastNumScriptCalls = numCalls;
+				
+				uint64_t numContexts = ScriptManager::GetNumContextAcquisitions();
+				sprintf(buf, ", contexts: %d/frame",
+						static_cast<int>(numContexts - lastNumScriptContexts));
+				str += buf;
+				lastNumScriptContexts = numContexts;
+			}
+			
 			float scrWidth = renderer->ScreenWidth();
 			float scrHeight = renderer->ScreenHeight();
 			IFont *font = textFont;
@@ -878,6 +927,7 @@ namespace spades {
 		
 		void Client::Draw2D(){
 			SPADES_MARK_FUNCTION();
+			SPADES_PROFILE_ZONE("Client::Draw2D");
 			
 			if(GetWorld()){
 				Draw2DWithWorld();
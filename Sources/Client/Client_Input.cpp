@@ -339,7 +339,7 @@ namespace spades {
 						if(name == "p" && down){
 							Corpse *corp;
 							Player *victim = world->GetLocalPlayer();
-							corp = new Corpse(renderer, map, victim);
+							corp = new Corpse(renderer, corpseSolver.get(), victim);
 							corp->AddImpulse(victim->GetFront() * 32.f);
 							corpses.emplace_back(corp);
 							
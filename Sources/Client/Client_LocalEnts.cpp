@@ -41,8 +41,7 @@
 #include "Tracer.h"
 #include "FallingBlock.h"
 #include "HurtRingView.h"
-#include "ParticleSpriteEntity.h"
-#include "SmokeSpriteEntity.h"
+#include "ParticlePool.h"
 
 #include "World.h"
 #include "Weapon.h"
@@ -74,6 +73,11 @@ namespace spades {
 			SPADES_MARK_FUNCTION();
 			
 			localEntities.clear();
+			particles->Clear();
+		}
+		
+		void Client::AddParticle(const ParticleSprite& p) {
+			particles->Add(p);
 		}
 		
 		void Client::RemoveInvisibleCorpses(){
@@ -146,55 +150,52 @@ namespace spades {
 			Handle<IImage> img = renderer->RegisterImage("Gfx/White.tga");
 			Vector4 color = {0.5f, 0.02f, 0.04f, 1.f};
 			for(int i = 0; i < 10; i++){
-				ParticleSpriteEntity *ent =
-				new ParticleSpriteEntity(this, img, color);
-				ent->SetTrajectory(v,
-								   MakeVector3(GetRandom()-GetRandom(),
-											   GetRandom()-GetRandom(),
-											   GetRandom()-GetRandom()) * 10.f,
-								   1.f, 0.7f);
-				ent->SetRotation(GetRandom() * (float)M_PI * 2.f);
-				ent->SetRadius(0.1f + GetRandom()*GetRandom()*0.2f);
-				ent->SetLifeTime(3.f, 0.f, 1.f);
-				localEntities.emplace_back(ent);
+				ParticleSprite ent(img, color);
+				ent.SetTrajectory(v,
+								  MakeVector3(GetRandom()-GetRandom(),
+											  GetRandom()-GetRandom(),
+											  GetRandom()-GetRandom()) * 10.f,
+								  1.f, 0.7f);
+				ent.SetRotation(GetRandom() * (float)M_PI * 2.f);
+				ent.SetRadius(0.1f + GetRandom()*GetRandom()*0.2f);
+				ent.SetLifeTime(3.f, 0.f, 1.f);
+				particles->Add(ent);
 			}
 			
 			color = MakeVector4(.7f, .35f, .37f, .6f);
 			for(int i = 0; i < 2; i++){
-				ParticleSpriteEntity *ent =
-				new SmokeSpriteEntity(this, color, 100.f,
-									  SmokeSpriteEntity::Type::Explosion);
-				ent->SetTrajectory(v,
-								   MakeVector3(GetRandom()-GetRandom(),
-											   GetRandom()-GetRandom(),
-											   GetRandom()-GetRandom()) * .7f,
-								   .8f, 0.f);
-				ent->SetRotation(GetRandom() * (float)M_PI * 2.f);
-				ent->SetRadius(.5f + GetRandom()*GetRandom()*0.2f,
-							   2.f);
-				ent->SetBlockHitAction(ParticleSpriteEntity::Ignore);
-				ent->SetLifeTime(.20f + GetRandom() * .2f, 0.06f, .20f);
-				localEntities.emplace_back(ent);
+				SmokeSprite ent(color, 100.f,
+								SmokeSprite::Type::Explosion);
+				ent.SetTrajectory(v,
+								  MakeVector3(GetRandom()-GetRandom(),
+											  GetRandom()-GetRandom(),
+											  GetRandom()-GetRandom()) * .7f,
+								  .8f, 0.f);
+				ent.SetRotation(GetRandom() * (float)M_PI * 2.f);
+				ent.SetRadius(.5f + GetRandom()*GetRandom()*0.2f,
+							  2.f);
+				ent.SetBlockHitAction(ParticleSprite::Ignore);
+				ent.SetLifeTime(.20f + GetRandom() * .2f, 0.06f, .20f);
+				particles->Add(ent);
 			}
 			
 			if(cg_reduceSmoke)
 				return;
 			color.w *= .1f;
 			for(int i = 0; i < 1; i++){
-				ParticleSpriteEntity *ent =
-				new SmokeSpriteEntity(this, color, 40.f,
-									  SmokeSpriteEntity::Type::Steady);
-				ent->SetTrajectory(v,
-								   MakeVector3(GetRandom()-GetRandom(),
-											   GetRandom()-GetRandom(),
-											   GetRandom()-GetRandom()) * .7f,
-								   .8f, 0.f);
-				ent->SetRotation(GetRandom() * (float)M_PI * 2.f);
-				ent->SetRadius(.7f + GetRandom()*GetRandom()*0.2f,
-							   2.f, 0.1f);
-				ent->SetBlockHitAction(ParticleSpriteEntity::Ignore);
-				ent->SetLifeTime(.80f + GetRandom() * 0.4f, 0.06f, 1.0f);
-				localEntities.emplace_back(ent);
+				SmokeSprite ent(color, 40.f,
+								SmokeSprite::Type::Steady);
+				ent.SetTrajectory(v,
+								  MakeVector3(GetRandom()-GetRandom(),
+											  GetRandom()-GetRandom(),
+											  GetRandom()-GetRandom()) * .7f,
+								  .8f, 0.f);
+				ent.SetRotation(GetRandom() * (float)M_PI * 2.f);
+				ent.SetRadius(.7f + GetRandom()*GetRandom()*0.2f,
+							  2.f, 0.1f);
+				ent.SetBlockHitAction(ParticleSprite::Ignore);
+				ent.SetLifeTime(.80f + GetRandom() * 0.4f, 0.06f, 1.0f);
+				particles->Add(ent);
 			}
 		}
 		
@@ -212,56 +213,53 @@ namespace spades {
 			Vector4 color = {c.x / 255.f,
 				c.y / 255.f, c.z / 255.f, 1.f};
 			for(int i = 0; i < 7; i++){
-				ParticleSpriteEntity *ent =
-				new ParticleSpriteEntity(this, img, color);
-				ent->SetTrajectory(origin,
-								   MakeVector3(GetRandom()-GetRandom(),
-											   GetRandom()-GetRandom(),
-											   GetRandom()-GetRandom()) * 7.f,
-								   1.f, .9f);
-				ent->SetRotation(GetRandom() * (float)M_PI * 2.f);
-				ent->SetRadius(0.2f + GetRandom()*GetRandom()*0.1f);
-				ent->SetLifeTime(2.f, 0.f, 1.f);
+				ParticleSprite ent(img, color);
+				ent.SetTrajectory(origin,
+								  MakeVector3(GetRandom()-GetRandom(),
+											  GetRandom()-GetRandom(),
+											  GetRandom()-GetRandom()) * 7.f,
+								  1.f, .9f);
+				ent.SetRotation(GetRandom() * (float)M_PI * 2.f);
+				ent.SetRadius(0.2f + GetRandom()*GetRandom()*0.1f);
+				ent.SetLifeTime(2.f, 0.f, 1.f);
 				if(distPowered < 16.f * 16.f)
-					ent->SetBlockHitAction(ParticleSpriteEntity::BounceWeak);
-				localEntities.emplace_back(ent);
+					ent.SetBlockHitAction(ParticleSprite::BounceWeak);
+				particles->Add(ent);
 			}
 			
 			if(distPowered <
 			   32.f * 32.f){
 				for(int i = 0; i < 16; i++){
-					ParticleSpriteEntity *ent =
-					new ParticleSpriteEntity(this, img, color);
-					ent->SetTrajectory(origin,
-									   MakeVector3(GetRandom()-GetRandom(),
-												   GetRandom()-GetRandom(),
-												   GetRandom()-GetRandom()) * 12.f,
-									   1.f, .9f);
-					ent->SetRotation(GetRandom() * (float)M_PI * 2.f);
-					ent->SetRadius(0.1f + GetRandom()*GetRandom()*0.14f);
-					ent->SetLifeTime(2.f, 0.f, 1.f);
+					ParticleSprite ent(img, color);
+					ent.SetTrajectory(origin,
+									  MakeVector3(GetRandom()-GetRandom(),
+												  GetRandom()-GetRandom(),
+												  GetRandom()-GetRandom()) * 12.f,
+									  1.f, .9f);
+					ent.SetRotation(GetRandom() * (float)M_PI * 2.f);
+					ent.SetRadius(0.1f + GetRandom()*GetRandom()*0.14f);
+					ent.SetLifeTime(2.f, 0.f, 1.f);
 					if(distPowered < 16.f * 16.f)
-						ent->SetBlockHitAction(ParticleSpriteEntity::BounceWeak);
-					localEntities.emplace_back(ent);
+						ent.SetBlockHitAction(ParticleSprite::BounceWeak);
+					particles->Add(ent);
 				}
 			}
 			
 			color += (MakeVector4(1, 1, 1, 1) - color) * .2f;
 			color.w *= .2f;
 			for(int i = 0; i < 2; i++){
-				ParticleSpriteEntity *ent =
-				new SmokeSpriteEntity(this, color, 100.f);
-				ent->SetTrajectory(origin,
-								   MakeVector3(GetRandom()-GetRandom(),
-											   GetRandom()-GetRandom(),
-											   GetRandom()-GetRandom()) * .7f,
-								   1.f, 0.f);
-				ent->SetRotation(GetRandom() * (float)M_PI * 2.f);
-				ent->SetRadius(.6f + GetRandom()*GetRandom()*0.2f,
-							   0.8f);
-				ent->SetLifeTime(.3f + GetRandom() * .3f, 0.06f, .4f);
-				ent->SetBlockHitAction(ParticleSpriteEntity::Ignore);
-				localEntities.emplace_back(ent);
+				SmokeSprite ent(color, 100.f);
+				ent.SetTrajectory(origin,
+								  MakeVector3(GetRandom()-GetRandom(),
+											  GetRandom()-GetRandom(),
+											  GetRandom()-GetRandom()) * .7f,
+								  1.f, 0.f);
+				ent.SetRotation(GetRandom() * (float)M_PI * 2.f);
+				ent.SetRadius(.6f + GetRandom()*GetRandom()*0.2f,
+							  0.8f);
+				ent.SetLifeTime(.3f + GetRandom() * .3f, 0.06f, .4f);
+				ent.SetBlockHitAction(ParticleSprite::Ignore);
+				particles->Add(ent);
 			}
 			
 		}
@@ -281,18 +279,17 @@ namespace spades {
 			Vector4 color = {c.x / 255.f,
 				c.y / 255.f, c.z / 255.f, 1.f};
 			for(int i = 0; i < 8; i++){
-				ParticleSpriteEntity *ent =
-				new ParticleSpriteEntity(this, img, color);
-				ent->SetTrajectory(origin,
-								   MakeVector3(GetRandom()-GetRandom(),
-											   GetRandom()-GetRandom(),
-											   GetRandom()-GetRandom()) * 7.f,
-								   1.f, 1.f);
-				ent->SetRotation(GetRandom() * (float)M_PI * 2.f);
-				ent->SetRadius(0.3f + GetRandom()*GetRandom()*0.2f);
-				ent->SetLifeTime(2.f, 0.f, 1.f);
-				ent->SetBlockHitAction(ParticleSpriteEntity::BounceWeak);
-				localEntities.emplace_back(ent);
+				ParticleSprite ent(img, color);
+				ent.SetTrajectory(origin,
+								  MakeVector3(GetRandom()-GetRandom(),
+											  GetRandom()-GetRandom(),
+											  GetRandom()-GetRandom()) * 7.f,
+								  1.f, 1.f);
+				ent.SetRotation(GetRandom() * (float)M_PI * 2.f);
+				ent.SetRadius(0.3f + GetRandom()*GetRandom()*0.2f);
+				ent.SetLifeTime(2.f, 0.f, 1.f);
+				ent.SetBlockHitAction(ParticleSprite::BounceWeak);
+				particles->Add(ent);
 			}
 		}
 		
@@ -312,20 +309,19 @@ namespace spades {
 			
 			// rapid smoke
 			for(int i = 0; i < 2; i++){
-				ParticleSpriteEntity *ent =
-				new SmokeSpriteEntity(this, color, 120.f,
-									  SmokeSpriteEntity::Type::Explosion);
-				ent->SetTrajectory(origin,
-								   (MakeVector3(GetRandom()-GetRandom(),
+				SmokeSprite ent(color, 120.f,
+								SmokeSprite::Type::Explosion);
+				ent.SetTrajectory(origin,
+								  (MakeVector3(GetRandom()-GetRandom(),
 												GetRandom()-GetRandom(),
 												GetRandom()-GetRandom())+velBias*.5f) * 0.3f,
-								   1.f, 0.f);
-				ent->SetRotation(GetRandom() * (float)M_PI * 2.f);
-				ent->SetRadius(.4f,
-							   3.f, 0.0000005f);
-				ent->SetBlockHitAction(ParticleSpriteEntity::Ignore);
-				ent->SetLifeTime(0.2f + GetRandom()*0.1f, 0.f, .30f);
-				localEntities.emplace_back(ent);
+								  1.f, 0.f);
+				ent.SetRotation(GetRandom() * (float)M_PI * 2.f);
+				ent.SetRadius(.4f,
+							  3.f, 0.0000005f);
+				ent.SetBlockHitAction(ParticleSprite::Ignore);
+				ent.SetLifeTime(0.2f + GetRandom()*0.1f, 0.f, .30f);
+				particles->Add(ent);
 			}
 		}
 		
@@ -371,82 +367,78 @@ namespace spades {
 			color = MakeVector4( .6f, .6f, .6f, 1.f);
 			// rapid smoke
 			for(int i = 0; i < 4; i++){
-				ParticleSpriteEntity *ent =
-				new SmokeSpriteEntity(this, color, 60.f,
-									  SmokeSpriteEntity::Type::Explosion);
-				ent->SetTrajectory(origin,
-								   (MakeVector3(GetRandom()-GetRandom(),
+				SmokeSprite ent(color, 60.f,
+								SmokeSprite::Type::Explosion);
+				ent.SetTrajectory(origin,
+								  (MakeVector3(GetRandom()-GetRandom(),
 												GetRandom()-GetRandom(),
 												GetRandom()-GetRandom())+velBias*.5f) * 2.f,
-								   1.f, 0.f);
-				ent->SetRotation(GetRandom() * (float)M_PI * 2.f);
-				ent->SetRadius(.6f + GetRandom()*GetRandom()*0.4f,
-							   2.f, .2f);
-				ent->SetBlockHitAction(ParticleSpriteEntity::Ignore);
-				ent->SetLifeTime(1.8f + GetRandom()*0.1f, 0.f, .20f);
-				localEntities.emplace_back(ent);
+								  1.f, 0.f);
+				ent.SetRotation(GetRandom() * (float)M_PI * 2.f);
+				ent.SetRadius(.6f + GetRandom()*GetRandom()*0.4f,
+							  2.f, .2f);
+				ent.SetBlockHitAction(ParticleSprite::Ignore);
+				ent.SetLifeTime(1.8f + GetRandom()*0.1f, 0.f, .20f);
+				particles->Add(ent);
 			}
 			
 			// slow smoke
 			color.w = .25f;
 			for(int i = 0; i < 8; i++){
-				ParticleSpriteEntity *ent =
-				new SmokeSpriteEntity(this, color, 20.f);
-				ent->SetTrajectory(origin,
-								   (MakeVector3(GetRandom()-GetRandom(),
+				SmokeSprite ent(color, 20.f);
+				ent.SetTrajectory(origin,
+								  (MakeVector3(GetRandom()-GetRandom(),
 												GetRandom()-GetRandom(),
 												(GetRandom()-GetRandom()) * .2f)) * 2.f,
-								   1.f, 0.f);
-				ent->SetRotation(GetRandom() * (float)M_PI * 2.f);
-				ent->SetRadius(1.5f + GetRandom()*GetRandom()*0.8f,
-							   0.2f);
-				ent->SetBlockHitAction(ParticleSpriteEntity::Ignore);
+								  1.f, 0.f);
+				ent.SetRotation(GetRandom() * (float)M_PI * 2.f);
+				ent.SetRadius(1.5f + GetRandom()*GetRandom()*0.8f,
+							  0.2f);
+				ent.SetBlockHitAction(ParticleSprite::Ignore);
 				if(cg_reduceSmoke)
-					ent->SetLifeTime(1.f + GetRandom() * 2.f, 0.1f, 8.f);
+					ent.SetLifeTime(1.f + GetRandom() * 2.f, 0.1f, 8.f);
 				else
-					ent->SetLifeTime(2.f + GetRandom() * 5.f, 0.1f, 8.f);
-				localEntities.emplace_back(ent);
+					ent.SetLifeTime(2.f + GetRandom() * 5.f, 0.1f, 8.f);
+				particles->Add(ent);
 			}
 			
 			// fragments
 			Handle<IImage> img = renderer->RegisterImage("Gfx/White.tga");
 			color = MakeVector4(0.01, 0.03, 0, 1.f);
 			for(int i = 0; i < 42; i++){
-				ParticleSpriteEntity *ent =
-				new ParticleSpriteEntity(this, img, color);
+				ParticleSprite ent(img, color);
 				Vector3 dir = MakeVector3(GetRandom()-GetRandom(),
 										  GetRandom()-GetRandom(),
 										  GetRandom()-GetRandom());
 				dir += velBias * .5f;
 				float radius = 0.1f + GetRandom()*GetRandom()*0.2f;
-				ent->SetTrajectory(origin + dir * .2f,
-								   dir * 20.f,
-								   .1f + radius * 3.f, 1.f);
-				ent->SetRotation(GetRandom() * (float)M_PI * 2.f);
-				ent->SetRadius(radius);
-				ent->SetLifeTime(3.5f + GetRandom() * 2.f, 0.f, 1.f);
-				ent->SetBlockHitAction(ParticleSpriteEntity::BounceWeak);
-				localEntities.emplace_back(ent);
+				ent.SetTrajectory(origin + dir * .2f,
+								  dir * 20.f,
+								  .1f + radius * 3.f, 1.f);
+				ent.SetRotation(GetRandom() * (float)M_PI * 2.f);
+				ent.SetRadius(radius);
+				ent.SetLifeTime(3.5f + GetRandom() * 2.f, 0.f, 1.f);
+				ent.SetBlockHitAction(ParticleSprite::BounceWeak);
+				particles->Add(ent);
 			}
 			
 			// fire smoke
 			color= MakeVector4(1.f, .7f, .4f, .2f) * 5.f;
 			for(int i = 0; i < 4; i++){
-				ParticleSpriteEntity *ent =
-				new SmokeSpriteEntity(this, color, 120.f,
-									  SmokeSpriteEntity::Type::Explosion);
-				ent->SetTrajectory(origin,
-								   (MakeVector3(GetRandom()-GetRandom(),
+				SmokeSprite ent(color, 120.f,
+								SmokeSprite::Type::Explosion);
+				ent.SetTrajectory(origin,
+								  (MakeVector3(GetRandom()-GetRandom(),
 												GetRandom()-GetRandom(),
 												GetRandom()-GetRandom())+velBias) * 6.f,
-								   1.f, 0.f);
-				ent->SetRotation(GetRandom() * (float)M_PI * 2.f);
-				ent->SetRadius(.3f + GetRandom()*GetRandom()*0.4f,
-							   3.f, .1f);
-				ent->SetBlockHitAction(ParticleSpriteEntity::Ignore);
-				ent->SetLifeTime(.18f + GetRandom()*0.03f, 0.f, .10f);
-				//ent->SetAdditive(true);
-				localEntities.emplace_back(ent);
+								  1.f, 0.f);
+				ent.SetRotation(GetRandom() * (float)M_PI * 2.f);
+				ent.SetRadius(.3f + GetRandom()*GetRandom()*0.4f,
+							  3.f, .1f);
+				ent.SetBlockHitAction(ParticleSprite::Ignore);
+				ent.SetLifeTime(.18f + GetRandom()*0.03f, 0.f, .10f);
+				//ent.SetAdditive(true);
+				particles->Add(ent);
 			}
 		}
 		
@@ -466,19 +458,18 @@ namespace spades {
 			Handle<IImage> img = renderer->RegisterImage("Textures/WaterExpl.png");
 			if(cg_reduceSmoke) color.w = .3f;
 			for(int i = 0; i < 7; i++){
-				ParticleSpriteEntity *ent =
-				new ParticleSpriteEntity(this, img, color);
-				ent->SetTrajectory(origin,
-								   (MakeVector3(GetRandom()-GetRandom(),
+				ParticleSprite ent(img, color);
+				ent.SetTrajectory(origin,
+								  (MakeVector3(GetRandom()-GetRandom(),
 												GetRandom()-GetRandom(),
 												-GetRandom()*7.f)) * 2.5f,
-								   .3f, .6f);
-				ent->SetRotation(0.f);
-				ent->SetRadius(1.5f + GetRandom()*GetRandom()*0.4f,
-							   1.3f);
-				ent->SetBlockHitAction(ParticleSpriteEntity::Ignore);
-				ent->SetLifeTime(3.f + GetRandom()*0.3f, 0.f, .60f);
-				localEntities.emplace_back(ent);
+								  .3f, .6f);
+				ent.SetRotation(0.f);
+				ent.SetRadius(1.5f + GetRandom()*GetRandom()*0.4f,
+							  1.3f);
+				ent.SetBlockHitAction(ParticleSprite::Ignore);
+				ent.SetLifeTime(3.f + GetRandom()*0.3f, 0.f, .60f);
+				particles->Add(ent);
 			}
 			
 			// water2
@@ -486,60 +477,57 @@ namespace spades {
 			color.w = .9f;
 			if(cg_reduceSmoke) color.w = .4f;
 			for(int i = 0; i < 16; i++){
-				ParticleSpriteEntity *ent =
-				new ParticleSpriteEntity(this, img, color);
-				ent->SetTrajectory(origin,
-								   (MakeVector3(GetRandom()-GetRandom(),
+				ParticleSprite ent(img, color);
+				ent.SetTrajectory(origin,
+								  (MakeVector3(GetRandom()-GetRandom(),
 												GetRandom()-GetRandom(),
 												-GetRandom()*10.f)) * 3.5f,
-								   1.f, 1.f);
-				ent->SetRotation(GetRandom() * (float)M_PI * 2.f);
-				ent->SetRadius(0.9f + GetRandom()*GetRandom()*0.4f,
-							   0.7f);
-				ent->SetBlockHitAction(ParticleSpriteEntity::Ignore);
-				ent->SetLifeTime(3.f + GetRandom()*0.3f, .7f, .60f);
-				localEntities.emplace_back(ent);
+								  1.f, 1.f);
+				ent.SetRotation(GetRandom() * (float)M_PI * 2.f);
+				ent.SetRadius(0.9f + GetRandom()*GetRandom()*0.4f,
+							  0.7f);
+				ent.SetBlockHitAction(ParticleSprite::Ignore);
+				ent.SetLifeTime(3.f + GetRandom()*0.3f, .7f, .60f);
+				particles->Add(ent);
 			}
 			
 			// slow smoke
 			color.w = .4f;
 			if(cg_reduceSmoke) color.w = .2f;
 			for(int i = 0; i < 8; i++){
-				ParticleSpriteEntity *ent =
-				new SmokeSpriteEntity(this, color, 20.f);
-				ent->SetTrajectory(origin,
-								   (MakeVector3(GetRandom()-GetRandom(),
+				SmokeSprite ent(color, 20.f);
+				ent.SetTrajectory(origin,
+								  (MakeVector3(GetRandom()-GetRandom(),
 												GetRandom()-GetRandom(),
 												(GetRandom()-GetRandom()) * .2f)) * 2.f,
-								   1.f, 0.f);
-				ent->SetRotation(GetRandom() * (float)M_PI * 2.f);
-				ent->SetRadius(1.4f + GetRandom()*GetRandom()*0.8f,
-							   0.2f);
-				ent->SetBlockHitAction(ParticleSpriteEntity::Ignore);
-				ent->SetLifeTime((cg_reduceSmoke ? 3.f : 6.f) + GetRandom() * 5.f, 0.1f, 8.f);
-				localEntities.emplace_back(ent);
+								  1.f, 0.f);
+				ent.SetRotation(GetRandom() * (float)M_PI * 2.f);
+				ent.SetRadius(1.4f + GetRandom()*GetRandom()*0.8f,
+							  0.2f);
+				ent.SetBlockHitAction(ParticleSprite::Ignore);
+				ent.SetLifeTime((cg_reduceSmoke ? 3.f : 6.f) + GetRandom() * 5.f, 0.1f, 8.f);
+				particles->Add(ent);
 			}
 			
 			// fragments
 			img = renderer->RegisterImage("Gfx/White.tga");
 			color = MakeVector4(1,1,1, 0.7f);
 			for(int i = 0; i < 42; i++){
-				ParticleSpriteEntity *ent =
-				new ParticleSpriteEntity(this, img, color);
+				ParticleSprite ent(img, color);
 				Vector3 dir = MakeVector3(GetRandom()-GetRandom(),
 										  GetRandom()-GetRandom(),
 										  -GetRandom() * 3.f);
 				dir += velBias * .5f;
 				float radius = 0.1f + GetRandom()*GetRandom()*0.2f;
-				ent->SetTrajectory(origin + dir * .2f +
-								   MakeVector3(0, 0, -1.2f),
-								   dir * 13.f,
-								   .1f + radius * 3.f, 1.f);
-				ent->SetRotation(GetRandom() * (float)M_PI * 2.f);
-				ent->SetRadius(radius);
-				ent->SetLifeTime(3.5f + GetRandom() * 2.f, 0.f, 1.f);
-				ent->SetBlockHitAction(ParticleSpriteEntity::Delete);
-				localEntities.emplace_back(ent);
+				ent.SetTrajectory(origin + dir * .2f +
+								  MakeVector3(0, 0, -1.2f),
+								  dir * 13.f,
+								  .1f + radius * 3.f, 1.f);
+				ent.SetRotation(GetRandom() * (float)M_PI * 2.f);
+				ent.SetRadius(radius);
+				ent.SetLifeTime(3.5f + GetRandom() * 2.f, 0.f, 1.f);
+				ent.SetBlockHitAction(ParticleSprite::Delete);
+				particles->Add(ent);
 			}
 			
 			
@@ -560,19 +548,18 @@ namespace spades {
 			Handle<IImage> img = renderer->RegisterImage("Textures/WaterExpl.png");
 			if(cg_reduceSmoke) color.w = .2f;
 			for(int i = 0; i < 2; i++){
-				ParticleSpriteEntity *ent =
-				new ParticleSpriteEntity(this, img, color);
-				ent->SetTrajectory(origin,
-								   (MakeVector3(GetRandom()-GetRandom(),
+				ParticleSprite ent(img, color);
+				ent.SetTrajectory(origin,
+								  (MakeVector3(GetRandom()-GetRandom(),
 												GetRandom()-GetRandom(),
 												-GetRandom()*7.f)) * 1.f,
-								   .3f, .6f);
-				ent->SetRotation(0.f);
-				ent->SetRadius(0.6f + GetRandom()*GetRandom()*0.4f,
-							   .7f);
-				ent->SetBlockHitAction(ParticleSpriteEntity::Ignore);
-				ent->SetLifeTime(3.f + GetRandom()*0.3f, 0.1f, .60f);
-				localEntities.emplace_back(ent);
+								  .3f, .6f);
+				ent.SetRotation(0.f);
+				ent.SetRadius(0.6f + GetRandom()*GetRandom()*0.4f,
+							  .7f);
+				ent.SetBlockHitAction(ParticleSprite::Ignore);
+				ent.SetLifeTime(3.f + GetRandom()*0.3f, 0.1f, .60f);
+				particles->Add(ent);
 			}
 			
 			// water2
@@ -580,19 +567,18 @@ namespace spades {
 			color.w = .9f;
 			if(cg_reduceSmoke) color.w = .4f;
 			for(int i = 0; i < 6; i++){
-				ParticleSpriteEntity *ent =
-				new ParticleSpriteEntity(this, img, color);
-				ent->SetTrajectory(origin,
-								   (MakeVector3(GetRandom()-GetRandom(),
+				ParticleSprite ent(img, color);
+				ent.SetTrajectory(origin,
+								  (MakeVector3(GetRandom()-GetRandom(),
 												GetRandom()-GetRandom(),
 												-GetRandom()*10.f)) * 2.f,
-								   1.f, 1.f);
-				ent->SetRotation(GetRandom() * (float)M_PI * 2.f);
-				ent->SetRadius(0.6f + GetRandom()*GetRandom()*0.6f,
-							   0.6f);
-				ent->SetBlockHitAction(ParticleSpriteEntity::Ignore);
-				ent->SetLifeTime(3.f + GetRandom()*0.3f, GetRandom() * 0.3f, .60f);
-				localEntities.emplace_back(ent);
+								  1.f, 1.f);
+				ent.SetRotation(GetRandom() * (float)M_PI * 2.f);
+				ent.SetRadius(0.6f + GetRandom()*GetRandom()*0.6f,
+							  0.6f);
+				ent.SetBlockHitAction(ParticleSprite::Ignore);
+				ent.SetLifeTime(3.f + GetRandom()*0.3f, GetRandom() * 0.3f, .60f);
+				particles->Add(ent);
 			}
 			
 			
@@ -600,21 +586,20 @@ namespace spades {
 			img = renderer->RegisterImage("Gfx/White.tga");
 			color = MakeVector4(1,1,1, 0.7f);
 			for(int i = 0; i < 10; i++){
-				ParticleSpriteEntity *ent =
-				new ParticleSpriteEntity(this, img, color);
+				ParticleSprite ent(img, color);
 				Vector3 dir = MakeVector3(GetRandom()-GetRandom(),
 										  GetRandom()-GetRandom(),
 										  -GetRandom() * 3.f);
 				float radius = 0.03f + GetRandom()*GetRandom()*0.05f;
-				ent->SetTrajectory(origin + dir * .2f +
-								   MakeVector3(0, 0, -1.2f),
-								   dir * 5.f,
-								   .1f + radius * 3.f, 1.f);
-				ent->SetRotation(GetRandom() * (float)M_PI * 2.f);
-				ent->SetRadius(radius);
-				ent->SetLifeTime(3.5f + GetRandom() * 2.f, 0.f, 1.f);
-				ent->SetBlockHitAction(ParticleSpriteEntity::Delete);
-				localEntities.emplace_back(ent);
+				ent.SetTrajectory(origin + dir * .2f +
+								  MakeVector3(0, 0, -1.2f),
+								  dir * 5.f,
+								  .1f + radius * 3.f, 1.f);
+				ent.SetRotation(GetRandom() * (float)M_PI * 2.f);
+				ent.SetRadius(radius);
+				ent.SetLifeTime(3.5f + GetRandom() * 2.f, 0.f, 1.f);
+				ent.SetBlockHitAction(ParticleSprite::Delete);
+				particles->Add(ent);
 			}
 			
 			
@@ -38,8 +38,10 @@
 
 #include "ClientPlayer.h"
 #include "ILocalEntity.h"
+#include "ParticlePool.h"
 
 #include "NetClient.h"
+#include <Core/Profiler.h>
 
 SPADES_SETTING(cg_fov, "68");
 
@@ -510,6 +512,7 @@ namespace spades {
 		
 		void Client::DrawScene(){
 			SPADES_MARK_FUNCTION();
+			SPADES_PROFILE_ZONE("Client::DrawScene");
 			
 			renderer->StartScene(lastSceneDef);
 			
@@ -545,6 +548,7 @@ namespace spades {
 					for(auto& ent: localEntities){
 						ent->Render3D();
 					}
+					particles->Render(renderer);
 				}
 				
 				// draw block cursor
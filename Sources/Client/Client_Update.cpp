@@ -22,7 +22,6 @@
 #include "Client.h"
 #include <cstdlib>
 
-#include <Core/ConcurrentDispatch.h>
 #include <Core/Settings.h>
 #include <Core/Strings.h>
 
@@ -34,8 +33,10 @@
 #include "LimboView.h"
 #include "MapView.h"
 #include "Corpse.h"
+#include "CorpseSolver.h"
 #include "ClientPlayer.h"
 #include "ILocalEntity.h"
+#include "ParticlePool.h"
 #include "ChatWindow.h"
 #include "CenterMessageView.h"
 #include "Tracer.h"
@@ -48,6 +49,7 @@
 #include "Grenade.h"
 
 #include "NetClient.h"
+#include <Core/Profiler.h>
 
 SPADES_SETTING(cg_ragdoll, "1");
 SPADES_SETTING(cg_blood, "1");
@@ -133,6 +135,7 @@ namespace spades {
 		
 		void Client::UpdateWorld(float dt) {
 			SPADES_MARK_FUNCTION();
+			SPADES_PROFILE_ZONE("Client::UpdateWorld");
 			
 			Player* player = world->GetLocalPlayer();
 			
@@ -178,23 +181,8 @@ namespace spades {
 				}
 			}
 			
-			// corpse never accesses audio nor renderer, so
-			// we can do it in the separate thread
-			class CorpseUpdateDispatch: public ConcurrentDispatch{
-				Client *client;
-				float dt;
-			public:
-				CorpseUpdateDispatch(Client *c, float dt):
-				client(c), dt(dt){}
-				virtual void Run(){
-					for(auto& c: client->corpses){
-						for(int i = 0; i < 4; i++)
-							c->Update(dt / 4.f);
-					}
-				}
-			};
-			CorpseUpdateDispatch corpseDispatch(this, dt);
-			corpseDispatch.Start();
+			// corpses are stepped in the dispatch threads
+			corpseSolver->Start(dt);
 			
 			// local entities should be done in the client thread
 			{
@@ -207,9 +195,10 @@ namespace spades {
 				for(size_t i = 0; i < its.size(); i++){
 					localEntities.erase(its[i]);
 				}
+				particles->Update(dt, GetWorld() ? GetWorld()->GetMap() : NULL);
 			}
 			
-			corpseDispatch.Join();
+			corpseSolver->Join();
 			
 			if(grenadeVibration > 0.f){
 				grenadeVibration -= dt;
@@ -829,7 +818,7 @@ namespace spades {
 			// create ragdoll corpse
 			if(cg_ragdoll && victim->GetTeamId() < 2){
 				Corpse *corp;
-				corp = new Corpse(renderer, map, victim);
+				corp = new Corpse(renderer, corpseSolver.get(), victim);
 				if(victim == world->GetLocalPlayer())
 					lastMyCorpse = corp;
 				if(killer != victim && kt != KillTypeGrenade){
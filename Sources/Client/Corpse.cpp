@@ -32,11 +32,15 @@ SPADES_SETTING(r_corpseLineCollision, "1");
 namespace spades {
 	namespace client {
 		Corpse::Corpse(IRenderer *renderer,
-					   GameMap *map,
+					   CorpseSolver *solver,
 					   Player *p):
-		renderer(renderer), map(map) {
+		renderer(renderer), solver(solver),
+		map(solver->GetGameMap()) {
 			SPADES_MARK_FUNCTION();
 			
+			// allocates the nodes and sets slot
+			solver->Add(this);
+			
 			IntVector3 col = p->GetWorld()->GetTeam(p->GetTeamId()).color;
 			color = MakeVector3(col.x / 255.f,
 								col.y / 255.f,
@@ -102,7 +106,7 @@ namespace spades {
 				
 			}
 			
-			SetNode(Head, (nodes[Torso1].pos + nodes[Torso2].pos)
+			SetNode(Head, (nodes.GetPos(Torso1) + nodes.GetPos(Torso2))
 					* .5f + MakeVector3(0,0,-0.6f));
 			
 			
@@ -114,12 +118,11 @@ namespace spades {
 		
 		void Corpse::SetNode(NodeType n, spades::Vector3 v){
 			SPAssert(n >= 0); SPAssert(n < NodeCount);
-			nodes[n].pos = v;
-			nodes[n].vel = MakeVector3(VelNoise(),
-									   VelNoise(),
-									   0.f);
-			nodes[n].lastPos = v;
-			nodes[n].lastForce = MakeVector3(0, 0,0);
+			nodes.SetPos(n, v);
+			nodes.SetVel(n, MakeVector3(VelNoise(),
+										VelNoise(),
+										0.f));
+			nodes.SetLastPos(n, v);
 			
 		}
 		void Corpse::SetNode(NodeType n, spades::Vector4 v){
@@ -127,7 +130,7 @@ namespace spades {
 		}
 		
 		Corpse::~Corpse(){
-			
+			solver->Remove(slot);
 		}
 		
 		void Corpse::Spring(NodeType n1,
@@ -137,23 +140,21 @@ namespace spades {
 			SPADES_MARK_FUNCTION_DEBUG();
 			SPAssert(n1 >= 0); SPAssert(n1 < NodeCount);
 			SPAssert(n2 >= 0); SPAssert(n2 < NodeCount);
-			Node& a = nodes[n1];
-			Node& b = nodes[n2];
-			Vector3 diff = b.pos - a.pos;
+			Vector3 diff = nodes.GetPos(n2) - nodes.GetPos(n1);
 			float dist = diff.GetLength();
 			Vector3 force = diff.Normalize() * (distance - dist);
 			force *= dt * 50.f;
 			
-			b.vel += force;
-			a.vel -= force;
+			Vector3 aVel = nodes.GetVel(n1) - force;
+			Vector3 bVel = nodes.GetVel(n2) + force;
 			
-			b.pos += force / (dt * 50.f) * 0.5f;
-			a.pos -= force / (dt * 50.f) * 0.5f;
+			nodes.AddPos(n2, force / (dt * 50.f) * 0.5f);
+			nodes.AddPos(n1, force / (dt * 50.f) * -0.5f);
 			
-			Vector3 velMid = (a.vel + b.vel) * .5f;
+			Vector3 velMid = (aVel + bVel) * .5f;
 			float dump = 1.f - powf(.1f, dt);
-			a.vel += (velMid - a.vel) * dump;
-			b.vel += (velMid - b.vel) * dump;
+			nodes.SetVel(n1, aVel + (velMid - aVel) * dump);
+			nodes.SetVel(n2, bVel + (velMid - bVel) * dump);
 			
 		}
 		void Corpse::Spring(NodeType n1a,
@@ -165,24 +166,22 @@ namespace spades {
 			SPAssert(n1a >= 0); SPAssert(n1a < NodeCount);
 			SPAssert(n1b >= 0); SPAssert(n1b < NodeCount);
 			SPAssert(n2 >= 0); SPAssert(n2 < NodeCount);
-			Node& x = nodes[n1a];
-			Node& y = nodes[n1b];
-			Node& b = nodes[n2];
-			Vector3 diff = b.pos - (x.pos + y.pos) * .5f;
+			Vector3 diff = nodes.GetPos(n2) -
+			(nodes.GetPos(n1a) + nodes.GetPos(n1b)) * .5f;
 			float dist = diff.GetLength();
 			Vector3 force = diff.Normalize() * (distance - dist);
 			force *= dt * 50.f;
 			
-			b.vel += force;
+			Vector3 bVel = nodes.GetVel(n2) + force;
 			force *= .5f;
-			x.vel -= force;
-			y.vel -= force;
+			Vector3 xVel = nodes.GetVel(n1a) - force;
+			Vector3 yVel = nodes.GetVel(n1b) - force;
 			
-			Vector3 velMid = (x.vel + y.vel) * .25f + b.vel * .5f;
+			Vector3 velMid = (xVel + yVel) * .25f + bVel * .5f;
 			float dump = 1.f - powf(.05f, dt);
-			x.vel += (velMid - x.vel) * dump;
-			y.vel += (velMid - y.vel) * dump;
-			b.vel += (velMid - b.vel) * dump;
+			nodes.SetVel(n1a, xVel + (velMid - xVel) * dump);
+			nodes.SetVel(n1b, yVel + (velMid - yVel) * dump);
+			nodes.SetVel(n2, bVel + (velMid - bVel) * dump);
 			
 		}
 		
@@ -204,11 +203,11 @@ namespace spades {
 								 float minDot,
 								 float maxDot,
 								 float dt){
-			Node& nBase = nodes[base];
-			Node& n1 = nodes[n1id];
-			Node& n2 = nodes[n2id];
-			Vector3 d1 = n1.pos - nBase.pos;
-			Vector3 d2 = n2.pos - nBase.pos;
+			Vector3 basePos = nodes.GetPos(base);
+			Vector3 n1Pos = nodes.GetPos(n1id);
+			Vector3 n2Pos = nodes.GetPos(n2id);
+			Vector3 d1 = n1Pos - basePos;
+			Vector3 d2 = n2Pos - basePos;
 			float ln1 = d1.GetLength();
 			float ln2 = d2.GetLength();
 			float dot = Vector3::Dot(d1, d2) / (ln1 * ln2 + 0.0000001f);
@@ -216,7 +215,7 @@ namespace spades {
 			if(dot >= minDot && dot <= maxDot)
 				return;
 			
-			Vector3 diff = n2.pos - n1.pos;
+			Vector3 diff = n2Pos - n1Pos;
 			float strength = 0.f;
 			
 			Vector3 a1 = Vector3::Cross(d1, diff);
@@ -245,9 +244,9 @@ namespace spades {
 			
 			a2 *= 0.f;
 			
-			n2.vel += a1;
-			n1.vel += a2;
-			nBase.vel -= a1 + a2;
+			nodes.AddVel(n2id, a1);
+			nodes.AddVel(n1id, a2);
+			nodes.AddVel(base, -(a1 + a2));
 			
 			/*
 			d1 += a1 * 0.01;
@@ -272,9 +271,7 @@ namespace spades {
 								 float minDot,
 								 float maxDot,
 								 float dt){
-			Node& n1 = nodes[n1id];
-			Node& n2 = nodes[n2id];
-			Vector3 diff = n2.pos - n1.pos;
+			Vector3 diff = nodes.GetPos(n2id) - nodes.GetPos(n1id);
 			float ln1 = diff.GetLength();
 			float dot = Vector3::Dot(diff, dir) / (ln1 + 0.000000001f);
 			
@@ -304,8 +301,8 @@ namespace spades {
 			a1 *= strength;
 			a2 *= strength;
 			
-			n2.vel += a1;
-			n1.vel += a2;
+			nodes.AddVel(n2id, a1);
+			nodes.AddVel(n1id, a2);
 			//nBase.vel -= a1 + a2;
 			
 			/*
@@ -378,8 +375,13 @@ namespace spades {
 		void Corpse::LineCollision(NodeType a, NodeType b, float dt){
 			if(!r_corpseLineCollision)
 				return;
-			Node& n1 = nodes[a];
-			Node& n2 = nodes[b];
+			struct {
+				Vector3 pos, lastPos, vel;
+			} n1, n2;
+			n1.pos = nodes.GetPos(a);
+			n1.lastPos = nodes.GetLastPos(a);
+			n2.pos = nodes.GetPos(b);
+			n2.lastPos = nodes.GetLastPos(b);
 			
 			IntVector3 hitBlock;
 			
@@ -475,6 +477,9 @@ namespace spades {
 				
 				Vector3 normDir = dir; // |D|
 				
+				n1.vel = nodes.GetVel(a);
+				n2.vel = nodes.GetVel(b);
+				
 				n1.vel -= normDir * std::min(Vector3::Dot(normDir, n1.vel), 0.f);
 				n2.vel -= normDir * std::min(Vector3::Dot(normDir, n2.vel), 0.f);
 				
@@ -487,6 +492,8 @@ namespace spades {
 				n1.vel -= (n1.vel - normDir * Vector3::Dot(normDir, n1.vel)) * .2f;
 				n2.vel -= (n2.vel - normDir * Vector3::Dot(normDir, n2.vel)) * .2f;
 				
+				nodes.SetVel(a, n1.vel);
+				nodes.SetVel(b, n2.vel);
 			}
 			
 		}
@@ -495,7 +502,7 @@ namespace spades {
 									 NodeType a,
 									 NodeType b){
 			Edge& e = edges[eId];
-			e.velDiff = nodes[b].vel - nodes[a].vel;
+			e.velDiff = nodes.GetVel(b) - nodes.GetVel(a);
 			if(e.node1 != a || e.node2 != b){
 				e.lastVelDiff = e.velDiff;
 				e.node1 = a; e.node2 = b;
@@ -504,8 +511,8 @@ namespace spades {
 			
 			Vector3 force = e.lastVelDiff - e.velDiff;
 			force *= .5f;
-			nodes[b].vel += force;
-			nodes[a].vel -= force;
+			nodes.AddVel(b, force);
+			nodes.AddVel(a, -force);
 			
 			e.lastVelDiff = e.velDiff;
 		}
@@ -622,64 +629,72 @@ namespace spades {
             }
 			//dt *= 0.1f;
 			
-			for(int i = 0; i <NodeCount; i++){
-				Node& node = nodes[i];
-				Vector3 oldPos = node.lastPos;
-				node.pos += node.vel * dt;
-				
-				SPAssert(!isnan(node.pos.x));
-				SPAssert(!isnan(node.pos.y));
-				SPAssert(!isnan(node.pos.z));
-				
-				if(node.pos.z > 63.f){
-					node.vel.z -= dt * 6.f; // buoyancy
-					node.vel *= damp;
+			// integration doesn't depend on the map, so this loop
+			// runs straight over the SoA storage
+			for(int i = 0; i < NodeCount; i++){
+				nodes.posX[i] += nodes.velX[i] * dt;
+				nodes.posY[i] += nodes.velY[i] * dt;
+				nodes.posZ[i] += nodes.velZ[i] * dt;
+				
+				if(nodes.posZ[i] > 63.f){
+					nodes.velZ[i] -= dt * 6.f; // buoyancy
+					nodes.velX[i] *= damp;
+					nodes.velY[i] *= damp;
+					nodes.velZ[i] *= damp;
 				}else{
-                    node.vel.z += dt * 32.f; // gravity
-                    node.vel.z *= damp2;
-                }
+					nodes.velZ[i] += dt * 32.f; // gravity
+					nodes.velZ[i] *= damp2;
+				}
+			}
+			
+			for(int i = 0; i <NodeCount; i++){
+				Vector3 oldPos = nodes.GetLastPos(i);
+				Vector3 pos = nodes.GetPos(i);
+				Vector3 vel = nodes.GetVel(i);
 				
-				//node.vel *= damp;
+				SPAssert(!isnan(pos.x));
+				SPAssert(!isnan(pos.y));
+				SPAssert(!isnan(pos.z));
 				
 				if(!map->ClipBox(oldPos.x, oldPos.y, oldPos.z)){
 					
-					if(map->ClipBox(node.pos.x,
+					if(map->ClipBox(pos.x,
 									oldPos.y,
 									oldPos.z)){
-						node.vel.x = -node.vel.x * .2f;
-						if(fabsf(node.vel.x) < .3f)
-							node.vel.x = 0.f;
-						node.pos.x = oldPos.x;
+						vel.x = -vel.x * .2f;
+						if(fabsf(vel.x) < .3f)
+							vel.x = 0.f;
+						pos.x = oldPos.x;
 						
-						node.vel.y *= .5f;
-						node.vel.z *= .5f;
+						vel.y *= .5f;
+						vel.z *= .5f;
 					}
 					
-					if(map->ClipBox(node.pos.x,
-									node.pos.y,
+					if(map->ClipBox(pos.x,
+									pos.y,
 									oldPos.z)){
-						node.vel.y = -node.vel.y * .2f;
-						if(fabsf(node.vel.y) < .3f)
-							node.vel.y = 0.f;
-						node.pos.y = oldPos.y;
+						vel.y = -vel.y * .2f;
+						if(fabsf(vel.y) < .3f)
+							vel.y = 0.f;
+						pos.y = oldPos.y;
 						
-						node.vel.x *= .5f;
-						node.vel.z *= .5f;
+						vel.x *= .5f;
+						vel.z *= .5f;
 					}
 					
-					if(map->ClipBox(node.pos.x,
-									node.pos.y,
-									node.pos.z)){
-						node.vel.z = -node.vel.z * .2f;
-						if(fabsf(node.vel.z) < .3f)
-							node.vel.z = 0.f;
-						node.pos.z = oldPos.z;
+					if(map->ClipBox(pos.x,
+									pos.y,
+									pos.z)){
+						vel.z = -vel.z * .2f;
+						if(fabsf(vel.z) < .3f)
+							vel.z = 0.f;
+						pos.z = oldPos.z;
 						
-						node.vel.x *= .5f;
-						node.vel.y *= .5f;
+						vel.x *= .5f;
+						vel.y *= .5f;
 					}
 					
-					if(map->ClipBox(node.pos.x, node.pos.y, node.pos.z)){
+					if(map->ClipBox(pos.x, pos.y, pos.z)){
 						// TODO: getting out block
 						//node.pos = oldPos;
 						//node.vel *= .5f;
@@ -722,59 +737,56 @@ namespace spades {
 					}
 				}*/
 				
-				node.lastPos = node.pos;
-				node.lastForce = node.vel;
+				nodes.SetPos(i, pos);
+				nodes.SetVel(i, vel);
+				nodes.SetLastPos(i, pos);
 			}
 			ApplyConstraint(dt);
 			
-			for(int i = 0; i <NodeCount; i++){
-				nodes[i].lastForce = nodes[i].vel - nodes[i].lastForce;
-			}
-			
 		}
 		
 		void Corpse::AddToScene() {
 			if(false){
 				// debug line only
 				Vector4 col = {1, 1, 0, 0};
-				renderer->AddDebugLine(nodes[Torso1].pos,
-									   nodes[Torso2].pos,
+				renderer->AddDebugLine(nodes.GetPos(Torso1),
+									   nodes.GetPos(Torso2),
 									   col);
-				renderer->AddDebugLine(nodes[Torso2].pos,
-									   nodes[Torso3].pos,
+				renderer->AddDebugLine(nodes.GetPos(Torso2),
+									   nodes.GetPos(Torso3),
 									   col);
-				renderer->AddDebugLine(nodes[Torso3].pos,
-									   nodes[Torso4].pos,
+				renderer->AddDebugLine(nodes.GetPos(Torso3),
+									   nodes.GetPos(Torso4),
 									   col);
-				renderer->AddDebugLine(nodes[Torso4].pos,
-									   nodes[Torso1].pos,
+				renderer->AddDebugLine(nodes.GetPos(Torso4),
+									   nodes.GetPos(Torso1),
 									   col);
 				
-				renderer->AddDebugLine(nodes[Torso2].pos,
-									   nodes[Torso4].pos,
+				renderer->AddDebugLine(nodes.GetPos(Torso2),
+									   nodes.GetPos(Torso4),
 									   col);
-				renderer->AddDebugLine(nodes[Torso1].pos,
-									   nodes[Torso3].pos,
+				renderer->AddDebugLine(nodes.GetPos(Torso1),
+									   nodes.GetPos(Torso3),
 									   col);
 				
 				
-				renderer->AddDebugLine(nodes[Torso1].pos,
-									   nodes[Arm1].pos,
+				renderer->AddDebugLine(nodes.GetPos(Torso1),
+									   nodes.GetPos(Arm1),
 									   col);
-				renderer->AddDebugLine(nodes[Torso2].pos,
-									   nodes[Arm2].pos,
+				renderer->AddDebugLine(nodes.GetPos(Torso2),
+									   nodes.GetPos(Arm2),
 									   col);
 				
-				renderer->AddDebugLine(nodes[Torso3].pos,
-									   nodes[Leg1].pos,
+				renderer->AddDebugLine(nodes.GetPos(Torso3),
+									   nodes.GetPos(Leg1),
 									   col);
-				renderer->AddDebugLine(nodes[Torso4].pos,
-									   nodes[Leg2].pos,
+				renderer->AddDebugLine(nodes.GetPos(Torso4),
+									   nodes.GetPos(Leg2),
 									   col);
 				
 				
-				renderer->AddDebugLine((nodes[Torso1].pos+nodes[Torso2].pos)*.5f,
-									   nodes[Head].pos,
+				renderer->AddDebugLine((nodes.GetPos(Torso1)+nodes.GetPos(Torso2))*.5f,
+									   nodes.GetPos(Head),
 									   col);
 				return;
 			}
@@ -789,10 +801,10 @@ namespace spades {
 			Matrix4 torso;
 			Vector3 tX, tY;
 			{
-				Vector3 tX1 = nodes[Torso1].pos - nodes[Torso2].pos;
-				Vector3 tX2 = nodes[Torso4].pos - nodes[Torso3].pos;
-				Vector3 tY1 = nodes[Torso1].pos + nodes[Torso2].pos;
-				Vector3 tY2 = nodes[Torso4].pos + nodes[Torso3].pos;
+				Vector3 tX1 = nodes.GetPos(Torso1) - nodes.GetPos(Torso2);
+				Vector3 tX2 = nodes.GetPos(Torso4) - nodes.GetPos(Torso3);
+				Vector3 tY1 = nodes.GetPos(Torso1) + nodes.GetPos(Torso2);
+				Vector3 tY2 = nodes.GetPos(Torso4) + nodes.GetPos(Torso3);
 				tX = ((tX1 + tX2) * .5f).Normalize();
 				tY = ((tY2 - tY1) * .5f).Normalize();
 				Vector3 tZ = Vector3::Cross(tX, tY).Normalize();
@@ -815,12 +827,12 @@ namespace spades {
 				("Models/Player/Head.kv6");
 				
 				Vector3 aX, aY, aZ;
-				Vector3 center = (nodes[Torso1].pos + nodes[Torso2].pos) * .5f;
+				Vector3 center = (nodes.GetPos(Torso1) + nodes.GetPos(Torso2)) * .5f;
 				
-				aZ = nodes[Head].pos - center;
+				aZ = nodes.GetPos(Head) - center;
 				aZ = -torso.GetAxis(2);
 				aZ = aZ.Normalize();
-				aY = nodes[Torso2].pos - nodes[Torso1].pos;
+				aY = nodes.GetPos(Torso2) - nodes.GetPos(Torso1);
 				aY = Vector3::Cross(aY, aZ).Normalize();
 				aX = Vector3::Cross(aY, aZ).Normalize();
 				param.matrix = Matrix4::FromAxis(-aX, aY, -aZ, headBase) * scaler;
@@ -840,18 +852,18 @@ namespace spades {
 				
 				Vector3 aX, aY, aZ;
 				
-				aZ = nodes[Arm1].pos - nodes[Torso1].pos;
+				aZ = nodes.GetPos(Arm1) - nodes.GetPos(Torso1);
 				aZ = aZ.Normalize();
-				aY = nodes[Torso2].pos - nodes[Torso1].pos;
+				aY = nodes.GetPos(Torso2) - nodes.GetPos(Torso1);
 				aY = Vector3::Cross(aY, aZ).Normalize();
 				aX = Vector3::Cross(aY, aZ).Normalize();
 				param.matrix = Matrix4::FromAxis(aX, aY, aZ, arm1Base) * scaler;
 				
 				renderer->RenderModel(model, param);
 				
-				aZ = nodes[Arm2].pos - nodes[Torso2].pos;
+				aZ = nodes.GetPos(Arm2) - nodes.GetPos(Torso2);
 				aZ = aZ.Normalize();
-				aY = nodes[Torso1].pos - nodes[Torso2].pos;
+				aY = nodes.GetPos(Torso1) - nodes.GetPos(Torso2);
 				aY = Vector3::Cross(aY, aZ).Normalize();
 				aX = Vector3::Cross(aY, aZ).Normalize();
 				param.matrix = Matrix4::FromAxis(aX, aY, aZ, arm2Base) * scaler;
@@ -871,18 +883,18 @@ namespace spades {
 				
 				Vector3 aX, aY, aZ;
 				
-				aZ = nodes[Leg1].pos - nodes[Torso3].pos;
+				aZ = nodes.GetPos(Leg1) - nodes.GetPos(Torso3);
 				aZ = aZ.Normalize();
-				aY = nodes[Torso1].pos - nodes[Torso2].pos;
+				aY = nodes.GetPos(Torso1) - nodes.GetPos(Torso2);
 				aY = Vector3::Cross(aY, aZ).Normalize();
 				aX = Vector3::Cross(aY, aZ).Normalize();
 				param.matrix = Matrix4::FromAxis(aX, aY, aZ, leg1Base) * scaler;
 				
 				renderer->RenderModel(model, param);
 				
-				aZ = nodes[Leg2].pos - nodes[Torso4].pos;
+				aZ = nodes.GetPos(Leg2) - nodes.GetPos(Torso4);
 				aZ = aZ.Normalize();
-				aY = nodes[Torso1].pos - nodes[Torso2].pos;
+				aY = nodes.GetPos(Torso1) - nodes.GetPos(Torso2);
 				aY = Vector3::Cross(aY, aZ).Normalize();
 				aX = Vector3::Cross(aY, aZ).Normalize();
 				param.matrix = Matrix4::FromAxis(aX, aY, aZ, leg2Base) * scaler;
@@ -894,7 +906,7 @@ namespace spades {
 		Vector3 Corpse::GetCenter() {
 			Vector3 v = {0,0,0};
 			for(int i = 0; i < NodeCount; i++)
-				v += nodes[i].pos;
+				v += nodes.GetPos(i);
 			v *= 1.f / (float)NodeCount;
 			return v;
 		}
@@ -906,7 +918,7 @@ namespace spades {
 			
 			for(int i = 0; i < NodeCount; i++){
 				IntVector3 outBlk;
-				if(map->CastRay(eye, nodes[i].pos,
+				if(map->CastRay(eye, nodes.GetPos(i),
 								 256.f, outBlk))
 					return true;
 			}
@@ -915,7 +927,12 @@ namespace spades {
 		
 		void Corpse::AddImpulse(spades::Vector3 v){
 			for(int i = 0; i < NodeCount; i++)
-				nodes[i].vel += v;
+				nodes.AddVel(i, v);
+			solver->WakeUp(slot);
+		}
+		
+		bool Corpse::IsSleeping() {
+			return solver->sleeping[slot] != 0;
 		}
 	}
 }
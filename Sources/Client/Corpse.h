@@ -21,6 +21,7 @@
 #pragma once
 
 #include "../Core/Math.h"
+#include "CorpseSolver.h"
 
 namespace spades {
 	namespace client {
@@ -30,6 +31,8 @@ namespace spades {
 		class IModel;
 		
 		class Corpse {
+			friend class CorpseSolver;
+			
 			enum NodeType {
 				// torso in CW seen from front
 				Torso1, Torso2,
@@ -45,13 +48,6 @@ namespace spades {
 				NodeCount
 			};
 			
-			struct Node {
-				Vector3 pos, vel;
-				Vector3 lastPos;
-				
-				Vector3 lastForce;
-			};
-			
 			struct Edge {
 				NodeType node1, node2;
 				Vector3 lastVelDiff;
@@ -62,10 +58,13 @@ namespace spades {
 			};
 			
 			IRenderer *renderer;
+			CorpseSolver *solver;
 			GameMap *map;
 			Vector3 color;
 			
-			Node nodes[NodeCount];
+			/** index of this corpse in the solver. */
+			size_t slot;
+			CorpseSolver::NodeSpan nodes;
 			Edge edges[8];
 			
 			void SetNode(NodeType n, Vector3);
@@ -99,21 +98,23 @@ namespace spades {
 			
 			void LineCollision(NodeType a, NodeType b, float dt);
 			
+			/** called by CorpseSolver on one of its shards. */
+			void Update(float dt);
 			
 		public:
 			Corpse(IRenderer *renderer,
-				   GameMap *map,
+				   CorpseSolver *solver,
 				   Player *p);
 			~Corpse();
 			
-			void Update(float dt);
-			
 			void AddToScene();
 			
 			Vector3 GetCenter();
 			bool IsVisibleFrom(Vector3 eye);
 			
 			void AddImpulse(Vector3);
+			
+			bool IsSleeping();
 		};
 	}
 }
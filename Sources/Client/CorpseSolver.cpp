@@ -0,0 +1,384 @@
+/*
+ Copyright (c) 2013 yvt
+ 
+ This file is part of OpenSpades.
+ 
+ OpenSpades is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+ 
+ OpenSpades is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with OpenSpades.  If not, see <http://www.gnu.org/licenses/>.
+ 
+ */
+
+
+#include "CorpseSolver.h"
+#include "Corpse.h"
+#include "GameMap.h"
+#include "World.h"
+#include "Player.h"
+#include "Weapon.h"
+#include "../Core/AutoLocker.h"
+#include "../Core/ConcurrentDispatch.h"
+#include "../Core/Debug.h"
+#include "../Core/Settings.h"
+#include "../Core/Stopwatch.h"
+#include "../Core/Profiler.h"
+#include <algorithm>
+#include <random>
+#include <stdlib.h>
+
+SPADES_SETTING(cg_corpseNumThreads, "4");
+SPADES_SETTING(cg_corpseSleep, "1");
+
+namespace spades {
+	namespace client {
+		
+		/** a corpse is put to sleep when none of its nodes moved
+		 * faster than SleepSpeed for SleepDelay seconds. */
+		static const float SleepSpeed = .3f;
+		static const float SleepDelay = 1.f;
+		
+		/** block changes this far from a sleeping corpse wake it. */
+		static const float WakeMargin = 2.f;
+		
+		/** don't spread corpses thinner than this over threads. */
+		static const size_t MinCorpsesPerShard = 4;
+		
+		CorpseSolver::CorpseSolver():
+		map(nullptr) {
+			static_assert((int)Corpse::NodeCount == (int)NodesPerCorpse,
+						  "NodesPerCorpse mismatch");
+		}
+		
+		CorpseSolver::~CorpseSolver() {
+			SPADES_MARK_FUNCTION();
+			Join();
+			if(!corpses.empty()) {
+				// destructors can't throw, so SPAssert can't be used here
+				SPLog("CorpseSolver destroyed with %d corpse(s) still added",
+					  (int)corpses.size());
+				abort();
+			}
+			SetGameMap(nullptr);
+		}
+		
+		void CorpseSolver::SetGameMap(GameMap *mp) {
+			SPADES_MARK_FUNCTION();
+			if(mp == map)
+				return;
+			
+			SPAssert(corpses.empty());
+			
+			if(mp) {
+				mp->AddListener(this);
+				mp->AddRef();
+			}
+			GameMap *oldMap = map;
+			map = mp;
+			if(oldMap) {
+				oldMap->RemoveListener(this);
+				oldMap->Release();
+			}
+			
+			AutoLocker guard(&changedBlocksMutex);
+			changedBlocks.clear();
+		}
+		
+		void CorpseSolver::Resize(size_t numSlots) {
+			for(auto& a: nodeData)
+				a.resize(numSlots * NodesPerCorpse);
+			restTime.resize(numSlots);
+			sleeping.resize(numSlots);
+		}
+		
+		CorpseSolver::NodeSpan CorpseSolver::GetNodes(size_t slot) {
+			size_t base = slot * NodesPerCorpse;
+			NodeSpan span;
+			span.posX = nodeData[PosX].data() + base;
+			span.posY = nodeData[PosY].data() + base;
+			span.posZ = nodeData[PosZ].data() + base;
+			span.velX = nodeData[VelX].data() + base;
+			span.velY = nodeData[VelY].data() + base;
+			span.velZ = nodeData[VelZ].data() + base;
+			span.lastPosX = nodeData[LastPosX].data() + base;
+			span.lastPosY = nodeData[LastPosY].data() + base;
+			span.lastPosZ = nodeData[LastPosZ].data() + base;
+			return span;
+		}
+		
+		void CorpseSolver::UpdateSpans() {
+			// storage might have been reallocated or moved
+			for(size_t i = 0; i < corpses.size(); i++)
+				corpses[i]->nodes = GetNodes(i);
+		}
+		
+		size_t CorpseSolver::Add(Corpse *c) {
+			SPADES_MARK_FUNCTION();
+			SPAssert(shards.empty());
+			
+			size_t slot = corpses.size();
+			corpses.push_back(c);
+			Resize(corpses.size());
+			restTime[slot] = 0.f;
+			sleeping[slot] = 0;
+			
+			c->slot = slot;
+			UpdateSpans();
+			return slot;
+		}
+		
+		void CorpseSolver::Remove(size_t slot) {
+			SPADES_MARK_FUNCTION();
+			SPAssert(shards.empty());
+			SPAssert(slot < corpses.size());
+			
+			// move the last corpse into the hole
+			size_t last = corpses.size() - 1;
+			if(slot != last) {
+				corpses[slot] = corpses[last];
+				corpses[slot]->slot = slot;
+				restTime[slot] = restTime[last];
+				sleeping[slot] = sleeping[last];
+				for(auto& a: nodeData) {
+					std::copy(a.begin() + last * NodesPerCorpse,
+							  a.begin() + (last + 1) * NodesPerCorpse,
+							  a.begin() + slot * NodesPerCorpse);
+				}
+			}
+			
+			corpses.pop_back();
+			Resize(corpses.size());
+			UpdateSpans();
+		}
+		
+		size_t CorpseSolver::GetNumSleepingCorpses() const {
+			return std::count(sleeping.begin(), sleeping.end(), 1);
+		}
+		
+		void CorpseSolver::WakeUp(size_t slot) {
+			SPAssert(slot < corpses.size());
+			sleeping[slot] = 0;
+			restTime[slot] = 0.f;
+		}
+		
+		void CorpseSolver::WakeUpNear(const std::vector<IntVector3> &blocks) {
+			SPADES_MARK_FUNCTION();
+			
+			for(size_t slot = 0; slot < corpses.size(); slot++) {
+				if(!sleeping[slot])
+					continue;
+				
+				size_t base = slot * NodesPerCorpse;
+				const float *x = nodeData[PosX].data() + base;
+				const float *y = nodeData[PosY].data() + base;
+				const float *z = nodeData[PosZ].data() + base;
+				AABB3 bounds(x[0], y[0], z[0], 0.f, 0.f, 0.f);
+				for(int i = 1; i < NodesPerCorpse; i++)
+					bounds += MakeVector3(x[i], y[i], z[i]);
+				bounds = bounds.Inflate(WakeMargin);
+				
+				for(const auto& b: blocks) {
+					Vector3 center = MakeVector3(b.x + .5f, b.y + .5f, b.z + .5f);
+					if(bounds.Contains(center)) {
+						WakeUp(slot);
+						break;
+					}
+				}
+			}
+		}
+		
+		void CorpseSolver::GameMapChanged(int x, int y, int z, GameMap *) {
+			// called by whoever modifies the map; consumed by the next Start
+			AutoLocker guard(&changedBlocksMutex);
+			changedBlocks.push_back(IntVector3::Make(x, y, z));
+		}
+		
+		void CorpseSolver::RunShard(size_t begin, size_t end,
+									float dt, bool allowSleep) {
+			SPADES_MARK_FUNCTION();
+			SPADES_PROFILE_ZONE("CorpseSolver::RunShard");
+			
+			const float sleepDistSq = SleepSpeed * SleepSpeed * dt * dt;
+			
+			for(size_t k = begin; k < end; k++) {
+				size_t slot = awakeSlots[k];
+				Corpse *c = corpses[slot];
+				
+				// resting ragdolls keep jittering against the floor with
+				// a small velocity, so watch how far they actually moved
+				NodeSpan &nodes = c->nodes;
+				float oldX[NodesPerCorpse], oldY[NodesPerCorpse], oldZ[NodesPerCorpse];
+				std::copy(nodes.posX, nodes.posX + NodesPerCorpse, oldX);
+				std::copy(nodes.posY, nodes.posY + NodesPerCorpse, oldY);
+				std::copy(nodes.posZ, nodes.posZ + NodesPerCorpse, oldZ);
+				
+				for(int i = 0; i < NumSubsteps; i++)
+					c->Update(dt / (float)NumSubsteps);
+				
+				float maxDistSq = 0.f;
+				for(int i = 0; i < NodesPerCorpse; i++) {
+					float dx = nodes.posX[i] - oldX[i];
+					float dy = nodes.posY[i] - oldY[i];
+					float dz = nodes.posZ[i] - oldZ[i];
+					maxDistSq = std::max(maxDistSq, dx * dx + dy * dy + dz * dz);
+				}
+				
+				if(maxDistSq >= sleepDistSq) {
+					restTime[slot] = 0.f;
+					continue;
+				}
+				
+				restTime[slot] += dt;
+				if(allowSleep && restTime[slot] > SleepDelay) {
+					sleeping[slot] = 1;
+					std::fill(nodes.velX, nodes.velX + NodesPerCorpse, 0.f);
+					std::fill(nodes.velY, nodes.velY + NodesPerCorpse, 0.f);
+					std::fill(nodes.velZ, nodes.velZ + NodesPerCorpse, 0.f);
+				}
+			}
+		}
+		
+		void CorpseSolver::Start(float dt) {
+			Start(dt, (int)cg_corpseNumThreads, (int)cg_corpseSleep != 0);
+		}
+		
+		void CorpseSolver::Start(float dt, int numThreads, bool allowSleep) {
+			SPADES_MARK_FUNCTION();
+			SPAssert(shards.empty());
+			
+			std::vector<IntVector3> blocks;
+			{
+				AutoLocker guard(&changedBlocksMutex);
+				blocks.swap(changedBlocks);
+			}
+			if(!blocks.empty())
+				WakeUpNear(blocks);
+			
+			awakeSlots.clear();
+			for(size_t slot = 0; slot < corpses.size(); slot++) {
+				if(!sleeping[slot])
+					awakeSlots.push_back(slot);
+			}
+			if(awakeSlots.empty())
+				return;
+			
+			size_t numShards = awakeSlots.size() / MinCorpsesPerShard;
+			numShards = std::min(numShards, (size_t)std::max(numThreads, 1));
+			numShards = std::max(numShards, (size_t)1);
+			
+			// corpse never accesses audio nor renderer, so
+			// every shard can run in a separate thread
+			for(size_t i = 0; i < numShards; i++) {
+				size_t begin = awakeSlots.size() * i / numShards;
+				size_t end = awakeSlots.size() * (i + 1) / numShards;
+				auto f = [this, begin, end, dt, allowSleep]() {
+					RunShard(begin, end, dt, allowSleep);
+				};
+				shards.emplace_back
+				(static_cast<ConcurrentDispatch *>(new FunctionDispatch<decltype(f)>(f)));
+				shards.back()->Start();
+			}
+		}
+		
+		void CorpseSolver::Join() {
+			SPADES_MARK_FUNCTION();
+			for(auto& s: shards)
+				s->Join();
+			shards.clear();
+		}
+		
+		void CorpseSolver::RunBenchmark() {
+			SPADES_MARK_FUNCTION();
+			
+			const int numFrames = 300;
+			const float dt = 1.f / 60.f;
+			const int counts[] = {32, 64, 128};
+			
+			// a floor with a few pillars for the ragdolls to land on
+			Handle<GameMap> map(new GameMap(), false);
+			for(int x = 192; x < 320; x++)
+				for(int y = 192; y < 320; y++) {
+					int top = ((x / 8 + y / 8) % 5 == 0) ? 58 : 62;
+					for(int z = top; z < 64; z++)
+						map->Set(x, y, z, true, 0);
+				}
+			
+			World world;
+			int numSlots = (int)world.GetNumPlayerSlots();
+			for(int i = 0; i < numSlots; i++) {
+				Player *p = new Player(&world, i, RIFLE_WEAPON, i & 1,
+									   MakeVector3(256.f, 256.f, 40.f),
+									   IntVector3::Make(255, 255, 255));
+				world.SetPlayer(i, p);
+			}
+			
+			// returns the average frame time over all frames and
+			// over the last second, when most ragdolls have settled
+			struct Result {
+				double average, settled;
+				size_t numSleeping;
+			};
+			const int numSettledFrames = 60;
+			
+			auto run = [&](int numCorpses, int numThreads, bool allowSleep) {
+				std::mt19937 rnd(12345);
+				std::uniform_real_distribution<float> unit(0.f, 1.f);
+				
+				CorpseSolver solver;
+				solver.SetGameMap(map);
+				std::vector<std::unique_ptr<Corpse>> corpses;
+				for(int i = 0; i < numCorpses; i++) {
+					Player *p = world.GetPlayer(i % numSlots);
+					p->SetPosition(MakeVector3(200.f + unit(rnd) * 112.f,
+											   200.f + unit(rnd) * 112.f,
+											   45.f + unit(rnd) * 10.f));
+					float yaw = unit(rnd) * 6.2831853f;
+					p->SetOrientation(MakeVector3(cosf(yaw), sinf(yaw), 0.f));
+					corpses.emplace_back(new Corpse(nullptr, &solver, p));
+					corpses.back()->AddImpulse(MakeVector3(unit(rnd) - unit(rnd),
+														   unit(rnd) - unit(rnd),
+														   -unit(rnd)) * 8.f);
+				}
+				
+				Result result;
+				Stopwatch sw;
+				double settledStart = 0.;
+				sw.Reset();
+				for(int i = 0; i < numFrames; i++) {
+					if(i == numFrames - numSettledFrames)
+						settledStart = sw.GetTime();
+					solver.Start(dt, numThreads, allowSleep);
+					solver.Join();
+				}
+				double total = sw.GetTime();
+				result.average = total * 1000. / numFrames;
+				result.settled = (total - settledStart) * 1000. / numSettledFrames;
+				result.numSleeping = solver.GetNumSleepingCorpses();
+				corpses.clear();
+				return result;
+			};
+			
+			int numThreads = std::max((int)cg_corpseNumThreads, 1);
+			for(int numCorpses: counts) {
+				Result single = run(numCorpses, 1, false);
+				Result sharded = run(numCorpses, numThreads, false);
+				Result sleep = run(numCorpses, numThreads, true);
+				SPLog("Corpse benchmark: %d corpses, ms/frame (average / settled): "
+					  "1 thread: %.3f / %.3f, %d threads: %.3f / %.3f, "
+					  "%d threads with sleeping: %.3f / %.3f (%d asleep)",
+					  numCorpses, single.average, single.settled,
+					  numThreads, sharded.average, sharded.settled,
+					  numThreads, sleep.average, sleep.settled,
+					  (int)sleep.numSleeping);
+			}
+		}
+	}
+}
@@ -0,0 +1,139 @@
+/*
+ Copyright (c) 2013 yvt
+ 
+ This file is part of OpenSpades.
+ 
+ OpenSpades is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+ 
+ OpenSpades is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with OpenSpades.  If not, see <http://www.gnu.org/licenses/>.
+ 
+ */
+
+
+#pragma once
+
+#include <vector>
+#include <memory>
+#include "../Core/Math.h"
+#include "../Core/Mutex.h"
+#include "IGameMapListener.h"
+
+namespace spades {
+	class ConcurrentDispatch;
+	namespace client {
+		class GameMap;
+		class Corpse;
+		
+		/** Steps the ragdolls of all corpses.
+		 * Nodes of every corpse are stored in structure-of-arrays form,
+		 * corpses are sharded across dispatch threads, and ragdolls that
+		 * came to rest are put to sleep until a nearby block changes. */
+		class CorpseSolver: public IGameMapListener {
+			friend class Corpse;
+		public:
+			/** View of the nodes owned by a single corpse.
+			 * Valid until the solver adds or removes a corpse. */
+			struct NodeSpan {
+				float *posX, *posY, *posZ;
+				float *velX, *velY, *velZ;
+				float *lastPosX, *lastPosY, *lastPosZ;
+				
+				Vector3 GetPos(int i) const {
+					return MakeVector3(posX[i], posY[i], posZ[i]);
+				}
+				Vector3 GetVel(int i) const {
+					return MakeVector3(velX[i], velY[i], velZ[i]);
+				}
+				Vector3 GetLastPos(int i) const {
+					return MakeVector3(lastPosX[i], lastPosY[i], lastPosZ[i]);
+				}
+				void SetPos(int i, const Vector3& v) {
+					posX[i] = v.x; posY[i] = v.y; posZ[i] = v.z;
+				}
+				void SetVel(int i, const Vector3& v) {
+					velX[i] = v.x; velY[i] = v.y; velZ[i] = v.z;
+				}
+				void SetLastPos(int i, const Vector3& v) {
+					lastPosX[i] = v.x; lastPosY[i] = v.y; lastPosZ[i] = v.z;
+				}
+				void AddPos(int i, const Vector3& v) {
+					posX[i] += v.x; posY[i] += v.y; posZ[i] += v.z;
+				}
+				void AddVel(int i, const Vector3& v) {
+					velX[i] += v.x; velY[i] += v.y; velZ[i] += v.z;
+				}
+			};
+			
+		private:
+			enum {
+				NodesPerCorpse = 9,
+				NumSubsteps = 4
+			};
+			
+			enum NodeArray {
+				PosX, PosY, PosZ,
+				VelX, VelY, VelZ,
+				LastPosX, LastPosY, LastPosZ,
+				NumNodeArrays
+			};
+			
+			GameMap *map;
+			
+			std::vector<Corpse *> corpses;
+			/** NodesPerCorpse consecutive elements per corpse. */
+			std::vector<float> nodeData[NumNodeArrays];
+			std::vector<float> restTime;
+			std::vector<unsigned char> sleeping;
+			
+			/** slots of corpses being stepped by the running shards. */
+			std::vector<size_t> awakeSlots;
+			std::vector<std::unique_ptr<ConcurrentDispatch>> shards;
+			
+			Mutex changedBlocksMutex;
+			std::vector<IntVector3> changedBlocks;
+			
+			size_t Add(Corpse *);
+			void Remove(size_t slot);
+			void Resize(size_t numSlots);
+			void UpdateSpans();
+			NodeSpan GetNodes(size_t slot);
+			
+			void WakeUp(size_t slot);
+			void WakeUpNear(const std::vector<IntVector3>& blocks);
+			
+			void RunShard(size_t begin, size_t end,
+						  float dt, bool allowSleep);
+			void Start(float dt, int numThreads, bool allowSleep);
+			
+		public:
+			CorpseSolver();
+			~CorpseSolver();
+			
+			/** Changes the map the ragdolls collide with.
+			 * Must not be called while corpses exist. */
+			void SetGameMap(GameMap *);
+			GameMap *GetGameMap() { return map; }
+			
+			/** Starts stepping all awake corpses by dt.
+			 * Corpses must not be touched until Join returns. */
+			void Start(float dt);
+			void Join();
+			
+			size_t GetNumCorpses() const { return corpses.size(); }
+			size_t GetNumSleepingCorpses() const;
+			
+			virtual void GameMapChanged(int x, int y, int z, GameMap *);
+			
+			static void RunBenchmark();
+		};
+	}
+}
@@ -0,0 +1,120 @@
+/*
+ Copyright (c) 2013 yvt
+ 
+ This file is part of OpenSpades.
+ 
+ OpenSpades is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+ 
+ OpenSpades is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with OpenSpades.  If not, see <http://www.gnu.org/licenses/>.
+ 
+ */
+
+
+#include "Demo.h"
+#include <Core/Debug.h>
+#include <Core/Exception.h>
+#include <Core/IStream.h>
+#include <string.h>
+
+namespace spades {
+	namespace client {
+		
+		static const char DemoMagic[8] = {'S', 'P', 'D', 'E', 'M', 'O', 0, 0};
+		static const uint32_t DemoFormatVersion = 1;
+		
+		DemoRecorder::DemoRecorder(IStream *s, int protocolVersion):
+		stream(s) {
+			SPADES_MARK_FUNCTION();
+			
+			stream->Write(DemoMagic, sizeof(DemoMagic));
+			WriteInt(DemoFormatVersion);
+			WriteInt((uint32_t)protocolVersion);
+			stopwatch.Reset();
+		}
+		
+		DemoRecorder::~DemoRecorder() {
+			SPADES_MARK_FUNCTION();
+			stream->Flush();
+		}
+		
+		void DemoRecorder::WriteInt(uint32_t v) {
+			char buf[4];
+			buf[0] = (char)(v);
+			buf[1] = (char)(v >> 8);
+			buf[2] = (char)(v >> 16);
+			buf[3] = (char)(v >> 24);
+			stream->Write(buf, 4);
+		}
+		
+		void DemoRecorder::RecordPacket(const char *data, size_t size) {
+			SPADES_MARK_FUNCTION_DEBUG();
+			
+			WriteInt((uint32_t)(stopwatch.GetTime() * 1000.));
+			WriteInt((uint32_t)size);
+			stream->Write(data, size);
+		}
+		
+		DemoPlayer::DemoPlayer(IStream *s):
+		stream(s),
+		hasNext(false) {
+			SPADES_MARK_FUNCTION();
+			
+			char magic[sizeof(DemoMagic)];
+			if(stream->Read(magic, sizeof(magic)) < sizeof(magic) ||
+			   memcmp(magic, DemoMagic, sizeof(magic))) {
+				SPRaise("Not a demo file");
+			}
+			uint32_t version = stream->ReadLittleInt();
+			if(version != DemoFormatVersion) {
+				SPRaise("Unsupported demo format version: %d", (int)version);
+			}
+			protocolVersion = (int)stream->ReadLittleInt();
+			
+			ReadNext();
+		}
+		
+		DemoPlayer::~DemoPlayer() {
+		}
+		
+		void DemoPlayer::ReadNext() {
+			SPADES_MARK_FUNCTION_DEBUG();
+			
+			hasNext = false;
+			if(stream->GetPosition() >= stream->GetLength())
+				return;
+			
+			// a demo whose recording was cut off ends with
+			// a truncated packet; just stop there.
+			try {
+				uint32_t ms = stream->ReadLittleInt();
+				uint32_t len = stream->ReadLittleInt();
+				nextData.resize(len);
+				if(len > 0 && stream->Read(nextData.data(), len) < len) {
+					SPLog("Demo file is truncated");
+					return;
+				}
+				nextTime = (double)ms / 1000.;
+				hasNext = true;
+			}catch(const std::exception& ex){
+				SPLog("Demo file is truncated: %s", ex.what());
+			}
+		}
+		
+		bool DemoPlayer::Poll(double time, std::vector<char> &data) {
+			if(!hasNext || nextTime > time)
+				return false;
+			data.swap(nextData);
+			ReadNext();
+			return true;
+		}
+	}
+}
@@ -0,0 +1,81 @@
+/*
+ Copyright (c) 2013 yvt
+ 
+ This file is part of OpenSpades.
+ 
+ OpenSpades is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+ 
+ OpenSpades is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with OpenSpades.  If not, see <http://www.gnu.org/licenses/>.
+ 
+ */
+
+
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <Core/Stopwatch.h>
+
+namespace spades {
+	class IStream;
+	namespace client {
+		
+		/* A demo file holds the packets a NetClient received from
+		 * a server, each with the time it arrived at:
+		 *
+		 *   header:  "SPDEMO\0\0", uint32 format version,
+		 *            uint32 protocol version
+		 *   packets: uint32 milliseconds since connection,
+		 *            uint32 length, packet data
+		 *
+		 * All integers are little endian, like the game protocol. */
+		
+		/** Writes received packets to a demo file. */
+		class DemoRecorder {
+			std::unique_ptr<IStream> stream;
+			Stopwatch stopwatch;
+			
+			void WriteInt(uint32_t);
+		public:
+			/** takes ownership of the stream. */
+			DemoRecorder(IStream *, int protocolVersion);
+			~DemoRecorder();
+			
+			void RecordPacket(const char *data, size_t size);
+		};
+		
+		/** Reads packets back from a demo file. */
+		class DemoPlayer {
+			std::unique_ptr<IStream> stream;
+			int protocolVersion;
+			
+			bool hasNext;
+			double nextTime;
+			std::vector<char> nextData;
+			
+			void ReadNext();
+		public:
+			/** takes ownership of the stream. */
+			DemoPlayer(IStream *);
+			~DemoPlayer();
+			
+			int GetProtocolVersion() const { return protocolVersion; }
+			
+			/** retrieves the next packet if it had arrived by
+			 * the given time since the start of the demo.
+			 * @return false when no packet is due yet. */
+			bool Poll(double time, std::vector<char>& data);
+			
+			bool IsFinished() const { return !hasNext; }
+		};
+	}
+}
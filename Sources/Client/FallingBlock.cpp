@@ -27,8 +27,7 @@
 #include "../Core/Exception.h"
 #include "World.h"
 #include "GameMap.h"
-#include "SmokeSpriteEntity.h"
-#include "ParticleSpriteEntity.h"
+#include "ParticlePool.h"
 
 namespace spades {
 	namespace client {
@@ -162,36 +161,34 @@ namespace spades {
 							Vector3 p3 = p2 + vmAxis3 * (float)z;
 							
 							{
-								ParticleSpriteEntity *ent =
-								new SmokeSpriteEntity(client, col, 70.f);
-								ent->SetTrajectory(p3,
-												   (MakeVector3(GetRandom()-GetRandom(),
+								SmokeSprite ent(col, 70.f);
+								ent.SetTrajectory(p3,
+												  (MakeVector3(GetRandom()-GetRandom(),
 																GetRandom()-GetRandom(),
 																GetRandom()-GetRandom())) * 0.2f,
-												   1.f, 0.f);
-								ent->SetRotation(GetRandom() * (float)M_PI * 2.f);
-								ent->SetRadius(1.0f,
-											   0.5f);
-								ent->SetBlockHitAction(ParticleSpriteEntity::Ignore);
-								ent->SetLifeTime(1.0f + GetRandom()*0.5f, 0.f, 1.0f);
-								client->AddLocalEntity(ent);
+												  1.f, 0.f);
+								ent.SetRotation(GetRandom() * (float)M_PI * 2.f);
+								ent.SetRadius(1.0f,
+											  0.5f);
+								ent.SetBlockHitAction(ParticleSprite::Ignore);
+								ent.SetLifeTime(1.0f + GetRandom()*0.5f, 0.f, 1.0f);
+								client->AddParticle(ent);
 							}
 							
 							col.w = 1.f;
 							for(int i = 0; i < 6; i++){
-								ParticleSpriteEntity *ent =
-								new ParticleSpriteEntity(client, img, col);
-								ent->SetTrajectory(p3,
-												   MakeVector3(GetRandom()-GetRandom(),
-															   GetRandom()-GetRandom(),
-															   GetRandom()-GetRandom()) * 13.f,
-												   1.f, .6f);
-								ent->SetRotation(GetRandom() * (float)M_PI * 2.f);
-								ent->SetRadius(0.35f + GetRandom()*GetRandom()*0.1f);
-								ent->SetLifeTime(2.f, 0.f, 1.f);
+								ParticleSprite ent(img, col);
+								ent.SetTrajectory(p3,
+												  MakeVector3(GetRandom()-GetRandom(),
+															  GetRandom()-GetRandom(),
+															  GetRandom()-GetRandom()) * 13.f,
+												  1.f, .6f);
+								ent.SetRotation(GetRandom() * (float)M_PI * 2.f);
+								ent.SetRadius(0.35f + GetRandom()*GetRandom()*0.1f);
+								ent.SetLifeTime(2.f, 0.f, 1.f);
 								if(usePrecisePhysics)
-									ent->SetBlockHitAction(ParticleSpriteEntity::BounceWeak);
-								client->AddLocalEntity(ent);
+									ent.SetBlockHitAction(ParticleSprite::BounceWeak);
+								client->AddParticle(ent);
 							}
 						}
 					}
@@ -33,7 +33,8 @@
 namespace spades {
 	namespace client {
 		GameMap::GameMap():
-		listener(NULL){
+		listener(NULL),
+		numSnapshots(0){
 			SPADES_MARK_FUNCTION();
 			
 			uint32_t rnd = (uint32_t)rand() ^ ((uint32_t)rand() << 16);
@@ -69,106 +70,201 @@ namespace spades {
 			}
 		}
 		
-		bool GameMap::IsSurface(int x, int y, int z) {
-			if(!IsSolid(x, y, z)) return false;
-			if(z == 0) return true;
-			if(x > 0 && !IsSolid(x - 1, y, z))
-				return true;
-			if(x < Width() - 1 && !IsSolid(x + 1, y, z))
-				return true;
-			if(y > 0 && !IsSolid(x, y - 1, z))
-				return true;
-			if(y < Height() - 1 && !IsSolid(x, y + 1, z))
-				return true;
-			if(!IsSolid(x, y, z - 1))
-				return true;
-			if(z < Depth() - 1 && !IsSolid(x, y, z + 1))
-				return true;
-			return false;
+		void GameMap::PreserveColumn(int x, int y) {
+			AutoLocker guard(&snapshotsMutex);
+			for(auto *snapshot: snapshots)
+				snapshot->Preserve(x, y);
 		}
 		
-		static void WriteColor(std::vector<char>& buffer, int color) {
-			buffer.push_back((char)(color >> 16));
-			buffer.push_back((char)(color >> 8));
-			buffer.push_back((char)(color >> 0));
-			buffer.push_back((char)(color >> 24));
-		}
-		
-		// base on pysnip
-		void GameMap::Save(spades::IStream *stream){
-			int w = Width();
-			int h = Height();
-			int d = Depth();
-			std::vector<char> buffer;
-			buffer.reserve(10 * 1024 * 1024);
-			for(int y = 0; y < h; y++){
-				for(int x = 0; x < w; x++) {
-					int k = 0;
-					while(k < d) {
-						int z;
-						
-						int air_start;
-						int top_colors_start;
-						int top_colors_end; // exclusive
-						int bottom_colors_start;
-						int bottom_colors_end; // exclusive
-						int top_colors_len;
-						int bottom_colors_len;
-						int colors;
-						air_start = k;
-						while (k < d && !IsSolid(x, y, k))
-							++k;
-						top_colors_start = k;
-						while (k < d && IsSurface(x, y, k))
-							++k;
-						top_colors_end = k;
-						
-						while (k < d && IsSolid(x, y, k) &&
-							   !IsSurface(x, y, k))
-							++k;
-						
-						bottom_colors_start = k;
-						
-						z = k;
-						while (z < d && IsSurface(x, y, z))
-							++z;
-						
-						if (z != d) {
-							while (IsSurface(x, y, k))
+		namespace {
+			enum {
+				VxlWidth = GameMap::DefaultWidth,
+				VxlHeight = GameMap::DefaultHeight,
+				VxlDepth = GameMap::DefaultDepth
+			};
+			
+			/** solid bits laid out like GameMap::solidMap. */
+			inline bool IsSolid(const uint64_t *solid, int x, int y, int z) {
+				return ((solid[x * VxlHeight + y] >> (uint64_t)z) & 1ULL) != 0;
+			}
+			
+			bool IsSurface(const uint64_t *solid, int x, int y, int z) {
+				if(!IsSolid(solid, x, y, z)) return false;
+				if(z == 0) return true;
+				if(x > 0 && !IsSolid(solid, x - 1, y, z))
+					return true;
+				if(x < VxlWidth - 1 && !IsSolid(solid, x + 1, y, z))
+					return true;
+				if(y > 0 && !IsSolid(solid, x, y - 1, z))
+					return true;
+				if(y < VxlHeight - 1 && !IsSolid(solid, x, y + 1, z))
+					return true;
+				if(!IsSolid(solid, x, y, z - 1))
+					return true;
+				if(z < VxlDepth - 1 && !IsSolid(solid, x, y, z + 1))
+					return true;
+				return false;
+			}
+			
+			void WriteColor(std::vector<char>& buffer, int color) {
+				buffer.push_back((char)(color >> 16));
+				buffer.push_back((char)(color >> 8));
+				buffer.push_back((char)(color >> 0));
+				buffer.push_back((char)(color >> 24));
+			}
+			
+			/** encodes the map in VXL format.
+			 * fetchColumn(x, y) returns colors of a column.
+			 * based on pysnip. */
+			template <class F>
+			void EncodeVXL(const uint64_t *solid, F fetchColumn,
+						   std::vector<char>& buffer) {
+				int w = VxlWidth;
+				int h = VxlHeight;
+				int d = VxlDepth;
+				buffer.reserve(10 * 1024 * 1024);
+				for(int y = 0; y < h; y++){
+					for(int x = 0; x < w; x++) {
+						const uint32_t *columnColors = fetchColumn(x, y);
+						int k = 0;
+						while(k < d) {
+							int z;
+							
+							int air_start;
+							int top_colors_start;
+							int top_colors_end; // exclusive
+							int bottom_colors_start;
+							int bottom_colors_end; // exclusive
+							int top_colors_len;
+							int bottom_colors_len;
+							int colors;
+							air_start = k;
+							while (k < d && !IsSolid(solid, x, y, k))
 								++k;
-						}
-						bottom_colors_end = k;
-						
-						top_colors_len    = top_colors_end    - top_colors_start;
-						bottom_colors_len = bottom_colors_end - bottom_colors_start;
-						
-						colors = top_colors_len + bottom_colors_len;
-						
-						if (k == d)
-						{
-							buffer.push_back(0);
-						}
-						else
-						{
-							buffer.push_back(colors + 1);
-						}
-						buffer.push_back(top_colors_start);
-						buffer.push_back(top_colors_end - 1);
-						buffer.push_back(air_start);
-						
-						for (z=0; z < top_colors_len; ++z)
-						{
-							WriteColor(buffer, GetColor(x, y,
-															  top_colors_start + z));
-						}
-						for (z=0; z < bottom_colors_len; ++z)
-						{
-							WriteColor(buffer, GetColor(x, y,
-															  bottom_colors_start + z));
+							top_colors_start = k;
+							while (k < d && IsSurface(solid, x, y, k))
+								++k;
+							top_colors_end = k;
+							
+							while (k < d && IsSolid(solid, x, y, k) &&
+								   !IsSurface(solid, x, y, k))
+								++k;
+							
+							bottom_colors_start = k;
+							
+							z = k;
+							while (z < d && IsSurface(solid, x, y, z))
+								++z;
+							
+							if (z != d) {
+								while (IsSurface(solid, x, y, k))
+									++k;
+							}
+							bottom_colors_end = k;
+							
+							top_colors_len    = top_colors_end    - top_colors_start;
+							bottom_colors_len = bottom_colors_end - bottom_colors_start;
+							
+							colors = top_colors_len + bottom_colors_len;
+							
+							if (k == d)
+							{
+								buffer.push_back(0);
+							}
+							else
+							{
+								buffer.push_back(colors + 1);
+							}
+							buffer.push_back(top_colors_start);
+							buffer.push_back(top_colors_end - 1);
+							buffer.push_back(air_start);
+							
+							for (z=0; z < top_colors_len; ++z)
+							{
+								WriteColor(buffer, columnColors[top_colors_start + z]);
+							}
+							for (z=0; z < bottom_colors_len; ++z)
+							{
+								WriteColor(buffer, columnColors[bottom_colors_start + z]);
+							}
 						}
 					}
 				}
 			}
+		}
+		
+		void GameMap::Save(spades::IStream *stream){
+			std::vector<char> buffer;
+			EncodeVXL(&solidMap[0][0], [this](int x, int y) -> const uint32_t * {
+				return colorMap[x][y];
+			}, buffer);
+			stream->Write(buffer.data(), buffer.size());
+		}
+		
+#pragma mark - Snapshot
+		
+		GameMapSnapshot::GameMapSnapshot(GameMap *m):
+		map(m),
+		solidMap(&m->solidMap[0][0],
+				 &m->solidMap[0][0] + GameMap::DefaultWidth * GameMap::DefaultHeight),
+		preservedIndex(GameMap::DefaultWidth * GameMap::DefaultHeight, -1) {
+			SPADES_MARK_FUNCTION();
+			
+			AutoLocker guard(&map->snapshotsMutex);
+			map->snapshots.push_back(this);
+			map->numSnapshots++;
+		}
+		
+		GameMapSnapshot::~GameMapSnapshot() {
+			SPADES_MARK_FUNCTION();
+			
+			AutoLocker guard(&map->snapshotsMutex);
+			auto it = std::find(map->snapshots.begin(), map->snapshots.end(), this);
+			if(it == map->snapshots.end()) {
+				// destructors can't throw, so SPAssert can't be used here
+				SPLog("GameMapSnapshot is not registered to its map");
+				abort();
+			}
+			map->snapshots.erase(it);
+			map->numSnapshots--;
+		}
+		
+		void GameMapSnapshot::Preserve(int x, int y) {
+			AutoLocker guard(&mutex);
+			int& index = preservedIndex[x * GameMap::DefaultHeight + y];
+			if(index >= 0)
+				return;
+			index = (int)preservedColors.size();
+			const uint32_t *colors = map->colorMap[x][y];
+			preservedColors.insert(preservedColors.end(),
+								   colors, colors + GameMap::DefaultDepth);
+		}
+		
+		void GameMapSnapshot::FetchColumn(int x, int y, uint32_t *colors) {
+			// holding the lock prevents the game thread from modifying
+			// a column which is not preserved yet
+			AutoLocker guard(&mutex);
+			int index = preservedIndex[x * GameMap::DefaultHeight + y];
+			const uint32_t *src = index >= 0 ?
+			preservedColors.data() + index :
+			map->colorMap[x][y];
+			std::copy(src, src + GameMap::DefaultDepth, colors);
+		}
+		
+		int GameMapSnapshot::GetNumPreservedColumns() {
+			AutoLocker guard(&mutex);
+			return (int)(preservedColors.size() / GameMap::DefaultDepth);
+		}
+		
+		void GameMapSnapshot::Save(spades::IStream *stream) {
+			SPADES_MARK_FUNCTION();
+			
+			std::vector<char> buffer;
+			uint32_t colors[GameMap::DefaultDepth];
+			EncodeVXL(solidMap.data(), [&](int x, int y) -> const uint32_t * {
+				FetchColumn(x, y, colors);
+				return colors;
+			}, buffer);
 			stream->Write(buffer.data(), buffer.size());
 		}
 		
@@ -30,11 +30,16 @@
 #include <list>
 #include <Core/Mutex.h>
 #include <Core/AutoLocker.h>
+#include <vector>
+#include <atomic>
 
 namespace spades{
 	class IStream;
 	namespace client {
+		class GameMapSnapshot;
+		
 		class GameMap: public RefCountedObject {
+			friend class GameMapSnapshot;
 		protected:
 			~GameMap();
 		public:
@@ -90,6 +95,8 @@ namespace spades{
 				SPAssert(x >= 0); SPAssert(x < Width());
 				SPAssert(y >= 0); SPAssert(y < Height());
 				SPAssert(z >= 0); SPAssert(z < Depth());
+				if(numSnapshots.load(std::memory_order_relaxed) > 0)
+					PreserveColumn(x, y);
 				uint64_t mask = 1ULL << z;
 				uint64_t value = solidMap[x][y];
 				bool changed = false;
@@ -155,8 +162,40 @@ namespace spades{
 			IGameMapListener *listener;
 			std::list<IGameMapListener *> listeners;
 			Mutex listenersMutex;
+			std::vector<GameMapSnapshot *> snapshots;
+			Mutex snapshotsMutex;
+			std::atomic<int> numSnapshots;
 			
-			bool IsSurface(int x, int y, int z);
+			void PreserveColumn(int x, int y);
+		};
+		
+		/** Point-in-time view of a GameMap that can be saved on another
+		 * thread while the game keeps modifying the map.
+		 * Solid bits are copied on creation, and colors of a column are
+		 * copied only when the game is about to modify that column.
+		 * Must be created on the thread that modifies the map. */
+		class GameMapSnapshot {
+			friend class GameMap;
+			Handle<GameMap> map;
+			std::vector<uint64_t> solidMap;
+			/** index into preservedColors for each column, or -1 */
+			std::vector<int> preservedIndex;
+			std::vector<uint32_t> preservedColors;
+			Mutex mutex;
+			
+			void Preserve(int x, int y);
+			void FetchColumn(int x, int y, uint32_t *colors);
+			
+			GameMapSnapshot(const GameMapSnapshot&) = delete;
+			void operator =(const GameMapSnapshot&) = delete;
+		public:
+			GameMapSnapshot(GameMap *);
+			~GameMapSnapshot();
+			
+			/** @return the number of columns copied so far. */
+			int GetNumPreservedColumns();
+			
+			void Save(IStream *);
 		};
 	}
 }
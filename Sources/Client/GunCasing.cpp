@@ -25,7 +25,7 @@
 #include "World.h"
 #include "IAudioDevice.h"
 #include <stdlib.h>
-#include "ParticleSpriteEntity.h"
+#include "ParticlePool.h"
 #include "IAudioChunk.h"
 
 namespace spades {
@@ -120,17 +120,16 @@ namespace spades {
 						Vector3 pt = matrix.GetOrigin();
 						pt.z = 62.99f;
 						for(int i = 0; i < splats; i++){
-							ParticleSpriteEntity *ent =
-							new ParticleSpriteEntity(client, img, col);
-							ent->SetTrajectory(pt,
-											   MakeVector3(GetRandom()-GetRandom(),
-														   GetRandom()-GetRandom(),
-														   -GetRandom()) * 2.f,
-											   1.f, .4f);
-							ent->SetRotation(GetRandom() * (float)M_PI * 2.f);
-							ent->SetRadius(0.1f + GetRandom()*GetRandom()*0.1f);
-							ent->SetLifeTime(2.f, 0.f, 1.f);
-							client->AddLocalEntity(ent);
+							ParticleSprite ent(img, col);
+							ent.SetTrajectory(pt,
+											  MakeVector3(GetRandom()-GetRandom(),
+														  GetRandom()-GetRandom(),
+														  -GetRandom()) * 2.f,
+											  1.f, .4f);
+							ent.SetRotation(GetRandom() * (float)M_PI * 2.f);
+							ent.SetRadius(0.1f + GetRandom()*GetRandom()*0.1f);
+							ent.SetLifeTime(2.f, 0.f, 1.f);
+							client->AddParticle(ent);
 						}
 							
 					}
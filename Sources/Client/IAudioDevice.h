@@ -46,6 +46,10 @@ namespace spades {
 			
 			virtual IAudioChunk *RegisterSound(const char *name) = 0;
 			
+			/** Hints that the sound will be registered soon, so that
+			 * the device can start loading it in background. */
+			virtual void PreloadSound(const char *name) {}
+			
 			virtual void SetGameMap(GameMap *) = 0;
 			
 			virtual void Play(IAudioChunk *, const Vector3& origin, const AudioParam&) = 0;
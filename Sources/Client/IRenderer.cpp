@@ -22,6 +22,13 @@
 
 namespace spades {
 	namespace client{
-	
+		void IRenderer::AddSprites(IImage *const *images, const Vector4 *colors,
+								   const Vector3 *centers, const float *radii,
+								   const float *rotations, size_t count) {
+			for(size_t i = 0; i < count; i++) {
+				SetColorAlphaPremultiplied(colors[i]);
+				AddSprite(images[i], centers[i], radii[i], rotations[i]);
+			}
+		}
 	}
 }
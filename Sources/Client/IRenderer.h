@@ -103,6 +103,12 @@ namespace spades {
 			virtual void AddSprite(IImage *, Vector3 center, float radius, float rotation) = 0;
 			virtual void AddLongSprite(IImage *, Vector3 p1, Vector3 p2, float radius) = 0;
 			
+			/** Adds `count` sprites, each with its own alpha premultiplied
+			 * color. The current color is undefined afterwards. */
+			virtual void AddSprites(IImage *const *images, const Vector4 *colors,
+									const Vector3 *centers, const float *radii,
+									const float *rotations, size_t count);
+			
 			/** Finalizes a scene. 2D drawing follows. */
 			virtual void EndScene() = 0;
 			
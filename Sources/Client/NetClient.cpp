@@ -22,6 +22,8 @@
 #include <vector>
 #include <string.h>
 #include <math.h>
+#include <stdlib.h>
+#include <algorithm>
 
 #include "NetClient.h"
 #include <Core/Debug.h>
@@ -37,13 +39,21 @@
 #include <Core/MemoryStream.h>
 #include "GameMap.h"
 #include "TCGameMode.h"
+#include "Demo.h"
 #include <Core/Settings.h>
 #include <enet/enet.h>
 #include <Core/CP437.h>
 #include <Core/Strings.h>
+#include <Core/Mutex.h>
+#include <Core/AutoLocker.h>
+#include <Core/FileManager.h>
+#include <Core/Stopwatch.h>
+#include <Core/Profiler.h>
+#include <random>
 
 SPADES_SETTING(cg_protocolVersion, "3");
 SPADES_SETTING(cg_unicode, "1");
+SPADES_SETTING(cg_netBenchmarkDemo, "");
 
 namespace spades {
 	namespace client {
@@ -118,31 +128,46 @@ namespace spades {
 			return CP437::Decode(s);
 		}
 		
+		/** Reads a packet in place. Nothing is copied until one of
+		 * the string/vector accessors is called. */
 		class NetPacketReader {
-			std::vector<char> data;
+			ENetPacket *packet;
+			const char *data;
+			size_t size;
 			size_t pos;
 		public:
-			NetPacketReader(ENetPacket *packet){
-				SPADES_MARK_FUNCTION();
-				
-				data.resize(packet->dataLength);
-				memcpy(data.data(), packet->data, packet->dataLength);
-				enet_packet_destroy(packet);
-				pos = 1;
+			/** takes ownership of the packet. */
+			NetPacketReader(ENetPacket *packet):
+			packet(packet),
+			data(reinterpret_cast<const char *>(packet->data)),
+			size(packet->dataLength),
+			pos(1){
+			}
+			
+			/** the vector must outlive the reader. */
+			NetPacketReader(const std::vector<char>& inData):
+			packet(nullptr),
+			data(inData.data()),
+			size(inData.size()),
+			pos(1){
 			}
 			
-			NetPacketReader(const std::vector<char> inData){
-				data = inData;
-				pos = 1;
+			~NetPacketReader() {
+				if(packet)
+					enet_packet_destroy(packet);
 			}
+			
+			NetPacketReader(const NetPacketReader&) = delete;
+			void operator =(const NetPacketReader&) = delete;
+			
 			PacketType GetType() {
 				return (PacketType)data[0];
 			}
 			uint32_t ReadInt() {
-				SPADES_MARK_FUNCTION();
+				SPADES_MARK_FUNCTION_DEBUG();
 				
 				uint32_t value = 0;
-				if(pos + 4 > data.size()){
+				if(pos + 4 > size){
 					SPRaise("Received packet truncated");
 				}
 				value |= ((uint32_t)(uint8_t)data[pos++]);
@@ -152,10 +177,10 @@ namespace spades {
 				return value;
 			}
 			uint16_t ReadShort() {
-				SPADES_MARK_FUNCTION();
+				SPADES_MARK_FUNCTION_DEBUG();
 				
 				uint32_t value = 0;
-				if(pos + 2 > data.size()){
+				if(pos + 2 > size){
 					SPRaise("Received packet truncated");
 				}
 				value |= ((uint32_t)(uint8_t)data[pos++]);
@@ -163,15 +188,15 @@ namespace spades {
 				return (uint16_t)value;
 			}
 			uint8_t ReadByte() {
-				SPADES_MARK_FUNCTION();
+				SPADES_MARK_FUNCTION_DEBUG();
 				
-				if(pos >= data.size()){
+				if(pos >= size){
 					SPRaise("Received packet truncated");
 				}
 				return (uint8_t)data[pos++];
 			}
 			float ReadFloat() {
-				SPADES_MARK_FUNCTION();
+				SPADES_MARK_FUNCTION_DEBUG();
 				union {
 					float f;
 					uint32_t v;
@@ -181,7 +206,7 @@ namespace spades {
 			}
 			
 			IntVector3 ReadIntColor() {
-				SPADES_MARK_FUNCTION();
+				SPADES_MARK_FUNCTION_DEBUG();
 				IntVector3 col;
 				col.z = ReadByte();
 				col.y = ReadByte();
@@ -190,7 +215,7 @@ namespace spades {
 			}
 			
 			Vector3 ReadFloatColor() {
-				SPADES_MARK_FUNCTION();
+				SPADES_MARK_FUNCTION_DEBUG();
 				Vector3 col;
 				col.z = ReadByte() / 255.f;
 				col.y = ReadByte() / 255.f;
@@ -198,21 +223,24 @@ namespace spades {
 				return col;
 			}
 			
+			const char *GetBytes() const { return data; }
+			size_t GetSize() const { return size; }
+			
 			std::vector<char> GetData() {
-				return data;
+				return std::vector<char>(data, data + size);
 			}
 			
 			std::string ReadData(size_t siz) {
-				if(pos + siz > data.size()){
+				if(pos + siz > size){
 					SPRaise("Received packet truncated");
 				}
-				std::string s = std::string(data.data() + pos, siz);
+				std::string s = std::string(data + pos, siz);
 				pos += siz;
 				return s;
 			}
 			std::string ReadRemainingData() {
-				return std::string(data.data() + pos,
-								   data.size() - pos);
+				return std::string(data + pos,
+								   size - pos);
 			}
 			
 			std::string ReadString(size_t siz){
@@ -235,9 +263,9 @@ namespace spades {
 				char buf[1024];
 				std::string str;
 				sprintf(buf, "Packet 0x%02x [len=%d]", (int)GetType(),
-					   (int)data.size());
+					   (int)size);
 				str = buf;
-				int bytes = (int)data.size();
+				int bytes = (int)size;
 				if(bytes > 64){
 					bytes = 64;
 				}
@@ -252,28 +280,150 @@ namespace spades {
 			}
 		};
 		
+		/** Recycles the buffers of outgoing packets. Buffers are handed
+		 * to ENet without copying (ENET_PACKET_FLAG_NO_ALLOCATE) and come
+		 * back here when ENet destroys the packet. */
+		class NetPacketBufferPool {
+		public:
+			struct Buffer {
+				Buffer *next;
+				size_t capacity;
+				char *GetData() { return reinterpret_cast<char *>(this + 1); }
+			};
+			
+		private:
+			enum {
+				// enough for every packet but long chat messages
+				MinCapacityShift = 6,
+				NumSizeClasses = 8
+			};
+			Mutex mutex;
+			Buffer *freeLists[NumSizeClasses];
+			
+			static int GetSizeClass(size_t capacity) {
+				int cls = 0;
+				while(((size_t)1 << (cls + MinCapacityShift)) < capacity)
+					cls++;
+				return cls;
+			}
+			
+			NetPacketBufferPool() {
+				std::fill(freeLists, freeLists + NumSizeClasses, nullptr);
+			}
+			~NetPacketBufferPool() {
+				for(int i = 0; i < NumSizeClasses; i++) {
+					while(freeLists[i]) {
+						Buffer *b = freeLists[i];
+						freeLists[i] = b->next;
+						free(b);
+					}
+				}
+			}
+			
+			static void PacketFreed(ENetPacket *packet) {
+				GetInstance().Release(reinterpret_cast<Buffer *>(packet->data) - 1);
+			}
+			
+		public:
+			static NetPacketBufferPool& GetInstance() {
+				static NetPacketBufferPool pool;
+				return pool;
+			}
+			
+			Buffer *Acquire(size_t minCapacity) {
+				int cls = GetSizeClass(minCapacity);
+				if(cls < NumSizeClasses) {
+					AutoLocker lock(&mutex);
+					if(Buffer *b = freeLists[cls]) {
+						freeLists[cls] = b->next;
+						return b;
+					}
+				}
+				size_t capacity = (size_t)1 << (cls + MinCapacityShift);
+				Buffer *b = reinterpret_cast<Buffer *>(malloc(sizeof(Buffer) + capacity));
+				if(!b)
+					SPRaise("Failed to allocate a packet buffer of %d bytes", (int)capacity);
+				b->next = nullptr;
+				b->capacity = capacity;
+				return b;
+			}
+			
+			void Release(Buffer *b) {
+				int cls = GetSizeClass(b->capacity);
+				if(cls >= NumSizeClasses) {
+					free(b);
+					return;
+				}
+				AutoLocker lock(&mutex);
+				b->next = freeLists[cls];
+				freeLists[cls] = b;
+			}
+			
+			/** creates a packet that returns the buffer to the pool
+			 * when ENet is done with it. */
+			ENetPacket *CreatePacket(Buffer *b, size_t size, int flag) {
+				ENetPacket *packet = enet_packet_create(b->GetData(), size,
+														flag | ENET_PACKET_FLAG_NO_ALLOCATE);
+				if(!packet)
+					SPRaise("Failed to create a packet");
+				packet->freeCallback = PacketFreed;
+				return packet;
+			}
+		};
+		
 		class NetPacketWriter {
-			std::vector<char> data;
+			NetPacketBufferPool::Buffer *buffer;
+			size_t size;
+			
+			void Reserve(size_t bytes) {
+				if(size + bytes <= buffer->capacity)
+					return;
+				auto& pool = NetPacketBufferPool::GetInstance();
+				auto *newBuffer = pool.Acquire(std::max(size + bytes, buffer->capacity * 2));
+				memcpy(newBuffer->GetData(), buffer->GetData(), size);
+				pool.Release(buffer);
+				buffer = newBuffer;
+			}
+			void Push(char c) {
+				Reserve(1);
+				buffer->GetData()[size++] = c;
+			}
+			void Append(const char *bytes, size_t len) {
+				Reserve(len);
+				memcpy(buffer->GetData() + size, bytes, len);
+				size += len;
+			}
 		public:
-			NetPacketWriter(PacketType type){
-				data.push_back(type);
+			NetPacketWriter(PacketType type):
+			buffer(NetPacketBufferPool::GetInstance().Acquire(1)),
+			size(0){
+				Push(type);
+			}
+			~NetPacketWriter() {
+				if(buffer)
+					NetPacketBufferPool::GetInstance().Release(buffer);
 			}
 			
+			NetPacketWriter(const NetPacketWriter&) = delete;
+			void operator =(const NetPacketWriter&) = delete;
+			
 			void Write(uint8_t v){
 				SPADES_MARK_FUNCTION_DEBUG();
-				data.push_back(v);
+				Push(v);
 			}
 			void Write(uint16_t v){
 				SPADES_MARK_FUNCTION_DEBUG();
-				data.push_back((char)(v));
-				data.push_back((char)(v >> 8));
+				Reserve(2);
+				Push((char)(v));
+				Push((char)(v >> 8));
 			}
 			void Write(uint32_t v){
 				SPADES_MARK_FUNCTION_DEBUG();
-				data.push_back((char)(v));
-				data.push_back((char)(v >> 8));
-				data.push_back((char)(v >> 16));
-				data.push_back((char)(v >> 24));
+				Reserve(4);
+				Push((char)(v));
+				Push((char)(v >> 8));
+				Push((char)(v >> 16));
+				Push((char)(v >> 24));
 			}
 			void Write(float v){
 				SPADES_MARK_FUNCTION_DEBUG();
@@ -291,9 +441,7 @@ namespace spades {
 			
 			void Write(std::string str){
 				str = EncodeString(str);
-				data.insert(data.end(),
-							str.begin(),
-							str.end());
+				Append(str.data(), str.size());
 			}
 			
 			void Write(std::string str, size_t fillLen){
@@ -306,10 +454,13 @@ namespace spades {
 				}
 			}
 			
+			/** hands the buffer over to the returned packet; the writer
+			 * cannot be used after this. */
 			ENetPacket *CreatePacket(int flag = ENET_PACKET_FLAG_RELIABLE) {
-				return enet_packet_create(data.data(),
-										  data.size(),
-										  flag);
+				SPAssert(buffer);
+				ENetPacket *packet = NetPacketBufferPool::GetInstance().CreatePacket(buffer, size, flag);
+				buffer = nullptr;
+				return packet;
 			}
 		};
 		
@@ -337,6 +488,7 @@ namespace spades {
 			
 			peer = NULL;
 			status = NetClientStatusNotConnected;
+			demoStartTime = 0.f;
 			
 			lastPlayerInput = 0;
 			lastWeaponInput = 0;
@@ -400,9 +552,49 @@ namespace spades {
 			protocolVersion = cg_protocolVersion;
 		}
 		
+		void NetClient::PlayDemo(IStream *stream) {
+			SPADES_MARK_FUNCTION();
+			
+			Disconnect();
+			SPAssert(status == NetClientStatusNotConnected);
+			
+			demoPlayer.reset(new DemoPlayer(stream));
+			demoStartTime = client->GetTime();
+			
+			cg_protocolVersion = demoPlayer->GetProtocolVersion();
+			protocolVersion = cg_protocolVersion;
+			SPLog("Playing demo recorded with protocol version %d", protocolVersion);
+			
+			savedPackets.clear();
+			
+			// the recording starts right after the connection
+			status = NetClientStatusConnecting;
+			statusString = _Tr("NetClient", "Awaiting for state");
+			timeToTryMapLoad = 0;
+		}
+		
+		bool NetClient::IsDemoFinished() {
+			return demoPlayer && demoPlayer->IsFinished();
+		}
+		
+		void NetClient::StartDemoRecording(IStream *stream) {
+			SPADES_MARK_FUNCTION();
+			SPAssert(!demoPlayer);
+			demoRecorder.reset(new DemoRecorder(stream, protocolVersion));
+		}
+		
 		void NetClient::Disconnect() {
 			SPADES_MARK_FUNCTION();
 			
+			demoRecorder.reset();
+			if(demoPlayer){
+				demoPlayer.reset();
+				status = NetClientStatusNotConnected;
+				statusString = _Tr("NetClient", "Not connected");
+				savedPackets.clear();
+				return;
+			}
+			
 			if(!peer)
 				return;
 			enet_peer_disconnect(peer, 0);
@@ -440,7 +632,7 @@ namespace spades {
 		int NetClient::GetPing() {
 			SPADES_MARK_FUNCTION();
 			
-			if(status == NetClientStatusNotConnected)
+			if(status == NetClientStatusNotConnected || !peer)
 				return -1;
 			
 			auto rtt = peer->roundTripTime;
@@ -450,6 +642,7 @@ namespace spades {
 		
 		void NetClient::DoEvents(int timeout) {
 			SPADES_MARK_FUNCTION();
+			SPADES_PROFILE_ZONE("NetClient::DoEvents");
 			
 			if(status == NetClientStatusNotConnected)
 				return;
@@ -462,136 +655,39 @@ namespace spades {
 			if(bandwidthMonitor)
 				bandwidthMonitor->Update();
 			
-			ENetEvent event;
-			while(enet_host_service(host, &event, timeout) > 0){
-				if(event.type == ENET_EVENT_TYPE_DISCONNECT) {
-					if(GetWorld()){
-						client->SetWorld(NULL);
-					}
-					
-					enet_peer_reset(peer);
-					peer = NULL;
-					status = NetClientStatusNotConnected;
-					
-					SPLog("Disconnected (data = 0x%08x)",
-						  (unsigned int)event.data);
-					statusString = "Disconnected: " + DisconnectReasonString(event.data);
-					SPRaise("Disconnected: %s", DisconnectReasonString(event.data).c_str());
+			if(demoPlayer){
+				// feed the packets that had arrived by now in the recording
+				double demoTime = client->GetTime() - demoStartTime;
+				std::vector<char> data;
+				while(demoPlayer->Poll(demoTime, data)){
+					NetPacketReader reader(data);
+					HandlePacket(reader);
 				}
-				if(status == NetClientStatusConnecting){
-					if(event.type == ENET_EVENT_TYPE_CONNECT){
-						statusString = _Tr("NetClient", "Awaiting for state");
-					}else if(event.type == ENET_EVENT_TYPE_RECEIVE){
-						NetPacketReader reader(event.packet);
-						reader.DumpDebug();
-						if(reader.GetType() != PacketTypeMapStart){
-							SPRaise("Unexpected packet: %d", (int)reader.GetType());
+			}else{
+				ENetEvent event;
+				while(enet_host_service(host, &event, timeout) > 0){
+					if(event.type == ENET_EVENT_TYPE_DISCONNECT) {
+						if(GetWorld()){
+							client->SetWorld(NULL);
 						}
 						
-						mapSize = reader.ReadInt();
-						status = NetClientStatusReceivingMap;
-						statusString = _Tr("NetClient", "Loading snapshot");
-						timeToTryMapLoad = 30;
-						tryMapLoadOnPacketType = true;
-					}
-				}else if(status == NetClientStatusReceivingMap){
-					if(event.type == ENET_EVENT_TYPE_RECEIVE){
-						NetPacketReader reader(event.packet);
+						enet_peer_reset(peer);
+						peer = NULL;
+						status = NetClientStatusNotConnected;
 						
-						if(reader.GetType() == PacketTypeMapChunk){
-							std::vector<char> dt = reader.GetData();
-							dt.erase(dt.begin());
-							mapData.insert(mapData.end(),
-										   dt.begin(), dt.end());
-							
-							timeToTryMapLoad = 200;
-							
-							statusString = _Tr("NetClient", "Loading snapshot ({0}/{1})",
-											   mapData.size(), mapSize);
-							
-							if(mapSize == mapData.size()){
-								status = NetClientStatusConnected;
-								statusString = _Tr("NetClient", "Connected");
-								
-								try{
-									MapLoaded();
-								}catch(const std::exception& ex){
-									if(strstr(ex.what(), "File truncated") ||
-									   strstr(ex.what(), "EOF reached")){
-										SPLog("Map decoder returned error. Maybe we will get more data...:\n%s",
-											  ex.what());
-										// hack: more data to load...
-										status = NetClientStatusReceivingMap;
-										statusString = _Tr("NetClient", "Still loading...");
-									}else{
-										Disconnect();
-										statusString = _Tr("NetClient", "Error");
-										throw;
-									}
-									
-								}catch(...){
-									Disconnect();
-									statusString = _Tr("NetClient", "Error");
-									throw;
-								}
-								
-							}
-							
-						}else{
-							reader.DumpDebug();
-							
-							if(reader.GetType() != PacketTypeWorldUpdate &&
-							   reader.GetType() != PacketTypeExistingPlayer &&
-							   reader.GetType() != PacketTypeCreatePlayer &&
-							   tryMapLoadOnPacketType){
-								status = NetClientStatusConnected;
-								statusString = _Tr("NetClient", "Connected");
-								
-								try{
-									MapLoaded();
-								}catch(const std::exception& ex){
-									tryMapLoadOnPacketType = false;
-									if(strstr(ex.what(), "File truncated") ||
-									   strstr(ex.what(), "EOF reached")){
-										SPLog("Map decoder returned error. Maybe we will get more data...:\n%s",
-											  ex.what());
-										// hack: more data to load...
-										status = NetClientStatusReceivingMap;
-										statusString = _Tr("NetClient", "Still loading...");
-										goto stillLoading;
-									}else{
-										Disconnect();
-										statusString = _Tr("NetClient", "Error");
-										throw;
-									}
-								}catch(...){
-									Disconnect();
-									statusString = _Tr("NetClient", "Error");
-									throw;
-								}
-								Handle(reader);
-							}else{
-							stillLoading:
-								savedPackets.push_back(reader.GetData());
-							}
-							
-							//Handle(reader);
-							
-							
-						}
+						SPLog("Disconnected (data = 0x%08x)",
+							  (unsigned int)event.data);
+						statusString = "Disconnected: " + DisconnectReasonString(event.data);
+						SPRaise("Disconnected: %s", DisconnectReasonString(event.data).c_str());
 					}
-				}else if(status == NetClientStatusConnected){
-					if(event.type == ENET_EVENT_TYPE_RECEIVE){
+					if(event.type == ENET_EVENT_TYPE_CONNECT){
+						if(status == NetClientStatusConnecting)
+							statusString = _Tr("NetClient", "Awaiting for state");
+					}else if(event.type == ENET_EVENT_TYPE_RECEIVE){
 						NetPacketReader reader(event.packet);
-						//reader.DumpDebug();
-						try{
-							Handle(reader);
-						}catch(const std::exception& ex){
-							int type = reader.GetType();
-							reader.DumpDebug();
-							SPRaise("Exception while handling packet type 0x%08x:\n%s",
-									type, ex.what());
-						}
+						if(demoRecorder)
+							demoRecorder->RecordPacket(reader.GetBytes(), reader.GetSize());
+						HandlePacket(reader);
 					}
 				}
 			}
@@ -627,6 +723,114 @@ namespace spades {
 			}
 		}
 		
+		void NetClient::HandlePacket(NetPacketReader& reader) {
+			SPADES_MARK_FUNCTION();
+			
+			if(status == NetClientStatusConnecting){
+				reader.DumpDebug();
+				if(reader.GetType() != PacketTypeMapStart){
+					SPRaise("Unexpected packet: %d", (int)reader.GetType());
+				}
+				
+				mapSize = reader.ReadInt();
+				status = NetClientStatusReceivingMap;
+				statusString = _Tr("NetClient", "Loading snapshot");
+				timeToTryMapLoad = 30;
+				tryMapLoadOnPacketType = true;
+			}else if(status == NetClientStatusReceivingMap){
+				if(reader.GetType() == PacketTypeMapChunk){
+					mapData.insert(mapData.end(),
+								   reader.GetBytes() + 1,
+								   reader.GetBytes() + reader.GetSize());
+					
+					timeToTryMapLoad = 200;
+					
+					statusString = _Tr("NetClient", "Loading snapshot ({0}/{1})",
+									   mapData.size(), mapSize);
+					
+					if(mapSize == mapData.size()){
+						status = NetClientStatusConnected;
+						statusString = _Tr("NetClient", "Connected");
+						
+						try{
+							MapLoaded();
+						}catch(const std::exception& ex){
+							if(strstr(ex.what(), "File truncated") ||
+							   strstr(ex.what(), "EOF reached")){
+								SPLog("Map decoder returned error. Maybe we will get more data...:\n%s",
+									  ex.what());
+								// hack: more data to load...
+								status = NetClientStatusReceivingMap;
+								statusString = _Tr("NetClient", "Still loading...");
+							}else{
+								Disconnect();
+								statusString = _Tr("NetClient", "Error");
+								throw;
+							}
+							
+						}catch(...){
+							Disconnect();
+							statusString = _Tr("NetClient", "Error");
+							throw;
+						}
+						
+					}
+					
+				}else{
+					reader.DumpDebug();
+					
+					if(reader.GetType() != PacketTypeWorldUpdate &&
+					   reader.GetType() != PacketTypeExistingPlayer &&
+					   reader.GetType() != PacketTypeCreatePlayer &&
+					   tryMapLoadOnPacketType){
+						status = NetClientStatusConnected;
+						statusString = _Tr("NetClient", "Connected");
+						
+						try{
+							MapLoaded();
+						}catch(const std::exception& ex){
+							tryMapLoadOnPacketType = false;
+							if(strstr(ex.what(), "File truncated") ||
+							   strstr(ex.what(), "EOF reached")){
+								SPLog("Map decoder returned error. Maybe we will get more data...:\n%s",
+									  ex.what());
+								// hack: more data to load...
+								status = NetClientStatusReceivingMap;
+								statusString = _Tr("NetClient", "Still loading...");
+								goto stillLoading;
+							}else{
+								Disconnect();
+								statusString = _Tr("NetClient", "Error");
+								throw;
+							}
+						}catch(...){
+							Disconnect();
+							statusString = _Tr("NetClient", "Error");
+							throw;
+						}
+						Handle(reader);
+					}else{
+					stillLoading:
+						savedPackets.push_back(reader.GetData());
+					}
+					
+					//Handle(reader);
+					
+					
+				}
+			}else if(status == NetClientStatusConnected){
+				//reader.DumpDebug();
+				try{
+					Handle(reader);
+				}catch(const std::exception& ex){
+					int type = reader.GetType();
+					reader.DumpDebug();
+					SPRaise("Exception while handling packet type 0x%08x:\n%s",
+							type, ex.what());
+				}
+			}
+		}
+		
 		World *NetClient::GetWorld(){
 			return client->GetWorld();
 		}
@@ -712,7 +916,7 @@ namespace spades {
 				{
 					Player *p = GetLocalPlayer();
 					Vector3 pos;
-					if(reader.GetData().size() < 12){
+					if(reader.GetSize() < 12){
 						// sometimes 00 00 00 00 packet is sent.
 						// ignore this now
 						break;
@@ -740,7 +944,7 @@ namespace spades {
 					if((int)cg_protocolVersion == 4)
 						bytesPerEntry++;
 
-					int entries = reader.GetData().size() / bytesPerEntry;
+					int entries = reader.GetSize() / bytesPerEntry;
 					for(int i = 0; i < entries; i++){
 						int idx = i;
 						if((int)cg_protocolVersion == 4)
@@ -1528,6 +1732,15 @@ namespace spades {
 			}
 		}
 		
+		void NetClient::SendPacket(NetPacketWriter& wri) {
+			// there's no server to talk to while playing a demo
+			if(!peer)
+				return;
+			ENetPacket *packet = wri.CreatePacket();
+			if(enet_peer_send(peer, 0, packet) < 0)
+				enet_packet_destroy(packet);
+		}
+		
 		void NetClient::SendJoin(int team, WeaponType weapType, std::string name, int kills){
 			SPADES_MARK_FUNCTION();
 			int weapId;
@@ -1546,7 +1759,7 @@ namespace spades {
 			wri.Write((uint32_t)kills);
 			wri.WriteColor(GetWorld()->GetTeam(team).color);
 			wri.Write(name, 16);
-			enet_peer_send(peer, 0, wri.CreatePacket());
+			SendPacket(wri);
 		}
 		
 		void NetClient::SendPosition(){
@@ -1558,7 +1771,7 @@ namespace spades {
 			wri.Write(v.x);
 			wri.Write(v.y);
 			wri.Write(v.z);
-			enet_peer_send(peer, 0, wri.CreatePacket());
+			SendPacket(wri);
 			//printf("> (%f %f %f)\n", v.x, v.y, v.z);
 		}
 		
@@ -1569,7 +1782,7 @@ namespace spades {
 			wri.Write(v.x);
 			wri.Write(v.y);
 			wri.Write(v.z);
-			enet_peer_send(peer, 0, wri.CreatePacket());
+			SendPacket(wri);
 			//printf("> (%f %f %f)\n", v.x, v.y, v.z);
 		}
 		
@@ -1594,7 +1807,7 @@ namespace spades {
 			wri.Write((uint8_t)GetLocalPlayer()->GetId());
 			wri.Write(bits);
 
-			enet_peer_send(peer, 0, wri.CreatePacket());
+			SendPacket(wri);
 		}
 		
 		void NetClient::SendWeaponInput( WeaponInput inp) {
@@ -1611,7 +1824,7 @@ namespace spades {
 			wri.Write((uint8_t)GetLocalPlayer()->GetId());
 			wri.Write(bits);
 
-			enet_peer_send(peer, 0, wri.CreatePacket());
+			SendPacket(wri);
 		}
 		
 		void NetClient::SendBlockAction(spades::IntVector3 v,
@@ -1632,7 +1845,7 @@ namespace spades {
 			wri.Write((uint32_t)v.y);
 			wri.Write((uint32_t)v.z);
 			
-			enet_peer_send(peer, 0, wri.CreatePacket());
+			SendPacket(wri);
 		}
 		
 		void NetClient::SendBlockLine(spades::IntVector3 v1,
@@ -1648,7 +1861,7 @@ namespace spades {
 			wri.Write((uint32_t)v2.y);
 			wri.Write((uint32_t)v2.z);
 			
-			enet_peer_send(peer, 0, wri.CreatePacket());
+			SendPacket(wri);
 		}
 		
 		void NetClient::SendReload() {
@@ -1662,7 +1875,7 @@ namespace spades {
 			wri.Write((uint8_t)255); // clip_ammo; not used?
 			wri.Write((uint8_t)255); // reserve_ammo; not used?
 			
-			enet_peer_send(peer, 0, wri.CreatePacket());
+			SendPacket(wri);
 		}
 		
 		void NetClient::SendHeldBlockColor() {
@@ -1671,7 +1884,7 @@ namespace spades {
 			wri.Write((uint8_t)GetLocalPlayer()->GetId());
 			IntVector3 v = GetLocalPlayer()->GetBlockColor();
 			wri.WriteColor(v);
-			enet_peer_send(peer, 0, wri.CreatePacket());
+			SendPacket(wri);
 			
 		}
 		
@@ -1692,7 +1905,7 @@ namespace spades {
 					SPInvalidEnum("tool", GetLocalPlayer()->GetTool());
 			}
 			
-			enet_peer_send(peer, 0, wri.CreatePacket());
+			SendPacket(wri);
 		}
 		
 		void NetClient::SendGrenade(spades::client::Grenade *g){
@@ -1711,7 +1924,7 @@ namespace spades {
 			wri.Write(v.x);
 			wri.Write(v.y);
 			wri.Write(v.z);
-			enet_peer_send(peer, 0, wri.CreatePacket());
+			SendPacket(wri);
 		}
 		
 		void NetClient::SendHit(int targetPlayerId, HitType type){
@@ -1738,7 +1951,7 @@ namespace spades {
 				default:
 					SPInvalidEnum("type", type);
 			}
-			enet_peer_send(peer, 0, wri.CreatePacket());
+			SendPacket(wri);
 		}
 		
 		void NetClient::SendChat(std::string text,
@@ -1749,7 +1962,7 @@ namespace spades {
 			wri.Write((uint8_t)(global?0:1));
 			wri.Write(text);
 			wri.Write((uint8_t)0);
-			enet_peer_send(peer, 0, wri.CreatePacket());
+			SendPacket(wri);
 		}
 		
 		void NetClient::SendWeaponChange(WeaponType wt){
@@ -1767,7 +1980,7 @@ namespace spades {
 					wri.Write((uint8_t)2);
 					break;
 			}
-			enet_peer_send(peer, 0, wri.CreatePacket());
+			SendPacket(wri);
 			
 		}
 		
@@ -1776,7 +1989,7 @@ namespace spades {
 			NetPacketWriter wri(PacketTypeChangeTeam);
 			wri.Write((uint8_t)GetLocalPlayer()->GetId());
 			wri.Write((uint8_t)team);
-			enet_peer_send(peer, 0, wri.CreatePacket());
+			SendPacket(wri);
 		}
 
 
@@ -1785,7 +1998,7 @@ namespace spades {
 			NetPacketWriter wri(PacketTypeHandShakeReturn);
 			wri.Write((uint32_t)challenge);
 			SPLog("Sending hand shake back.");
-			enet_peer_send(peer, 0, wri.CreatePacket());
+			SendPacket(wri);
 		}
 
 		void NetClient::SendVersion() {
@@ -1797,7 +2010,7 @@ namespace spades {
 			wri.Write((uint8_t)OpenSpades_VERSION_REVISION);
 			wri.Write(VersionInfo::GetVersionInfo());
 			SPLog("Sending version back.");
-			enet_peer_send(peer, 0, wri.CreatePacket());
+			SendPacket(wri);
 		}
 		
 		void NetClient::MapLoaded() {
@@ -1862,6 +2075,125 @@ namespace spades {
 			}
 		}
 		
-		
+		void NetClient::RunBenchmark() {
+			SPADES_MARK_FUNCTION();
+			
+			const int numRepeats = 20;
+			const int bytesPerEntry = 24;
+			
+			// world updates from a demo if one is given,
+			// otherwise 32 players for 5 minutes at 10 Hz
+			std::vector<std::vector<char>> packets;
+			std::string demoName = cg_netBenchmarkDemo;
+			if(!demoName.empty()) {
+				DemoPlayer demo(FileManager::OpenForReading(demoName.c_str()));
+				std::vector<char> data;
+				while(demo.Poll(1.e+30, data)) {
+					if(!data.empty() && data[0] == PacketTypeWorldUpdate &&
+					   demo.GetProtocolVersion() == 3)
+						packets.push_back(data);
+				}
+			}else{
+				std::mt19937 rnd(12345);
+				std::uniform_real_distribution<float> unit(0.f, 1.f);
+				for(int i = 0; i < 3000; i++) {
+					std::vector<char> data;
+					data.push_back(PacketTypeWorldUpdate);
+					for(int j = 0; j < 32 * 6; j++) {
+						union {
+							float f; uint32_t v;
+						};
+						f = unit(rnd) * 512.f;
+						for(int k = 0; k < 4; k++)
+							data.push_back((char)(v >> (k * 8)));
+					}
+					packets.push_back(data);
+				}
+			}
+			if(packets.empty()) {
+				SPLog("Packet benchmark: no protocol 3 world updates in '%s'",
+					  demoName.c_str());
+				return;
+			}
+			
+			Vector3 pos[32], front[32];
+			auto decode = [&](NetPacketReader& reader) {
+				int entries = std::min<int>(reader.GetSize() / bytesPerEntry, 32);
+				for(int i = 0; i < entries; i++) {
+					pos[i].x = reader.ReadFloat();
+					pos[i].y = reader.ReadFloat();
+					pos[i].z = reader.ReadFloat();
+					front[i].x = reader.ReadFloat();
+					front[i].y = reader.ReadFloat();
+					front[i].z = reader.ReadFloat();
+				}
+			};
+			
+			// packets are created the way ENet hands them to us
+			// on receipt; the copying reader is how NetPacketReader
+			// used to work
+			Stopwatch sw;
+			sw.Reset();
+			for(int r = 0; r < numRepeats; r++) {
+				for(const auto& data: packets) {
+					ENetPacket *packet = enet_packet_create(data.data(), data.size(), 0);
+					std::vector<char> copied(packet->data, packet->data + packet->dataLength);
+					enet_packet_destroy(packet);
+					NetPacketReader reader(copied);
+					decode(reader);
+				}
+			}
+			double copyTime = sw.GetTime();
+			
+			sw.Reset();
+			for(int r = 0; r < numRepeats; r++) {
+				for(const auto& data: packets) {
+					NetPacketReader reader(enet_packet_create(data.data(), data.size(), 0));
+					decode(reader);
+				}
+			}
+			double viewTime = sw.GetTime();
+			
+			int numDecoded = (int)packets.size() * numRepeats;
+			SPLog("Packet benchmark: decoded %d world updates, us/packet: "
+				  "copying reader: %.3f, in-place reader: %.3f (check: %f)",
+				  numDecoded, copyTime * 1.e+6 / numDecoded,
+				  viewTime * 1.e+6 / numDecoded, pos[0].x + front[0].y);
+			
+			// outgoing position updates
+			const int numWrites = 200000;
+			Vector3 v = MakeVector3(256.f, 256.f, 32.f);
+			sw.Reset();
+			for(int i = 0; i < numWrites; i++) {
+				std::vector<char> data;
+				data.push_back(PacketTypePositionData);
+				for(float f: {v.x, v.y, v.z}) {
+					union {
+						float ff; uint32_t u;
+					};
+					ff = f;
+					for(int k = 0; k < 4; k++)
+						data.push_back((char)(u >> (k * 8)));
+				}
+				enet_packet_destroy(enet_packet_create(data.data(), data.size(),
+													   ENET_PACKET_FLAG_RELIABLE));
+			}
+			double allocTime = sw.GetTime();
+			
+			sw.Reset();
+			for(int i = 0; i < numWrites; i++) {
+				NetPacketWriter wri(PacketTypePositionData);
+				wri.Write(v.x);
+				wri.Write(v.y);
+				wri.Write(v.z);
+				enet_packet_destroy(wri.CreatePacket());
+			}
+			double pooledTime = sw.GetTime();
+			
+			SPLog("Packet benchmark: wrote %d position updates, us/packet: "
+				  "allocating writer: %.3f, pooled writer: %.3f",
+				  numWrites, allocTime * 1.e+6 / numWrites,
+				  pooledTime * 1.e+6 / numWrites);
+		}
 	}
 }
@@ -39,6 +39,7 @@ typedef _ENetPeer ENetPeer;
 
 
 namespace spades {
+	class IStream;
 	namespace client {
 		class Client;
 		class Player;
@@ -51,6 +52,9 @@ namespace spades {
 		
 		class World;
 		class NetPacketReader;
+		class NetPacketWriter;
+		class DemoRecorder;
+		class DemoPlayer;
 		struct PlayerInput;
 		struct WeaponInput;
 		class Grenade;
@@ -104,7 +108,13 @@ namespace spades {
 			// used for some scripts including Arena by Yourself
 			IntVector3 temporaryPlayerBlockColor;
 			
+			std::unique_ptr<DemoRecorder> demoRecorder;
+			std::unique_ptr<DemoPlayer> demoPlayer;
+			float demoStartTime;
+			
+			void HandlePacket(NetPacketReader&);
 			void Handle(NetPacketReader&);
+			void SendPacket(NetPacketWriter&);
 			World *GetWorld();
 			Player *GetPlayer(int);
 			Player *GetPlayerOrNull(int);
@@ -129,6 +139,15 @@ namespace spades {
 			void Connect(const ServerAddress& hostname);
 			void Disconnect();
 			
+			/** replays a demo file instead of connecting to a server.
+			 * Takes ownership of the stream. */
+			void PlayDemo(IStream *);
+			bool IsDemoFinished();
+			
+			/** records the packets received from now on.
+			 * Takes ownership of the stream. */
+			void StartDemoRecording(IStream *);
+			
 			int GetPing();
 			
 			void DoEvents(int timeout = 0);
@@ -155,6 +174,10 @@ namespace spades {
 			
 			double GetDownlinkBps() { return bandwidthMonitor->GetDownlinkBps(); }
 			double GetUplinkBps() { return bandwidthMonitor->GetUplinkBps(); }
+			
+			/** times decoding of world updates and encoding of
+			 * position updates, and logs the result. */
+			static void RunBenchmark();
 		};
 	}
 }
@@ -0,0 +1,537 @@
+/*
+ Copyright (c) 2013 yvt
+ 
+ This file is part of OpenSpades.
+ 
+ OpenSpades is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+ 
+ OpenSpades is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with OpenSpades.  If not, see <http://www.gnu.org/licenses/>.
+ 
+ */
+
+
+#include "ParticlePool.h"
+#include "IRenderer.h"
+#include "IImage.h"
+#include "GameMap.h"
+#include <Core/Debug.h>
+#include <Core/Stopwatch.h>
+#include <Core/Profiler.h>
+#include <Draw/SWFeatureLevel.h>
+#include <algorithm>
+#include <random>
+#include <math.h>
+#include <stdio.h>
+
+namespace spades {
+	namespace client {
+		
+#pragma mark - Particle Description
+		
+		ParticleSprite::ParticleSprite(IImage *image, Vector4 color):
+		image(image), color(color) {
+			additive = false;
+			blockHitAction = Delete;
+			sequence = Sequence::None;
+			fps = 0.f;
+			position = MakeVector3(0, 0, 0);
+			velocity = MakeVector3(0, 0, 0);
+			radius = 1.f;
+			radiusVelocity = 0.f;
+			angle = 0.f;
+			rotationVelocity = 0.f;
+			velocityDamp = 1.f;
+			radiusDamp = 1.f;
+			gravityScale = 1.f;
+			lifetime = 1.f;
+			fadeInDuration = .1f;
+			fadeOutDuration = .5f;
+		}
+		
+		void ParticleSprite::SetLifeTime(float lifeTime,
+										 float fadeIn,
+										 float fadeOut){
+			lifetime = lifeTime;
+			fadeInDuration = fadeIn;
+			fadeOutDuration = fadeOut;
+		}
+		
+		void ParticleSprite::SetTrajectory(Vector3 pos,
+										   Vector3 vel,
+										   float damp,
+										   float grav) {
+			position = pos;
+			velocity = vel;
+			velocityDamp = damp;
+			gravityScale = grav;
+		}
+		
+		void ParticleSprite::SetRotation(float initialAngle,
+										 float angleVelocity) {
+			angle = initialAngle;
+			rotationVelocity = angleVelocity;
+		}
+		
+		void ParticleSprite::SetRadius(float initialRadius,
+									   float radiusVelocity,
+									   float damp) {
+			radius = initialRadius;
+			this->radiusVelocity = radiusVelocity;
+			radiusDamp = damp;
+		}
+		
+		SmokeSprite::SmokeSprite(Vector4 color, float fps, Type type):
+		ParticleSprite(NULL, color) {
+			this->fps = fps;
+			sequence = type == Type::Steady ?
+			Sequence::SmokeSteady : Sequence::SmokeExplosion;
+		}
+		
+#pragma mark - Smoke Sequences
+		
+		enum {
+			SteadySequenceLength = 180,
+			ExplosionSequenceLength = 48
+		};
+		
+		static IRenderer *lastRenderer = NULL;
+		static IImage *lastSeq[SteadySequenceLength];
+		static IImage *lastSeq2[ExplosionSequenceLength];
+		
+		// FIXME: add "image manager"?
+		static void LoadSequences(IRenderer *r) {
+			if(r == lastRenderer)
+				return;
+			
+			for(int i = 0; i < SteadySequenceLength; i++){
+				char buf[256];
+				sprintf(buf, "Textures/Smoke1/%03d.png", i);
+				lastSeq[i] = r->RegisterImage(buf);
+			}
+			for(int i = 0; i < ExplosionSequenceLength; i++){
+				char buf[256];
+				sprintf(buf, "Textures/Smoke2/%03d.png", i);
+				lastSeq2[i] = r->RegisterImage(buf);
+			}
+			
+			lastRenderer = r;
+		}
+		
+		void ParticlePool::Preload(IRenderer *r) {
+			LoadSequences(r);
+		}
+		
+#pragma mark - Pool
+		
+		ParticlePool::ParticlePool():
+		numParticles(0), capacity(0) {
+		}
+		
+		ParticlePool::~ParticlePool() {
+			Clear();
+		}
+		
+		void ParticlePool::Reserve(size_t count) {
+			if(count <= capacity)
+				return;
+			
+			// keep the capacity a multiple of 4 so that Integrate
+			// doesn't need a scalar tail loop
+			size_t newCapacity = std::max<size_t>(capacity * 2, 256);
+			while(newCapacity < count)
+				newCapacity *= 2;
+			capacity = newCapacity;
+			
+			for(auto *a: {&posX, &posY, &posZ, &velX, &velY, &velZ,
+				&radius, &radiusVelocity, &angle, &rotationVelocity,
+				&velocityDamp, &radiusDamp, &gravityScale,
+				&time, &lifetime, &fadeIn, &fadeOut, &frame, &fps,
+				&lastX, &lastY, &lastZ})
+				a->resize(capacity, 0.f);
+			for(auto *a: {&additive, &blockHitAction, &sequence})
+				a->resize(capacity, 0);
+			for(auto *a: {&blockX, &blockY, &blockZ})
+				a->resize(capacity, 0);
+			for(auto *a: {&image, &drawImages})
+				a->resize(capacity, nullptr);
+			color.resize(capacity);
+			drawColors.resize(capacity);
+			drawCenters.resize(capacity);
+		}
+		
+		void ParticlePool::Move(size_t dest, size_t src) {
+			for(auto *a: {&posX, &posY, &posZ, &velX, &velY, &velZ,
+				&radius, &radiusVelocity, &angle, &rotationVelocity,
+				&velocityDamp, &radiusDamp, &gravityScale,
+				&time, &lifetime, &fadeIn, &fadeOut, &frame, &fps,
+				&lastX, &lastY, &lastZ})
+				(*a)[dest] = (*a)[src];
+			for(auto *a: {&additive, &blockHitAction, &sequence})
+				(*a)[dest] = (*a)[src];
+			for(auto *a: {&blockX, &blockY, &blockZ})
+				(*a)[dest] = (*a)[src];
+			color[dest] = color[src];
+			image[dest] = image[src];
+		}
+		
+		void ParticlePool::Remove(size_t index) {
+			SPAssert(index < numParticles);
+			if(image[index])
+				image[index]->Release();
+			numParticles--;
+			if(index != numParticles)
+				Move(index, numParticles);
+			image[numParticles] = NULL;
+		}
+		
+		void ParticlePool::Add(const ParticleSprite& p) {
+			Reserve(numParticles + 1);
+			size_t i = numParticles++;
+			
+			posX[i] = p.position.x;
+			posY[i] = p.position.y;
+			posZ[i] = p.position.z;
+			velX[i] = p.velocity.x;
+			velY[i] = p.velocity.y;
+			velZ[i] = p.velocity.z;
+			radius[i] = p.radius;
+			radiusVelocity[i] = p.radiusVelocity;
+			angle[i] = p.angle;
+			rotationVelocity[i] = p.rotationVelocity;
+			velocityDamp[i] = p.velocityDamp;
+			radiusDamp[i] = p.radiusDamp;
+			gravityScale[i] = p.gravityScale;
+			time[i] = 0.f;
+			lifetime[i] = p.lifetime;
+			fadeIn[i] = p.fadeInDuration;
+			fadeOut[i] = p.fadeOutDuration;
+			frame[i] = 0.f;
+			fps[i] = p.fps;
+			color[i] = p.color;
+			additive[i] = p.additive ? 1 : 0;
+			blockHitAction[i] = static_cast<uint8_t>(p.blockHitAction);
+			sequence[i] = static_cast<uint8_t>(p.sequence);
+			
+			image[i] = p.image;
+			if(p.image)
+				p.image->AddRef();
+		}
+		
+		void ParticlePool::Clear() {
+			for(size_t i = 0; i < numParticles; i++) {
+				if(image[i]) {
+					image[i]->Release();
+					image[i] = NULL;
+				}
+			}
+			numParticles = 0;
+		}
+		
+#pragma mark - Simulation
+		
+#if ENABLE_SSE2
+		static inline __m128i FloorToInt(__m128 v) {
+			__m128i t = _mm_cvttps_epi32(v);
+			// truncation rounds negative values up; subtract one
+			// (the comparison mask is -1) where that happened
+			__m128 mask = _mm_cmplt_ps(v, _mm_cvtepi32_ps(t));
+			return _mm_add_epi32(t, _mm_castps_si128(mask));
+		}
+#endif
+		
+		/** moves every particle by one step and computes the block
+		 * each one is in. collision response and removal is done
+		 * by Update afterwards. */
+		void ParticlePool::Integrate(float dt) {
+			SPADES_MARK_FUNCTION_DEBUG();
+			
+			size_t count = (numParticles + 3) & ~(size_t)3;
+			SPAssert(count <= capacity);
+			
+#if ENABLE_SSE2
+			__m128 vdt = _mm_set1_ps(dt);
+			__m128 vgravity = _mm_set1_ps(32.f * dt);
+			for(size_t i = 0; i < count; i += 4) {
+				__m128 x = _mm_loadu_ps(&posX[i]);
+				__m128 y = _mm_loadu_ps(&posY[i]);
+				__m128 z = _mm_loadu_ps(&posZ[i]);
+				__m128 vx = _mm_loadu_ps(&velX[i]);
+				__m128 vy = _mm_loadu_ps(&velY[i]);
+				__m128 vz = _mm_loadu_ps(&velZ[i]);
+				
+				_mm_storeu_ps(&lastX[i], x);
+				_mm_storeu_ps(&lastY[i], y);
+				_mm_storeu_ps(&lastZ[i], z);
+				
+				x = _mm_add_ps(x, _mm_mul_ps(vx, vdt));
+				y = _mm_add_ps(y, _mm_mul_ps(vy, vdt));
+				z = _mm_add_ps(z, _mm_mul_ps(vz, vdt));
+				vz = _mm_add_ps(vz, _mm_mul_ps(vgravity,
+											   _mm_loadu_ps(&gravityScale[i])));
+				
+				_mm_storeu_ps(&posX[i], x);
+				_mm_storeu_ps(&posY[i], y);
+				_mm_storeu_ps(&posZ[i], z);
+				_mm_storeu_ps(&velZ[i], vz);
+				
+				_mm_storeu_si128(reinterpret_cast<__m128i *>(&blockX[i]), FloorToInt(x));
+				_mm_storeu_si128(reinterpret_cast<__m128i *>(&blockY[i]), FloorToInt(y));
+				_mm_storeu_si128(reinterpret_cast<__m128i *>(&blockZ[i]), FloorToInt(z));
+				
+				__m128 v;
+				v = _mm_add_ps(_mm_loadu_ps(&time[i]), vdt);
+				_mm_storeu_ps(&time[i], v);
+				v = _mm_add_ps(_mm_loadu_ps(&frame[i]),
+							   _mm_mul_ps(_mm_loadu_ps(&fps[i]), vdt));
+				_mm_storeu_ps(&frame[i], v);
+				v = _mm_add_ps(_mm_loadu_ps(&radius[i]),
+							   _mm_mul_ps(_mm_loadu_ps(&radiusVelocity[i]), vdt));
+				_mm_storeu_ps(&radius[i], v);
+				v = _mm_add_ps(_mm_loadu_ps(&angle[i]),
+							   _mm_mul_ps(_mm_loadu_ps(&rotationVelocity[i]), vdt));
+				_mm_storeu_ps(&angle[i], v);
+			}
+#else
+			for(size_t i = 0; i < count; i++) {
+				lastX[i] = posX[i];
+				lastY[i] = posY[i];
+				lastZ[i] = posZ[i];
+				posX[i] += velX[i] * dt;
+				posY[i] += velY[i] * dt;
+				posZ[i] += velZ[i] * dt;
+				velZ[i] += 32.f * dt * gravityScale[i];
+				blockX[i] = (int)floorf(posX[i]);
+				blockY[i] = (int)floorf(posY[i]);
+				blockZ[i] = (int)floorf(posZ[i]);
+				time[i] += dt;
+				frame[i] += fps[i] * dt;
+				radius[i] += radiusVelocity[i] * dt;
+				angle[i] += rotationVelocity[i] * dt;
+			}
+#endif
+		}
+		
+		/** same as GameMap::ClipWorld, but inlined. */
+		static inline bool ClipWorld(GameMap *map, int x, int y, int z) {
+			if(x < 0 || x >= map->Width() ||
+			   y < 0 || y >= map->Height() || z < 0)
+				return false;
+			if(z == 63)
+				z = 62;
+			else if(z >= 63)
+				return true;
+			return map->IsSolid(x, y, z);
+		}
+		
+		/** @return false if the particle should be removed. */
+		bool ParticlePool::HitBlock(size_t i, GameMap *map) {
+			if(blockHitAction[i] == ParticleSprite::Ignore)
+				return true;
+			if(!ClipWorld(map, blockX[i], blockY[i], blockZ[i]))
+				return true;
+			if(blockHitAction[i] == ParticleSprite::Delete)
+				return false;
+			
+			IntVector3 lp2 = MakeVector3(lastX[i], lastY[i], lastZ[i]).Floor();
+			IntVector3 lp = {blockX[i], blockY[i], blockZ[i]};
+			if (lp.z != lp2.z && ((lp.x == lp2.x && lp.y == lp2.y) ||
+								  !map->ClipWorld(lp.x, lp.y, lp2.z)))
+				velZ[i] = -velZ[i];
+			else if(lp.x != lp2.x && ((lp.y == lp2.y && lp.z == lp2.z) ||
+									  !map->ClipWorld(lp2.x, lp.y, lp.z)))
+				velX[i] = -velX[i];
+			else if(lp.y != lp2.y && ((lp.x == lp2.x && lp.z == lp2.z) ||
+									  !map->ClipWorld(lp.x, lp2.y, lp.z)))
+				velY[i] = -velY[i];
+			velX[i] *= .36f;
+			velY[i] *= .36f;
+			velZ[i] *= .36f;
+			posX[i] = lastX[i];
+			posY[i] = lastY[i];
+			posZ[i] = lastZ[i];
+			return true;
+		}
+		
+		void ParticlePool::Update(float dt, GameMap *map) {
+			SPADES_MARK_FUNCTION();
+			SPADES_PROFILE_ZONE("ParticlePool::Update");
+			
+			Integrate(dt);
+			
+			size_t i = 0;
+			while(i < numParticles) {
+				bool alive = time[i] <= lifetime[i];
+				
+				switch(static_cast<ParticleSprite::Sequence>(sequence[i])) {
+					case ParticleSprite::Sequence::None:
+						break;
+					case ParticleSprite::Sequence::SmokeSteady:
+						frame[i] = fmodf(frame[i], (float)SteadySequenceLength);
+						break;
+					case ParticleSprite::Sequence::SmokeExplosion:
+						if(frame[i] > (float)(ExplosionSequenceLength - 1))
+							alive = false;
+						break;
+				}
+				
+				if(alive && map)
+					alive = HitBlock(i, map);
+				
+				if(!alive) {
+					// the last particle is moved here; process it next
+					Remove(i);
+					continue;
+				}
+				
+				if(velocityDamp[i] != 1.f) {
+					float damp = powf(velocityDamp[i], dt);
+					velX[i] *= damp;
+					velY[i] *= damp;
+					velZ[i] *= damp;
+				}
+				if(radiusDamp[i] != 1.f)
+					radiusVelocity[i] *= powf(radiusDamp[i], dt);
+				
+				i++;
+			}
+		}
+		
+#pragma mark - Rendering
+		
+		void ParticlePool::Render(IRenderer *renderer) {
+			SPADES_MARK_FUNCTION();
+			
+			if(numParticles == 0)
+				return;
+			
+			LoadSequences(renderer);
+			
+			for(size_t i = 0; i < numParticles; i++) {
+				float t = time[i];
+				float fade = 1.f;
+				if(t < fadeIn[i]){
+					fade *= t / fadeIn[i];
+				}
+				if(t > lifetime[i] - fadeOut[i]){
+					fade *= (lifetime[i] - t) / fadeOut[i];
+				}
+				
+				Vector4 col = color[i];
+				col.w *= fade;
+				
+				// premultiplied alpha!
+				col.x *= col.w;
+				col.y *= col.w;
+				col.z *= col.w;
+				
+				if(additive[i])
+					col.w = 0.f;
+				
+				IImage *img;
+				int f = (int)frame[i];
+				switch(static_cast<ParticleSprite::Sequence>(sequence[i])) {
+					case ParticleSprite::Sequence::SmokeSteady:
+						img = lastSeq[std::max(std::min(f, SteadySequenceLength - 1), 0)];
+						break;
+					case ParticleSprite::Sequence::SmokeExplosion:
+						img = lastSeq2[std::max(std::min(f, ExplosionSequenceLength - 1), 0)];
+						break;
+					default:
+						img = image[i];
+						break;
+				}
+				
+				drawImages[i] = img;
+				drawColors[i] = col;
+				drawCenters[i] = MakeVector3(posX[i], posY[i], posZ[i]);
+			}
+			
+			renderer->AddSprites(drawImages.data(), drawColors.data(),
+								 drawCenters.data(), radius.data(),
+								 angle.data(), numParticles);
+		}
+		
+#pragma mark - Benchmark
+		
+		void ParticlePool::RunBenchmark() {
+			SPADES_MARK_FUNCTION();
+			
+			const int numParticles = 100000;
+			const int numSteps = 300;
+			const float dt = 1.f / 60.f;
+			
+			std::mt19937 rnd(12345);
+			std::uniform_real_distribution<float> unit(0.f, 1.f);
+			
+			// a floor for the fragments to bounce on
+			Handle<GameMap> map(new GameMap(), false);
+			for(int x = 192; x < 320; x++)
+				for(int y = 192; y < 320; y++)
+					for(int z = 50; z < 64; z++)
+						map->Set(x, y, z, true, 0);
+			
+			ParticlePool pool;
+			for(int i = 0; i < numParticles; i++) {
+				Vector3 pos = MakeVector3(200.f + unit(rnd) * 112.f,
+										  200.f + unit(rnd) * 112.f,
+										  30.f + unit(rnd) * 15.f);
+				Vector3 vel = MakeVector3(unit(rnd) - unit(rnd),
+										  unit(rnd) - unit(rnd),
+										  unit(rnd) - unit(rnd)) * 10.f;
+				switch(i & 3) {
+					case 0:
+					case 1:{
+						ParticleSprite p(NULL, MakeVector4(1, 1, 1, 1));
+						p.SetTrajectory(pos, vel, .9f, 1.f);
+						p.SetRadius(.2f);
+						p.SetLifeTime(60.f, 0.f, 1.f);
+						p.SetBlockHitAction(ParticleSprite::BounceWeak);
+						pool.Add(p);
+						break;
+					}
+					case 2:{
+						ParticleSprite p(NULL, MakeVector4(1, 1, 1, 1));
+						p.SetTrajectory(pos, vel, 1.f, 1.f);
+						p.SetRadius(.1f);
+						p.SetLifeTime(60.f, 0.f, 1.f);
+						pool.Add(p);
+						break;
+					}
+					default:{
+						SmokeSprite p(MakeVector4(1, 1, 1, .5f), 20.f);
+						p.SetTrajectory(pos, vel * .1f, 1.f, 0.f);
+						p.SetRadius(1.f, .2f);
+						p.SetLifeTime(60.f, .1f, 8.f);
+						p.SetBlockHitAction(ParticleSprite::Ignore);
+						pool.Add(p);
+						break;
+					}
+				}
+			}
+			
+			size_t numUpdated = 0;
+			Stopwatch sw;
+			sw.Reset();
+			for(int i = 0; i < numSteps; i++) {
+				numUpdated += pool.GetNumParticles();
+				pool.Update(dt, map);
+			}
+			double elapsed = sw.GetTime();
+			
+			SPLog("Particle benchmark: %d particles, %d steps, %d alive at end",
+				  numParticles, numSteps, (int)pool.GetNumParticles());
+			SPLog("Particle benchmark: %.2f ms, %.0f particles/ms",
+				  elapsed * 1000.,
+				  (double)numUpdated / (elapsed * 1000.));
+		}
+	}
+}
@@ -0,0 +1,170 @@
+/*
+ Copyright (c) 2013 yvt
+ 
+ This file is part of OpenSpades.
+ 
+ OpenSpades is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+ 
+ OpenSpades is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with OpenSpades.  If not, see <http://www.gnu.org/licenses/>.
+ 
+ */
+
+
+#pragma once
+
+#include <Core/Math.h>
+#include <vector>
+#include <stdint.h>
+
+namespace spades {
+	namespace client {
+		class IImage;
+		class IRenderer;
+		class GameMap;
+		
+		/** Describes a single sprite particle to be spawned by
+		 * `ParticlePool::Add`. */
+		class ParticleSprite {
+			friend class ParticlePool;
+		public:
+			enum BlockHitAction {
+				Delete,
+				Ignore,
+				BounceWeak
+			};
+		protected:
+			enum class Sequence: uint8_t {
+				None,
+				SmokeSteady,
+				SmokeExplosion
+			};
+			
+			IImage *image;
+			Vector4 color;
+			bool additive;
+			BlockHitAction blockHitAction;
+			Sequence sequence;
+			float fps;
+			
+			Vector3 position, velocity; // unit/sec
+			float radius, radiusVelocity; // unit/sec
+			float angle, rotationVelocity; // radian/sec
+			
+			float velocityDamp;
+			float radiusDamp;
+			float gravityScale;
+			
+			float lifetime;
+			float fadeInDuration;
+			float fadeOutDuration;
+		public:
+			ParticleSprite(IImage *image, Vector4 color);
+			
+			void SetAdditive(bool b){additive = b;}
+			
+			void SetLifeTime(float lifeTime,
+							 float fadeIn,
+							 float fadeOut);
+			
+			void SetTrajectory(Vector3 initialPosition,
+							   Vector3 initialVelocity,
+							   float velocityDamp = 1.f,
+							   float gravityScale = 1.f);
+			
+			void SetRotation(float initialAngle,
+							 float angleVelocity = 0.f);
+			
+			void SetRadius(float initialRadius,
+						   float radiusVelocity = 0.f,
+						   float radiusDamp = 1.f);
+			
+			void SetBlockHitAction(BlockHitAction act){
+				blockHitAction = act;
+			}
+		};
+		
+		/** Particle whose image is animated with one of the
+		 * smoke image sequences. */
+		class SmokeSprite: public ParticleSprite {
+		public:
+			enum class Type {
+				Steady,
+				Explosion
+			};
+			
+			SmokeSprite(Vector4 color, float fps,
+						Type type = Type::Steady);
+		};
+		
+		/** Simulates and draws sprite particles.
+		 * Particles are stored as a structure of arrays so that the
+		 * integration can be done four particles at a time, and dead
+		 * particles are removed by moving the last one into their slot.
+		 * All sprites are submitted to the renderer by a single
+		 * `IRenderer::AddSprites` call. */
+		class ParticlePool {
+			size_t numParticles;
+			size_t capacity;
+			
+			std::vector<float> posX, posY, posZ;
+			std::vector<float> velX, velY, velZ;
+			std::vector<float> radius, radiusVelocity;
+			std::vector<float> angle, rotationVelocity;
+			std::vector<float> velocityDamp, radiusDamp;
+			std::vector<float> gravityScale;
+			std::vector<float> time, lifetime;
+			std::vector<float> fadeIn, fadeOut;
+			std::vector<float> frame, fps;
+			std::vector<Vector4> color;
+			std::vector<IImage *> image;
+			std::vector<uint8_t> additive;
+			std::vector<uint8_t> blockHitAction;
+			std::vector<uint8_t> sequence;
+			
+			// scratch arrays, valid during Update
+			std::vector<float> lastX, lastY, lastZ;
+			std::vector<int> blockX, blockY, blockZ;
+			
+			// scratch arrays, valid during Render
+			std::vector<IImage *> drawImages;
+			std::vector<Vector4> drawColors;
+			std::vector<Vector3> drawCenters;
+			
+			void Reserve(size_t);
+			void Move(size_t dest, size_t src);
+			void Remove(size_t);
+			
+			void Integrate(float dt);
+			bool HitBlock(size_t, GameMap *);
+		public:
+			ParticlePool();
+			~ParticlePool();
+			
+			/** loads the image sequences used by smoke particles. */
+			static void Preload(IRenderer *);
+			
+			void Add(const ParticleSprite&);
+			void Clear();
+			
+			size_t GetNumParticles() const { return numParticles; }
+			
+			/** advances all particles by `dt` seconds.
+			 * @param map used for block collision. can be null. */
+			void Update(float dt, GameMap *map);
+			
+			void Render(IRenderer *);
+			
+			/** measures the update throughput and reports it to the log. */
+			static void RunBenchmark();
+		};
+	}
+}
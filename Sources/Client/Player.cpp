@@ -31,6 +31,7 @@
 #include "../Core/Debug.h"
 #include "../Core/Settings.h"
 #include "HitTestDebugger.h"
+#include "PlayerBVH.h"
 
 namespace spades {
 	namespace client {
@@ -542,14 +543,6 @@ namespace spades {
 			return dist < 8.f;
 		}
 		
-		enum class HitBodyPart {
-			None,
-			Head,
-			Torso,
-			Limb1, Limb2,
-			Arms
-		};
-		
 		void Player::FireWeapon() {
 			SPADES_MARK_FUNCTION();
 			
@@ -571,6 +564,9 @@ namespace spades {
 			// speed hack (shotgun does this)
 			bool blockDestroyed = false;
 			
+			// hitboxes are computed once for all pellets
+			PlayerRayQuery playerQuery(world, this);
+			
 			Vector3 dir2 = GetFront();
 			for(int i =0 ; i < pellets; i++){
 				
@@ -588,58 +584,10 @@ namespace spades {
 										  dir,
 										  500);
 				
-				Player *hitPlayer = NULL;
-				float hitPlayerDistance = 0.f;
-				HitBodyPart hitPart = HitBodyPart::None;
-				
-				for(int i = 0; i < world->GetNumPlayerSlots(); i++){
-					Player *other = world->GetPlayer(i);
-					if(other == this || other == NULL)
-						continue;
-					if(other == this || !other->IsAlive() ||
-					   other->GetTeamId() >= 2)
-						continue;
-					// quickly reject players unlikely to be hit
-					if(!other->RayCastApprox(muzzle, dir))
-						continue;
-					
-					HitBoxes hb = other->GetHitBoxes();
-					Vector3 hitPos;
-					
-					if(hb.head.RayCast(muzzle, dir, &hitPos)) {
-						float dist = (hitPos - muzzle).GetLength();
-						if(hitPlayer == NULL ||
-						   dist < hitPlayerDistance){
-							hitPlayer = other;
-							hitPlayerDistance = dist;
-							hitPart = HitBodyPart::Head;
-						}
-					}
-					if(hb.torso.RayCast(muzzle, dir, &hitPos)) {
-						float dist = (hitPos - muzzle).GetLength();
-						if(hitPlayer == NULL ||
-						   dist < hitPlayerDistance){
-							hitPlayer = other;
-							hitPlayerDistance = dist;
-							hitPart = HitBodyPart::Torso;
-						}
-					}
-					for(int j = 0; j < 3 ;j++){
-						if(hb.limbs[j].RayCast(muzzle, dir, &hitPos)) {
-							float dist = (hitPos - muzzle).GetLength();
-							if(hitPlayer == NULL ||
-							   dist < hitPlayerDistance){
-								hitPlayer = other;
-								hitPlayerDistance = dist;
-								switch(j) {
-									case 0: hitPart = HitBodyPart::Limb1; break;
-									case 1: hitPart = HitBodyPart::Limb2; break;
-									case 2: hitPart = HitBodyPart::Arms;  break;
-								}
-							}
-						}
-					}
-				}
+				PlayerRayCastResult playerResult = playerQuery.Cast(muzzle, dir);
+				Player *hitPlayer = playerResult.player;
+				float hitPlayerDistance = playerResult.distance;
+				HitBodyPart hitPart = playerResult.hitPart;
 				
 				Vector3 finalHitPos;
 				finalHitPos = muzzle + dir * 128.f;
@@ -0,0 +1,391 @@
+/*
+ Copyright (c) 2013 yvt
+ 
+ This file is part of OpenSpades.
+ 
+ OpenSpades is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+ 
+ OpenSpades is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with OpenSpades.  If not, see <http://www.gnu.org/licenses/>.
+ 
+ */
+
+
+#include "PlayerBVH.h"
+#include "World.h"
+#include "Weapon.h"
+#include <Core/Debug.h>
+#include <Core/Stopwatch.h>
+#include <algorithm>
+#include <random>
+#include <float.h>
+
+namespace spades {
+	namespace client {
+		
+		const float PlayerBVH::HitBoxRadius = 4.f;
+		const float PlayerBVH::RefitThreshold = .5f;
+		
+		PlayerBVH::PlayerBVH():
+		root(-1),
+		numRebuilds(0),
+		numRefits(0) {
+		}
+		
+		AABB3 PlayerBVH::GetLeafBounds(const spades::Vector3 &position) {
+			float r = HitBoxRadius + RefitThreshold;
+			return AABB3(position - MakeVector3(r, r, r),
+						 position + MakeVector3(r, r, r));
+		}
+		
+		static AABB3 Union(const AABB3& a, const AABB3& b) {
+			return AABB3(MakeVector3(std::min(a.min.x, b.min.x),
+									 std::min(a.min.y, b.min.y),
+									 std::min(a.min.z, b.min.z)),
+						 MakeVector3(std::max(a.max.x, b.max.x),
+									 std::max(a.max.y, b.max.y),
+									 std::max(a.max.z, b.max.z)));
+		}
+		
+		int PlayerBVH::BuildNode(int *slots, int count) {
+			SPAssert(count > 0);
+			
+			int index = (int)nodes.size();
+			nodes.push_back(Node());
+			
+			if(count == 1) {
+				Node& node = nodes[index];
+				node.slot = slots[0];
+				node.children[0] = node.children[1] = -1;
+				node.bounds = GetLeafBounds(leaves[slots[0]].position);
+				leafNodes[slots[0]] = index;
+				return index;
+			}
+			
+			// split at the median along the longest axis
+			Vector3 cmin = leaves[slots[0]].position, cmax = cmin;
+			for(int i = 1; i < count; i++) {
+				const Vector3& p = leaves[slots[i]].position;
+				cmin = MakeVector3(std::min(cmin.x, p.x), std::min(cmin.y, p.y), std::min(cmin.z, p.z));
+				cmax = MakeVector3(std::max(cmax.x, p.x), std::max(cmax.y, p.y), std::max(cmax.z, p.z));
+			}
+			Vector3 ext = cmax - cmin;
+			int axis = ext.x >= ext.y ? (ext.x >= ext.z ? 0 : 2) : (ext.y >= ext.z ? 1 : 2);
+			auto key = [&](int slot) {
+				const Vector3& p = leaves[slot].position;
+				return axis == 0 ? p.x : axis == 1 ? p.y : p.z;
+			};
+			int half = count / 2;
+			std::nth_element(slots, slots + half, slots + count,
+							 [&](int a, int b) { return key(a) < key(b); });
+			
+			int left = BuildNode(slots, half);
+			int right = BuildNode(slots + half, count - half);
+			Node& node = nodes[index];
+			node.slot = -1;
+			node.children[0] = left;
+			node.children[1] = right;
+			node.bounds = Union(nodes[left].bounds, nodes[right].bounds);
+			return index;
+		}
+		
+		void PlayerBVH::RefitNode(int index) {
+			Node& node = nodes[index];
+			if(node.slot >= 0) {
+				node.bounds = GetLeafBounds(leaves[node.slot].position);
+				return;
+			}
+			RefitNode(node.children[0]);
+			RefitNode(node.children[1]);
+			node.bounds = Union(nodes[node.children[0]].bounds,
+								nodes[node.children[1]].bounds);
+		}
+		
+		void PlayerBVH::Rebuild(World *world) {
+			SPADES_MARK_FUNCTION_DEBUG();
+			
+			size_t numSlots = world->GetNumPlayerSlots();
+			leaves.resize(numSlots);
+			leafNodes.assign(numSlots, -1);
+			nodes.clear();
+			
+			std::vector<int> slots;
+			for(size_t i = 0; i < numSlots; i++) {
+				Player *p = world->GetPlayer((unsigned int)i);
+				leaves[i].player = p;
+				if(p) {
+					leaves[i].position = p->GetPosition();
+					slots.push_back((int)i);
+				}
+			}
+			
+			root = slots.empty() ? -1 : BuildNode(slots.data(), (int)slots.size());
+			numRebuilds++;
+		}
+		
+		void PlayerBVH::Update(World *world) {
+			SPADES_MARK_FUNCTION_DEBUG();
+			
+			size_t numSlots = world->GetNumPlayerSlots();
+			if(leaves.size() != numSlots) {
+				Rebuild(world);
+				return;
+			}
+			
+			bool moved = false;
+			for(size_t i = 0; i < numSlots; i++) {
+				Player *p = world->GetPlayer((unsigned int)i);
+				Leaf& leaf = leaves[i];
+				if(p != leaf.player) {
+					Rebuild(world);
+					return;
+				}
+				if(p == nullptr)
+					continue;
+				
+				Vector3 pos = p->GetPosition();
+				Vector3 diff = pos - leaf.position;
+				if(fabsf(diff.x) > RefitThreshold ||
+				   fabsf(diff.y) > RefitThreshold ||
+				   fabsf(diff.z) > RefitThreshold) {
+					leaf.position = pos;
+					moved = true;
+				}
+			}
+			
+			if(moved) {
+				RefitNode(root);
+				numRefits++;
+			}
+		}
+		
+		/** conservative ray-box test for t >= 0. */
+		static bool RayHitsBox(const AABB3& box, const Vector3& start,
+							   const Vector3& dir) {
+			float tmin = 0.f, tmax = FLT_MAX;
+			const float s[] = {start.x, start.y, start.z};
+			const float d[] = {dir.x, dir.y, dir.z};
+			const float bmin[] = {box.min.x, box.min.y, box.min.z};
+			const float bmax[] = {box.max.x, box.max.y, box.max.z};
+			for(int i = 0; i < 3; i++) {
+				if(d[i] == 0.f) {
+					if(s[i] < bmin[i] || s[i] > bmax[i])
+						return false;
+					continue;
+				}
+				float inv = 1.f / d[i];
+				float t1 = (bmin[i] - s[i]) * inv;
+				float t2 = (bmax[i] - s[i]) * inv;
+				if(t1 > t2) std::swap(t1, t2);
+				tmin = std::max(tmin, t1);
+				tmax = std::min(tmax, t2);
+				if(tmin > tmax)
+					return false;
+			}
+			return true;
+		}
+		
+		void PlayerBVH::QueryRay(spades::Vector3 start, spades::Vector3 dir,
+								 std::vector<int> &slots) const {
+			if(root < 0)
+				return;
+			
+			size_t first = slots.size();
+			int stack[MaxDepth];
+			int sp = 0;
+			stack[sp++] = root;
+			while(sp > 0) {
+				const Node& node = nodes[stack[--sp]];
+				if(!RayHitsBox(node.bounds, start, dir))
+					continue;
+				if(node.slot >= 0) {
+					slots.push_back(node.slot);
+				}else{
+					SPAssert(sp + 2 <= MaxDepth);
+					stack[sp++] = node.children[1];
+					stack[sp++] = node.children[0];
+				}
+			}
+			std::sort(slots.begin() + first, slots.end());
+		}
+		
+#pragma mark - Query
+		
+		PlayerRayQuery::PlayerRayQuery(World *world, Player *exclude,
+									   bool useBVH):
+		world(world),
+		exclude(exclude),
+		bvh(useBVH ? world->GetPlayerBVH() : nullptr),
+		hitBoxes(world->GetNumPlayerSlots()),
+		hitBoxesValid(world->GetNumPlayerSlots(), false) {
+		}
+		
+		PlayerRayCastResult PlayerRayQuery::Cast(spades::Vector3 start,
+												 spades::Vector3 dir) {
+			PlayerRayCastResult result;
+			Cast(start, &dir, 1, &result);
+			return result;
+		}
+		
+		void PlayerRayQuery::Cast(spades::Vector3 start,
+								  const spades::Vector3 *dirs,
+								  size_t numRays,
+								  spades::client::PlayerRayCastResult *results) {
+			SPADES_MARK_FUNCTION_DEBUG();
+			
+			for(size_t i = 0; i < numRays; i++) {
+				PlayerRayCastResult& result = results[i];
+				result.player = nullptr;
+				result.distance = 0.f;
+				result.hitFlag = hit_None;
+				result.hitPart = HitBodyPart::None;
+				
+				candidates.clear();
+				if(bvh) {
+					bvh->QueryRay(start, dirs[i], candidates);
+				}else{
+					for(size_t j = 0; j < hitBoxes.size(); j++)
+						candidates.push_back((int)j);
+				}
+				
+				// players are tested in the slot order so that the ties
+				// are resolved in the same way regardless of the BVH
+				for(int slot: candidates)
+					TestPlayer(slot, start, dirs[i], result);
+			}
+		}
+		
+		void PlayerRayQuery::TestPlayer(int slot, spades::Vector3 start,
+										spades::Vector3 dir,
+										PlayerRayCastResult &result) {
+			Player *p = world->GetPlayer((unsigned int)slot);
+			if(p == NULL || p == exclude)
+				return;
+			if(p->GetTeamId() >= 2 || !p->IsAlive())
+				return;
+			// quickly reject players unlikely to be hit
+			if(!p->RayCastApprox(start, dir))
+				return;
+			
+			if(!hitBoxesValid[slot]) {
+				hitBoxes[slot] = p->GetHitBoxes();
+				hitBoxesValid[slot] = true;
+			}
+			Player::HitBoxes& hb = hitBoxes[slot];
+			Vector3 hitPos;
+			
+			auto hit = [&](hitTag_t flag, HitBodyPart part) {
+				float dist = (hitPos - start).GetLength();
+				if(result.player == NULL ||
+				   dist < result.distance){
+					if(result.player != p){
+						result.player = p;
+						result.hitFlag = hit_None;
+					}
+					result.distance = dist;
+					result.hitFlag |= flag;
+					result.hitPart = part;
+				}
+			};
+			
+			if(hb.head.RayCast(start, dir, &hitPos))
+				hit(hit_Head, HitBodyPart::Head);
+			if(hb.torso.RayCast(start, dir, &hitPos))
+				hit(hit_Torso, HitBodyPart::Torso);
+			if(hb.limbs[0].RayCast(start, dir, &hitPos))
+				hit(hit_Legs, HitBodyPart::Limb1);
+			if(hb.limbs[1].RayCast(start, dir, &hitPos))
+				hit(hit_Legs, HitBodyPart::Limb2);
+			if(hb.limbs[2].RayCast(start, dir, &hitPos))
+				hit(hit_Arms, HitBodyPart::Arms);
+		}
+		
+#pragma mark - Benchmark
+		
+		void PlayerRayQuery::RunBenchmark() {
+			SPADES_MARK_FUNCTION();
+			
+			const int numShots = 20000;
+			const int numPellets = 8;
+			
+			std::mt19937 rnd(12345);
+			std::uniform_real_distribution<float> unit(0.f, 1.f);
+			
+			World world;
+			int numSlots = (int)world.GetNumPlayerSlots();
+			for(int i = 0; i < numSlots; i++) {
+				Vector3 pos = MakeVector3(200.f + unit(rnd) * 100.f,
+										  200.f + unit(rnd) * 100.f,
+										  40.f + unit(rnd) * 10.f);
+				Player *p = new Player(&world, i, SHOTGUN_WEAPON, i & 1, pos,
+									   IntVector3::Make(255, 255, 255));
+				p->SetPosition(pos);
+				float yaw = unit(rnd) * 6.2831853f;
+				p->SetOrientation(MakeVector3(cosf(yaw), sinf(yaw), unit(rnd) - .5f).Normalize());
+				world.SetPlayer(i, p);
+			}
+			
+			// pellets are aimed roughly at random players
+			std::vector<Vector3> starts(numShots);
+			std::vector<int> shooters(numShots);
+			std::vector<Vector3> dirs(numShots * numPellets);
+			for(int i = 0; i < numShots; i++) {
+				int shooter = (int)(unit(rnd) * numSlots) % numSlots;
+				int target = (int)(unit(rnd) * numSlots) % numSlots;
+				Player *s = world.GetPlayer(shooter);
+				Player *t = world.GetPlayer(target);
+				shooters[i] = shooter;
+				starts[i] = s->GetEye();
+				Vector3 aim = (t->GetOrigin() - starts[i]).Normalize();
+				for(int j = 0; j < numPellets; j++) {
+					Vector3 d = aim;
+					d.x += (unit(rnd) - unit(rnd)) * .05f;
+					d.y += (unit(rnd) - unit(rnd)) * .05f;
+					d.z += (unit(rnd) - unit(rnd)) * .05f;
+					dirs[i * numPellets + j] = d.Normalize();
+				}
+			}
+			
+			std::vector<PlayerRayCastResult> linearResults(dirs.size());
+			std::vector<PlayerRayCastResult> bvhResults(dirs.size());
+			Stopwatch sw;
+			
+			sw.Reset();
+			for(int i = 0; i < numShots; i++) {
+				PlayerRayQuery query(&world, world.GetPlayer(shooters[i]), false);
+				query.Cast(starts[i], &dirs[i * numPellets], numPellets,
+						   &linearResults[i * numPellets]);
+			}
+			double linearTime = sw.GetTime();
+			
+			sw.Reset();
+			for(int i = 0; i < numShots; i++) {
+				PlayerRayQuery query(&world, world.GetPlayer(shooters[i]), true);
+				query.Cast(starts[i], &dirs[i * numPellets], numPellets,
+						   &bvhResults[i * numPellets]);
+			}
+			double bvhTime = sw.GetTime();
+			
+			int numHits = 0, numMismatches = 0;
+			for(size_t i = 0; i < dirs.size(); i++) {
+				if(linearResults[i].player)
+					numHits++;
+				if(!(linearResults[i] == bvhResults[i]))
+					numMismatches++;
+			}
+			
+			SPLog("Player hit test benchmark (%d players, %d shots x %d pellets, %d hits): "
+				  "linear %.3f ms, BVH %.3f ms, %d mismatch(es)",
+				  numSlots, numShots, numPellets, numHits,
+				  linearTime * 1000., bvhTime * 1000., numMismatches);
+		}
+	}
+}
@@ -0,0 +1,140 @@
+/*
+ Copyright (c) 2013 yvt
+ 
+ This file is part of OpenSpades.
+ 
+ OpenSpades is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+ 
+ OpenSpades is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with OpenSpades.  If not, see <http://www.gnu.org/licenses/>.
+ 
+ */
+
+
+#pragma once
+
+#include <Core/Math.h>
+#include <vector>
+#include "Player.h"
+
+namespace spades {
+	namespace client {
+		class World;
+		
+		/** Bounding volume hierarchy over player slots, used to find
+		 * players which a ray might hit.
+		 * Leaf bounds are derived from each player's position with a
+		 * margin large enough to contain all hitboxes, so a player has
+		 * to move by more than `RefitThreshold` before its leaf needs
+		 * to be refit. */
+		class PlayerBVH {
+			struct Node {
+				AABB3 bounds;
+				int children[2];
+				int slot; // >= 0 for leaves
+			};
+			struct Leaf {
+				Player *player;
+				Vector3 position;
+			};
+			
+			std::vector<Leaf> leaves;
+			std::vector<Node> nodes;
+			std::vector<int> leafNodes; // slot -> node
+			int root;
+			
+			int numRebuilds;
+			int numRefits;
+			
+			static AABB3 GetLeafBounds(const Vector3& position);
+			int BuildNode(int *slots, int count);
+			void RefitNode(int node);
+		public:
+			enum {
+				MaxDepth = 64
+			};
+			
+			/** maximum distance between a player's position and any
+			 * point in its hitboxes. */
+			static const float HitBoxRadius;
+			static const float RefitThreshold;
+			
+			PlayerBVH();
+			
+			/** rebuilds the hierarchy from the world's player slots. */
+			void Rebuild(World *);
+			
+			/** refits the leaves of players that moved, and rebuilds
+			 * the hierarchy when players have joined or left. */
+			void Update(World *);
+			
+			/** appends slot indices of players whose bounds the ray
+			 * (from `start`, towards `dir`) intersects, in ascending
+			 * order. */
+			void QueryRay(Vector3 start, Vector3 dir,
+						  std::vector<int>& slots) const;
+			
+			int GetNumRebuilds() const { return numRebuilds; }
+			int GetNumRefits() const { return numRefits; }
+		};
+		
+		enum class HitBodyPart {
+			None,
+			Head,
+			Torso,
+			Limb1, Limb2,
+			Arms
+		};
+		
+		struct PlayerRayCastResult {
+			/** NULL if no player was hit */
+			Player *player;
+			float distance;
+			/** hit flags as reported by World::WeaponRayCast */
+			hitTag_t hitFlag;
+			/** hit part as used by Player::FireWeapon */
+			HitBodyPart hitPart;
+			
+			bool operator ==(const PlayerRayCastResult& o) const {
+				return player == o.player && distance == o.distance &&
+				hitFlag == o.hitFlag && hitPart == o.hitPart;
+			}
+		};
+		
+		/** Casts rays against hitboxes of alive players.
+		 * Hitboxes are computed at most once per player for the
+		 * lifetime of the query, so players must not move while this
+		 * is alive. */
+		class PlayerRayQuery {
+			World *world;
+			Player *exclude;
+			const PlayerBVH *bvh;
+			std::vector<Player::HitBoxes> hitBoxes;
+			std::vector<bool> hitBoxesValid;
+			std::vector<int> candidates;
+			
+			void TestPlayer(int slot, Vector3 start, Vector3 dir,
+							PlayerRayCastResult& result);
+		public:
+			/** @param useBVH when false, every player slot is tested
+			 * (used for reference/benchmarking). */
+			PlayerRayQuery(World *, Player *exclude, bool useBVH = true);
+			
+			PlayerRayCastResult Cast(Vector3 start, Vector3 dir);
+			void Cast(Vector3 start, const Vector3 *dirs, size_t numRays,
+					  PlayerRayCastResult *results);
+			
+			/** measures the hit test of 8-pellet shots in a crowded
+			 * world with and without the hierarchy. */
+			static void RunBenchmark();
+		};
+	}
+}
@@ -0,0 +1,133 @@
+/*
+ Copyright (c) 2013 yvt
+ 
+ This file is part of OpenSpades.
+ 
+ OpenSpades is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+ 
+ OpenSpades is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with OpenSpades.  If not, see <http://www.gnu.org/licenses/>.
+ 
+ */
+
+
+#include "SnapshotSaver.h"
+#include <Core/ConcurrentDispatch.h>
+#include <Core/AutoLocker.h>
+#include <Core/Exception.h>
+#include <Core/Debug.h>
+#include <Core/Stopwatch.h>
+
+namespace spades {
+	namespace client {
+		
+		class SnapshotSaver::Worker: public ConcurrentDispatch {
+			SnapshotSaver& saver;
+		public:
+			Worker(SnapshotSaver& saver):
+			ConcurrentDispatch("SnapshotSaver"),
+			saver(saver) {}
+			virtual void Run() {
+				saver.ProcessJobs();
+			}
+		};
+		
+		SnapshotSaver::SnapshotSaver():
+		running(false),
+		worker(new Worker(*this)) {
+		}
+		
+		SnapshotSaver::~SnapshotSaver() {
+			SPADES_MARK_FUNCTION();
+			worker->Join();
+		}
+		
+		void SnapshotSaver::Enqueue(const std::string& name,
+									std::function<void()> func,
+									const std::string &successMessage,
+									const std::string &failureMessage) {
+			SPADES_MARK_FUNCTION();
+			
+			Job job;
+			job.name = name;
+			job.func = std::move(func);
+			job.successMessage = successMessage;
+			job.failureMessage = failureMessage;
+			
+			{
+				AutoLocker guard(&mutex);
+				jobs.push_back(std::move(job));
+				if(running)
+					return;
+				running = true;
+			}
+			
+			// previous run has already finished (or is just returning)
+			worker->Join();
+			worker->Start();
+		}
+		
+		void SnapshotSaver::ProcessJobs() {
+			SPADES_MARK_FUNCTION();
+			
+			while(true) {
+				Job job;
+				{
+					AutoLocker guard(&mutex);
+					if(jobs.empty()) {
+						running = false;
+						return;
+					}
+					job = std::move(jobs.front());
+				}
+				
+				Result result;
+				Stopwatch sw;
+				try{
+					job.func();
+					result.failed = false;
+					result.message = job.successMessage;
+					SPLog("Saving %s took %.2f ms in background",
+						  job.name.c_str(), sw.GetTime() * 1000.);
+				}catch(const Exception& ex){
+					result.failed = true;
+					result.message = job.failureMessage + ex.GetShortMessage();
+					SPLog("Saving %s failed: %s", job.name.c_str(), ex.what());
+				}catch(const std::exception& ex){
+					result.failed = true;
+					result.message = job.failureMessage + ex.what();
+					SPLog("Saving %s failed: %s", job.name.c_str(), ex.what());
+				}
+				
+				// release the job's resources before it's reported as done
+				job.func = nullptr;
+				
+				AutoLocker guard(&mutex);
+				// the job stays in the queue while running so that
+				// GetNumPendingJobs counts it
+				jobs.pop_front();
+				results.push_back(std::move(result));
+			}
+		}
+		
+		std::vector<SnapshotSaver::Result> SnapshotSaver::TakeResults() {
+			AutoLocker guard(&mutex);
+			std::vector<Result> ret;
+			ret.swap(results);
+			return ret;
+		}
+		
+		int SnapshotSaver::GetNumPendingJobs() {
+			AutoLocker guard(&mutex);
+			return (int)jobs.size();
+		}
+	}
+}
@@ -0,0 +1,82 @@
+/*
+ Copyright (c) 2013 yvt
+ 
+ This file is part of OpenSpades.
+ 
+ OpenSpades is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+ 
+ OpenSpades is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with OpenSpades.  If not, see <http://www.gnu.org/licenses/>.
+ 
+ */
+
+
+#pragma once
+
+#include <functional>
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <Core/Mutex.h>
+
+namespace spades {
+	class ConcurrentDispatch;
+	namespace client {
+		
+		/** Runs screenshot/mapshot encoding and file writes on a
+		 * background thread, one job at a time, so that the game thread
+		 * doesn't hitch. Completion is collected with TakeResults on
+		 * the game thread. */
+		class SnapshotSaver {
+		public:
+			struct Result {
+				bool failed;
+				/** alert message to display. */
+				std::string message;
+			};
+		private:
+			class Worker;
+			
+			struct Job {
+				std::string name;
+				std::function<void()> func;
+				std::string successMessage;
+				std::string failureMessage;
+			};
+			
+			Mutex mutex;
+			std::deque<Job> jobs;
+			std::vector<Result> results;
+			bool running;
+			std::unique_ptr<Worker> worker;
+			
+			void ProcessJobs();
+		public:
+			SnapshotSaver();
+			/** waits for all queued jobs to complete. */
+			~SnapshotSaver();
+			
+			/** queues a job. func is called on the background thread and
+			 * throws on failure, in which case the exception message is
+			 * appended to failureMessage. */
+			void Enqueue(const std::string& name,
+						 std::function<void()> func,
+						 const std::string& successMessage,
+						 const std::string& failureMessage);
+			
+			std::vector<Result> TakeResults();
+			
+			/** @return the number of jobs that aren't completed yet. */
+			int GetNumPendingJobs();
+		};
+	}
+}
@@ -35,6 +35,8 @@
 #include "IWorldListener.h"
 #include <Core/Settings.h>
 #include "HitTestDebugger.h"
+#include "PlayerBVH.h"
+#include <Core/Profiler.h>
 #include <deque>
 
 SPADES_SETTING(cg_debugHitTest, "0");
@@ -61,6 +63,7 @@ namespace spades {
 			time = 0.f;
 			mode = NULL;
 			
+			playerBVH.reset(new PlayerBVH());
 		}
 		World::~World() {
 			SPADES_MARK_FUNCTION();
@@ -82,6 +85,7 @@ namespace spades {
 		
 		void World::Advance(float dt) {
 			SPADES_MARK_FUNCTION();
+			SPADES_PROFILE_ZONE("World::Advance");
 			
 			ApplyBlockActions();
 			
@@ -100,6 +104,8 @@ namespace spades {
 			for(size_t i = 0; i < removedGrenades.size(); i++)
 				grenades.erase(removedGrenades[i]);
 			
+			playerBVH->Update(this);
+			
 			time += dt;
 		}
 		
@@ -404,65 +410,12 @@ namespace spades {
 														spades::Vector3 dir,
 														Player *exclude) {
 			WeaponRayCastResult result;
-			Player *hitPlayer = NULL;
-			float hitPlayerDistance = 0.f;
-			hitTag_t hitFlag = hit_None;
 			
-			for(int i = 0; i < (int)players.size(); i++){
-				Player *p = players[i];
-				if(p == NULL || p == exclude)
-					continue;
-				if(p->GetTeamId() >= 2 || !p->IsAlive())
-					continue;
-				if(!p->RayCastApprox(startPos, dir))
-					continue;
-				
-				Player::HitBoxes hb = p->GetHitBoxes();
-				Vector3 hitPos;
-				
-				if(hb.head.RayCast(startPos, dir, &hitPos)) {
-					float dist = (hitPos - startPos).GetLength();
-					if(hitPlayer == NULL ||
-					   dist < hitPlayerDistance){
-						if(hitPlayer != p){
-							hitPlayer = p;
-							hitFlag = hit_None;
-						}
-						hitPlayerDistance = dist;
-						hitFlag |= hit_Head;
-					}
-				}
-				if(hb.torso.RayCast(startPos, dir, &hitPos)) {
-					float dist = (hitPos - startPos).GetLength();
-					if(hitPlayer == NULL ||
-					   dist < hitPlayerDistance){
-						if(hitPlayer != p){
-							hitPlayer = p;
-							hitFlag = hit_None;
-						}
-						hitPlayerDistance = dist;
-						hitFlag |= hit_Torso;
-					}
-				}
-				for(int j = 0; j < 3 ;j++){
-					if(hb.limbs[j].RayCast(startPos, dir, &hitPos)) {
-						float dist = (hitPos - startPos).GetLength();
-						if(hitPlayer == NULL ||
-						   dist < hitPlayerDistance){
-							if(hitPlayer != p){
-								hitPlayer = p;
-								hitFlag = hit_None;
-							}
-							hitPlayerDistance = dist;
-							if(j == 2) {
-								hitFlag |= hit_Arms;
-							} else {
-								hitFlag |= hit_Legs;
-							}
-						}
-					}
-				}
-			}
+			PlayerRayQuery query(this, exclude);
+			PlayerRayCastResult playerResult = query.Cast(startPos, dir);
+			Player *hitPlayer = playerResult.player;
+			float hitPlayerDistance = playerResult.distance;
+			hitTag_t hitFlag = playerResult.hitFlag;
 			
 			// map raycast
 			GameMap::RayCastResult res2;
@@ -490,6 +443,11 @@ namespace spades {
 			return result;
 		}
 		
+		PlayerBVH *World::GetPlayerBVH() {
+			playerBVH->Update(this);
+			return playerBVH.get();
+		}
+		
 		HitTestDebugger *World::GetHitTestDebugger() {
 			if(cg_debugHitTest) {
 				if(hitTestDebugger == nullptr) {
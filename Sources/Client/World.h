@@ -41,6 +41,7 @@ namespace spades {
 		class IGameMode;
 		class Client; // FIXME: for debug
 		class HitTestDebugger;
+		class PlayerBVH;
 		class World {
 			friend class Client; // FIXME: for debug
 		public:
@@ -70,6 +71,7 @@ namespace spades {
 			
 			std::list<Grenade *> grenades;
 			std::unique_ptr<HitTestDebugger> hitTestDebugger;
+			std::unique_ptr<PlayerBVH> playerBVH;
 			
 			std::unordered_map<CellPos, spades::IntVector3, CellPosHash> createdBlocks;
 			std::unordered_set<CellPos, CellPosHash> destroyedBlocks;
@@ -148,6 +150,10 @@ namespace spades {
 			
 			HitTestDebugger *GetHitTestDebugger();
 			
+			/** @return the player hierarchy, updated for the current
+			 * player positions. */
+			PlayerBVH *GetPlayerBVH();
+			
 			void SetListener(IWorldListener *l){
 				listener = l;
 			}
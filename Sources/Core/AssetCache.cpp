@@ -0,0 +1,158 @@
+/*
+ Copyright (c) 2013 yvt
+ 
+ This file is part of OpenSpades.
+ 
+ OpenSpades is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+ 
+ OpenSpades is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with OpenSpades.  If not, see <http://www.gnu.org/licenses/>.
+ 
+ */
+
+
+#include "AssetCache.h"
+#include "AutoLocker.h"
+#include "Debug.h"
+#include "FileManager.h"
+#include "IStream.h"
+#include "Math.h"
+#include "Mutex.h"
+#include "Settings.h"
+#include <cstring>
+#include <memory>
+
+SPADES_SETTING(core_assetCache, "1");
+
+namespace spades {
+	
+	// increment when the format of any payload changes
+	static const uint32_t assetCacheVersion = 1;
+	
+	struct AssetCacheHeader {
+		char magic[4];
+		uint32_t version;
+		uint64_t key;
+		uint64_t payloadLength;
+		uint64_t payloadHash;
+		double buildTime;
+	};
+	
+	static const char assetCacheMagic[4] = {'O', 'S', 'A', 'C'};
+	
+	
+	namespace {
+		struct Statistics {
+			Mutex mutex;
+			int numHits;
+			int numMisses;
+			double loadTime;
+			double timeSaved;
+			Statistics(): numHits(0), numMisses(0),
+			loadTime(0.), timeSaved(0.) {}
+		};
+		
+		Statistics& GetStatistics() {
+			static Statistics *stats = new Statistics();
+			return *stats;
+		}
+	}
+	
+	bool AssetCache::IsEnabled() {
+		return core_assetCache;
+	}
+	
+	static std::string GetEntryPath(const std::string& kind,
+									const std::string& name) {
+		uint64_t h = HashBytes(HashSeed, name.data(), name.size());
+		char buf[32];
+		sprintf(buf, "%016llx", (unsigned long long)h);
+		return "Cache/Assets/" + kind + "/" + buf + ".bin";
+	}
+	
+	bool AssetCache::Load(const std::string& kind, const std::string& name,
+						  uint64_t key, std::string& payload, double& buildTime) {
+		SPADES_MARK_FUNCTION();
+		
+		std::string path = GetEntryPath(kind, name);
+		if(!FileManager::FileExists(path.c_str()))
+			return false;
+		
+		std::string data;
+		try{
+			data = FileManager::ReadAllBytes(path.c_str());
+		}catch(const std::exception& ex) {
+			SPLog("Failed to read asset cache '%s': %s", path.c_str(), ex.what());
+			return false;
+		}
+		
+		AssetCacheHeader header;
+		if(data.size() < sizeof(header))
+			return false;
+		std::memcpy(&header, data.data(), sizeof(header));
+		if(std::memcmp(header.magic, assetCacheMagic, sizeof(assetCacheMagic)) != 0 ||
+		   header.version != assetCacheVersion ||
+		   header.key != key ||
+		   header.payloadLength != data.size() - sizeof(header))
+			return false;
+		if(header.payloadHash != HashBytes(HashSeed, data.data() + sizeof(header),
+									  data.size() - sizeof(header))) {
+			SPLog("Asset cache '%s' for '%s' is corrupted", path.c_str(), name.c_str());
+			return false;
+		}
+		
+		payload = data.substr(sizeof(header));
+		buildTime = header.buildTime;
+		return true;
+	}
+	
+	void AssetCache::Store(const std::string& kind, const std::string& name,
+						   uint64_t key, const std::string& payload, double buildTime) {
+		SPADES_MARK_FUNCTION();
+		
+		AssetCacheHeader header;
+		std::memcpy(header.magic, assetCacheMagic, sizeof(assetCacheMagic));
+		header.version = assetCacheVersion;
+		header.key = key;
+		header.payloadLength = payload.size();
+		header.payloadHash = HashBytes(HashSeed, payload.data(), payload.size());
+		header.buildTime = buildTime;
+		
+		std::string path = GetEntryPath(kind, name);
+		try{
+			std::unique_ptr<IStream> s(FileManager::OpenForWriting(path.c_str()));
+			s->Write(&header, sizeof(header));
+			s->Write(payload);
+		}catch(const std::exception& ex) {
+			SPLog("Failed to write asset cache '%s': %s", path.c_str(), ex.what());
+		}
+	}
+	
+	void AssetCache::Report(bool hit, double time, double buildTime) {
+		Statistics& stats = GetStatistics();
+		AutoLocker lock(&stats.mutex);
+		stats.loadTime += time;
+		if(hit) {
+			stats.numHits++;
+			stats.timeSaved += buildTime - time;
+		}else{
+			stats.numMisses++;
+		}
+	}
+	
+	void AssetCache::LogStatistics() {
+		Statistics& stats = GetStatistics();
+		AutoLocker lock(&stats.mutex);
+		SPLog("Asset cache: %d hits, %d misses, %.1f ms spent loading, "
+			  "%.1f ms saved", stats.numHits, stats.numMisses,
+			  stats.loadTime * 1000., stats.timeSaved * 1000.);
+	}
+}
@@ -0,0 +1,58 @@
+/*
+ Copyright (c) 2013 yvt
+ 
+ This file is part of OpenSpades.
+ 
+ OpenSpades is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+ 
+ OpenSpades is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with OpenSpades.  If not, see <http://www.gnu.org/licenses/>.
+ 
+ */
+
+
+#pragma once
+
+#include <stdint.h>
+#include <string>
+
+namespace spades {
+	
+	/** On-disk cache of data derived from assets, such as decoded bitmaps
+	 * and voxel model meshes, stored under "Cache/Assets" of the writable
+	 * directory. Each entry is identified by a name and validated by a key
+	 * computed from the source data; entries that are broken, outdated,
+	 * or written by another format version are ignored and overwritten.
+	 * Enabled by `core_assetCache`. */
+	class AssetCache {
+		AssetCache() {}
+	public:
+		static bool IsEnabled();
+		
+		/** Reads a cache entry.
+		 * @param buildTime receives the time (in seconds) it took to
+		 *                  create the entry's data from the source.
+		 * @return true if a valid entry was found. */
+		static bool Load(const std::string& kind, const std::string& name,
+						 uint64_t key, std::string& payload, double& buildTime);
+		
+		/** Writes a cache entry. Errors are logged and ignored. */
+		static void Store(const std::string& kind, const std::string& name,
+						  uint64_t key, const std::string& payload, double buildTime);
+		
+		/** Records the time spent to produce an asset from the cache
+		 * (`hit` = true) or from the source. */
+		static void Report(bool hit, double time, double buildTime);
+		
+		/** Logs the total load time and the time saved by the cache so far. */
+		static void LogStatistics();
+	};
+}
@@ -0,0 +1,241 @@
+/*
+ Copyright (c) 2013 yvt
+ 
+ This file is part of OpenSpades.
+ 
+ OpenSpades is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+ 
+ OpenSpades is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with OpenSpades.  If not, see <http://www.gnu.org/licenses/>.
+ 
+ */
+
+
+#include "AssetPreloader.h"
+#include "AutoLocker.h"
+#include "Bitmap.h"
+#include "ConcurrentDispatch.h"
+#include "Debug.h"
+#include "FileManager.h"
+#include "IStream.h"
+#include "Semaphore.h"
+#include "Settings.h"
+#include "Stopwatch.h"
+#include "VoxelModel.h"
+#include <algorithm>
+
+SPADES_SETTING(core_numPreloadThreads, "2");
+
+namespace spades {
+	
+	AssetPreloader::AssetPreloader() {
+		int count = std::max((int)core_numPreloadThreads, 1);
+		workers.resize(static_cast<std::size_t>(count));
+		for(auto& w: workers)
+			w.running = false;
+	}
+	
+	AssetPreloader::~AssetPreloader() {
+	}
+	
+	AssetPreloader& AssetPreloader::GetInstance() {
+		// never destroyed because loaders might still be running
+		// while static objects are destroyed
+		static AssetPreloader *instance = new AssetPreloader();
+		return *instance;
+	}
+	
+	std::vector<std::string> AssetPreloader::ReadManifest(const std::string& name) {
+		SPADES_MARK_FUNCTION();
+		
+		std::vector<std::string> assets;
+		std::string text = FileManager::ReadAllBytes(name.c_str());
+		std::size_t pos = 0;
+		while(pos < text.size()) {
+			std::size_t end = text.find('\n', pos);
+			if(end == std::string::npos)
+				end = text.size();
+			std::string line = text.substr(pos, end - pos);
+			pos = end + 1;
+			
+			// trim
+			std::size_t first = line.find_first_not_of(" \t\r");
+			if(first == std::string::npos)
+				continue;
+			std::size_t last = line.find_last_not_of(" \t\r");
+			line = line.substr(first, last - first + 1);
+			
+			if(line[0] == '#')
+				continue;
+			assets.push_back(line);
+		}
+		return assets;
+	}
+	
+	void AssetPreloader::Load(const std::string& name, Entry& entry) {
+		SPADES_MARK_FUNCTION();
+		
+		Stopwatch sw;
+		try {
+			if(entry.isModel) {
+				std::unique_ptr<IStream> stream(FileManager::OpenForReading(name.c_str()));
+				entry.model.Set(VoxelModel::LoadKV6(stream.get()), false);
+			}else{
+				entry.bitmap.Set(Bitmap::Load(name), false);
+			}
+			SPLog("Preloaded '%s' in %.2f ms", name.c_str(), sw.GetTime() * 1000.);
+		}catch(const std::exception& ex) {
+			// the renderer will try again and report the error
+			SPLog("Failed to preload '%s': %s", name.c_str(), ex.what());
+		}
+	}
+	
+	void AssetPreloader::RunWorker(std::size_t index) {
+		while(true) {
+			std::string name;
+			Entry result;
+			{
+				AutoLocker lock(&mutex);
+				if(queue.empty()) {
+					// Preload starts a new worker in this slot when
+					// more requests arrive
+					workers[index].running = false;
+					return;
+				}
+				name = queue.front();
+				queue.pop_front();
+				
+				Entry& e = entries[name];
+				e.queued = false;
+				result.isModel = e.isModel;
+			}
+			
+			// FileManager and the file systems are thread-safe
+			Load(name, result);
+			
+			AutoLocker lock(&mutex);
+			Entry& e = entries[name];
+			e.bitmap = result.bitmap;
+			e.model = result.model;
+			e.done->Post();
+		}
+	}
+	
+	void AssetPreloader::StartWorker() {
+		// `mutex` must be held by the caller
+		for(std::size_t i = 0; i < workers.size(); i++) {
+			Worker& w = workers[i];
+			if(w.running)
+				continue;
+			
+			// the previous dispatch in this slot has left RunWorker;
+			// destroying it only waits for the dispatch to finish.
+			w.dispatch.reset();
+			
+			auto f = [this, i]() { RunWorker(i); };
+			w.dispatch = std::make_shared<FunctionDispatch<decltype(f)>>(f);
+			w.running = true;
+			w.dispatch->Start();
+			return;
+		}
+		// all workers are busy; one of them will pick the request up
+	}
+	
+	void AssetPreloader::Preload(const std::string& name, bool isModel) {
+		SPADES_MARK_FUNCTION();
+		
+		AutoLocker lock(&mutex);
+		if(entries.find(name) != entries.end())
+			return;
+		
+		Entry& entry = entries[name];
+		entry.isModel = isModel;
+		entry.queued = true;
+		entry.done = std::make_shared<Semaphore>(0);
+		queue.push_back(name);
+		
+		StartWorker();
+	}
+	
+	void AssetPreloader::PreloadBitmap(const std::string& name) {
+		Preload(name, false);
+	}
+	
+	void AssetPreloader::PreloadModel(const std::string& name) {
+		Preload(name, true);
+	}
+	
+	bool AssetPreloader::Take(const std::string& name, Entry& out) {
+		SPADES_MARK_FUNCTION();
+		
+		std::shared_ptr<Semaphore> done;
+		{
+			AutoLocker lock(&mutex);
+			auto it = entries.find(name);
+			if(it == entries.end())
+				return false;
+			
+			Entry& e = it->second;
+			out.isModel = e.isModel;
+			if(e.queued) {
+				// no worker has started it yet; waiting would only
+				// add the queue latency, so decode it here
+				queue.erase(std::find(queue.begin(), queue.end(), name));
+				entries.erase(it);
+			}else{
+				done = e.done;
+			}
+		}
+		
+		if(!done) {
+			Load(name, out);
+			return true;
+		}
+		
+		// wait for the worker to complete the decode
+		Stopwatch sw;
+		done->Wait();
+		done->Post(); // for another thread taking the same asset
+		double waited = sw.GetTime();
+		if(waited > 0.001) {
+			SPLog("Waited %.2f ms for '%s' to be preloaded", waited * 1000., name.c_str());
+		}
+		
+		AutoLocker lock(&mutex);
+		auto it = entries.find(name);
+		if(it == entries.end())
+			return false; // taken by another thread
+		out.bitmap = it->second.bitmap;
+		out.model = it->second.model;
+		entries.erase(it);
+		return true;
+	}
+	
+	Bitmap *AssetPreloader::TakeBitmap(const std::string& name) {
+		Entry e;
+		if(!Take(name, e))
+			return NULL;
+		Bitmap *bmp = e.bitmap;
+		if(bmp)
+			bmp->AddRef();
+		return bmp;
+	}
+	
+	VoxelModel *AssetPreloader::TakeModel(const std::string& name) {
+		Entry e;
+		if(!Take(name, e))
+			return NULL;
+		VoxelModel *model = e.model;
+		if(model)
+			model->AddRef();
+		return model;
+	}
+}
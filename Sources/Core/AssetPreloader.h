@@ -0,0 +1,95 @@
+/*
+ Copyright (c) 2013 yvt
+ 
+ This file is part of OpenSpades.
+ 
+ OpenSpades is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+ 
+ OpenSpades is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with OpenSpades.  If not, see <http://www.gnu.org/licenses/>.
+ 
+ */
+
+
+#pragma once
+
+#include "Mutex.h"
+#include "RefCountedObject.h"
+#include <deque>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace spades {
+	class Bitmap;
+	class VoxelModel;
+	class ConcurrentDispatch;
+	class Semaphore;
+	
+	/** Decodes images and voxel models on the dispatch threads ahead of
+	 * their first use. A renderer takes the decoded data with `TakeBitmap`
+	 * or `TakeModel` when the asset is registered and uploads it; assets
+	 * that were not preloaded are loaded by the renderer as before.
+	 * Requests are queued and served by at most `core_numPreloadThreads`
+	 * dispatches, so the dispatch threads stay available to others. */
+	class AssetPreloader {
+		struct Entry {
+			Handle<Bitmap> bitmap;
+			Handle<VoxelModel> model;
+			// posted when a worker finishes the entry
+			std::shared_ptr<Semaphore> done;
+			bool isModel;
+			bool queued;
+		};
+		
+		struct Worker {
+			std::shared_ptr<ConcurrentDispatch> dispatch;
+			bool running;
+		};
+		
+		Mutex mutex;
+		std::map<std::string, Entry> entries;
+		std::deque<std::string> queue;
+		std::vector<Worker> workers;
+		
+		AssetPreloader();
+		~AssetPreloader();
+		
+		static void Load(const std::string& name, Entry&);
+		void RunWorker(std::size_t index);
+		void StartWorker();
+		void Preload(const std::string& name, bool isModel);
+		bool Take(const std::string& name, Entry& out);
+	public:
+		static AssetPreloader& GetInstance();
+		
+		/** Reads a preload manifest, a text file listing one asset path
+		 * per line. Empty lines and lines starting with '#' are ignored. */
+		static std::vector<std::string> ReadManifest(const std::string& name);
+		
+		/** Starts decoding the specified image in background. */
+		void PreloadBitmap(const std::string& name);
+		
+		/** Starts decoding the specified KV6 model in background. */
+		void PreloadModel(const std::string& name);
+		
+		/** Returns the preloaded image, waiting for the decode to complete,
+		 * and forgets about it. The caller owns the returned reference.
+		 * An image still waiting in the queue is decoded on the calling
+		 * thread. Returns NULL if the image wasn't preloaded or failed
+		 * to load. */
+		Bitmap *TakeBitmap(const std::string& name);
+		
+		/** Same as TakeBitmap, but for models. */
+		VoxelModel *TakeModel(const std::string& name);
+	};
+}
@@ -27,6 +27,10 @@
 #include "Debug.h"
 #include "IBitmapCodec.h"
 #include "FileManager.h"
+#include "AssetCache.h"
+#include "Math.h"
+#include "MemoryStream.h"
+#include "Stopwatch.h"
 #include <ScriptBindings/ScriptManager.h>
 
 namespace spades {
@@ -60,7 +64,10 @@ namespace spades {
 			delete[] pixels;
 	}
 	
-	Bitmap *Bitmap::Load(const std::string& filename) {
+	/** Decodes the file with the codecs. If `data` is given, it's used
+	 * as the contents of the file instead of opening the file again. */
+	static Bitmap *DecodeBitmap(const std::string& filename,
+								const std::string *data) {
 		std::vector<IBitmapCodec *>codecs = IBitmapCodec::GetAllCodecs();
 		std::string errMsg;
 		for(size_t i = 0; i < codecs.size(); i++){
@@ -68,7 +75,9 @@ namespace spades {
 			if(codec->CanLoad() && codec->CheckExtension(filename)){
 				// give it a try.
 				// open error shouldn't be handled here
-				StreamHandle str = FileManager::OpenForReading(filename.c_str());
+				StreamHandle str = data ?
+				static_cast<IStream *>(new MemoryStream(data->data(), data->size())) :
+				FileManager::OpenForReading(filename.c_str());
 				try{
 					return codec->Load(str);
 				}catch(const std::exception& ex){
@@ -88,6 +97,43 @@ namespace spades {
 		}
 	}
 	
+	Bitmap *Bitmap::Load(const std::string& filename) {
+		if(!AssetCache::IsEnabled())
+			return DecodeBitmap(filename, NULL);
+		
+		// the decoded pixels are cached with the hash of the file
+		Stopwatch sw;
+		std::string data = FileManager::ReadAllBytes(filename.c_str());
+		uint64_t key = HashBytes(HashSeed, data.data(), data.size());
+		
+		std::string payload;
+		double buildTime;
+		if(AssetCache::Load("Bitmap", filename, key, payload, buildTime) &&
+		   payload.size() >= sizeof(uint32_t) * 2) {
+			uint32_t dims[2];
+			std::memcpy(dims, payload.data(), sizeof(dims));
+			std::size_t numPixels = static_cast<std::size_t>(dims[0]) * dims[1];
+			if(payload.size() == sizeof(dims) + numPixels * sizeof(uint32_t)) {
+				Bitmap *bmp = new Bitmap((int)dims[0], (int)dims[1]);
+				std::memcpy(bmp->GetPixels(), payload.data() + sizeof(dims),
+							numPixels * sizeof(uint32_t));
+				AssetCache::Report(true, sw.GetTime(), buildTime);
+				return bmp;
+			}
+		}
+		
+		Bitmap *bmp = DecodeBitmap(filename, &data);
+		buildTime = sw.GetTime();
+		AssetCache::Report(false, buildTime, buildTime);
+		
+		uint32_t dims[2] = {(uint32_t)bmp->GetWidth(), (uint32_t)bmp->GetHeight()};
+		payload.assign(reinterpret_cast<const char *>(dims), sizeof(dims));
+		payload.append(reinterpret_cast<const char *>(bmp->GetPixels()),
+					   (std::size_t)dims[0] * dims[1] * sizeof(uint32_t));
+		AssetCache::Store("Bitmap", filename, key, payload, buildTime);
+		return bmp;
+	}
+	
 	Bitmap *Bitmap::Load(IStream *stream) {
 		std::vector<IBitmapCodec *>codecs = IBitmapCodec::GetAllCodecs();
 		auto pos = stream->GetPosition();
@@ -45,6 +45,7 @@
 #endif
 
 #include "ThreadLocalStorage.h"
+#include "Profiler.h"
 
 SPADES_SETTING(core_numDispatchQueueThreads, "auto");
 
@@ -230,6 +231,7 @@ namespace spades {
 	public:
 		virtual void Run() throw() {
 			SPADES_MARK_FUNCTION();
+			Profiler::SetThreadName("Dispatch");
 			while(true){
 				SyncQueueEntry *ent = globalQueue.Wait();
 				ent->dispatch->ExecuteProtected();
@@ -255,6 +257,7 @@ namespace spades {
 	
 	void ConcurrentDispatch::Execute() {
 		SPADES_MARK_FUNCTION();
+		SPADES_PROFILE_ZONE("ConcurrentDispatch::Execute");
 		SyncQueueEntry *ent = entry;
 		if(!ent){
 			SPRaise("Attempted to execute dispatch '%s' without entry", name.c_str());
@@ -27,7 +27,20 @@
 #include "FileManager.h"
 #include <stdarg.h>
 #include <time.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <atomic>
+#include <memory>
 #include "Math.h"
+#include "Semaphore.h"
+#include "SdlFileStream.h"
+#include <errno.h>
+#include "AutoLocker.h"
+#include "Thread.h"
+#include "Stopwatch.h"
+#include "ConcurrentDispatch.h"
 
 #define SPADES_USE_TLS 1
 
@@ -35,6 +48,14 @@
 #include "ThreadLocalStorage.h"
 #endif // SPADES_USE_TLS
 
+#ifdef WIN32
+#include <io.h>
+#define SPADES_RAW_WRITE(fd, data, size) _write(fd, data, (unsigned int)(size))
+#else
+#include <unistd.h>
+#define SPADES_RAW_WRITE(fd, data, size) write(fd, data, size)
+#endif
+
 namespace spades {
 	namespace reflection {
 		Function::Function(const char *n,
@@ -168,16 +189,236 @@ namespace spades {
 	
 #pragma mark - 
 	
+	namespace {
+		/** Bounded multi-producer queue of formatted log lines
+		 * (D. Vyukov's bounded MPMC queue). Producers never lock;
+		 * consumers are serialized by logWriterLock. */
+		class LogQueue {
+			struct Cell {
+				std::atomic<size_t> sequence;
+				std::string text;
+			};
+			enum { NumCells = 4096 };
+			std::unique_ptr<Cell[]> cells;
+			std::atomic<size_t> enqueuePos;
+			std::atomic<size_t> dequeuePos;
+		public:
+			LogQueue():
+			cells(new Cell[NumCells]),
+			enqueuePos(0), dequeuePos(0) {
+				for(size_t i = 0; i < NumCells; i++)
+					cells[i].sequence.store(i, std::memory_order_relaxed);
+			}
+			
+			/** takes the contents of text. returns false when full. */
+			bool TryPush(std::string& text) {
+				size_t pos = enqueuePos.load(std::memory_order_relaxed);
+				while(true) {
+					Cell& cell = cells[pos & (NumCells - 1)];
+					size_t seq = cell.sequence.load(std::memory_order_acquire);
+					intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+					if(diff == 0) {
+						if(enqueuePos.compare_exchange_weak(pos, pos + 1,
+															std::memory_order_relaxed)) {
+							cell.text.swap(text);
+							cell.sequence.store(pos + 1, std::memory_order_release);
+							return true;
+						}
+					}else if(diff < 0) {
+						return false;
+					}else{
+						pos = enqueuePos.load(std::memory_order_relaxed);
+					}
+				}
+			}
+			
+			/** appends the next line to text. only one thread may pop
+			 * at a time. */
+			bool TryPopInto(std::string& text) {
+				size_t pos = dequeuePos.load(std::memory_order_relaxed);
+				Cell& cell = cells[pos & (NumCells - 1)];
+				size_t seq = cell.sequence.load(std::memory_order_acquire);
+				if(seq != pos + 1)
+					return false;
+				text += cell.text;
+				cell.text.clear();
+				dequeuePos.store(pos + 1, std::memory_order_relaxed);
+				cell.sequence.store(pos + NumCells, std::memory_order_release);
+				return true;
+			}
+			
+			/** passes the next line to write(data, size) without
+			 * copying or allocating. only one thread may pop at a
+			 * time. */
+			template<class F>
+			bool TryPopWith(F write) {
+				size_t pos = dequeuePos.load(std::memory_order_relaxed);
+				Cell& cell = cells[pos & (NumCells - 1)];
+				size_t seq = cell.sequence.load(std::memory_order_acquire);
+				if(seq != pos + 1)
+					return false;
+				write(cell.text.data(), cell.text.size());
+				dequeuePos.store(pos + 1, std::memory_order_relaxed);
+				cell.sequence.store(pos + NumCells, std::memory_order_release);
+				return true;
+			}
+		};
+	}
+	
 	static IStream *logStream = NULL;
 	static bool attemptedToInitializeLog = false;
 	static std::string accumlatedLog;
 	
+	/** serializes writing out the log. a flag instead of a Mutex so
+	 * that the crash handler can try it from a signal handler. */
+	class LogWriterLock: public ILockable {
+		std::atomic_flag flag;
+	public:
+		LogWriterLock() { flag.clear(); }
+		bool TryLock() {
+			return !flag.test_and_set(std::memory_order_acquire);
+		}
+		virtual void Lock() {
+			while(!TryLock())
+				SDL_Delay(0);
+		}
+		virtual void Unlock() {
+			flag.clear(std::memory_order_release);
+		}
+	};
+	
+	// created by StartLog and never destroyed so that messages
+	// logged while exiting are still written
+	static LogQueue *logQueue = NULL;
+	static LogWriterLock logWriterLock;
+	static Semaphore *logWriterSignal = NULL;
+	static std::atomic<bool> logWriterWaiting(false);
+	static std::atomic<bool> asyncLog(false);
+	
+	// descriptor of SystemMessages.log, so that the log can be
+	// written with write(2) alone; -1 if the stream has none.
+	static int logFileDescriptor = -1;
+	
+	// async-signal-safe; errors are ignored since there is
+	// nowhere left to report them.
+	static void WriteRaw(int fd, const char *data, size_t size) {
+		while(size > 0) {
+			auto written = SPADES_RAW_WRITE(fd, data, size);
+			if(written < 0 && errno == EINTR)
+				continue;
+			if(written <= 0)
+				return;
+			data += written;
+			size -= (size_t)written;
+		}
+	}
+	
+	// callers hold logWriterLock.
+	static void WriteLogData(const std::string& data) {
+		WriteRaw(1, data.data(), data.size());
+		if(logFileDescriptor != -1) {
+			WriteRaw(logFileDescriptor, data.data(), data.size());
+		}else if(logStream) {
+			logStream->Write(data);
+			logStream->Flush();
+		}
+	}
+	
+	// writes out what is queued; returns false if nothing was.
+	static bool WriteQueuedLog() {
+		AutoLocker locker(&logWriterLock);
+		std::string batch;
+		while(logQueue->TryPopInto(batch));
+		if(batch.empty())
+			return false;
+		WriteLogData(batch);
+		return true;
+	}
+	
+	class LogWriterThread: public Thread {
+	public:
+		virtual void Run() throw() {
+			while(true) {
+				try{
+					if(WriteQueuedLog())
+						continue;
+					
+					// sleep until LogMessage signals. the queue is checked
+					// once more after announcing it, so a message pushed
+					// in between isn't left waiting for the next one.
+					logWriterWaiting = true;
+					std::atomic_thread_fence(std::memory_order_seq_cst);
+					if(!WriteQueuedLog())
+						logWriterSignal->Wait();
+					logWriterWaiting = false;
+				}catch(const std::exception& ex){
+					fprintf(stderr, "Failed to write log: %s\n", ex.what());
+					SDL_Delay(100);
+				}
+			}
+		}
+	};
+	
+	void FlushLogAfterCrash() {
+		if(!logQueue)
+			return;
+		
+		// popping needs the lock; if it's taken, the queue is being
+		// written out by another thread, or we crashed while doing so,
+		// and it is left alone.
+		if(!logWriterLock.TryLock()) {
+			static const char message[] =
+			"Crashed while the log was being written; "
+			"some of the last messages might be missing.\r\n";
+			WriteRaw(2, message, sizeof(message) - 1);
+			return;
+		}
+		
+		// nothing but write(2) here; the heap, stdio or a lock
+		// might be what we crashed in.
+		while(logQueue->TryPopWith([](const char *data, size_t size) {
+			WriteRaw(1, data, size);
+			if(logFileDescriptor != -1)
+				WriteRaw(logFileDescriptor, data, size);
+		}));
+		logWriterLock.Unlock();
+	}
+	
+	static void LogCrashHandler(int sig) {
+		FlushLogAfterCrash();
+		signal(sig, SIG_DFL);
+		raise(sig);
+	}
+	
 	void StartLog() {
 		attemptedToInitializeLog = true;
+		logQueue = new LogQueue();
+		logWriterSignal = new Semaphore(0);
+		
 		logStream = FileManager::OpenForWriting("SystemMessages.log");
 		
 		logStream->Write(accumlatedLog);
 		accumlatedLog.clear();
+		
+		// everything after this goes straight to the descriptor
+		// so that the crash handler can use it too
+		if(SdlFileStream *fs = dynamic_cast<SdlFileStream *>(logStream))
+			logFileDescriptor = fs->GetFileDescriptor();
+		
+		// from now on, messages are written by a background thread.
+		// they still reach the disk when the program exits or crashes.
+		(new LogWriterThread())->Start();
+		atexit(FlushLog);
+		signal(SIGSEGV, LogCrashHandler);
+		signal(SIGABRT, LogCrashHandler);
+		signal(SIGFPE, LogCrashHandler);
+		signal(SIGILL, LogCrashHandler);
+		asyncLog = true;
+	}
+	
+	void FlushLog() {
+		if(logQueue)
+			WriteQueuedLog();
 	}
 	
 	void LogMessage(const char *file, int line,
@@ -204,17 +445,78 @@ namespace spades {
 		
 		std::string outStr = EscapeControlCharacters(buf);
 		
-		printf("%s", outStr.c_str());
+		if(asyncLog) {
+			// wait for the writer if the queue is full
+			while(!logQueue->TryPush(outStr))
+				SDL_Delay(1);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			if(logWriterWaiting.exchange(false))
+				logWriterSignal->Post();
+			return;
+		}
+		
+		AutoLocker locker(&logWriterLock);
 		
-		if(logStream || !attemptedToInitializeLog) {
-			
-			if(attemptedToInitializeLog){
-				logStream->Write(outStr);
-				logStream->Flush();
-			}else
-				accumlatedLog += buf;
+		if(attemptedToInitializeLog) {
+			if(logStream)
+				WriteLogData(outStr);
+			else
+				WriteRaw(1, outStr.data(), outStr.size());
+		}else{
+			WriteRaw(1, outStr.data(), outStr.size());
+			accumlatedLog += buf;
+		}
+	}
+	
+	void RunLogBenchmark() {
+		SPADES_MARK_FUNCTION();
+		
+		if(!logQueue) {
+			SPLog("Log benchmark: the log has not been started");
+			return;
 		}
+		
+		const int numThreads = 4;
+		const int numMessages = 5000;
+		
+		// returns the time the callers spent logging, and the time
+		// until everything was written
+		auto run = [&](bool async, double& callTime, double& totalTime) {
+			FlushLog();
+			asyncLog = async;
+			Stopwatch total;
+			total.Reset();
+			std::atomic<int64_t> callNanoseconds(0);
+			auto producer = [&] {
+				Stopwatch sw;
+				sw.Reset();
+				for(int i = 0; i < numMessages; i++)
+					SPLog("Log benchmark (%s): message %d", async ? "async" : "sync", i);
+				callNanoseconds += (int64_t)(sw.GetTime() * 1.e+9);
+			};
+			std::vector<std::unique_ptr<ConcurrentDispatch>> dispatches;
+			for(int i = 0; i < numThreads; i++) {
+				dispatches.emplace_back(new FunctionDispatch<decltype(producer)>(producer));
+				dispatches.back()->Start();
+			}
+			for(auto& d: dispatches)
+				d->Join();
+			FlushLog();
+			totalTime = total.GetTime();
+			callTime = (double)callNanoseconds / 1.e+9;
+			asyncLog = true;
+		};
+		
+		double syncCall, syncTotal, asyncCall, asyncTotal;
+		run(false, syncCall, syncTotal);
+		run(true, asyncCall, asyncTotal);
+		
+		int n = numThreads * numMessages;
+		SPLog("Log benchmark: %d messages from %d threads, "
+			  "us/message in caller: sync: %.3f, async: %.3f; "
+			  "messages/s written: sync: %.0f, async: %.0f",
+			  n, numThreads, syncCall * 1.e+6 / n, asyncCall * 1.e+6 / n,
+			  n / syncTotal, n / asyncTotal);
 	}
 	
 }
-
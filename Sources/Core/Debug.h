@@ -78,7 +78,15 @@ namespace spades {
 		
 		std::string BacktraceRecordToString(const BacktraceRecord&);
 	}
+	/** opens SystemMessages.log and starts writing the log
+	 * from a background thread. */
 	void StartLog();
+	/** writes out the queued log messages. */
+	void FlushLog();
+	/** Writes out the queued log messages from a crash handler.
+	 * Doesn't allocate memory or wait for locks. */
+	void FlushLogAfterCrash();
+	void RunLogBenchmark();
 	void LogMessage(const char *file, int line,
 						   const char *format, ...);
 }
@@ -117,3 +125,10 @@ static ::spades::reflection::Function thisFunction(__PRETTY_FUNCTION__, __FILE__
 #pragma message("WARNING: You need to implement DEPRECATED for this compiler")
 #define DEPRECATED(func) func
 #endif
+
+// Visual C++ before 2015 doesn't know noexcept
+#if defined(_MSC_VER) && _MSC_VER < 1900
+#define SPADES_NOEXCEPT throw()
+#else
+#define SPADES_NOEXCEPT noexcept
+#endif
@@ -24,15 +24,31 @@
 #include "Exception.h"
 #include "IStream.h"
 #include "Debug.h"
+#include "Mutex.h"
+#include "AutoLocker.h"
 #include <set>
+#include <vector>
 
 namespace spades {
 	static std::list<IFileSystem *> g_fileSystems;
+	
+	// protects g_fileSystems. file systems themselves are thread-safe,
+	// so they are accessed without holding this.
+	static Mutex& GetFileSystemMutex() {
+		static Mutex mutex;
+		return mutex;
+	}
+	
+	static std::vector<IFileSystem *> GetFileSystems() {
+		AutoLocker lock(&GetFileSystemMutex());
+		return std::vector<IFileSystem *>(g_fileSystems.begin(), g_fileSystems.end());
+	}
+	
 	IStream *FileManager::OpenForReading(const char *fn) {
 		SPADES_MARK_FUNCTION();
 		if(!fn) SPInvalidArgument("fn");
 		if(fn[0] == 0) SPFileNotFound(fn);
-		for(auto *fs: g_fileSystems){
+		for(auto *fs: GetFileSystems()){
 			if(fs->FileExists(fn))
 				return fs->OpenForReading(fn);
 		}
@@ -42,13 +58,14 @@ namespace spades {
 		SPADES_MARK_FUNCTION();
 		if(!fn) SPInvalidArgument("fn");
 		if(fn[0] == 0) SPFileNotFound(fn);
-		for(auto *fs: g_fileSystems){
+		std::vector<IFileSystem *> fileSystems = GetFileSystems();
+		for(auto *fs: fileSystems){
 			if(fs->FileExists(fn))
 				return fs->OpenForWriting(fn);
 		}
 		
 		// create file
-		for(auto *fs: g_fileSystems){
+		for(auto *fs: fileSystems){
 			try{
 				return fs->OpenForWriting(fn);
 			}catch(...){
@@ -61,7 +78,7 @@ namespace spades {
 		SPADES_MARK_FUNCTION();
 		if(!fn) SPInvalidArgument("fn");
 		
-		for(auto *fs: g_fileSystems){
+		for(auto *fs: GetFileSystems()){
 			if(fs->FileExists(fn))
 				return true;
 		}
@@ -78,12 +95,14 @@ namespace spades {
 		SPADES_MARK_FUNCTION();
 		if(!fs) SPInvalidArgument("fs");
 		
+		AutoLocker lock(&GetFileSystemMutex());
 		g_fileSystems.push_back(fs);
 	}
 	void FileManager::PrependFileSystem(spades::IFileSystem *fs){
 		SPADES_MARK_FUNCTION();
 		if(!fs) SPInvalidArgument("fs");
 		
+		AutoLocker lock(&GetFileSystemMutex());
 		g_fileSystems.push_front(fs);
 	}
 	
@@ -106,7 +125,7 @@ namespace spades {
 		std::set<std::string> set;
 		if(!path) SPInvalidArgument("path");
 		
-		for(auto *fs: g_fileSystems){
+		for(auto *fs: GetFileSystems()){
 			std::vector<std::string> l = fs->EnumFiles(path);
 			for(size_t i = 0; i < l.size(); i++)
 				set.insert(l[i]);
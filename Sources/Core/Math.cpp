@@ -503,6 +503,15 @@ namespace spades {
 	}
 	
 	
+	uint64_t HashBytes(uint64_t h, const void *data, size_t len) {
+		const unsigned char *bytes = reinterpret_cast<const unsigned char *>(data);
+		for(size_t i = 0; i < len; i++) {
+			h ^= bytes[i];
+			h *= 1099511628211ULL;
+		}
+		return h;
+	}
+	
 	std::string TrimSpaces(const std::string& str){
 		size_t pos = str.find_first_not_of(" \t\n\r");
 		if(pos == std::string::npos)
@@ -906,6 +906,12 @@ namespace spades {
 
 	std::string TrimSpaces(const std::string&);
 	
+	/** 64-bit FNV-1a. Fast, but only meant for detecting changes
+	 * and naming cache entries. Chain calls by passing the previous
+	 * result as `h`, starting with HashSeed. */
+	static const uint64_t HashSeed = 14695981039346656037ULL;
+	uint64_t HashBytes(uint64_t h, const void *data, size_t len);
+	
 	float GetRandom();
 	float SmoothStep(float);
 }
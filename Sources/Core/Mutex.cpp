@@ -37,4 +37,8 @@ namespace spades {
 	void Mutex::Unlock(){
 		SDL_mutexV((SDL_mutex *)priv);
 	}
+	
+	bool Mutex::TryLock(){
+		return SDL_TryLockMutex((SDL_mutex *)priv) == 0;
+	}
 }
@@ -31,5 +31,8 @@ namespace spades {
 		
 		virtual void Lock();
 		virtual void Unlock();
+		/** Returns false instead of waiting when another thread
+		 * holds the lock. */
+		bool TryLock();
 	};
 }
@@ -0,0 +1,250 @@
+/*
+ Copyright (c) 2013 yvt
+ 
+ This file is part of OpenSpades.
+ 
+ OpenSpades is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+ 
+ OpenSpades is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with OpenSpades.  If not, see <http://www.gnu.org/licenses/>.
+ 
+ */
+
+
+#include "Profiler.h"
+#include "Debug.h"
+#include "Settings.h"
+#include "FileManager.h"
+#include "IStream.h"
+#include "Mutex.h"
+#include "AutoLocker.h"
+#include "ThreadLocalStorage.h"
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include <time.h>
+
+SPADES_SETTING(core_profileFrames, "0");
+
+namespace spades {
+	
+	namespace {
+		struct ProfilerEvent {
+			const Profiler::Zone *zone;
+			int64_t start, end;
+		};
+		
+		/** events of one thread. Only that thread writes to it;
+		 * count is published after the event is written so that the
+		 * main thread can read the events when a capture finishes. */
+		struct ProfilerThreadBuffer {
+			enum { NumEvents = 1 << 16 };
+			std::vector<ProfilerEvent> events;
+			std::atomic<size_t> count;
+			size_t captureStart;
+			int id;
+			std::string name;
+			
+			ProfilerThreadBuffer(): events(NumEvents), count(0), captureStart(0) {}
+		};
+		
+		// buffers are kept after their thread exits so that the
+		// events stay readable
+		struct ProfilerRegistry {
+			Mutex mutex;
+			std::vector<ProfilerThreadBuffer *> buffers;
+		};
+		
+		ProfilerRegistry& GetRegistry() {
+			static ProfilerRegistry registry;
+			return registry;
+		}
+		
+		ThreadLocalStorage<ProfilerThreadBuffer> threadBuffer("profilerThreadBuffer");
+		
+		ProfilerThreadBuffer *GetThreadBuffer() {
+			ProfilerThreadBuffer *buf = threadBuffer;
+			if(!buf) {
+				buf = new ProfilerThreadBuffer();
+				auto& registry = GetRegistry();
+				AutoLocker lock(&registry.mutex);
+				buf->id = (int)registry.buffers.size() + 1;
+				char name[64];
+				sprintf(name, "Thread %d", buf->id);
+				buf->name = name;
+				registry.buffers.push_back(buf);
+				threadBuffer = buf;
+			}
+			return buf;
+		}
+		
+		int numFramesToCapture = 0;
+		int numFramesCaptured = 0;
+		bool capturing = false;
+		int64_t lastFrameTime = 0;
+		
+		std::string EscapeJson(const char *s) {
+			std::string ret;
+			for(; *s; s++) {
+				if(*s == '"' || *s == '\\')
+					ret += '\\';
+				if((unsigned char)*s >= 0x20)
+					ret += *s;
+			}
+			return ret;
+		}
+	}
+	
+	std::atomic<bool> Profiler::recording(false);
+	
+	int64_t Profiler::GetTimestamp() {
+		using namespace std::chrono;
+		return duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+	}
+	
+	void Profiler::AddEvent(const Zone *zone, int64_t start, int64_t end) {
+		ProfilerThreadBuffer *buf = GetThreadBuffer();
+		size_t index = buf->count.load(std::memory_order_relaxed);
+		ProfilerEvent& ev = buf->events[index % ProfilerThreadBuffer::NumEvents];
+		ev.zone = zone;
+		ev.start = start;
+		ev.end = end;
+		buf->count.store(index + 1, std::memory_order_release);
+	}
+	
+	void Profiler::SetThreadName(const char *name) {
+		ProfilerThreadBuffer *buf = GetThreadBuffer();
+		AutoLocker lock(&GetRegistry().mutex);
+		buf->name = name;
+	}
+	
+	void Profiler::RequestCapture(int numFrames) {
+		if(numFrames > 0 && !capturing)
+			numFramesToCapture = numFrames;
+	}
+	
+	void Profiler::MarkFrame() {
+		static Zone frameZone("Frame", __FILE__, __LINE__);
+		
+		int64_t now = GetTimestamp();
+		if(capturing) {
+			AddEvent(&frameZone, lastFrameTime, now);
+			if(++numFramesCaptured >= numFramesToCapture)
+				FinishCapture();
+		}
+		lastFrameTime = now;
+		
+		if(!capturing) {
+			if((int)core_profileFrames > 0) {
+				RequestCapture(core_profileFrames);
+				core_profileFrames = 0;
+			}
+			if(numFramesToCapture > 0)
+				StartCapture();
+		}
+	}
+	
+	void Profiler::StartCapture() {
+		SPADES_MARK_FUNCTION();
+		
+		static bool mainThreadNamed = false;
+		if(!mainThreadNamed) {
+			SetThreadName("Main");
+			mainThreadNamed = true;
+		}
+		
+		{
+			auto& registry = GetRegistry();
+			AutoLocker lock(&registry.mutex);
+			for(auto *buf: registry.buffers)
+				buf->captureStart = buf->count.load(std::memory_order_acquire);
+		}
+		
+		SPLog("Capturing %d frame(s) for profiling", numFramesToCapture);
+		capturing = true;
+		numFramesCaptured = 0;
+		recording.store(true);
+	}
+	
+	void Profiler::FinishCapture() {
+		SPADES_MARK_FUNCTION();
+		
+		recording.store(false);
+		capturing = false;
+		numFramesToCapture = 0;
+		
+		// zones still open on other threads may add a few events
+		// after this; they simply don't make it into the trace
+		std::string json = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+		char buf[512];
+		bool first = true;
+		size_t numEvents = 0;
+		int64_t origin = 0;
+		auto& registry = GetRegistry();
+		AutoLocker lock(&registry.mutex);
+		for(auto *tb: registry.buffers) {
+			size_t end = tb->count.load(std::memory_order_acquire);
+			size_t start = tb->captureStart;
+			if(end - start > ProfilerThreadBuffer::NumEvents)
+				start = end - ProfilerThreadBuffer::NumEvents;
+			if(start == end)
+				continue;
+			
+			sprintf(buf, "%s{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":%d,"
+					"\"args\":{\"name\":\"%s\"}}",
+					first ? "" : ",\n", tb->id, EscapeJson(tb->name.c_str()).c_str());
+			json += buf;
+			first = false;
+			
+			for(size_t i = start; i < end; i++) {
+				const ProfilerEvent& ev = tb->events[i % ProfilerThreadBuffer::NumEvents];
+				if(origin == 0 || ev.start < origin)
+					origin = ev.start;
+			}
+		}
+		for(auto *tb: registry.buffers) {
+			size_t end = tb->count.load(std::memory_order_acquire);
+			size_t start = tb->captureStart;
+			if(end - start > ProfilerThreadBuffer::NumEvents)
+				start = end - ProfilerThreadBuffer::NumEvents;
+			for(size_t i = start; i < end; i++) {
+				const ProfilerEvent& ev = tb->events[i % ProfilerThreadBuffer::NumEvents];
+				sprintf(buf, ",\n{\"ph\":\"X\",\"name\":\"%s\",\"pid\":1,\"tid\":%d,"
+						"\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"line\":%d}}",
+						EscapeJson(ev.zone->GetName()).c_str(), tb->id,
+						(double)(ev.start - origin) / 1000.,
+						(double)(ev.end - ev.start) / 1000.,
+						ev.zone->GetLineNumber());
+				json += buf;
+				numEvents++;
+			}
+		}
+		json += "\n]}\n";
+		
+		char name[256];
+		time_t t;
+		time(&t);
+		struct tm tm = *localtime(&t);
+		sprintf(name, "Profiles/%04d%02d%02d%02d%02d%02d.json",
+				tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday,
+				tm.tm_hour, tm.tm_min, tm.tm_sec);
+		try{
+			std::unique_ptr<IStream> stream(FileManager::OpenForWriting(name));
+			stream->Write(json);
+			SPLog("Wrote %d profiler events of %d frame(s) to %s",
+				  (int)numEvents, numFramesCaptured, name);
+		}catch(const std::exception& ex){
+			SPLog("Failed to write the profile: %s", ex.what());
+		}
+	}
+}
@@ -0,0 +1,110 @@
+/*
+ Copyright (c) 2013 yvt
+ 
+ This file is part of OpenSpades.
+ 
+ OpenSpades is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+ 
+ OpenSpades is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with OpenSpades.  If not, see <http://www.gnu.org/licenses/>.
+ 
+ */
+
+
+#pragma once
+
+#include <atomic>
+#include <stdint.h>
+
+// set to 0 to compile SPADES_PROFILE_ZONE out entirely
+#ifndef SPADES_ENABLE_PROFILER
+#define SPADES_ENABLE_PROFILER 1
+#endif
+
+namespace spades {
+	/** Records the time spent in instrumented regions of code
+	 * (zones) and writes the frames it captured to a Chrome trace file
+	 * that chrome://tracing or Perfetto can open.
+	 *
+	 * A zone only costs a relaxed load and a branch unless a capture
+	 * is in progress. While capturing, each zone appends one event to
+	 * its thread's ring buffer, so nothing is locked or allocated on
+	 * the way. Unlike SPADES_MARK_FUNCTION, zones don't maintain a
+	 * backtrace; the backtrace is still what crash reports use. */
+	class Profiler {
+	public:
+		/** A named region of code. Declared static by SPADES_PROFILE_ZONE. */
+		class Zone {
+			const char *name;
+			const char *file;
+			int line;
+		public:
+			Zone(const char *name, const char *file, int line):
+			name(name), file(file), line(line) {}
+			
+			const char *GetName() const { return name; }
+			const char *GetFileName() const { return file; }
+			int GetLineNumber() const { return line; }
+		};
+		
+		class Scope {
+			const Zone *zone;
+			int64_t start;
+		public:
+			Scope(const Zone *z) {
+				if(IsRecording()) {
+					zone = z;
+					start = GetTimestamp();
+				}else{
+					zone = nullptr;
+				}
+			}
+			~Scope() {
+				if(zone)
+					AddEvent(zone, start, GetTimestamp());
+			}
+		};
+		
+		static bool IsRecording() {
+			return recording.load(std::memory_order_relaxed);
+		}
+		
+		/** in nanoseconds from an arbitrary origin. */
+		static int64_t GetTimestamp();
+		
+		static void AddEvent(const Zone *, int64_t start, int64_t end);
+		
+		/** names the calling thread in the trace. */
+		static void SetThreadName(const char *);
+		
+		/** called by the main loop at the start of every frame.
+		 * Starts and finishes the captures requested by
+		 * core_profileFrames or RequestCapture. */
+		static void MarkFrame();
+		
+		/** captures the next numFrames frames. */
+		static void RequestCapture(int numFrames);
+		
+	private:
+		static std::atomic<bool> recording;
+		
+		static void StartCapture();
+		static void FinishCapture();
+	};
+}
+
+#if SPADES_ENABLE_PROFILER
+#define SPADES_PROFILE_ZONE(name) \
+static ::spades::Profiler::Zone thisProfilerZone(name, __FILE__, __LINE__); \
+::spades::Profiler::Scope profilerScope(&thisProfilerZone)
+#else
+#define SPADES_PROFILE_ZONE(name) do{}while(0)
+#endif
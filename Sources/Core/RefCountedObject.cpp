@@ -22,10 +22,19 @@
 #include "../ScriptBindings/ScriptManager.h"
 #include "Exception.h"
 #include "AutoLocker.h"
+#include "Stopwatch.h"
+#include "Thread.h"
+#include <vector>
 
 namespace spades {
 	RefCountedObject::RefCountedObject() {
 		refCount = 1;
+		singleThreaded = false;
+	}
+	
+	RefCountedObject::RefCountedObject(RefCountMode mode) {
+		refCount = 1;
+		singleThreaded = mode == RefCountMode::SingleThreaded;
 	}
 	
 	RefCountedObject::~RefCountedObject(){
@@ -33,14 +42,17 @@ namespace spades {
 	}
 	
 	void RefCountedObject::AddRef() {
-		asAtomicInc(refCount);
+		if(singleThreaded)
+			++refCount;
+		else
+			asAtomicInc(refCount);
 	}
 	
 	void RefCountedObject::Release() {
 #if DEBUG_REFCOUNTED_OBJECT_LAST_RELEASE
 		AutoLocker guard(&releaseInfoMutex);
 #endif
-		int cnt = asAtomicDec(refCount);
+		int cnt = singleThreaded ? --refCount : asAtomicDec(refCount);
 		if(cnt == 0){
 #if DEBUG_REFCOUNTED_OBJECT_LAST_RELEASE
 			
@@ -61,4 +73,88 @@ namespace spades {
 		lastRelease = std::move(reflection::Backtrace::GetGlobalBacktrace()->GetRecord());
 #endif
 	}
+	
+	namespace {
+		class BenchmarkObject: public RefCountedObject {
+		public:
+			BenchmarkObject(RefCountMode mode):
+			RefCountedObject(mode) {}
+			int value = 1;
+		};
+		
+		/** Keeps another thread hammering the same reference count. */
+		class BenchmarkChurnThread: public Thread {
+			BenchmarkObject *obj;
+		public:
+			volatile bool stop = false;
+			BenchmarkChurnThread(BenchmarkObject *obj): obj(obj) {}
+			virtual void Run() throw() {
+				while(!stop) {
+					obj->AddRef();
+					obj->Release();
+				}
+			}
+		};
+		
+		// calls that cannot be inlined, like passing through an interface
+		int (* volatile passHandle)(Handle<BenchmarkObject>) =
+		[](Handle<BenchmarkObject> h) -> int { return h->value; };
+		int (* volatile passBorrowed)(Borrowed<BenchmarkObject>) =
+		[](Borrowed<BenchmarkObject> h) -> int { return h->value; };
+	}
+	
+	void RefCountedObject::RunBenchmark() {
+		SPADES_MARK_FUNCTION();
+		
+		const int numOps = 10000000;
+		const int numSlots = 64;
+		Handle<BenchmarkObject> atomicObj
+		(new BenchmarkObject(RefCountMode::Atomic), false);
+		Handle<BenchmarkObject> localObj
+		(new BenchmarkObject(RefCountMode::SingleThreaded), false);
+		
+		Stopwatch sw;
+		int sum = 0;
+		
+		auto copyChurn = [&](Handle<BenchmarkObject>& obj) {
+			std::vector<Handle<BenchmarkObject>> slots(numSlots, obj);
+			sw.Reset();
+			for(int i = 0; i < numOps; i++) {
+				slots[i & (numSlots - 1)] = slots[(i + 1) & (numSlots - 1)];
+				sum += passHandle(slots[i & (numSlots - 1)]);
+			}
+			return sw.GetTime();
+		};
+		
+		double copyTime = copyChurn(atomicObj);
+		double localCopyTime = copyChurn(localObj);
+		
+		{
+			std::vector<Handle<BenchmarkObject>> slots(numSlots, atomicObj);
+			sw.Reset();
+			for(int i = 0; i < numOps; i++) {
+				Handle<BenchmarkObject> h = std::move(slots[i & (numSlots - 1)]);
+				sum += passBorrowed(h);
+				slots[i & (numSlots - 1)] = std::move(h);
+			}
+		}
+		double moveTime = sw.GetTime();
+		
+		double contendedTime;
+		{
+			BenchmarkChurnThread thread(atomicObj);
+			thread.Start();
+			contendedTime = copyChurn(atomicObj);
+			thread.stop = true;
+			thread.Join();
+		}
+		
+		SPLog("Handle benchmark: %d ops, ns/op: copy: %.3f, "
+			  "copy (single-threaded count): %.3f, move + borrow: %.3f, "
+			  "copy (contended): %.3f (check: %d)",
+			  numOps, copyTime * 1.e+9 / numOps,
+			  localCopyTime * 1.e+9 / numOps,
+			  moveTime * 1.e+9 / numOps,
+			  contendedTime * 1.e+9 / numOps, sum);
+	}
 }
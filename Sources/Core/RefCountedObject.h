@@ -29,18 +29,31 @@ namespace spades {
 	
 	class RefCountedObject {
 		int refCount;
+		bool singleThreaded;
 #if DEBUG_REFCOUNTED_OBJECT_LAST_RELEASE
 		reflection::BacktraceRecord lastRelease;
 		reflection::BacktraceRecord secondLastRelease;
 		Mutex releaseInfoMutex;
 #endif
 	protected:
+		/** Objects that are only ever referenced from one thread can
+		 * opt out of the interlocked reference counting. */
+		enum class RefCountMode {
+			Atomic,
+			SingleThreaded
+		};
+		
+		RefCountedObject(RefCountMode);
 		virtual ~RefCountedObject();
 	public:
 		RefCountedObject();
 		
 		void AddRef();
 		void Release();
+		
+		/** Measures the cost of handle copies, moves and borrowed
+		 * references and logs the result. */
+		static void RunBenchmark();
 	};
 	
 	template <typename T>
@@ -56,6 +69,9 @@ namespace spades {
 			if(ptr)
 				ptr->AddRef();
 		}
+		Handle(Handle<T>&& h) SPADES_NOEXCEPT: ptr(h.ptr) {
+			h.ptr = NULL;
+		}
 		~Handle() {
 			if(ptr)
 				ptr->Release();
@@ -95,9 +111,21 @@ namespace spades {
 		void operator =(const Handle<T>& h){
 			Set(h.ptr, true);
 		}
+		void operator =(Handle<T>&& h) SPADES_NOEXCEPT {
+			if(&h == this)
+				return;
+			T *old = ptr;
+			ptr = h.ptr;
+			h.ptr = NULL;
+			if(old)
+				old->Release();
+		}
 		operator T *() {
 			return ptr;
 		}
+		T *GetPointerOrNull() const {
+			return ptr;
+		}
 		T *Unmanage() {
 			SPAssert(ptr != NULL);
 			T *p = ptr;
@@ -109,4 +137,35 @@ namespace spades {
 		}
 	};
 	
+	/** Non-owning reference to a RefCountedObject.
+	 * Use this instead of Handle for parameters and lookup results
+	 * whose lifetime is guaranteed by someone else (e.g. a resource
+	 * manager) to avoid the reference count traffic. */
+	template <typename T>
+	class Borrowed {
+		T *ptr;
+	public:
+		Borrowed(): ptr(NULL) {}
+		Borrowed(T *ptr): ptr(ptr) {}
+		Borrowed(const Handle<T>& h): ptr(h.GetPointerOrNull()) {}
+		T *operator ->() const {
+			SPAssert(ptr != NULL);
+			return ptr;
+		}
+		T& operator *() const {
+			SPAssert(ptr != NULL);
+			return *ptr;
+		}
+		operator T *() const {
+			return ptr;
+		}
+		T *GetPointerOrNull() const {
+			return ptr;
+		}
+		/** Takes a new reference. */
+		Handle<T> ToHandle() const {
+			return Handle<T>(ptr, true);
+		}
+	};
+	
 }
\ No newline at end of file
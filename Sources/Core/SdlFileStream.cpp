@@ -21,6 +21,12 @@
 #include "SdlFileStream.h"
 #include "Exception.h"
 #include "Debug.h"
+#include <stdio.h>
+
+#ifdef WIN32
+#include <io.h>
+#include <fcntl.h>
+#endif
 
 namespace spades {
 	SdlFileStream::SdlFileStream(SDL_RWops *f, bool ac):
@@ -122,4 +128,19 @@ namespace spades {
 		SetPosition(opos);
 	}
 	
+	int SdlFileStream::GetFileDescriptor() {
+#if defined(WIN32)
+		if(ops->type == SDL_RWOPS_WINFILE)
+			return _open_osfhandle((intptr_t)ops->hidden.windowsio.h, _O_BINARY);
+#elif defined(HAVE_STDIO_H)
+		if(ops->type == SDL_RWOPS_STDFILE) {
+			// writes through the descriptor mustn't overtake
+			// what's still in the stdio buffer
+			fflush(ops->hidden.stdio.fp);
+			return fileno(ops->hidden.stdio.fp);
+		}
+#endif
+		return -1;
+	}
+	
 }
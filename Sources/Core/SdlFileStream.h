@@ -46,5 +46,10 @@ namespace spades {
 		virtual void SetLength(uint64_t);
 		
 		virtual void Flush();
+		
+		/** returns the file descriptor the stream writes to, or -1
+		 * if it doesn't have one. a new descriptor is made on each
+		 * call on Windows. */
+		int GetFileDescriptor();
 	};
 }
\ No newline at end of file
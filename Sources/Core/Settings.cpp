@@ -27,6 +27,9 @@
 #include <memory>
 #include <Core/Math.h>
 #include "FltkPreferenceImporter.h"
+#include "Stopwatch.h"
+
+SPADES_SETTING(core_settingsBenchmark, "0");
 
 namespace spades {
 	
@@ -249,7 +252,7 @@ namespace spades {
 				emitString(itm->name, true);
 				buffer += ": "; column += 2;
 				
-				emitString(itm->string, false);
+				emitString(*itm->GetString(), false);
 				
 				buffer += "\n";
 				column = 0;
@@ -296,7 +299,7 @@ namespace spades {
 			item->defaultValue = def;
 			item->value = static_cast<float>(atof(def.c_str()));
 			item->intValue = atoi(def.c_str());
-			item->string = def;
+			item->SetString(def);
 			item->defaults = true;
 			
 			items[name] = item;
@@ -305,12 +308,23 @@ namespace spades {
 		return it->second;
 	}
 	
-	void Settings::Item::Load() {
-		// no longer need to Load
+	std::shared_ptr<const std::string> Settings::Item::GetString() const {
+		while(stringLock.test_and_set(std::memory_order_acquire));
+		std::shared_ptr<const std::string> s = string;
+		stringLock.clear(std::memory_order_release);
+		return s;
+	}
+	
+	void Settings::Item::SetString(const std::string &str) {
+		std::shared_ptr<const std::string> s = std::make_shared<std::string>(str);
+		while(stringLock.test_and_set(std::memory_order_acquire));
+		string.swap(s);
+		stringLock.clear(std::memory_order_release);
+		// the old string is released outside the lock
 	}
 	
 	void Settings::Item::Set(const std::string &str) {
-		string = str;
+		SetString(str);
 		value = static_cast<float>(atof(str.c_str()));
 		intValue = atoi(str.c_str());
 		defaults = false;
@@ -321,7 +335,7 @@ namespace spades {
 		SPADES_MARK_FUNCTION_DEBUG();
 		char buf[256];
 		sprintf(buf, "%d", v);
-		string = buf;
+		SetString(buf);
 		intValue = v;
 		value = (float)v;
 		defaults = false;
@@ -331,7 +345,7 @@ namespace spades {
 		SPADES_MARK_FUNCTION_DEBUG();
 		char buf[256];
 		sprintf(buf, "%f", v);
-		string = buf;
+		SetString(buf);
 		intValue = (int)v;
 		value = v;
 		defaults = false;
@@ -369,28 +383,49 @@ namespace spades {
 		item->Set(value);
 	}
 	Settings::ItemHandle::operator std::string() {
-		item->Load();
-		return item->string;
-	}
-	Settings::ItemHandle::operator int() {
-		item->Load();
-		return item->intValue;
-	}
-	Settings::ItemHandle::operator float() {
-		item->Load();
-		return item->value;
-	}
-	Settings::ItemHandle::operator bool() {
-		item->Load();
-		return item->intValue != 0;
+		return *item->GetString();
 	}
 	const char *Settings::ItemHandle::CString() {
-		item->Load();
-		return item->string.c_str();
+		// the item keeps the snapshot alive until it's replaced
+		return item->GetString()->c_str();
 	}
 	std::string Settings::ItemHandle::GetDescription() {
 		return item->desc;
 	}
 	
+	void Settings::RunBenchmark() {
+		SPADES_MARK_FUNCTION();
+		
+		const int numReads = 10000000;
+		ItemHandle& handle = core_settingsBenchmark;
+		
+		// a call that cannot be inlined, like the reads used to be
+		int (* volatile readOutOfLine)(ItemHandle&) = [](ItemHandle& h) -> int {
+			return (int)h;
+		};
+		
+		Stopwatch sw;
+		int sum = 0;
+		sw.Reset();
+		for(int i = 0; i < numReads; i++)
+			sum += (int)handle;
+		double cachedTime = sw.GetTime();
+		
+		sw.Reset();
+		for(int i = 0; i < numReads; i++)
+			sum += readOutOfLine(handle);
+		double callTime = sw.GetTime();
+		
+		sw.Reset();
+		for(int i = 0; i < numReads; i++)
+			sum += atoi(handle.CString());
+		double parseTime = sw.GetTime();
+		
+		SPLog("Settings benchmark: %d reads, ns/read: cached: %.3f, "
+			  "out-of-line call: %.3f, parsing: %.3f (check: %d)",
+			  numReads, cachedTime * 1.e+9 / numReads,
+			  callTime * 1.e+9 / numReads,
+			  parseTime * 1.e+9 / numReads, sum);
+	}
 	
 }
@@ -23,23 +23,41 @@
 #include <string>
 #include <map>
 #include <vector>
+#include <atomic>
+#include <memory>
 
 namespace spades {
+	/** Settings may be read from any thread, but are only changed
+	 * from the main thread. */
 	class Settings {
 		struct Item {
 			std::string name;
-			std::string string;
-			float value;
-			int intValue;
+			
+			// replaced as a whole, never modified, so that other
+			// threads can copy the string while it's being changed.
+			// the pointer itself is guarded by stringLock because
+			// the shared_ptr atomics are missing before GCC 5.
+			std::shared_ptr<const std::string> string;
+			mutable std::atomic_flag stringLock;
+			
+			// parsed from string whenever it changes so that reading
+			// a number is a single load, even while another thread
+			// changes the setting
+			std::atomic<float> value;
+			std::atomic<int> intValue;
 			
 			std::string defaultValue;
 			std::string desc;
 			bool defaults;
 			
-			void Load();
 			void Set(const std::string&);
 			void Set(int);
 			void Set(float);
+			
+			Item() { stringLock.clear(); }
+			
+			std::shared_ptr<const std::string> GetString() const;
+			void SetString(const std::string&);
 		};
 		std::map<std::string, Item *> items;
 		bool loaded;
@@ -65,9 +83,18 @@ namespace spades {
 			void operator =(int);
 			void operator =(float);
 			operator std::string();
-			operator float();
-			operator int();
-			operator bool();
+			operator float() {
+				return item->value.load(std::memory_order_relaxed);
+			}
+			operator int() {
+				return item->intValue.load(std::memory_order_relaxed);
+			}
+			operator bool() {
+				return item->intValue.load(std::memory_order_relaxed) != 0;
+			}
+			/** The pointer is valid until the setting changes, so this
+			 * is only safe on the main thread. Other threads should
+			 * copy the value with `operator std::string`. */
 			const char *CString();
 			
 			std::string GetDescription();
@@ -77,6 +104,9 @@ namespace spades {
 		void Flush();
 		std::vector<std::string> GetAllItemNames();
 		
+		/** compares reading numeric settings through ItemHandle
+		 * with parsing them, and logs the result. */
+		static void RunBenchmark();
 	};
 	/*
 	template<const char *name, const char *def>
@@ -18,114 +18,44 @@
  
  */
 
+
 #include "ZipFileSystem.h"
 #include "../unzip/unzip.h"
 #include "../unzip/ioapi.h"
 #include "../Core/Debug.h"
 #include "../Core/Exception.h"
+#include "AutoLocker.h"
+#include "ConcurrentDispatch.h"
 #include "IStream.h"
+#include "Stopwatch.h"
 #include <string.h>
-#include "DynamicMemoryStream.h"
+#include <algorithm>
+#include <memory>
+#include <zlib.h>
 
 namespace spades {
-	class ZipFileSystem::ZipFileInputStream: public IStream {
-		ZipFileSystem *fs;
-		unzFile zip;
+	
+	/** Seekable stream on the decompressed contents of an entry. */
+	class ZipFileSystem::ZipEntryStream: public IStream {
+		std::vector<char> data;
 		uint64_t pos;
-		
-		bool streaming;
-		
-		// unzip library doesn't support opening multiple
-		// file, but ZipFileSystem has to.
-		// so when second file is open, the contents of
-		// first file is read and is closed in unzip level.
-		// read contents are stored in remainingData.
-		// streaming becomes false.
-		std::vector<unsigned char> remainingData;
-		size_t remDataPos;
 	public:
-		
-		ZipFileInputStream(ZipFileSystem *fs, unzFile zf):
-		streaming(true),zip(zf),fs(fs){
-			SPADES_MARK_FUNCTION();
-		}
-		
-		virtual ~ZipFileInputStream(){
-			SPADES_MARK_FUNCTION();
-			if(streaming){
-				unzCloseCurrentFile(zip);
-				SPAssert(this == fs->currentStream);
-				fs->currentStream = NULL;
-			}
-		}
-		
-		void ForceCloseUnzipFile() {
-			SPADES_MARK_FUNCTION();
-			if(streaming){
-				streaming = false;
-				unsigned char buf[1024];
-				int bytes;
-				while((bytes = unzReadCurrentFile(zip, buf, sizeof(buf))) > 0) {
-					remainingData.insert(remainingData.end(), buf, buf+bytes);
-				}
-				remDataPos = 0;
-				
-				int ret = unzCloseCurrentFile(zip);
-				if(ret != UNZ_OK) {
-					SPRaise("Zip file close error: 0x%08x", ret);
-				}
-				
-				SPAssert(this == fs->currentStream);
-				fs->currentStream = NULL;
-			}
+		ZipEntryStream(std::vector<char>& d): pos(0) {
+			data.swap(d);
 		}
 		
 		virtual int ReadByte(){
-			SPADES_MARK_FUNCTION();
-			int byte;
-			if(streaming) {
-				unsigned char b;
-				int bytes = unzReadCurrentFile(zip, &b, 1);
-				if(bytes < 0){
-					SPRaise("Unzip error: 0x%08x", bytes);
-				}else if(bytes == 0){
-					byte = -1;
-				}else{
-					byte = b;
-					pos++;
-				}
-			}else{
-				if(remDataPos >= remainingData.size()){
-					return -1;
-				}else{
-					pos++;
-					byte = remainingData[remDataPos];
-					remDataPos++;
-				}
-			}
-			return byte;
+			if(pos >= data.size())
+				return -1;
+			return static_cast<unsigned char>(data[pos++]);
 		}
 		virtual size_t Read(void *buf, size_t bytes){
-			SPADES_MARK_FUNCTION();
-			size_t outBytes;
-			if(streaming){
-				int out = unzReadCurrentFile(zip, buf, bytes);
-				if(out < 0){
-					SPRaise("Unzip error: 0x%08x", bytes);
-				}
-				outBytes = (size_t)out;
-			}else{
-				outBytes = bytes;
-				size_t rem = remainingData.size() - remDataPos;
-				if(outBytes > rem)
-					outBytes = rem;
-				memcpy(buf, remainingData.data() + remDataPos, outBytes);
-				
-				remDataPos += outBytes;
-			}
-			
-			pos += outBytes;
-			return outBytes;
+			if(pos >= data.size())
+				return 0;
+			bytes = std::min(bytes, static_cast<size_t>(data.size() - pos));
+			memcpy(buf, data.data() + pos, bytes);
+			pos += bytes;
+			return bytes;
 		}
 		
 		virtual void WriteByte(int){
@@ -144,15 +74,12 @@ namespace spades {
 		virtual uint64_t GetPosition(){
 			return pos;
 		}
-		virtual void SetPosition(uint64_t){
-			SPADES_MARK_FUNCTION();
-			SPNotImplemented();
+		virtual void SetPosition(uint64_t p){
+			pos = p;
 		}
 		
 		virtual uint64_t GetLength(){
-			SPADES_MARK_FUNCTION();
-			ForceCloseUnzipFile();
-			return pos + remainingData.size() - remDataPos;
+			return data.size();
 		}
 		virtual void SetLength(uint64_t){
 			SPADES_MARK_FUNCTION();
@@ -160,226 +87,191 @@ namespace spades {
 		}
 	};
 	
-#pragma mark - Interface between ZipFileSystem and unzip
-	
-	class ZipFileSystem::ZipFileHandle {
-		ZipFileSystem *fs;
-		uint64_t pos;
-		
-		void ValidateCursor() {
-			SPADES_MARK_FUNCTION();
-			if(fs->cursorPos != pos) {
-				fs->cursorPos = pos;
-				fs->baseStream->SetPosition(pos);
-			}
-		}
-	public:
-		ZipFileHandle(ZipFileSystem *fs):fs(fs){
-			pos = 0;
-		}
-		
-		uint32_t Read(void *buf, uint32_t size) {
-			SPADES_MARK_FUNCTION();
-			ValidateCursor();
-			size_t ret = fs->baseStream->Read(buf, size);
-			pos += ret;
-			fs->cursorPos += ret;
-			return (uint32_t)ret;
-		}
-		
-		uint32_t Write(void *buf, uint32_t size) {
-			SPADES_MARK_FUNCTION();
-			ValidateCursor();
-			try{
-				fs->baseStream->Write(buf, size);
-			}catch(...){
-				// how many bytes written?
-				size_t written = fs->baseStream->GetPosition() - pos;
-				fs->cursorPos += written;
-				pos += written;
-				return pos;
-			}
-			pos += size;
-			fs->cursorPos += size;
-			return (uint32_t)size;
-		}
-		
-		long Tell() {
-			return (long)pos;
-		}
-		
-		long Seek(int32_t offset, int origin) {
-			switch(origin){
-				case ZLIB_FILEFUNC_SEEK_CUR:
-					break;
-				case ZLIB_FILEFUNC_SEEK_END:
-					pos = fs->baseStream->GetLength();
-					break;
-				case ZLIB_FILEFUNC_SEEK_SET:
-					pos = 0;
-					break;
-			}
-			pos += offset;
-			return 0; // (long)pos;
-		}
-		
-		int TestError() {
-			return 0; // ??
-		}
-	};
-	
-	ZipFileSystem::ZipFileHandle *ZipFileSystem::InternalOpen(spades::ZipFileSystem *fs,
-															  const char *fn, int mode) {
-		SPADES_MARK_FUNCTION();
-		return new ZipFileHandle(fs);
-	}
+#pragma mark - Zip file
 	
-	uint32_t ZipFileSystem::InternalRead(spades::ZipFileSystem *fs,
-										 spades::ZipFileSystem::ZipFileHandle *h,
-										 void *buf,
-										 uint32_t size) {
-		SPADES_MARK_FUNCTION_DEBUG();
-		return h->Read(buf, size);
+	static uint16_t ReadLE16(const unsigned char *p) {
+		return (uint16_t)(p[0] | (p[1] << 8));
 	}
 	
-	uint32_t ZipFileSystem::InternalWrite(spades::ZipFileSystem *fs,
-										  spades::ZipFileSystem::ZipFileHandle *h,
-										  void *buf,
-										  uint32_t size) {
-		SPADES_MARK_FUNCTION_DEBUG();
-		return h->Write(buf, size);
+	static uint32_t ReadLE32(const unsigned char *p) {
+		return (uint32_t)p[0] | ((uint32_t)p[1] << 8) |
+		((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
 	}
 	
-	long ZipFileSystem::InternalTell(spades::ZipFileSystem *fs,
-									 spades::ZipFileSystem::ZipFileHandle *h) {
-		SPADES_MARK_FUNCTION_DEBUG();
-		return h->Tell();
-	}
+	enum {
+		LocalHeaderSignature = 0x04034b50,
+		CentralHeaderSignature = 0x02014b50,
+		EndOfCentralDirSignature = 0x06054b50,
+		LocalHeaderSize = 30,
+		CentralHeaderSize = 46,
+		EndOfCentralDirSize = 22,
+		MaxCommentSize = 65535
+	};
 	
-	long ZipFileSystem::InternalSeek(spades::ZipFileSystem *fs,
-									 spades::ZipFileSystem::ZipFileHandle *h,
-									 int32_t offset,
-									 int origin) {
-		SPADES_MARK_FUNCTION_DEBUG();
-		return h->Seek(offset, origin);
+	ZipFileSystem::ZipFileSystem(IStream *stream, bool autoClose):
+	baseStream(stream), autoClose(autoClose){
+		SPADES_MARK_FUNCTION();
+		
+		baseLength = stream->GetLength();
+		ReadCentralDirectory();
 	}
 	
-	int ZipFileSystem::InternalClose(spades::ZipFileSystem *fs,
-									 spades::ZipFileSystem::ZipFileHandle *h) {
+	ZipFileSystem::~ZipFileSystem() {
 		SPADES_MARK_FUNCTION();
-		delete h;
-		return 0;
+		if(autoClose)
+			delete baseStream;
 	}
 	
-	int ZipFileSystem::InternalTestError(spades::ZipFileSystem *fs,
-										 spades::ZipFileSystem::ZipFileHandle *h) {
-		SPADES_MARK_FUNCTION_DEBUG();
-		return h->TestError();
+	std::string ZipFileSystem::NormalizePath(const char *fn) {
+		std::string f = fn;
+		for(std::size_t i = 0; i < f.size(); i++) {
+			if(f[i] == '\\') f[i] = '/';
+			else f[i] = tolower(f[i]);
+		}
+		return f;
 	}
 	
-	zlib_filefunc_def ZipFileSystem::CreateZLibFileFunc() {
-		zlib_filefunc_def def;
-		def.opaque = this;
-		def.zopen_file = (open_file_func)InternalOpen;
-		def.zclose_file = (close_file_func)InternalClose;
-		def.zread_file = (read_file_func)InternalRead;
-		def.zwrite_file = (write_file_func)InternalWrite;
-		def.ztell_file = (tell_file_func)InternalTell;
-		def.zseek_file = (seek_file_func)InternalSeek;
-		def.zerror_file = (testerror_file_func)InternalTestError;
-		return def;
+	void ZipFileSystem::ReadAt(uint64_t offset, void *buf, std::size_t size) {
+		if(offset > baseLength || size > baseLength - offset) {
+			SPRaise("Attempted to read beyond the end of the ZIP stream.");
+		}
+		AutoLocker lock(&streamMutex);
+		baseStream->SetPosition(offset);
+		if(baseStream->Read(buf, size) < size) {
+			SPRaise("Unexpected end of the ZIP stream.");
+		}
 	}
 	
-#pragma mark - Zip file
-	
-	ZipFileSystem::ZipFileSystem(IStream *stream, bool autoClose):
-	baseStream(stream), autoClose(autoClose){
+	void ZipFileSystem::ReadCentralDirectory() {
 		SPADES_MARK_FUNCTION();
 		
-		cursorPos = stream->GetPosition();
-		zlib_filefunc_def def = CreateZLibFileFunc();
-		zip = unzOpen2("ZipFile.zip", &def);
-		if(!zip){
-			SPRaise("Failed to open ZIP stream.");
+		// find the end of central directory record, which is followed
+		// by a comment of variable length
+		if(baseLength < EndOfCentralDirSize) {
+			SPRaise("Failed to open ZIP stream: too short");
+		}
+		std::size_t tailSize = (std::size_t)std::min<uint64_t>(baseLength,
+															   EndOfCentralDirSize + MaxCommentSize);
+		std::vector<unsigned char> tail(tailSize);
+		ReadAt(baseLength - tailSize, tail.data(), tailSize);
+		
+		const unsigned char *eocd = nullptr;
+		for(std::size_t i = tailSize - EndOfCentralDirSize + 1; i > 0; i--) {
+			const unsigned char *p = tail.data() + i - 1;
+			if(ReadLE32(p) == EndOfCentralDirSignature) {
+				eocd = p;
+				break;
+			}
+		}
+		if(!eocd) {
+			SPRaise("Failed to open ZIP stream: end of central directory not found");
 		}
 		
-		currentStream = NULL;
-		
-		if(unzGoToFirstFile(zip) != UNZ_OK) {
-			SPRaise("There was a problem while seeking the zip file to the first file.");
+		uint16_t numEntries = ReadLE16(eocd + 10);
+		uint32_t dirSize = ReadLE32(eocd + 12);
+		uint32_t dirOffset = ReadLE32(eocd + 16);
+		if(numEntries == 0xffff || dirOffset == 0xffffffffU) {
+			SPRaise("Failed to open ZIP stream: ZIP64 is not supported");
 		}
 		
-		// create list of files
-		do{
-			char buf[513];
-			buf[512] = 0;
-			unzGetCurrentFileInfo(zip, nullptr,
-								  buf, 512, nullptr, 0, nullptr, 0);
-			
-			for(char *ptr = buf; *ptr; ptr++) {
-				if(*ptr == '\\') *ptr = '/';
-				else
-					*ptr = tolower(*ptr);
+		std::vector<unsigned char> dir(dirSize);
+		ReadAt(dirOffset, dir.data(), dirSize);
+		
+		std::size_t pos = 0;
+		files.reserve(numEntries);
+		for(int i = 0; i < numEntries; i++) {
+			if(pos + CentralHeaderSize > dir.size() ||
+			   ReadLE32(dir.data() + pos) != CentralHeaderSignature) {
+				SPRaise("Failed to open ZIP stream: central directory is corrupted");
 			}
-			
-			unz_file_pos pos;
-			if(unzGetFilePos(zip, &pos) != UNZ_OK) {
-				SPRaise("unzGetFilePos failed");
+			const unsigned char *h = dir.data() + pos;
+			Entry entry;
+			entry.method = ReadLE16(h + 10);
+			entry.crc = ReadLE32(h + 16);
+			entry.compressedSize = ReadLE32(h + 20);
+			entry.uncompressedSize = ReadLE32(h + 24);
+			uint16_t nameLen = ReadLE16(h + 28);
+			uint16_t extraLen = ReadLE16(h + 30);
+			uint16_t commentLen = ReadLE16(h + 32);
+			entry.localHeaderOffset = ReadLE32(h + 42);
+			if(pos + CentralHeaderSize + nameLen > dir.size()) {
+				SPRaise("Failed to open ZIP stream: central directory is corrupted");
 			}
-			files.insert(std::make_pair(buf, pos));
-		}while(unzGoToNextFile(zip) == UNZ_OK);
-		
+			entry.name.assign(reinterpret_cast<const char *>(h + CentralHeaderSize), nameLen);
+			pos += CentralHeaderSize + nameLen + extraLen + commentLen;
+			
+			// directories
+			if(entry.name.empty() || entry.name.back() == '/')
+				continue;
+			
+			files.insert(std::make_pair(NormalizePath(entry.name.c_str()), entry));
+		}
 	}
 	
-	ZipFileSystem::~ZipFileSystem() {
+	std::vector<char> ZipFileSystem::ReadEntry(const Entry& entry) {
 		SPADES_MARK_FUNCTION();
-		if(currentStream){
-			currentStream->ForceCloseUnzipFile();
+		
+		// the local header might have a different extra field
+		// from the central directory, so it has to be read here
+		unsigned char localHeader[LocalHeaderSize];
+		ReadAt(entry.localHeaderOffset, localHeader, LocalHeaderSize);
+		if(ReadLE32(localHeader) != LocalHeaderSignature) {
+			SPRaise("Corrupted ZIP entry: %s", entry.name.c_str());
+		}
+		uint64_t dataOffset = (uint64_t)entry.localHeaderOffset + LocalHeaderSize +
+		ReadLE16(localHeader + 26) + ReadLE16(localHeader + 28);
+		
+		std::vector<char> data;
+		if(entry.method == 0) {
+			// stored
+			data.resize(entry.uncompressedSize);
+			if(!data.empty())
+				ReadAt(dataOffset, data.data(), data.size());
+		}else if(entry.method == Z_DEFLATED) {
+			std::vector<char> compressed(entry.compressedSize);
+			if(!compressed.empty())
+				ReadAt(dataOffset, compressed.data(), compressed.size());
+			
+			// inflating doesn't need the lock
+			data.resize(entry.uncompressedSize);
+			z_stream zs;
+			memset(&zs, 0, sizeof(zs));
+			if(inflateInit2(&zs, -MAX_WBITS) != Z_OK) {
+				SPRaise("Failed to initialize zlib inflator.");
+			}
+			zs.next_in = reinterpret_cast<Bytef *>(compressed.data());
+			zs.avail_in = (uInt)compressed.size();
+			zs.next_out = reinterpret_cast<Bytef *>(data.data());
+			zs.avail_out = (uInt)data.size();
+			int ret = inflate(&zs, Z_FINISH);
+			inflateEnd(&zs);
+			if(ret != Z_STREAM_END || zs.avail_out != 0) {
+				SPRaise("Failed to inflate ZIP entry %s: zlib error %d",
+						entry.name.c_str(), ret);
+			}
+		}else{
+			SPRaise("Unsupported compression method %d: %s",
+					(int)entry.method, entry.name.c_str());
 		}
 		
-		unzClose(zip);
+		uLong crc = crc32(0L, Z_NULL, 0);
+		crc = crc32(crc, reinterpret_cast<const Bytef *>(data.data()), (uInt)data.size());
+		if(crc != entry.crc) {
+			SPRaise("CRC mismatch in ZIP entry: %s", entry.name.c_str());
+		}
+		return data;
 	}
 	
 	IStream *ZipFileSystem::OpenForReading(const char *fn) {
 		SPADES_MARK_FUNCTION();
 		
-		if(currentStream){
-			currentStream->ForceCloseUnzipFile();
-		}
-		
-		if(!MoveToFile(fn)) {
+		auto it = files.find(NormalizePath(fn));
+		if(it == files.end()) {
 			SPFileNotFound(fn);
 		}
 		
-		unzOpenCurrentFile(zip);
-		try{
-			currentStream = new ZipFileInputStream(this, zip);
-#if 0
-			return currentStream;
-#else
-			// load all data to allow seeking
-			DynamicMemoryStream *stream;
-			stream = new DynamicMemoryStream();
-			try{
-				char buf[4096];
-				size_t rd;
-				while((rd = currentStream->Read(buf, 4096)) > 0) {
-					stream->Write(buf, rd);
-				}
-				currentStream->ForceCloseUnzipFile();
-				stream->SetPosition(0);
-				delete currentStream;
-				return stream;
-			}catch(...){
-				delete stream;
-				delete currentStream;
-				throw;
-			}
-#endif
-		}catch(...){
-			unzCloseCurrentFile(zip);
-			throw;
-		}
+		std::vector<char> data = ReadEntry(it->second);
+		return new ZipEntryStream(data);
 	}
 	
 	IStream *ZipFileSystem::OpenForWriting(const char *fn){
@@ -387,94 +279,175 @@ namespace spades {
 		SPRaise("ZIP file system doesn't support writing");
 	}
 	
-	static bool MatchesZipFile(const char *fn, const char *path) {
-		for(size_t i = 0;; i++) {
-			if(path[i] == 0){
-				return true;
-			}
-			if(fn[i] == 0) {
-				return false;
-			}
-			if((fn[i] == '/' || fn[i] == '\\') &&
-			   (path[i] == '/' || path[i] == '\\')) {
-				continue;
-			}
-			if(tolower(fn[i]) != tolower(path[i]))
-				return false;
-		}
-	}
-	
 	std::vector<std::string> ZipFileSystem::EnumFiles(const char *path) {
+		SPADES_MARK_FUNCTION();
 		
-		if(currentStream){
-			currentStream->ForceCloseUnzipFile();
-		}
-		
-		if(unzGoToFirstFile(zip) != UNZ_OK) {
-			SPRaise("There was a problem while seeking the zip file to the first file.");
-		}
+		std::string prefix = NormalizePath(path);
+		if(!prefix.empty() && prefix.back() != '/')
+			prefix += '/';
 		
-		// FIXME: use `files` for faster search?
 		std::vector<std::string> lst;
-		size_t ln = strlen(path);
-		do{
-			char buf[513];
-			buf[512] = 0;
-			unzGetCurrentFileInfo(zip, nullptr,
-								  buf, 512, nullptr, 0, nullptr, 0);
-			
-			if(!MatchesZipFile(buf, path))
+		for(const auto& item: files) {
+			const std::string& key = item.first;
+			if(key.size() <= prefix.size() ||
+			   key.compare(0, prefix.size(), prefix) != 0)
 				continue;
 			
-			if(buf[ln] != '/' && buf[ln] != '\\') {
-				// similar but bad pattern
-				// path = foo
-				// fn   = foobar\text.txt
-				continue;
-			}
-			if(strchr(buf + ln + 1, '/') ||
-			   strchr(buf + ln + 1, '\\')) {
-				// similar but bad pattern
-				// path = foo
-				// fn   = foo\bar\text.txt
+			// files in subdirectories are not listed
+			if(key.find('/', prefix.size()) != std::string::npos)
 				continue;
-			}
-			lst.push_back(buf + ln + 1);
-		}while(unzGoToNextFile(zip) == UNZ_OK);
+			
+			lst.push_back(item.second.name.substr(prefix.size()));
+		}
 		
 		return lst;
 	}
 	
-	bool ZipFileSystem::MoveToFile(const char *fn) {
+	bool ZipFileSystem::FileExists(const char *fn) {
 		SPADES_MARK_FUNCTION();
-		
-		std::string f = fn;
-		for(std::size_t i = 0; i < f.size(); i++) {
-			if(f[i] == '\\') f[i] = '/';
-			else f[i] = tolower(f[i]);
-		}
-		
-		auto it = files.find(f);
-		if(it == files.end()) {
-			return false;
-		}
-		
-		if(unzGoToFilePos(zip, &it->second) != UNZ_OK) {
-			SPRaise("Failed to seek to the requested file.");
+		return files.find(NormalizePath(fn)) != files.end();
+	}
+	
+#pragma mark - minizip, for comparison in RunBenchmark
+	
+	namespace {
+		// the way ZipFileSystem used to read the archive: minizip
+		// on top of the base stream, one file at a time
+		struct MinizipHandle {
+			IStream *stream;
+			uint64_t pos;
+		};
+		
+		voidpf ZCALLBACK MinizipOpen(voidpf opaque, const char *, int) {
+			return new MinizipHandle{static_cast<IStream *>(opaque), 0};
+		}
+		uLong ZCALLBACK MinizipRead(voidpf, voidpf h, void *buf, uLong size) {
+			auto *handle = static_cast<MinizipHandle *>(h);
+			handle->stream->SetPosition(handle->pos);
+			size_t ret = handle->stream->Read(buf, size);
+			handle->pos += ret;
+			return (uLong)ret;
+		}
+		uLong ZCALLBACK MinizipWrite(voidpf, voidpf, const void *, uLong) {
+			return 0;
+		}
+		long ZCALLBACK MinizipTell(voidpf, voidpf h) {
+			return (long)static_cast<MinizipHandle *>(h)->pos;
+		}
+		long ZCALLBACK MinizipSeek(voidpf, voidpf h, uLong offset, int origin) {
+			auto *handle = static_cast<MinizipHandle *>(h);
+			switch(origin){
+				case ZLIB_FILEFUNC_SEEK_CUR:
+					handle->pos += offset;
+					break;
+				case ZLIB_FILEFUNC_SEEK_END:
+					handle->pos = handle->stream->GetLength() + offset;
+					break;
+				case ZLIB_FILEFUNC_SEEK_SET:
+					handle->pos = offset;
+					break;
+			}
+			return 0;
+		}
+		int ZCALLBACK MinizipClose(voidpf, voidpf h) {
+			delete static_cast<MinizipHandle *>(h);
+			return 0;
+		}
+		int ZCALLBACK MinizipTestError(voidpf, voidpf) {
+			return 0;
+		}
+		
+		/** reads every file in the archive with minizip. */
+		void ReadAllWithMinizip(IStream *stream) {
+			zlib_filefunc_def def;
+			def.opaque = stream;
+			def.zopen_file = MinizipOpen;
+			def.zclose_file = MinizipClose;
+			def.zread_file = MinizipRead;
+			def.zwrite_file = MinizipWrite;
+			def.ztell_file = MinizipTell;
+			def.zseek_file = MinizipSeek;
+			def.zerror_file = MinizipTestError;
+			
+			unzFile zip = unzOpen2("ZipFile.zip", &def);
+			if(!zip)
+				SPRaise("Failed to open ZIP stream with minizip.");
+			try{
+				int ret = unzGoToFirstFile(zip);
+				while(ret == UNZ_OK) {
+					if(unzOpenCurrentFile(zip) != UNZ_OK)
+						SPRaise("minizip failed to open a file");
+					std::vector<char> data;
+					char buf[4096];
+					int bytes;
+					while((bytes = unzReadCurrentFile(zip, buf, sizeof(buf))) > 0)
+						data.insert(data.end(), buf, buf + bytes);
+					unzCloseCurrentFile(zip);
+					if(bytes < 0)
+						SPRaise("Unzip error: 0x%08x", bytes);
+					ret = unzGoToNextFile(zip);
+				}
+			}catch(...){
+				unzClose(zip);
+				throw;
+			}
+			unzClose(zip);
 		}
-		return true;
 	}
 	
-	bool ZipFileSystem::FileExists(const char *fn) {
+	void ZipFileSystem::RunBenchmark() {
 		SPADES_MARK_FUNCTION();
 		
-		std::string f = fn;
-		for(std::size_t i = 0; i < f.size(); i++) {
-			if(f[i] == '\\') f[i] = '/';
-			else f[i] = tolower(f[i]);
-		}
-		
-		return files.find(f) != files.end();
+		std::vector<const Entry *> entries;
+		uint64_t totalBytes = 0;
+		for(const auto& item: files) {
+			entries.push_back(&item.second);
+			totalBytes += item.second.uncompressedSize;
+		}
+		
+		// minizip moves the base stream's cursor, so nothing else
+		// may read the archive meanwhile. it could only ever be used
+		// by one thread at a time, so there's no parallel run for it.
+		Stopwatch sw;
+		{
+			AutoLocker lock(&streamMutex);
+			ReadAllWithMinizip(baseStream);
+		}
+		double minizipTime = sw.GetTime();
+		
+		sw.Reset();
+		for(const Entry *e: entries)
+			ReadEntry(*e);
+		double sequentialTime = sw.GetTime();
+		
+		// every dispatch reads an interleaved subset of the entries
+		const int numWorkers = 4;
+		sw.Reset();
+		{
+			std::vector<std::unique_ptr<ConcurrentDispatch>> workers;
+			for(int i = 0; i < numWorkers; i++) {
+				auto f = [this, &entries, i]() {
+					try{
+						for(std::size_t j = i; j < entries.size(); j += numWorkers)
+							ReadEntry(*entries[j]);
+					}catch(const std::exception& ex) {
+						SPLog("ZIP benchmark failed: %s", ex.what());
+					}
+				};
+				workers.emplace_back(new FunctionDispatch<decltype(f)>(f));
+				workers.back()->Start();
+			}
+			for(auto& w: workers)
+				w->Join();
+		}
+		double parallelTime = sw.GetTime();
+		
+		double mb = (double)totalBytes / (1024. * 1024.);
+		SPLog("ZIP read benchmark: %d files, %.1f MB; minizip %.1f MB/s, "
+			  "sequential %.1f MB/s, %d threads %.1f MB/s",
+			  (int)entries.size(), mb,
+			  mb / std::max(minizipTime, 1.e-6),
+			  mb / std::max(sequentialTime, 1.e-6), numWorkers,
+			  mb / std::max(parallelTime, 1.e-6));
 	}
 }
-
@@ -18,57 +18,48 @@
  
  */
 
+
 #pragma once
 
 #include "IFileSystem.h"
+#include "Mutex.h"
 #include <stdint.h>
-#include <map>
 #include <string>
+#include <unordered_map>
+#include <vector>
 
-extern "C"{
-	typedef void *unzFile;
-	struct zlib_filefunc_def_s;
-	typedef struct zlib_filefunc_def_s zlib_filefunc_def;
-	struct unz_file_pos_s;
-}
-	
 namespace spades {
+	/** Read-only file system backed by a ZIP archive.
+	 * The central directory is parsed once into a hash index. Reads from
+	 * the archive are serialized by a mutex only while the raw entry data
+	 * is fetched from the base stream; each opened file is inflated on
+	 * the calling thread, so any number of threads can open files
+	 * concurrently. */
 	class ZipFileSystem: public IFileSystem {
-		class ZipFileInputStream;
-		class ZipFileHandle;
+		class ZipEntryStream;
+		
+		struct Entry {
+			std::string name; // as stored in the archive
+			uint16_t method;
+			uint32_t crc;
+			uint32_t compressedSize;
+			uint32_t uncompressedSize;
+			uint32_t localHeaderOffset;
+		};
 		
 		IStream *baseStream;
 		bool autoClose;
-		unzFile zip;
-		
-		std::map<std::string, unz_file_pos_s> files;
+		Mutex streamMutex;
+		uint64_t baseLength;
 		
-		ZipFileInputStream *currentStream;
+		// keys are lower-case paths with '/' as the separator
+		std::unordered_map<std::string, Entry> files;
 		
-		uint64_t cursorPos;
+		static std::string NormalizePath(const char *);
 		
-		static ZipFileHandle *InternalOpen(ZipFileSystem *fs,
-										   const char *fn,
-										   int mode);
-		
-		static uint32_t InternalRead(ZipFileSystem *fs,
-										   ZipFileHandle *h,
-										   void *buf, uint32_t size);
-		static uint32_t InternalWrite(ZipFileSystem *fs,
-										   ZipFileHandle *h,
-										   void *buf, uint32_t size);
-		static long InternalTell(ZipFileSystem *fs,
-									  ZipFileHandle *h);
-		static long InternalSeek(ZipFileSystem *fs,
-								 ZipFileHandle *h,
-								 int32_t offset, int origin);
-		static int InternalClose(ZipFileSystem *fs,
-								 ZipFileHandle *h);
-		static int InternalTestError(ZipFileSystem *fs,
-								 ZipFileHandle *h);
-		
-		zlib_filefunc_def CreateZLibFileFunc();
-		bool MoveToFile(const char *);
+		void ReadAt(uint64_t offset, void *buf, std::size_t size);
+		void ReadCentralDirectory();
+		std::vector<char> ReadEntry(const Entry&);
 	public:
 		ZipFileSystem(IStream *, bool autoClose = true);
 		virtual ~ZipFileSystem();
@@ -78,5 +69,10 @@ namespace spades {
 		virtual IStream *OpenForReading(const char *);
 		virtual IStream *OpenForWriting(const char *);
 		virtual bool FileExists(const char *);
+		
+		/** Reads every file in the archive with minizip, as this class
+		 * used to, then on the calling thread and on the dispatch
+		 * threads, and logs the throughput of each. */
+		void RunBenchmark();
 	};
 }
@@ -23,6 +23,7 @@
 #include "GLProgramManager.h"
 #include "../Core/Settings.h"
 #include "GLImage.h"
+#include "GLImageManager.h"
 
 namespace spades {
 	namespace draw {
@@ -55,7 +56,7 @@ namespace spades {
 										const GLDynamicLight& light,
 										int texStage) {
 			if(lastRenderer != renderer){
-				whiteImage = static_cast<GLImage *>(renderer->RegisterImage("Gfx/White.tga"));
+				whiteImage = renderer->imageManager->GetWhiteImage();
 				lastRenderer = renderer;
 			}
 			
@@ -34,7 +34,7 @@ namespace spades {
 		class GLProgramManager;
 		class GLDynamicLightShader{
 			GLRenderer *lastRenderer;
-			GLImage *whiteImage;
+			Borrowed<GLImage> whiteImage;
 			
 			GLProgramUniform dynamicLightOrigin;
 			GLProgramUniform dynamicLightColor;
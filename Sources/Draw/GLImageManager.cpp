@@ -20,8 +20,10 @@
 
 #include "GLImageManager.h"
 #include "GLImage.h"
+#include "GLSpriteAtlas.h"
 #include "IGLDevice.h"
 #include "../Core/Bitmap.h"
+#include "../Core/AssetPreloader.h"
 #include "../Core/FileManager.h"
 #include "../Core/IStream.h"
 #include "../Core/Debug.h"
@@ -30,41 +32,44 @@
 namespace spades {
 	namespace draw {
 		GLImageManager::GLImageManager(IGLDevice *dev):
-		device(dev),
-		whiteImage(nullptr) {
+		device(dev) {
 			SPADES_MARK_FUNCTION();
+			spriteAtlas = new GLSpriteAtlas(dev);
 		}
 		
 		GLImageManager::~GLImageManager() {
 			SPADES_MARK_FUNCTION();
-			if(whiteImage) {
-				whiteImage->Release();
-				whiteImage = nullptr;
-			}
+			delete spriteAtlas;
 			for(std::map<std::string, GLImage *>::iterator it = images.begin(); it != images.end(); it++){
 				it->second->Invalidate();
 				it->second->Release();
 			}
 		}
 		
-		GLImage *GLImageManager::RegisterImage(const std::string &name) {
+		Borrowed<GLImage> GLImageManager::GetImage(const std::string &name) {
 			SPADES_MARK_FUNCTION();
 			
 			std::map<std::string, GLImage *>::iterator it;
-			it = images.find(name);
-			if(it == images.end()){
+			it = images.lower_bound(name);
+			if(it == images.end() || it->first != name){
 				GLImage *img = CreateImage(name);
-				images[name] = img;
-				img->AddRef();
+				images.insert(it, std::make_pair(name, img));
 				return img;
 			}
-			it->second->AddRef();
 			return it->second;
 		}
 		
-		GLImage *GLImageManager::GetWhiteImage() {
+		GLImage *GLImageManager::RegisterImage(const std::string &name) {
+			SPADES_MARK_FUNCTION();
+			
+			GLImage *img = GetImage(name);
+			img->AddRef();
+			return img;
+		}
+		
+		Borrowed<GLImage> GLImageManager::GetWhiteImage() {
 			if(!whiteImage) {
-				whiteImage = RegisterImage("Gfx/White.tga");
+				whiteImage = GetImage("Gfx/White.tga");
 			}
 			return whiteImage;
 		}
@@ -72,9 +77,13 @@ namespace spades {
 		GLImage *GLImageManager::CreateImage(const std::string &name) {
 			SPADES_MARK_FUNCTION();
 			
-			Handle<Bitmap> bmp(Bitmap::Load(name),  false);
+			Handle<Bitmap> bmp(AssetPreloader::GetInstance().TakeBitmap(name), false);
+			if(!bmp)
+				bmp.Set(Bitmap::Load(name), false);
 			
-			return GLImage::FromBitmap(bmp, device);
+			GLImage *img = GLImage::FromBitmap(bmp, device);
+			spriteAtlas->Register(img, bmp);
+			return img;
 		}
 		
 		// draw all imaegs so that all textures are resident
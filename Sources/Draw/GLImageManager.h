@@ -23,25 +23,34 @@
 #include <vector>
 #include <string>
 #include <map>
+#include "../Core/RefCountedObject.h"
 
 namespace spades {
 	namespace draw {
 		class IGLDevice;
 		class GLImage;
 		class GLRenderer;
+		class GLSpriteAtlas;
 		
 		class GLImageManager {
 			IGLDevice *device;
 			std::map<std::string, GLImage *> images;
-			GLImage *whiteImage;
+			Borrowed<GLImage> whiteImage;
+			GLSpriteAtlas *spriteAtlas;
 			
 			GLImage *CreateImage(const std::string&);
 		public:
 			GLImageManager(IGLDevice *);
 			~GLImageManager();
 			
+			/** Returns a new reference; the caller must release it. */
 			GLImage *RegisterImage(const std::string&);
-			GLImage *GetWhiteImage();
+			/** Same as RegisterImage, but the image stays owned by
+			 * the manager; no reference is added. */
+			Borrowed<GLImage> GetImage(const std::string&);
+			/** Per-frame fallback image; owned by the manager. */
+			Borrowed<GLImage> GetWhiteImage();
+			GLSpriteAtlas *GetSpriteAtlas() { return spriteAtlas; }
 			
 			void DrawAllImages(GLRenderer *);
 		};
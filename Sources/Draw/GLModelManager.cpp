@@ -21,6 +21,7 @@
 #include "GLModelManager.h"
 #include "GLVoxelModel.h"
 #include "../Core/VoxelModel.h"
+#include "../Core/AssetPreloader.h"
 #include "../Core/FileManager.h"
 #include "../Core/IStream.h"
 #include "../Core/Debug.h"
@@ -46,29 +47,30 @@ namespace spades {
 		GLModel *GLModelManager::RegisterModel(const char *name){
 			SPADES_MARK_FUNCTION();
 			
+			std::string key = name;
 			std::map<std::string, GLModel *>::iterator it;
-			it = models.find(std::string(name));
-			if(it == models.end()){
+			it = models.lower_bound(key);
+			if(it == models.end() || it->first != key){
 				GLModel *m = CreateModel(name);
-				models[name] = m;
-				m->AddRef();
-				return m;
+				it = models.insert(it, std::make_pair(std::move(key), m));
 			}
-			it->second->AddRef(); // model manager owns this reference
+			it->second->AddRef(); // model manager owns its own reference
 			return it->second;
 		}
 		
 		GLModel *GLModelManager::CreateModel(const char *name) {
 			SPADES_MARK_FUNCTION();
 			
-			VoxelModel *bmp;
-			IStream *stream = FileManager::OpenForReading(name);
-			try{
-				bmp = VoxelModel::LoadKV6(stream);
-				delete stream;
-			}catch(...){
-				delete stream;
-				throw;
+			VoxelModel *bmp = AssetPreloader::GetInstance().TakeModel(name);
+			if(!bmp){
+				IStream *stream = FileManager::OpenForReading(name);
+				try{
+					bmp = VoxelModel::LoadKV6(stream);
+					delete stream;
+				}catch(...){
+					delete stream;
+					throw;
+				}
 			}
 			try{
 				GLModel *model = static_cast<GLModel *>(renderer->CreateModelOptimized(bmp)); //new GLVoxelModel(bmp, renderer);
@@ -35,6 +35,7 @@ namespace spades {
 		public:
 			GLModelManager(GLRenderer *);
 			~GLModelManager();
+			/** Returns a new reference; the caller must release it. */
 			GLModel *RegisterModel(const char *);
 		};
 	}
@@ -34,6 +34,9 @@
 #include <set>
 #include "../Core/Bitmap.h"
 #include "../Core/BitmapAtlasGenerator.h"
+#include "../Core/AssetCache.h"
+#include "../Core/Stopwatch.h"
+#include <cstring>
 
 namespace spades {
 	namespace draw {
@@ -50,8 +53,32 @@ namespace spades {
 			renderer = r;
 			device = r->GetGLDevice();
 			
-			BuildVertices(m);
-			GenerateTexture();
+			// the mesh generation is slow, so the result is cached
+			// with the hash of the voxels
+			Handle<Bitmap> atlas;
+			bool cached = false;
+			uint64_t key = 0;
+			char name[32];
+			if(AssetCache::IsEnabled()) {
+				Stopwatch sw;
+				key = HashVoxelModel(m);
+				sprintf(name, "%016llx", (unsigned long long)key);
+				double buildTime;
+				cached = LoadCachedMesh(name, key, atlas, buildTime);
+				if(cached)
+					AssetCache::Report(true, sw.GetTime(), buildTime);
+			}
+			if(!cached) {
+				Stopwatch sw;
+				BuildVertices(m);
+				atlas = GenerateTexture();
+				if(AssetCache::IsEnabled()) {
+					double buildTime = sw.GetTime();
+					AssetCache::Report(false, buildTime, buildTime);
+					StoreCachedMesh(name, key, atlas, buildTime);
+				}
+			}
+			image = static_cast<GLImage *>(renderer->CreateImage(atlas));
 			
 			program = renderer->RegisterProgram("Shaders/OptimizedVoxelModel.program");
 			dlightProgram = renderer->RegisterProgram("Shaders/OptimizedVoxelModelDynamicLit.program");
@@ -103,7 +130,79 @@ namespace spades {
 			device->DeleteBuffer(buffer);
 		}
 		
-		void GLOptimizedVoxelModel::GenerateTexture() {
+		uint64_t GLOptimizedVoxelModel::HashVoxelModel(VoxelModel *m) {
+			int dims[3] = {m->GetWidth(), m->GetHeight(), m->GetDepth()};
+			uint64_t h = HashSeed;
+			h = HashBytes(h, dims, sizeof(dims));
+			for(int y = 0; y < dims[1]; y++) {
+				for(int x = 0; x < dims[0]; x++) {
+					uint64_t bits = m->GetSolidBitsAt(x, y);
+					h = HashBytes(h, &bits, sizeof(bits));
+					// colors of air voxels are undefined
+					for(int z = 0; z < dims[2]; z++) {
+						if(bits & (1ULL << z)) {
+							uint32_t col = m->GetColor(x, y, z);
+							h = HashBytes(h, &col, sizeof(col));
+						}
+					}
+				}
+			}
+			return h;
+		}
+		
+		bool GLOptimizedVoxelModel::LoadCachedMesh(const std::string& name,
+												   uint64_t key,
+												   Handle<Bitmap>& atlas,
+												   double& buildTime) {
+			SPADES_MARK_FUNCTION();
+			std::string payload;
+			if(!AssetCache::Load("VoxelMesh", name, key, payload, buildTime))
+				return false;
+			
+			// numVertices, numIndices, atlas width, atlas height
+			uint32_t counts[4];
+			if(payload.size() < sizeof(counts))
+				return false;
+			std::memcpy(counts, payload.data(), sizeof(counts));
+			std::size_t vertexBytes = counts[0] * sizeof(Vertex);
+			std::size_t indexBytes = counts[1] * sizeof(uint32_t);
+			std::size_t pixelBytes = (std::size_t)counts[2] * counts[3] * sizeof(uint32_t);
+			if(payload.size() != sizeof(counts) + vertexBytes + indexBytes + pixelBytes)
+				return false;
+			
+			const char *ptr = payload.data() + sizeof(counts);
+			vertices.resize(counts[0]);
+			std::memcpy(vertices.data(), ptr, vertexBytes);
+			ptr += vertexBytes;
+			indices.resize(counts[1]);
+			std::memcpy(indices.data(), ptr, indexBytes);
+			ptr += indexBytes;
+			atlas.Set(new Bitmap((int)counts[2], (int)counts[3]), false);
+			std::memcpy(atlas->GetPixels(), ptr, pixelBytes);
+			return true;
+		}
+		
+		void GLOptimizedVoxelModel::StoreCachedMesh(const std::string& name,
+													uint64_t key,
+													Handle<Bitmap>& atlas,
+													double buildTime) {
+			SPADES_MARK_FUNCTION();
+			uint32_t counts[4] = {
+				(uint32_t)vertices.size(), (uint32_t)indices.size(),
+				(uint32_t)atlas->GetWidth(), (uint32_t)atlas->GetHeight()
+			};
+			std::string payload;
+			payload.append(reinterpret_cast<const char *>(counts), sizeof(counts));
+			payload.append(reinterpret_cast<const char *>(vertices.data()),
+						   vertices.size() * sizeof(Vertex));
+			payload.append(reinterpret_cast<const char *>(indices.data()),
+						   indices.size() * sizeof(uint32_t));
+			payload.append(reinterpret_cast<const char *>(atlas->GetPixels()),
+						   (std::size_t)counts[2] * counts[3] * sizeof(uint32_t));
+			AssetCache::Store("VoxelMesh", name, key, payload, buildTime);
+		}
+		
+		Handle<Bitmap> GLOptimizedVoxelModel::GenerateTexture() {
 			BitmapAtlasGenerator atlasGen;
 			std::map<Bitmap *, int> idx;
 			std::vector<IntVector3> poss;
@@ -139,7 +238,7 @@ namespace spades {
 			
 			std::vector<uint16_t>().swap(bmpIndex);
 			
-			image = static_cast<GLImage *>(renderer->CreateImage(bmp));
+			return bmp;
 		}
 		
 		uint8_t GLOptimizedVoxelModel::calcAOID(VoxelModel *m,
@@ -84,7 +84,13 @@ namespace spades {
 						   bool flip,
 						   VoxelModel *);
 			void BuildVertices(VoxelModel *);
-			void GenerateTexture();
+			Handle<Bitmap> GenerateTexture();
+			
+			static uint64_t HashVoxelModel(VoxelModel *);
+			bool LoadCachedMesh(const std::string& name, uint64_t key,
+								Handle<Bitmap>& atlas, double& buildTime);
+			void StoreCachedMesh(const std::string& name, uint64_t key,
+								 Handle<Bitmap>& atlas, double buildTime);
 		protected:
 			virtual ~GLOptimizedVoxelModel();
 		public:
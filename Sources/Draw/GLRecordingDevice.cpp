@@ -0,0 +1,694 @@
+/*
+ Copyright (c) 2013 yvt
+ 
+ This file is part of OpenSpades.
+ 
+ OpenSpades is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+ 
+ OpenSpades is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with OpenSpades.  If not, see <http://www.gnu.org/licenses/>.
+ 
+ */
+
+#include "GLRecordingDevice.h"
+#include "../Core/Debug.h"
+#include "../Core/Math.h"
+#include <cstdio>
+#include <cstring>
+
+namespace spades {
+	namespace draw {
+		
+		GLRecordingDevice::State::State():
+		activeTexture(0),
+		program(0),
+		depthMask(true),
+		depthFunc(IGLDevice::Less),
+		frontFace(IGLDevice::CCW) {
+			for(int i = 0; i < 4; i++) {
+				colorMask[i] = true;
+				blendColor[i] = 0.f;
+				viewport[i] = 0;
+				clearColor[i] = 0.f;
+			}
+			blendFunc[0] = blendFunc[2] = IGLDevice::One;
+			blendFunc[1] = blendFunc[3] = IGLDevice::Zero;
+			blendEquation[0] = blendEquation[1] = IGLDevice::Add;
+		}
+		
+		bool GLRecordingDevice::State::operator ==(const State& s) const {
+			return Diff(s).empty();
+		}
+		
+		static std::string KeyToString(unsigned int v) {
+			char buf[32];
+			sprintf(buf, "%u", v);
+			return buf;
+		}
+		static std::string KeyToString(int v) {
+			char buf[32];
+			sprintf(buf, "%d", v);
+			return buf;
+		}
+		template<class A, class B>
+		static std::string KeyToString(const std::pair<A, B>& v) {
+			return "(" + KeyToString(v.first) + ", " + KeyToString(v.second) + ")";
+		}
+		
+		template<class M>
+		static std::string DiffMap(const char *name, const M& a, const M& b) {
+			for(auto& item: a) {
+				auto it = b.find(item.first);
+				if(it == b.end() || it->second != item.second)
+					return std::string(name) + " " + KeyToString(item.first) + " differs";
+			}
+			for(auto& item: b) {
+				if(a.find(item.first) == a.end())
+					return std::string(name) + " " + KeyToString(item.first) + " differs";
+			}
+			return std::string();
+		}
+		
+		template<class T>
+		static std::string DiffArray(const char *name, const T *a, const T *b, int count) {
+			for(int i = 0; i < count; i++) {
+				if(a[i] != b[i])
+					return std::string(name) + "[" + KeyToString(i) + "] differs";
+			}
+			return std::string();
+		}
+		
+		std::string GLRecordingDevice::State::Diff(const State& s) const {
+			std::string d;
+			if(activeTexture != s.activeTexture) return "active texture differs";
+			if(program != s.program) return "program differs";
+			if(depthMask != s.depthMask) return "depth mask differs";
+			if(depthFunc != s.depthFunc) return "depth function differs";
+			if(frontFace != s.frontFace) return "front face differs";
+			if(!(d = DiffMap("texture binding", textures, s.textures)).empty()) return d;
+			if(!(d = DiffMap("buffer binding", buffers, s.buffers)).empty()) return d;
+			if(!(d = DiffMap("framebuffer binding", framebuffers, s.framebuffers)).empty()) return d;
+			if(!(d = DiffMap("capability", capabilities, s.capabilities)).empty()) return d;
+			if(!(d = DiffMap("vertex attrib array", vertexAttribArrays, s.vertexAttribArrays)).empty()) return d;
+			if(!(d = DiffMap("uniform", uniforms, s.uniforms)).empty()) return d;
+			if(!(d = DiffArray("color mask", colorMask, s.colorMask, 4)).empty()) return d;
+			if(!(d = DiffArray("blend function", blendFunc, s.blendFunc, 4)).empty()) return d;
+			if(!(d = DiffArray("blend equation", blendEquation, s.blendEquation, 2)).empty()) return d;
+			if(!(d = DiffArray("blend color", blendColor, s.blendColor, 4)).empty()) return d;
+			if(!(d = DiffArray("viewport", viewport, s.viewport, 4)).empty()) return d;
+			if(!(d = DiffArray("clear color", clearColor, s.clearColor, 4)).empty()) return d;
+			return d;
+		}
+		
+		GLRecordingDevice::GLRecordingDevice(Integer width, Integer height):
+		numCalls(0),
+		nextName(0),
+		width(width),
+		height(height) {
+		}
+		
+		GLRecordingDevice::~GLRecordingDevice() {
+		}
+		
+		void GLRecordingDevice::ResetStatistics() {
+			drawCalls.clear();
+			numCalls = 0;
+		}
+		
+		void GLRecordingDevice::SetUniform(Integer loc, uint32_t kind,
+										   const void *values, int count) {
+			// GL ignores location -1, and uniforms need a program
+			if(loc == -1 || state.program == 0)
+				return;
+			
+			auto key = std::make_pair(state.program, loc);
+			std::vector<uint32_t> data(count + 1);
+			data[0] = kind;
+			std::memcpy(data.data() + 1, values, sizeof(uint32_t) * count);
+			
+			// uniforms are zero after linking, so zero is not stored
+			bool zero = true;
+			for(int i = 1; i <= count; i++)
+				if(data[i] != 0) zero = false;
+			if(zero)
+				state.uniforms.erase(key);
+			else
+				state.uniforms[key] = data;
+		}
+		
+		template<class M>
+		static void Unbind(M& bindings, IGLDevice::UInteger name) {
+			for(auto it = bindings.begin(); it != bindings.end();) {
+				if(it->second == name)
+					it = bindings.erase(it);
+				else
+					++it;
+			}
+		}
+		
+		template<class M, class K, class V>
+		static void SetBinding(M& bindings, const K& key, V value) {
+			if(value)
+				bindings[key] = value;
+			else
+				bindings.erase(key);
+		}
+		
+		void GLRecordingDevice::DepthRange(Float near, Float far) {
+			numCalls++;
+		}
+		
+		void GLRecordingDevice::Viewport(Integer x, Integer y, Sizei width, Sizei height) {
+			numCalls++;
+			state.viewport[0] = x;
+			state.viewport[1] = y;
+			state.viewport[2] = (Integer)width;
+			state.viewport[3] = (Integer)height;
+		}
+		
+		void GLRecordingDevice::ClearDepth(Float p0) {
+			numCalls++;
+		}
+		
+		void GLRecordingDevice::ClearColor(Float p0, Float p1, Float p2, Float p3) {
+			numCalls++;
+			state.clearColor[0] = p0;
+			state.clearColor[1] = p1;
+			state.clearColor[2] = p2;
+			state.clearColor[3] = p3;
+		}
+		
+		void GLRecordingDevice::Clear(Enum p0) {
+			numCalls++;
+		}
+		
+		void GLRecordingDevice::Finish() {
+			numCalls++;
+		}
+		
+		void GLRecordingDevice::Flush() {
+			numCalls++;
+		}
+		
+		void GLRecordingDevice::DepthMask(bool p0) {
+			numCalls++;
+			state.depthMask = p0;
+		}
+		
+		void GLRecordingDevice::ColorMask(bool r, bool g, bool b, bool a) {
+			numCalls++;
+			state.colorMask[0] = r;
+			state.colorMask[1] = g;
+			state.colorMask[2] = b;
+			state.colorMask[3] = a;
+		}
+		
+		void GLRecordingDevice::FrontFace(Enum p0) {
+			numCalls++;
+			state.frontFace = p0;
+		}
+		
+		void GLRecordingDevice::Enable(Enum s, bool p1) {
+			numCalls++;
+			SetBinding(state.capabilities, (int)s, p1);
+		}
+		
+		IGLDevice::Integer GLRecordingDevice::GetInteger(Enum type) {
+			numCalls++;
+			return 0;
+		}
+		
+		const char *GLRecordingDevice::GetString(Enum type) {
+			numCalls++;
+			return "";
+		}
+		
+		const char *GLRecordingDevice::GetIndexedString(Enum type, UInteger p1) {
+			numCalls++;
+			return "";
+		}
+		
+		void GLRecordingDevice::BlendEquation(Enum mode) {
+			numCalls++;
+			state.blendEquation[0] = state.blendEquation[1] = mode;
+		}
+		
+		void GLRecordingDevice::BlendEquation(Enum rgb, Enum alpha) {
+			numCalls++;
+			state.blendEquation[0] = rgb;
+			state.blendEquation[1] = alpha;
+		}
+		
+		void GLRecordingDevice::BlendFunc(Enum src, Enum dest) {
+			numCalls++;
+			state.blendFunc[0] = state.blendFunc[2] = src;
+			state.blendFunc[1] = state.blendFunc[3] = dest;
+		}
+		
+		void GLRecordingDevice::BlendFunc(Enum srcRgb, Enum destRgb, Enum srcAlpha, Enum destAlpha) {
+			numCalls++;
+			state.blendFunc[0] = srcRgb;
+			state.blendFunc[1] = destRgb;
+			state.blendFunc[2] = srcAlpha;
+			state.blendFunc[3] = destAlpha;
+		}
+		
+		void GLRecordingDevice::BlendColor(Float r, Float g, Float b, Float a) {
+			numCalls++;
+			state.blendColor[0] = r;
+			state.blendColor[1] = g;
+			state.blendColor[2] = b;
+			state.blendColor[3] = a;
+		}
+		
+		void GLRecordingDevice::DepthFunc(Enum p0) {
+			numCalls++;
+			state.depthFunc = p0;
+		}
+		
+		void GLRecordingDevice::LineWidth(Float p0) {
+			numCalls++;
+		}
+		
+		IGLDevice::UInteger GLRecordingDevice::GenBuffer() {
+			numCalls++;
+			return ++nextName;
+		}
+		
+		void GLRecordingDevice::DeleteBuffer(UInteger p0) {
+			numCalls++;
+			Unbind(state.buffers, p0);
+		}
+		
+		void GLRecordingDevice::BindBuffer(Enum p0, UInteger p1) {
+			numCalls++;
+			SetBinding(state.buffers, (int)p0, p1);
+		}
+		
+		void *GLRecordingDevice::MapBuffer(Enum target, Enum access) {
+			numCalls++;
+			return NULL;
+		}
+		
+		void GLRecordingDevice::UnmapBuffer(Enum target) {
+			numCalls++;
+		}
+		
+		void GLRecordingDevice::BufferData(Enum target, Sizei size, const void *data, Enum usage) {
+			numCalls++;
+		}
+		
+		void GLRecordingDevice::BufferSubData(Enum target, Sizei offset, Sizei size, const void *data) {
+			numCalls++;
+		}
+		
+		IGLDevice::UInteger GLRecordingDevice::GenQuery() {
+			numCalls++;
+			return ++nextName;
+		}
+		
+		void GLRecordingDevice::DeleteQuery(UInteger p0) {
+			numCalls++;
+		}
+		
+		void GLRecordingDevice::BeginQuery(Enum target, UInteger query) {
+			numCalls++;
+		}
+		
+		void GLRecordingDevice::EndQuery(Enum target) {
+			numCalls++;
+		}
+		
+		IGLDevice::UInteger GLRecordingDevice::GetQueryObjectUInteger(UInteger query, Enum pname) {
+			numCalls++;
+			return pname == QueryResultAvailable ? 1 : 0;
+		}
+		
+		void GLRecordingDevice::BeginConditionalRender(UInteger query, Enum p1) {
+			numCalls++;
+		}
+		
+		void GLRecordingDevice::EndConditionalRender() {
+			numCalls++;
+		}
+		
+		IGLDevice::UInteger GLRecordingDevice::GenTexture() {
+			numCalls++;
+			return ++nextName;
+		}
+		
+		void GLRecordingDevice::DeleteTexture(UInteger p0) {
+			numCalls++;
+			// bindings of a deleted texture revert to zero
+			Unbind(state.textures, p0);
+		}
+		
+		void GLRecordingDevice::ActiveTexture(UInteger stage) {
+			numCalls++;
+			state.activeTexture = stage;
+		}
+		
+		void GLRecordingDevice::BindTexture(Enum p0, UInteger p1) {
+			numCalls++;
+			SetBinding(state.textures, std::make_pair(state.activeTexture, (int)p0), p1);
+		}
+		
+		void GLRecordingDevice::TexParamater(Enum target, Enum paramater, Enum value) {
+			numCalls++;
+		}
+		
+		void GLRecordingDevice::TexParamater(Enum target, Enum paramater, float value) {
+			numCalls++;
+		}
+		
+		void GLRecordingDevice::TexImage2D(Enum target, Integer level, Enum internalFormat, Sizei width, Sizei height, Integer border, Enum format, Enum type, const void *data) {
+			numCalls++;
+		}
+		
+		void GLRecordingDevice::TexImage3D(Enum target, Integer level, Enum internalFormat, Sizei width, Sizei height, Sizei depth, Integer border, Enum format, Enum type, const void *data) {
+			numCalls++;
+		}
+		
+		void GLRecordingDevice::TexSubImage2D(Enum target, Integer level, Integer x, Integer y, Sizei width, Sizei height, Enum format, Enum type, const void *data) {
+			numCalls++;
+		}
+		
+		void GLRecordingDevice::TexSubImage3D(Enum target, Integer level, Integer x, Integer y, Integer z, Sizei width, Sizei height, Sizei depth, Enum format, Enum type, const void *data) {
+			numCalls++;
+		}
+		
+		void GLRecordingDevice::CopyTexSubImage2D(Enum target, Integer level, Integer destinationX, Integer destinationY, Integer srcX, Integer srcY, Sizei width, Sizei height) {
+			numCalls++;
+		}
+		
+		void GLRecordingDevice::GenerateMipmap(Enum target) {
+			numCalls++;
+		}
+		
+		void GLRecordingDevice::VertexAttrib(UInteger index, Float p1) {
+			numCalls++;
+		}
+		
+		void GLRecordingDevice::VertexAttrib(UInteger index, Float p1, Float p2) {
+			numCalls++;
+		}
+		
+		void GLRecordingDevice::VertexAttrib(UInteger index, Float p1, Float p2, Float p3) {
+			numCalls++;
+		}
+		
+		void GLRecordingDevice::VertexAttrib(UInteger index, Float p1, Float p2, Float p3, Float p4) {
+			numCalls++;
+		}
+		
+		void GLRecordingDevice::VertexAttribPointer(UInteger index, Integer size, Enum type, bool normalized, Sizei stride, const void *p5) {
+			numCalls++;
+		}
+		
+		void GLRecordingDevice::VertexAttribIPointer(UInteger index, Integer size, Enum type, Sizei stride, const void *p4) {
+			numCalls++;
+		}
+		
+		void GLRecordingDevice::EnableVertexAttribArray(UInteger index, bool p1) {
+			numCalls++;
+			SetBinding(state.vertexAttribArrays, index, p1);
+		}
+		
+		void GLRecordingDevice::VertexAttribDivisor(UInteger index, UInteger divisor) {
+			numCalls++;
+		}
+		
+		void GLRecordingDevice::DrawArrays(Enum mode, Integer first, Sizei count) {
+			numCalls++;
+			DrawCall call;
+			auto it = state.textures.find(std::make_pair(state.activeTexture, (int)Texture2D));
+			call.texture = it == state.textures.end() ? 0 : it->second;
+			call.program = state.program;
+			call.count = count;
+			drawCalls.push_back(call);
+		}
+		
+		void GLRecordingDevice::DrawElements(Enum mode, Sizei count, Enum type, const void *indices) {
+			numCalls++;
+			DrawCall call;
+			auto it = state.textures.find(std::make_pair(state.activeTexture, (int)Texture2D));
+			call.texture = it == state.textures.end() ? 0 : it->second;
+			call.program = state.program;
+			call.count = count;
+			drawCalls.push_back(call);
+		}
+		
+		void GLRecordingDevice::DrawArraysInstanced(Enum mode, Integer first, Sizei count, Sizei instances) {
+			numCalls++;
+			DrawCall call;
+			auto it = state.textures.find(std::make_pair(state.activeTexture, (int)Texture2D));
+			call.texture = it == state.textures.end() ? 0 : it->second;
+			call.program = state.program;
+			call.count = count;
+			drawCalls.push_back(call);
+		}
+		
+		void GLRecordingDevice::DrawElementsInstanced(Enum mode, Sizei count, Enum type, const void *indices, Sizei instances) {
+			numCalls++;
+			DrawCall call;
+			auto it = state.textures.find(std::make_pair(state.activeTexture, (int)Texture2D));
+			call.texture = it == state.textures.end() ? 0 : it->second;
+			call.program = state.program;
+			call.count = count;
+			drawCalls.push_back(call);
+		}
+		
+		IGLDevice::UInteger GLRecordingDevice::CreateShader(Enum type) {
+			numCalls++;
+			return ++nextName;
+		}
+		
+		void GLRecordingDevice::ShaderSource(UInteger shader, Sizei count, const char **string, const int *len) {
+			numCalls++;
+		}
+		
+		void GLRecordingDevice::CompileShader(UInteger p0) {
+			numCalls++;
+		}
+		
+		void GLRecordingDevice::DeleteShader(UInteger p0) {
+			numCalls++;
+		}
+		
+		IGLDevice::Integer GLRecordingDevice::GetShaderInteger(UInteger shader, Enum param) {
+			numCalls++;
+			return param == CompileStatus ? 1 : 0;
+		}
+		
+		void GLRecordingDevice::GetShaderInfoLog(UInteger shader, Sizei bufferSize, Sizei *length, char *outString) {
+			numCalls++;
+			if(length)
+				*length = 0;
+			if(bufferSize > 0)
+				outString[0] = 0;
+		}
+		
+		IGLDevice::Integer GLRecordingDevice::GetProgramInteger(UInteger program, Enum param) {
+			numCalls++;
+			return param == LinkStatus ? 1 : 0;
+		}
+		
+		void GLRecordingDevice::GetProgramInfoLog(UInteger program, Sizei bufferSize, Sizei *length, char *outString) {
+			numCalls++;
+			if(length)
+				*length = 0;
+			if(bufferSize > 0)
+				outString[0] = 0;
+		}
+		
+		IGLDevice::UInteger GLRecordingDevice::CreateProgram() {
+			numCalls++;
+			return ++nextName;
+		}
+		
+		void GLRecordingDevice::AttachShader(UInteger program, UInteger shader) {
+			numCalls++;
+		}
+		
+		void GLRecordingDevice::DetachShader(UInteger program, UInteger shader) {
+			numCalls++;
+		}
+		
+		void GLRecordingDevice::LinkProgram(UInteger program) {
+			numCalls++;
+			// linking resets the uniforms
+			for(auto it = state.uniforms.begin(); it != state.uniforms.end();) {
+				if(it->first.first == program)
+					it = state.uniforms.erase(it);
+				else
+					++it;
+			}
+		}
+		
+		void GLRecordingDevice::UseProgram(UInteger program) {
+			numCalls++;
+			state.program = program;
+		}
+		
+		void GLRecordingDevice::DeleteProgram(UInteger program) {
+			numCalls++;
+			// a program in use stays alive until it is unbound
+			if(program != state.program)
+				LinkProgram(program);
+		}
+		
+		void GLRecordingDevice::ValidateProgram(UInteger program) {
+			numCalls++;
+		}
+		
+		IGLDevice::Integer GLRecordingDevice::GetAttribLocation(UInteger program, const char *name) {
+			numCalls++;
+			return -1;
+		}
+		
+		void GLRecordingDevice::BindAttribLocation(UInteger program, UInteger index, const char *name) {
+			numCalls++;
+		}
+		
+		IGLDevice::Integer GLRecordingDevice::GetUniformLocation(UInteger program, const char *name) {
+			numCalls++;
+			return -1;
+		}
+		
+		void GLRecordingDevice::Uniform(Integer loc, Float p1) {
+			numCalls++;
+			SetUniform(loc, 1, &p1, 1);
+		}
+		
+		void GLRecordingDevice::Uniform(Integer loc, Float p1, Float p2) {
+			numCalls++;
+			Float v[] = {p1, p2};
+			SetUniform(loc, 2, v, 2);
+		}
+		
+		void GLRecordingDevice::Uniform(Integer loc, Float p1, Float p2, Float p3) {
+			numCalls++;
+			Float v[] = {p1, p2, p3};
+			SetUniform(loc, 3, v, 3);
+		}
+		
+		void GLRecordingDevice::Uniform(Integer loc, Float p1, Float p2, Float p3, Float p4) {
+			numCalls++;
+			Float v[] = {p1, p2, p3, p4};
+			SetUniform(loc, 4, v, 4);
+		}
+		
+		void GLRecordingDevice::Uniform(Integer loc, Integer p1) {
+			numCalls++;
+			SetUniform(loc, 5, &p1, 1);
+		}
+		
+		void GLRecordingDevice::Uniform(Integer loc, Integer p1, Integer p2) {
+			numCalls++;
+			Integer v[] = {p1, p2};
+			SetUniform(loc, 6, v, 2);
+		}
+		
+		void GLRecordingDevice::Uniform(Integer loc, Integer p1, Integer p2, Integer p3) {
+			numCalls++;
+			Integer v[] = {p1, p2, p3};
+			SetUniform(loc, 7, v, 3);
+		}
+		
+		void GLRecordingDevice::Uniform(Integer loc, Integer p1, Integer p2, Integer p3, Integer p4) {
+			numCalls++;
+			Integer v[] = {p1, p2, p3, p4};
+			SetUniform(loc, 8, v, 4);
+		}
+		
+		void GLRecordingDevice::Uniform(Integer loc, bool transpose, const Matrix4& p2) {
+			numCalls++;
+			Matrix4 m = transpose ? p2.Transposed() : p2;
+			SetUniform(loc, 9, m.m, 16);
+		}
+		
+		IGLDevice::UInteger GLRecordingDevice::GenRenderbuffer() {
+			numCalls++;
+			return ++nextName;
+		}
+		
+		void GLRecordingDevice::DeleteRenderbuffer(UInteger p0) {
+			numCalls++;
+		}
+		
+		void GLRecordingDevice::BindRenderbuffer(Enum target, UInteger p1) {
+			numCalls++;
+		}
+		
+		void GLRecordingDevice::RenderbufferStorage(Enum target, Enum internalFormat, Sizei width, Sizei height) {
+			numCalls++;
+		}
+		
+		void GLRecordingDevice::RenderbufferStorage(Enum target, Sizei samples, Enum internalFormat, Sizei width, Sizei height) {
+			numCalls++;
+		}
+		
+		IGLDevice::UInteger GLRecordingDevice::GenFramebuffer() {
+			numCalls++;
+			return ++nextName;
+		}
+		
+		void GLRecordingDevice::BindFramebuffer(Enum target, UInteger framebuffer) {
+			numCalls++;
+			if(target == Framebuffer) {
+				SetBinding(state.framebuffers, (int)ReadFramebuffer, framebuffer);
+				SetBinding(state.framebuffers, (int)DrawFramebuffer, framebuffer);
+			}else{
+				SetBinding(state.framebuffers, (int)target, framebuffer);
+			}
+		}
+		
+		void GLRecordingDevice::DeleteFramebuffer(UInteger p0) {
+			numCalls++;
+			Unbind(state.framebuffers, p0);
+		}
+		
+		void GLRecordingDevice::FramebufferTexture2D(Enum target, Enum attachment, Enum texTarget, UInteger texture, Integer level) {
+			numCalls++;
+		}
+		
+		void GLRecordingDevice::FramebufferRenderbuffer(Enum target, Enum attachment, Enum renderbufferTarget, UInteger renderbuffer) {
+			numCalls++;
+		}
+		
+		void GLRecordingDevice::BlitFramebuffer(Integer srcX0, Integer srcY0, Integer srcX1, Integer srcY1, Integer dstX0, Integer dstY0, Integer dstX1, Integer dstY1, UInteger mask, Enum filter) {
+			numCalls++;
+		}
+		
+		IGLDevice::Enum GLRecordingDevice::CheckFramebufferStatus(Enum target) {
+			numCalls++;
+			return FramebufferComplete;
+		}
+		
+		void GLRecordingDevice::ReadPixels(Integer x, Integer y, Sizei width, Sizei height, Enum format, Enum type, void *data) {
+			numCalls++;
+		}
+		
+		IGLDevice::Integer GLRecordingDevice::ScreenWidth() {
+			numCalls++;
+			return width;
+		}
+		
+		IGLDevice::Integer GLRecordingDevice::ScreenHeight() {
+			numCalls++;
+			return height;
+		}
+		
+		void GLRecordingDevice::Swap() {
+			numCalls++;
+		}
+	}
+}
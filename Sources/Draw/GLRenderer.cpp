@@ -62,6 +62,8 @@
 #include "GLDepthOfFieldFilter.h"
 #include "GLLensDustFilter.h"
 #include "GLSoftLitSpriteRenderer.h"
+#include "GLSpriteAtlas.h"
+#include <Core/Profiler.h>
 
 SPADES_SETTING(r_water, "2");
 SPADES_SETTING(r_bloom, "1");
@@ -255,6 +257,10 @@ namespace spades {
 			return imageManager->RegisterImage(filename);
 		}
 		
+		GLSpriteAtlas *GLRenderer::GetSpriteAtlas() {
+			return imageManager->GetSpriteAtlas();
+		}
+		
 		client::IModel *GLRenderer::RegisterModel(const char *filename){
 			SPADES_MARK_FUNCTION();
 			return modelManager->RegisterModel(filename);
@@ -486,6 +492,7 @@ namespace spades {
 			spriteRenderer->Clear();
 			longSpriteRenderer->Clear();
 			modelRenderer->Clear();
+			imageManager->GetSpriteAtlas()->Update();
 			lights.clear();
 			
 			device->DepthMask(true);
@@ -626,6 +633,7 @@ namespace spades {
 		}
 		
 		void GLRenderer::RenderObjects() {
+			SPADES_PROFILE_ZONE("GLRenderer::RenderObjects");
 			
 			device->Enable(IGLDevice::DepthTest, true);
 			device->Enable(IGLDevice::Texture2D, true);
@@ -673,6 +681,7 @@ namespace spades {
 		
 		void GLRenderer::EndScene() {
 			SPADES_MARK_FUNCTION();
+			SPADES_PROFILE_ZONE("GLRenderer::EndScene");
 			
 			EnsureInitialized();
 			EnsureSceneStarted();
@@ -1177,6 +1186,7 @@ namespace spades {
 		
 		void GLRenderer::FrameDone() {
 			SPADES_MARK_FUNCTION();
+			SPADES_PROFILE_ZONE("GLRenderer::FrameDone");
 			
 			EnsureSceneNotStarted();
 			
@@ -1214,6 +1224,7 @@ namespace spades {
 		
 		void GLRenderer::Flip() {
 			SPADES_MARK_FUNCTION();
+			SPADES_PROFILE_ZONE("GLRenderer::Flip");
 			
 			EnsureSceneNotStarted();
 			device->Swap();
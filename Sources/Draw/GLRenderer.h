@@ -51,12 +51,14 @@ namespace spades {
 		class GLRadiosityRenderer;
 		class GLLensDustFilter;
 		class GLSoftLitSpriteRenderer;
+		class GLSpriteAtlas;
 		
 		class GLRenderer: public client::IRenderer, public client::IGameMapListener  {
 			friend class GLShadowShader;
 			friend class IGLShadowMapRenderer;
 			friend class GLRadiosityRenderer;
 			friend class GLSoftLitSpriteRenderer;
+			friend class GLDynamicLightShader;
 			
 			struct DebugLine{
 				Vector3 v1, v2;
@@ -196,6 +198,7 @@ namespace spades {
 			GLMapShadowRenderer *GetMapShadowRenderer() { return mapShadowRenderer; }
 			GLRadiosityRenderer *GetRadiosityRenderer() { return radiosityRenderer; }
 			GLModelRenderer *GetModelRenderer() { return modelRenderer; }
+			GLSpriteAtlas *GetSpriteAtlas();
 			
 			const Matrix4& GetProjectionMatrix() const { return projectionMatrix; }
 			const Matrix4& GetProjectionViewMatrix() const { return projectionViewMatrix; }
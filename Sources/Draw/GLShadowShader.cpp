@@ -30,6 +30,7 @@
 #include "GLRadiosityRenderer.h"
 #include "GLSparseShadowMapRenderer.h"
 #include "GLImage.h"
+#include "GLImageManager.h"
 
 SPADES_SETTING(r_mapSoftShadow, "0");
 SPADES_SETTING(r_radiosity, "0");
@@ -142,7 +143,7 @@ namespace spades {
 								 renderer->mapShadowRenderer->GetTexture());
 			}else{
 				// TODO: do this case properly
-				GLImage *img = (GLImage*)renderer->RegisterImage("Gfx/White.tga");
+				GLImage *img = renderer->imageManager->GetWhiteImage();
 				img->Bind(IGLDevice::Texture2D);
 				
 			}
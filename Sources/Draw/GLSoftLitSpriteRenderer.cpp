@@ -24,6 +24,7 @@
 #include "../Core/Debug.h"
 #include "GLProgram.h"
 #include "GLImage.h"
+#include "GLSpriteAtlas.h"
 #include "GLFramebufferManager.h"
 #include "GLQuadRenderer.h"
 #include "GLProfiler.h"
@@ -33,6 +34,7 @@
 #include "SWFeatureLevel.h"
 
 SPADES_SETTING(r_hdr, "");
+SPADES_SETTING(r_spriteSort, "1");
 
 namespace spades {
 	namespace draw {
@@ -45,6 +47,7 @@ namespace spades {
 		positionAttribute("positionAttribute"),
 		spritePosAttribute("spritePosAttribute"),
 		colorAttribute("colorAttribute"),
+		texCoordAttribute("texCoordAttribute"),
 		texture("texture"),
 		viewMatrix("viewMatrix"),
 		fogDistance("fogDistance"),
@@ -73,8 +76,10 @@ namespace spades {
 										  Vector4 color){
 			SPADES_MARK_FUNCTION_DEBUG();
 			const client::SceneDefinition& def = renderer->GetSceneDef();
+			GLSpriteAtlas::Entry entry = renderer->GetSpriteAtlas()->Get(img);
 			Sprite spr;
-			spr.image = img;
+			spr.image = entry.texture;
+			spr.texCoords = entry.texCoords;
 			spr.center = center;
 			spr.radius = rad;
 			spr.angle = ang;
@@ -209,6 +214,8 @@ namespace spades {
 			
 			
 			lastImage = NULL;
+			if(r_spriteSort)
+				GLSpriteAtlas::SortByTexture(sprites);
 			program->Use();
 			
 			device->Enable(IGLDevice::Blend, true);
@@ -229,6 +236,7 @@ namespace spades {
 			positionAttribute(program);
 			spritePosAttribute(program);
 			colorAttribute(program);
+			texCoordAttribute(program);
 			emissionAttribute(program);
 			dlRAttribute(program);
 			dlGAttribute(program);
@@ -271,6 +279,7 @@ namespace spades {
 			device->EnableVertexAttribArray(positionAttribute(), true);
 			device->EnableVertexAttribArray(spritePosAttribute(), true);
 			device->EnableVertexAttribArray(colorAttribute(), true);
+			device->EnableVertexAttribArray(texCoordAttribute(), true);
 			device->EnableVertexAttribArray(emissionAttribute(), true);
 			device->EnableVertexAttribArray(dlRAttribute(), true);
 			device->EnableVertexAttribArray(dlGAttribute(), true);
@@ -311,12 +320,16 @@ namespace spades {
 					
 					uint32_t idx = (uint32_t)vertices.size();
 					v.sx = -1; v.sy = -1;
+					v.u = spr.texCoords.min.x; v.v = spr.texCoords.min.y;
 					vertices.push_back(v);
 					v.sx = 1; v.sy = -1;
+					v.u = spr.texCoords.max.x; v.v = spr.texCoords.min.y;
 					vertices.push_back(v);
 					v.sx = -1; v.sy = 1;
+					v.u = spr.texCoords.min.x; v.v = spr.texCoords.max.y;
 					vertices.push_back(v);
 					v.sx = 1; v.sy = 1;
+					v.u = spr.texCoords.max.x; v.v = spr.texCoords.max.y;
 					vertices.push_back(v);
 					
 					indices.push_back(idx);
@@ -374,12 +387,16 @@ namespace spades {
 					
 					uint32_t idx = (uint32_t)vertices.size();
 					v.sx = -1; v.sy = -1;
+					v.u = spr.texCoords.min.x; v.v = spr.texCoords.min.y;
 					vertices.push_back(v);
 					v.sx = 1; v.sy = -1;
+					v.u = spr.texCoords.max.x; v.v = spr.texCoords.min.y;
 					vertices.push_back(v);
 					v.sx = -1; v.sy = 1;
+					v.u = spr.texCoords.min.x; v.v = spr.texCoords.max.y;
 					vertices.push_back(v);
 					v.sx = 1; v.sy = 1;
+					v.u = spr.texCoords.max.x; v.v = spr.texCoords.max.y;
 					vertices.push_back(v);
 					
 					indices.push_back(idx);
@@ -403,6 +420,7 @@ namespace spades {
 			device->EnableVertexAttribArray(positionAttribute(), false);
 			device->EnableVertexAttribArray(spritePosAttribute(), false);
 			device->EnableVertexAttribArray(colorAttribute(), false);
+			device->EnableVertexAttribArray(texCoordAttribute(), false);
 			device->EnableVertexAttribArray(emissionAttribute(), false);
 			device->EnableVertexAttribArray(dlRAttribute(), false);
 			device->EnableVertexAttribArray(dlGAttribute(), false);
@@ -501,6 +519,10 @@ namespace spades {
 										4, IGLDevice::FloatType,
 										false, sizeof(Vertex),
 										&(vertices[0].color));
+			device->VertexAttribPointer(texCoordAttribute(),
+										2, IGLDevice::FloatType,
+										false, sizeof(Vertex),
+										&(vertices[0].u));
 			device->VertexAttribPointer(emissionAttribute(),
 										3, IGLDevice::FloatType,
 										false, sizeof(Vertex),
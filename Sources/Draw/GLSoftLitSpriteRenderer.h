@@ -34,7 +34,9 @@ namespace spades {
 		class GLImage;
 		class GLSoftLitSpriteRenderer: public IGLSpriteRenderer {
 			struct Sprite {
+				/** texture to bind; might be an atlas page. */
 				GLImage *image;
+				AABB2 texCoords;
 				Vector3 center;
 				float radius;
 				float angle;
@@ -53,6 +55,9 @@ namespace spades {
 				float sx, sy;
 				float angle;
 				
+				// texture coord
+				float u, v;
+				
 				// color
 				Vector4 color;
 				Vector3 emission;
@@ -86,6 +91,7 @@ namespace spades {
 			GLProgramAttribute positionAttribute;
 			GLProgramAttribute spritePosAttribute;
 			GLProgramAttribute colorAttribute;
+			GLProgramAttribute texCoordAttribute;
 			GLProgramAttribute emissionAttribute;
 			GLProgramAttribute dlRAttribute;
 			GLProgramAttribute dlGAttribute;
@@ -24,6 +24,7 @@
 #include "../Core/Debug.h"
 #include "GLProgram.h"
 #include "GLImage.h"
+#include "GLSpriteAtlas.h"
 #include "GLFramebufferManager.h"
 #include "GLQuadRenderer.h"
 #include "GLProfiler.h"
@@ -31,6 +32,7 @@
 #include "SWFeatureLevel.h"
 
 SPADES_SETTING(r_hdr, "");
+SPADES_SETTING(r_spriteSort, "1");
 
 namespace spades {
 	namespace draw {
@@ -43,6 +45,7 @@ namespace spades {
 		positionAttribute("positionAttribute"),
 		spritePosAttribute("spritePosAttribute"),
 		colorAttribute("colorAttribute"),
+		texCoordAttribute("texCoordAttribute"),
 		texture("texture"),
 		viewMatrix("viewMatrix"),
 		fogDistance("fogDistance"),
@@ -67,8 +70,10 @@ namespace spades {
 								   Vector4 color){
 			SPADES_MARK_FUNCTION_DEBUG();
 			const client::SceneDefinition& def = renderer->GetSceneDef();
+			GLSpriteAtlas::Entry entry = renderer->GetSpriteAtlas()->Get(img);
 			Sprite spr;
-			spr.image = img;
+			spr.image = entry.texture;
+			spr.texCoords = entry.texCoords;
 			spr.center = center;
 			spr.radius = rad;
 			spr.angle = ang;
@@ -107,6 +112,8 @@ namespace spades {
 		void GLSoftSpriteRenderer::Render() {
 			SPADES_MARK_FUNCTION();
 			lastImage = NULL;
+			if(r_spriteSort)
+				GLSpriteAtlas::SortByTexture(sprites);
 			program->Use();
 			
 			device->Enable(IGLDevice::Blend, true);
@@ -127,6 +134,7 @@ namespace spades {
 			positionAttribute(program);
 			spritePosAttribute(program);
 			colorAttribute(program);
+			texCoordAttribute(program);
 			
 			projectionViewMatrix.SetValue(renderer->GetProjectionViewMatrix());
 			viewMatrix.SetValue(renderer->GetViewMatrix());
@@ -162,6 +170,7 @@ namespace spades {
 			device->EnableVertexAttribArray(positionAttribute(), true);
 			device->EnableVertexAttribArray(spritePosAttribute(), true);
 			device->EnableVertexAttribArray(colorAttribute(), true);
+			device->EnableVertexAttribArray(texCoordAttribute(), true);
 			
 			thresLow = tanf(def.fovX * .5f) * tanf(def.fovY * .5f) * 1.8f;
 			thresRange = thresLow * .5f;
@@ -199,12 +208,16 @@ namespace spades {
 					
 					uint32_t idx = (uint32_t)vertices.size();
 					v.sx = -1; v.sy = -1;
+					v.u = spr.texCoords.min.x; v.v = spr.texCoords.min.y;
 					vertices.push_back(v);
 					v.sx = 1; v.sy = -1;
+					v.u = spr.texCoords.max.x; v.v = spr.texCoords.min.y;
 					vertices.push_back(v);
 					v.sx = -1; v.sy = 1;
+					v.u = spr.texCoords.min.x; v.v = spr.texCoords.max.y;
 					vertices.push_back(v);
 					v.sx = 1; v.sy = 1;
+					v.u = spr.texCoords.max.x; v.v = spr.texCoords.max.y;
 					vertices.push_back(v);
 					
 					indices.push_back(idx);
@@ -263,12 +276,16 @@ namespace spades {
 					
 					uint32_t idx = (uint32_t)vertices.size();
 					v.sx = -1; v.sy = -1;
+					v.u = spr.texCoords.min.x; v.v = spr.texCoords.min.y;
 					vertices.push_back(v);
 					v.sx = 1; v.sy = -1;
+					v.u = spr.texCoords.max.x; v.v = spr.texCoords.min.y;
 					vertices.push_back(v);
 					v.sx = -1; v.sy = 1;
+					v.u = spr.texCoords.min.x; v.v = spr.texCoords.max.y;
 					vertices.push_back(v);
 					v.sx = 1; v.sy = 1;
+					v.u = spr.texCoords.max.x; v.v = spr.texCoords.max.y;
 					vertices.push_back(v);
 					
 					indices.push_back(idx);
@@ -292,6 +309,7 @@ namespace spades {
 			device->EnableVertexAttribArray(positionAttribute(), false);
 			device->EnableVertexAttribArray(spritePosAttribute(), false);
 			device->EnableVertexAttribArray(colorAttribute(), false);
+			device->EnableVertexAttribArray(texCoordAttribute(), false);
 			
 			// composite downsampled sprite
 			device->BlendFunc(IGLDevice::One, IGLDevice::OneMinusSrcAlpha);
@@ -386,6 +404,10 @@ namespace spades {
 										4, IGLDevice::FloatType,
 										false, sizeof(Vertex),
 										&(vertices[0].r));
+			device->VertexAttribPointer(texCoordAttribute(),
+										2, IGLDevice::FloatType,
+										false, sizeof(Vertex),
+										&(vertices[0].u));
 			
 			SPAssert(lastImage);
 			lastImage->Bind(IGLDevice::Texture2D);
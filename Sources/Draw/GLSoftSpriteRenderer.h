@@ -34,7 +34,9 @@ namespace spades {
 		class GLImage;
 		class GLSoftSpriteRenderer: public IGLSpriteRenderer {
 			struct Sprite {
+				/** texture to bind; might be an atlas page. */
 				GLImage *image;
+				AABB2 texCoords;
 				Vector3 center;
 				float radius;
 				float angle;
@@ -51,6 +53,9 @@ namespace spades {
 				float sx, sy;
 				float angle;
 				
+				// texture coord
+				float u, v;
+				
 				// color
 				float r, g, b, a;
 			};
@@ -80,6 +85,7 @@ namespace spades {
 			GLProgramAttribute positionAttribute;
 			GLProgramAttribute spritePosAttribute;
 			GLProgramAttribute colorAttribute;
+			GLProgramAttribute texCoordAttribute;
 			
 			float thresLow, thresRange;
 			
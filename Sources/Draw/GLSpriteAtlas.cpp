@@ -0,0 +1,168 @@
+/*
+ Copyright (c) 2013 yvt
+ 
+ This file is part of OpenSpades.
+ 
+ OpenSpades is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+ 
+ OpenSpades is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with OpenSpades.  If not, see <http://www.gnu.org/licenses/>.
+ 
+ */
+
+
+#include "GLSpriteAtlas.h"
+#include "GLImage.h"
+#include "IGLDevice.h"
+#include "../Core/Bitmap.h"
+#include "../Core/BitmapAtlasGenerator.h"
+#include "../Core/Debug.h"
+#include "../Core/Settings.h"
+#include <algorithm>
+
+SPADES_SETTING(r_spriteAtlas, "1");
+SPADES_SETTING(r_spriteAtlasMaxImageSize, "128");
+SPADES_SETTING(r_spriteAtlasPageSize, "2048");
+
+namespace spades {
+	namespace draw {
+		GLSpriteAtlas::GLSpriteAtlas(IGLDevice *device):
+		device(device) {
+		}
+		
+		GLSpriteAtlas::~GLSpriteAtlas() {
+			ReleasePages();
+		}
+		
+		void GLSpriteAtlas::ReleasePages() {
+			for(size_t i = 0; i < pages.size(); i++)
+				pages[i]->Release();
+			pages.clear();
+			entries.clear();
+		}
+		
+		void GLSpriteAtlas::Register(GLImage *img, Bitmap *bmp) {
+			SPADES_MARK_FUNCTION();
+			if(!r_spriteAtlas)
+				return;
+			int maxSize = r_spriteAtlasMaxImageSize;
+			if(bmp->GetWidth() > maxSize || bmp->GetHeight() > maxSize)
+				return;
+			
+			if(entries.find(img) != entries.end())
+				return;
+			
+			pending[img] = Handle<Bitmap>(bmp);
+		}
+		
+		Handle<Bitmap> GLSpriteAtlas::MakePaddedBitmap(Bitmap *bmp) {
+			int w = bmp->GetWidth(), h = bmp->GetHeight();
+			int pw = w + Padding * 2, ph = h + Padding * 2;
+			Handle<Bitmap> out(new Bitmap(pw, ph), false);
+			
+			// replicate the edges into the padding
+			const uint32_t *src = bmp->GetPixels();
+			uint32_t *dest = out->GetPixels();
+			for(int y = 0; y < ph; y++) {
+				int sy = std::min(std::max(y - Padding, 0), h - 1);
+				for(int x = 0; x < pw; x++) {
+					int sx = std::min(std::max(x - Padding, 0), w - 1);
+					dest[x + y * pw] = src[sx + sy * w];
+				}
+			}
+			return out;
+		}
+		
+		void GLSpriteAtlas::Update() {
+			SPADES_MARK_FUNCTION();
+			if(pending.empty())
+				return;
+			
+			int oldNumPages = (int)pages.size();
+			
+			// split images into groups that fit in a page, largest first
+			std::vector<std::pair<int, GLImage *>> order;
+			for(auto& item: pending) {
+				Bitmap *bmp = item.second;
+				order.emplace_back((bmp->GetWidth() + Padding * 2) *
+								   (bmp->GetHeight() + Padding * 2),
+								   item.first);
+			}
+			std::sort(order.begin(), order.end(),
+					  [](const std::pair<int, GLImage *>& a,
+						 const std::pair<int, GLImage *>& b) {
+						  return a.first > b.first;
+					  });
+			
+			int pageSize = r_spriteAtlasPageSize;
+			// leave some space for the packing inefficiency
+			int pageArea = pageSize * pageSize / 4 * 3;
+			
+			size_t start = 0;
+			while(start < order.size()) {
+				size_t end = start;
+				int area = 0;
+				while(end < order.size() &&
+					  (end == start || area + order[end].first <= pageArea)) {
+					area += order[end].first;
+					end++;
+				}
+				
+				BitmapAtlasGenerator gen;
+				std::vector<Handle<Bitmap>> padded;
+				std::map<Bitmap *, GLImage *> imageForBitmap;
+				for(size_t i = start; i < end; i++) {
+					Handle<Bitmap> bmp = MakePaddedBitmap(pending[order[i].second]);
+					imageForBitmap[bmp] = order[i].second;
+					gen.AddBitmap(bmp);
+					padded.push_back(bmp);
+				}
+				
+				BitmapAtlasGenerator::Result result = gen.Pack();
+				Handle<Bitmap> atlasBitmap(result.bitmap, false);
+				GLImage *page = GLImage::FromBitmap(atlasBitmap, device);
+				pages.push_back(page);
+				
+				float invW = 1.f / (float)atlasBitmap->GetWidth();
+				float invH = 1.f / (float)atlasBitmap->GetHeight();
+				for(size_t i = 0; i < result.items.size(); i++) {
+					const BitmapAtlasGenerator::Item& item = result.items[i];
+					Entry entry;
+					entry.texture = page;
+					entry.texCoords = AABB2((float)(item.x + Padding) * invW,
+											(float)(item.y + Padding) * invH,
+											(float)(item.w - Padding * 2) * invW,
+											(float)(item.h - Padding * 2) * invH);
+					entries[imageForBitmap[item.bitmap]] = entry;
+				}
+				
+				start = end;
+			}
+			
+			// the pages hold the only copy we need from now on
+			SPLog("Sprite atlas: packed %d image(s) into %d new page(s) (%d images in %d pages)",
+				  (int)pending.size(), (int)pages.size() - oldNumPages,
+				  (int)entries.size(), (int)pages.size());
+			pending.clear();
+		}
+		
+		GLSpriteAtlas::Entry GLSpriteAtlas::Get(GLImage *img) {
+			auto it = entries.find(img);
+			if(it != entries.end())
+				return it->second;
+			
+			Entry entry;
+			entry.texture = img;
+			entry.texCoords = AABB2(0.f, 0.f, 1.f, 1.f);
+			return entry;
+		}
+	}
+}
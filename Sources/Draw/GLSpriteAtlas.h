@@ -0,0 +1,94 @@
+/*
+ Copyright (c) 2013 yvt
+ 
+ This file is part of OpenSpades.
+ 
+ OpenSpades is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+ 
+ OpenSpades is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with OpenSpades.  If not, see <http://www.gnu.org/licenses/>.
+ 
+ */
+
+
+#pragma once
+
+#include "../Core/Math.h"
+#include "../Core/RefCountedObject.h"
+#include <algorithm>
+#include <map>
+#include <vector>
+
+namespace spades {
+	class Bitmap;
+	namespace draw {
+		class IGLDevice;
+		class GLImage;
+		
+		/** Packs small registered images into shared textures so that
+		 * sprites with different images can be drawn by one draw call.
+		 * Images are packed lazily by `Update` into new pages; pages
+		 * that were already built are never repacked, so the source
+		 * bitmaps are only retained until the next `Update`. */
+		class GLSpriteAtlas {
+		public:
+			struct Entry {
+				/** texture to bind. the image itself when it
+				 * is not in the atlas. */
+				GLImage *texture;
+				/** normalized texture coordinates of the image. */
+				AABB2 texCoords;
+			};
+		private:
+			enum {
+				// empty texels around every image, so that bilinear
+				// filtering and lower mipmap levels don't bleed
+				Padding = 4
+			};
+			
+			IGLDevice *device;
+			/** images registered since the last `Update`. */
+			std::map<GLImage *, Handle<Bitmap>> pending;
+			std::map<GLImage *, Entry> entries;
+			std::vector<GLImage *> pages;
+			
+			void ReleasePages();
+			static Handle<Bitmap> MakePaddedBitmap(Bitmap *);
+		public:
+			GLSpriteAtlas(IGLDevice *);
+			~GLSpriteAtlas();
+			
+			/** makes `img` eligible for the atlas if it's small enough.
+			 * `bmp` must hold the contents of `img`. */
+			void Register(GLImage *img, Bitmap *bmp);
+			
+			/** packs the pending images into new pages and drops
+			 * their bitmaps. entries returned by `Get` before this
+			 * call stay valid. */
+			void Update();
+			
+			Entry Get(GLImage *);
+			
+			int GetNumPages() const { return (int)pages.size(); }
+			
+			/** groups sprites by their texture so that each texture
+			 * needs only one draw call. sprites sharing a texture keep
+			 * their order. */
+			template<class T>
+			static void SortByTexture(std::vector<T>& sprites) {
+				std::stable_sort(sprites.begin(), sprites.end(),
+								 [](const T& a, const T& b) {
+									 return a.image < b.image;
+								 });
+			}
+		};
+	}
+}
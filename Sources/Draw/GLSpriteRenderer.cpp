@@ -24,22 +24,29 @@
 #include "../Core/Debug.h"
 #include "GLProgram.h"
 #include "GLImage.h"
+#include "GLSpriteAtlas.h"
+#include "GLRecordingDevice.h"
 #include "SWFeatureLevel.h"
+#include "../Core/Bitmap.h"
 #include <Core/Settings.h>
+#include <set>
 
 SPADES_SETTING(r_hdr, "");
+SPADES_SETTING(r_spriteSort, "1");
 
 namespace spades {
 	namespace draw {
 		
 		GLSpriteRenderer::GLSpriteRenderer(GLRenderer *renderer):
 		renderer(renderer), device(renderer->GetGLDevice()),
+		atlas(renderer->GetSpriteAtlas()),
 		projectionViewMatrix("projectionViewMatrix"),
 		rightVector("rightVector"),
 		upVector("upVector"),
 		positionAttribute("positionAttribute"),
 		spritePosAttribute("spritePosAttribute"),
 		colorAttribute("colorAttribute"),
+		texCoordAttribute("texCoordAttribute"),
 		texture("texture"),
 		viewMatrix("viewMatrix"),
 		fogDistance("fogDistance"),
@@ -50,6 +57,24 @@ namespace spades {
 			program = renderer->RegisterProgram("Shaders/Sprite.program");
 		}
 		
+		GLSpriteRenderer::GLSpriteRenderer(IGLDevice *device,
+										   GLSpriteAtlas *atlas):
+		renderer(NULL), device(device), atlas(atlas),
+		program(NULL),
+		projectionViewMatrix("projectionViewMatrix"),
+		rightVector("rightVector"),
+		upVector("upVector"),
+		texture("texture"),
+		viewMatrix("viewMatrix"),
+		fogDistance("fogDistance"),
+		fogColor("fogColor"),
+		positionAttribute("positionAttribute"),
+		spritePosAttribute("spritePosAttribute"),
+		colorAttribute("colorAttribute"),
+		texCoordAttribute("texCoordAttribute")
+		{
+		}
+		
 		GLSpriteRenderer::~GLSpriteRenderer(){
 			SPADES_MARK_FUNCTION();
 			
@@ -59,8 +84,10 @@ namespace spades {
 								   spades::Vector3 center, float rad, float ang,
 								   Vector4 color){
 			SPADES_MARK_FUNCTION_DEBUG();
+			GLSpriteAtlas::Entry entry = atlas->Get(img);
 			Sprite spr;
-			spr.image = img;
+			spr.image = entry.texture;
+			spr.texCoords = entry.texCoords;
 			spr.center = center;
 			spr.radius = rad;
 			spr.angle = ang;
@@ -90,7 +117,8 @@ namespace spades {
 		
 		void GLSpriteRenderer::Render() {
 			SPADES_MARK_FUNCTION();
-			lastImage = NULL;
+			if(r_spriteSort)
+				GLSpriteAtlas::SortByTexture(sprites);
 			program->Use();
 			
 			projectionViewMatrix(program);
@@ -104,6 +132,7 @@ namespace spades {
 			positionAttribute(program);
 			spritePosAttribute(program);
 			colorAttribute(program);
+			texCoordAttribute(program);
 			
 			projectionViewMatrix.SetValue(renderer->GetProjectionViewMatrix());
 			viewMatrix.SetValue(renderer->GetViewMatrix());
@@ -127,7 +156,19 @@ namespace spades {
 			device->EnableVertexAttribArray(positionAttribute(), true);
 			device->EnableVertexAttribArray(spritePosAttribute(), true);
 			device->EnableVertexAttribArray(colorAttribute(), true);
+			device->EnableVertexAttribArray(texCoordAttribute(), true);
+			
+			DrawSprites();
 			
+			device->EnableVertexAttribArray(positionAttribute(), false);
+			device->EnableVertexAttribArray(spritePosAttribute(), false);
+			device->EnableVertexAttribArray(colorAttribute(), false);
+			device->EnableVertexAttribArray(texCoordAttribute(), false);
+		}
+		
+		void GLSpriteRenderer::DrawSprites() {
+			SPADES_MARK_FUNCTION();
+			lastImage = NULL;
 			
 			for(size_t i = 0; i < sprites.size(); i++){
 				Sprite& spr = sprites[i];
@@ -150,12 +191,16 @@ namespace spades {
 				
 				uint32_t idx = (uint32_t)vertices.size();
 				v.sx = -1; v.sy = -1;
+				v.u = spr.texCoords.min.x; v.v = spr.texCoords.min.y;
 				vertices.push_back(v);
 				v.sx = 1; v.sy = -1;
+				v.u = spr.texCoords.max.x; v.v = spr.texCoords.min.y;
 				vertices.push_back(v);
 				v.sx = -1; v.sy = 1;
+				v.u = spr.texCoords.min.x; v.v = spr.texCoords.max.y;
 				vertices.push_back(v);
 				v.sx = 1; v.sy = 1;
+				v.u = spr.texCoords.max.x; v.v = spr.texCoords.max.y;
 				vertices.push_back(v);
 				
 				indices.push_back(idx);
@@ -167,10 +212,6 @@ namespace spades {
 			}
 		
 			Flush();
-			
-			device->EnableVertexAttribArray(positionAttribute(), false);
-			device->EnableVertexAttribArray(spritePosAttribute(), false);
-			device->EnableVertexAttribArray(colorAttribute(), false);
 		}
 		
 		void GLSpriteRenderer::Flush() {
@@ -191,6 +232,10 @@ namespace spades {
 										4, IGLDevice::FloatType,
 										false, sizeof(Vertex),
 										&(vertices[0].r));
+			device->VertexAttribPointer(texCoordAttribute(),
+										2, IGLDevice::FloatType,
+										false, sizeof(Vertex),
+										&(vertices[0].u));
 			
 			SPAssert(lastImage);
 			lastImage->Bind(IGLDevice::Texture2D);
@@ -203,5 +248,72 @@ namespace spades {
 			vertices.clear();
 			indices.clear();
 		}
+		
+		void GLSpriteRenderer::RunDrawCallTest() {
+			SPADES_MARK_FUNCTION();
+			
+			Handle<GLRecordingDevice> device(new GLRecordingDevice(), false);
+			GLSpriteAtlas atlas(device);
+			
+			// small images go to the atlas, large ones don't
+			std::vector<GLImage *> images;
+			for(int i = 0; i < 15; i++) {
+				int size = i < 12 ? 16 : 256;
+				Handle<Bitmap> bmp(new Bitmap(size, size), false);
+				uint32_t *pixels = bmp->GetPixels();
+				for(int j = 0; j < size * size; j++)
+					pixels[j] = 0xff000000 | (uint32_t)(i * 0x10101);
+				GLImage *img = GLImage::FromBitmap(bmp, device);
+				atlas.Register(img, bmp);
+				images.push_back(img);
+			}
+			atlas.Update();
+			
+			std::set<GLImage *> textures;
+			for(size_t i = 0; i < images.size(); i++)
+				textures.insert(atlas.Get(images[i]).texture);
+			
+			// interleave the images so that every sprite would need
+			// its own draw call without batching
+			const int numSprites = 200;
+			GLSpriteRenderer r(device, &atlas);
+			for(int i = 0; i < numSprites; i++) {
+				r.Add(images[(i * 7) % images.size()],
+					  MakeVector3((float)i, 0.f, 0.f), 1.f, 0.f,
+					  MakeVector4(1.f, 1.f, 1.f, 1.f));
+			}
+			
+			device->ResetStatistics();
+			GLSpriteAtlas::SortByTexture(r.sprites);
+			r.DrawSprites();
+			
+			const std::vector<GLRecordingDevice::DrawCall>& calls = device->GetDrawCalls();
+			std::set<IGLDevice::UInteger> drawnTextures;
+			int numIndices = 0;
+			for(size_t i = 0; i < calls.size(); i++) {
+				drawnTextures.insert(calls[i].texture);
+				numIndices += (int)calls[i].count;
+			}
+			
+			SPLog("Sprite draw call test: %d sprites, %d images, %d atlas page(s)",
+				  numSprites, (int)images.size(), atlas.GetNumPages());
+			SPLog("  draw calls: %d (%d without batching), GL calls: %llu",
+				  (int)calls.size(), numSprites,
+				  (unsigned long long)device->GetNumCalls());
+			
+			if(calls.size() != textures.size() ||
+			   drawnTextures.size() != calls.size() ||
+			   drawnTextures.count(0) ||
+			   numIndices != numSprites * 6) {
+				SPLog("Sprite draw call test FAILED: expected %d draw calls "
+					  "with distinct textures and %d indices, got %d indices",
+					  (int)textures.size(), numSprites * 6, numIndices);
+			}else{
+				SPLog("Sprite draw call test passed");
+			}
+			
+			for(size_t i = 0; i < images.size(); i++)
+				images[i]->Release();
+		}
 	}
 }
@@ -32,9 +32,12 @@ namespace spades {
 		class GLRenderer;
 		class IGLDevice;
 		class GLImage;
+		class GLSpriteAtlas;
 		class GLSpriteRenderer: public IGLSpriteRenderer {
 			struct Sprite {
+				/** texture to bind; might be an atlas page. */
 				GLImage *image;
+				AABB2 texCoords;
 				Vector3 center;
 				float radius;
 				float angle;
@@ -50,12 +53,16 @@ namespace spades {
 				float sx, sy;
 				float angle;
 				
+				// texture coord
+				float u, v;
+				
 				// color
 				float r, g, b, a;
 			};
 			
 			GLRenderer *renderer;
 			IGLDevice *device;
+			GLSpriteAtlas *atlas;
 			std::vector<Sprite> sprites;
 			
 			GLImage *lastImage;
@@ -75,8 +82,15 @@ namespace spades {
 			GLProgramAttribute positionAttribute;
 			GLProgramAttribute spritePosAttribute;
 			GLProgramAttribute colorAttribute;
+			GLProgramAttribute texCoordAttribute;
 			
 			void Flush();
+			/** batches the sprites into draw calls. the program and
+			 * the vertex attributes must be set up. */
+			void DrawSprites();
+			
+			/** for RunDrawCallTest; draws without a program. */
+			GLSpriteRenderer(IGLDevice *, GLSpriteAtlas *);
 			
 		public:
 			GLSpriteRenderer(GLRenderer *);
@@ -86,6 +100,10 @@ namespace spades {
 					 float rad, float ang, Vector4 color);
 			virtual void Clear();
 			virtual void Render();
+			
+			/** Draws a batch of atlased and non-atlased sprites to a
+			 * GLRecordingDevice and checks the draw calls made. */
+			static void RunDrawCallTest();
 		};
 	}
 }
\ No newline at end of file
@@ -0,0 +1,547 @@
+/*
+ Copyright (c) 2013 yvt
+ 
+ This file is part of OpenSpades.
+ 
+ OpenSpades is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+ 
+ OpenSpades is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with OpenSpades.  If not, see <http://www.gnu.org/licenses/>.
+ 
+ */
+
+#include "GLStateCache.h"
+#include "GLRecordingDevice.h"
+#include "../Core/Debug.h"
+#include "../Core/FileManager.h"
+#include "../Core/IStream.h"
+#include "../Core/Exception.h"
+#include <string.h>
+#include <memory>
+
+namespace spades {
+	namespace draw {
+		
+		const uint32_t GLStateCache::Unknown;
+		
+		GLStateCache::GLStateCache() {
+			numForwarded = numDropped = 0;
+			currentUniforms = NULL;
+			Invalidate();
+		}
+		
+		void GLStateCache::Invalidate() {
+			activeTexture = Unknown;
+			for(int i = 0; i < MaxTextureStages; i++)
+				for(int j = 0; j < NumTextureTargets; j++)
+					textures[i][j] = Unknown;
+			program = Unknown;
+			drawFramebuffer = readFramebuffer = Unknown;
+			arrayBuffer = elementArrayBuffer = Unknown;
+			pixelPackBuffer = pixelUnpackBuffer = Unknown;
+			for(int i = 0; i < NumCapabilities; i++)
+				capabilities[i] = Unknown;
+			for(int i = 0; i < MaxVertexAttribs; i++)
+				vertexAttribArrays[i] = Unknown;
+			depthMask = colorMask = Unknown;
+			depthFunc = frontFace = Unknown;
+			for(int i = 0; i < 4; i++) {
+				blendFunc[i] = Unknown;
+				blendColor[i] = Unknown;
+				viewport[i] = Unknown;
+				clearColor[i] = Unknown;
+			}
+			blendEquation[0] = blendEquation[1] = Unknown;
+			
+			uniforms.clear();
+			currentUniforms = NULL;
+		}
+		
+		bool GLStateCache::Update(uint32_t &shadow, uint32_t value) {
+			if(shadow == value) {
+				numDropped++;
+				return false;
+			}
+			shadow = value;
+			numForwarded++;
+			return true;
+		}
+		
+		bool GLStateCache::Update(uint32_t *shadow, const uint32_t *values, int count) {
+			if(memcmp(shadow, values, count * sizeof(uint32_t)) == 0) {
+				numDropped++;
+				return false;
+			}
+			memcpy(shadow, values, count * sizeof(uint32_t));
+			numForwarded++;
+			return true;
+		}
+		
+		static inline uint32_t FloatBits(IGLDevice::Float f) {
+			uint32_t i;
+			memcpy(&i, &f, sizeof(i));
+			return i;
+		}
+		
+#pragma mark - Textures
+		
+		uint32_t *GLStateCache::GetTextureBinding(Enum target) {
+			int index;
+			switch(target) {
+				case IGLDevice::Texture2D: index = 0; break;
+				case IGLDevice::Texture3D: index = 1; break;
+				default: return NULL;
+			}
+			if(activeTexture == Unknown) {
+				// the binding goes to a stage we don't know
+				for(int i = 0; i < MaxTextureStages; i++)
+					textures[i][index] = Unknown;
+				return NULL;
+			}
+			if(activeTexture >= MaxTextureStages)
+				return NULL;
+			return &textures[activeTexture][index];
+		}
+		
+		bool GLStateCache::ActiveTexture(UInteger stage) {
+			return Update(activeTexture, stage);
+		}
+		
+		bool GLStateCache::BindTexture(Enum target, UInteger texture) {
+			uint32_t *binding = GetTextureBinding(target);
+			if(!binding) {
+				numForwarded++;
+				return true;
+			}
+			return Update(*binding, texture);
+		}
+		
+		void GLStateCache::DeleteTexture(UInteger texture) {
+			// deleted textures are unbound from every stage
+			for(int i = 0; i < MaxTextureStages; i++)
+				for(int j = 0; j < NumTextureTargets; j++)
+					if(textures[i][j] == texture)
+						textures[i][j] = 0;
+		}
+		
+#pragma mark - Programs
+		
+		bool GLStateCache::UseProgram(UInteger prog) {
+			if(!Update(program, prog))
+				return false;
+			currentUniforms = &uniforms[prog];
+			return true;
+		}
+		
+		void GLStateCache::LinkProgram(UInteger prog) {
+			// linking resets the uniforms and may move them around
+			auto it = uniforms.find(prog);
+			if(it != uniforms.end())
+				it->second.clear();
+		}
+		
+		void GLStateCache::DeleteProgram(UInteger prog) {
+			if(program == prog) {
+				// stays in use until something else is, but its name
+				// can be reused after that; just forget it
+				program = Unknown;
+				currentUniforms = NULL;
+			}
+			uniforms.erase(prog);
+		}
+		
+		bool GLStateCache::Uniform(Op op, Integer loc, const void *values, int count) {
+			if(loc < 0) {
+				// ignored by GL anyway
+				numDropped++;
+				return false;
+			}
+			if(currentUniforms == NULL || loc >= 4096) {
+				numForwarded++;
+				return true;
+			}
+			
+			std::vector<UniformSlot>& slots = *currentUniforms;
+			if((size_t)loc >= slots.size()) {
+				UniformSlot slot;
+				slot.op = Unknown;
+				slots.resize(loc + 1, slot);
+			}
+			
+			UniformSlot& slot = slots[loc];
+			uint32_t tag = (uint32_t)op | ((uint32_t)count << 8);
+			if(slot.op == tag &&
+			   memcmp(slot.data, values, count * sizeof(uint32_t)) == 0) {
+				numDropped++;
+				return false;
+			}
+			slot.op = tag;
+			memcpy(slot.data, values, count * sizeof(uint32_t));
+			numForwarded++;
+			return true;
+		}
+		
+		bool GLStateCache::Uniform(Integer loc, const Float *values, int count) {
+			return Uniform(OpUniformFloat, loc, values, count);
+		}
+		
+		bool GLStateCache::Uniform(Integer loc, const Integer *values, int count) {
+			return Uniform(OpUniformInteger, loc, values, count);
+		}
+		
+		bool GLStateCache::Uniform(Integer loc, bool transpose, const Matrix4 &mat) {
+			// compare what the shader actually sees
+			Matrix4 m = transpose ? mat.Transposed() : mat;
+			return Uniform(OpUniformMatrix, loc, m.m, 16);
+		}
+		
+#pragma mark - Framebuffers and Buffers
+		
+		bool GLStateCache::BindFramebuffer(Enum target, UInteger framebuffer) {
+			switch(target) {
+				case IGLDevice::Framebuffer:
+					if(drawFramebuffer == framebuffer &&
+					   readFramebuffer == framebuffer) {
+						numDropped++;
+						return false;
+					}
+					drawFramebuffer = readFramebuffer = framebuffer;
+					numForwarded++;
+					return true;
+				case IGLDevice::DrawFramebuffer:
+					return Update(drawFramebuffer, framebuffer);
+				case IGLDevice::ReadFramebuffer:
+					return Update(readFramebuffer, framebuffer);
+				default:
+					numForwarded++;
+					return true;
+			}
+		}
+		
+		void GLStateCache::DeleteFramebuffer(UInteger framebuffer) {
+			if(drawFramebuffer == framebuffer)
+				drawFramebuffer = 0;
+			if(readFramebuffer == framebuffer)
+				readFramebuffer = 0;
+		}
+		
+		uint32_t *GLStateCache::GetBufferBinding(Enum target) {
+			switch(target) {
+				case IGLDevice::ArrayBuffer: return &arrayBuffer;
+				case IGLDevice::ElementArrayBuffer: return &elementArrayBuffer;
+				case IGLDevice::PixelPackBuffer: return &pixelPackBuffer;
+				case IGLDevice::PixelUnpackBuffer: return &pixelUnpackBuffer;
+				default: return NULL;
+			}
+		}
+		
+		bool GLStateCache::BindBuffer(Enum target, UInteger buffer) {
+			uint32_t *binding = GetBufferBinding(target);
+			if(!binding) {
+				numForwarded++;
+				return true;
+			}
+			return Update(*binding, buffer);
+		}
+		
+		void GLStateCache::DeleteBuffer(UInteger buffer) {
+			uint32_t *bindings[] = {
+				&arrayBuffer, &elementArrayBuffer,
+				&pixelPackBuffer, &pixelUnpackBuffer
+			};
+			for(uint32_t *binding: bindings)
+				if(*binding == buffer)
+					*binding = 0;
+		}
+		
+#pragma mark - Fixed Function State
+		
+		uint32_t *GLStateCache::GetCapability(Enum state) {
+			switch(state) {
+				case IGLDevice::DepthTest: return &capabilities[0];
+				case IGLDevice::CullFace: return &capabilities[1];
+				case IGLDevice::Blend: return &capabilities[2];
+				case IGLDevice::Multisample: return &capabilities[3];
+				case IGLDevice::FramebufferSRGB: return &capabilities[4];
+				default: return NULL;
+			}
+		}
+		
+		bool GLStateCache::Enable(Enum state, bool b) {
+			uint32_t *cap = GetCapability(state);
+			if(!cap) {
+				numForwarded++;
+				return true;
+			}
+			return Update(*cap, b ? 1 : 0);
+		}
+		
+		bool GLStateCache::EnableVertexAttribArray(UInteger index, bool b) {
+			if(index >= MaxVertexAttribs) {
+				numForwarded++;
+				return true;
+			}
+			return Update(vertexAttribArrays[index], b ? 1 : 0);
+		}
+		
+		bool GLStateCache::DepthMask(bool b) {
+			return Update(depthMask, b ? 1 : 0);
+		}
+		
+		bool GLStateCache::ColorMask(bool r, bool g, bool b, bool a) {
+			return Update(colorMask, (r ? 1 : 0) | (g ? 2 : 0) |
+						  (b ? 4 : 0) | (a ? 8 : 0));
+		}
+		
+		bool GLStateCache::DepthFunc(Enum func) {
+			return Update(depthFunc, func);
+		}
+		
+		bool GLStateCache::FrontFace(Enum mode) {
+			return Update(frontFace, mode);
+		}
+		
+		bool GLStateCache::BlendFunc(Enum srcRgb, Enum destRgb,
+									 Enum srcAlpha, Enum destAlpha) {
+			uint32_t values[] = {
+				(uint32_t)srcRgb, (uint32_t)destRgb,
+				(uint32_t)srcAlpha, (uint32_t)destAlpha
+			};
+			return Update(blendFunc, values, 4);
+		}
+		
+		bool GLStateCache::BlendEquation(Enum rgb, Enum alpha) {
+			uint32_t values[] = {(uint32_t)rgb, (uint32_t)alpha};
+			return Update(blendEquation, values, 2);
+		}
+		
+		bool GLStateCache::BlendColor(Float r, Float g, Float b, Float a) {
+			uint32_t values[] = {
+				FloatBits(r), FloatBits(g), FloatBits(b), FloatBits(a)
+			};
+			return Update(blendColor, values, 4);
+		}
+		
+		bool GLStateCache::Viewport(Integer x, Integer y, Sizei width, Sizei height) {
+			uint32_t values[] = {
+				(uint32_t)x, (uint32_t)y, width, height
+			};
+			return Update(viewport, values, 4);
+		}
+		
+		bool GLStateCache::ClearColor(Float r, Float g, Float b, Float a) {
+			uint32_t values[] = {
+				FloatBits(r), FloatBits(g), FloatBits(b), FloatBits(a)
+			};
+			return Update(clearColor, values, 4);
+		}
+		
+#pragma mark - Traces
+		
+		bool GLStateCache::Execute(const Command &cmd) {
+			const Integer *a = cmd.args;
+			const Float *v = cmd.values;
+			switch(cmd.op) {
+				case OpActiveTexture: return ActiveTexture(a[0]);
+				case OpBindTexture: return BindTexture((Enum)a[0], a[1]);
+				// deletions and links are always forwarded, and not
+				// counted in the statistics
+				case OpDeleteTexture: DeleteTexture(a[0]); return true;
+				case OpUseProgram: return UseProgram(a[0]);
+				case OpLinkProgram: LinkProgram(a[0]); return true;
+				case OpDeleteProgram: DeleteProgram(a[0]); return true;
+				case OpBindFramebuffer: return BindFramebuffer((Enum)a[0], a[1]);
+				case OpDeleteFramebuffer: DeleteFramebuffer(a[0]); return true;
+				case OpBindBuffer: return BindBuffer((Enum)a[0], a[1]);
+				case OpDeleteBuffer: DeleteBuffer(a[0]); return true;
+				case OpEnable: return Enable((Enum)a[0], a[1] != 0);
+				case OpEnableVertexAttribArray:
+					return EnableVertexAttribArray(a[0], a[1] != 0);
+				case OpDepthMask: return DepthMask(a[0] != 0);
+				case OpColorMask:
+					return ColorMask(a[0] != 0, a[1] != 0, a[2] != 0, a[3] != 0);
+				case OpDepthFunc: return DepthFunc((Enum)a[0]);
+				case OpFrontFace: return FrontFace((Enum)a[0]);
+				case OpBlendFunc:
+					return BlendFunc((Enum)a[0], (Enum)a[1], (Enum)a[2], (Enum)a[3]);
+				case OpBlendEquation: return BlendEquation((Enum)a[0], (Enum)a[1]);
+				case OpBlendColor: return BlendColor(v[0], v[1], v[2], v[3]);
+				case OpViewport: return Viewport(a[0], a[1], a[2], a[3]);
+				case OpClearColor: return ClearColor(v[0], v[1], v[2], v[3]);
+				case OpUniformFloat: return Uniform(a[0], v, a[1]);
+				case OpUniformInteger:
+					return Uniform(a[0], reinterpret_cast<const Integer *>(v), a[1]);
+				case OpUniformMatrix: {
+					Matrix4 m;
+					memcpy(m.m, v, sizeof(m.m));
+					return Uniform(a[0], a[1] != 0, m);
+				}
+				default:
+					SPRaise("Invalid GL state trace command: %d", (int)cmd.op);
+			}
+		}
+		
+		const char *GLStateCache::GetOpName(Op op) {
+			static const char *names[] = {
+				"ActiveTexture", "BindTexture", "DeleteTexture",
+				"UseProgram", "LinkProgram", "DeleteProgram",
+				"BindFramebuffer", "DeleteFramebuffer",
+				"BindBuffer", "DeleteBuffer",
+				"Enable", "EnableVertexAttribArray",
+				"DepthMask", "ColorMask", "DepthFunc", "FrontFace",
+				"BlendFunc", "BlendEquation", "BlendColor",
+				"Viewport", "ClearColor",
+				"Uniform (float)", "Uniform (int)", "Uniform (matrix)"
+			};
+			static_assert(sizeof(names) / sizeof(names[0]) == NumOps,
+						  "op name table is out of date");
+			return names[op];
+		}
+		
+		/** Makes the IGLDevice call a trace command was recorded from. */
+		static void Replay(const GLStateCache::Command& cmd, IGLDevice *dev) {
+			typedef IGLDevice::Enum Enum;
+			const IGLDevice::Integer *a = cmd.args;
+			const IGLDevice::Float *v = cmd.values;
+			const IGLDevice::Integer *iv = reinterpret_cast<const IGLDevice::Integer *>(v);
+			switch(cmd.op) {
+				case GLStateCache::OpActiveTexture: dev->ActiveTexture(a[0]); break;
+				case GLStateCache::OpBindTexture: dev->BindTexture((Enum)a[0], a[1]); break;
+				case GLStateCache::OpDeleteTexture: dev->DeleteTexture(a[0]); break;
+				case GLStateCache::OpUseProgram: dev->UseProgram(a[0]); break;
+				case GLStateCache::OpLinkProgram: dev->LinkProgram(a[0]); break;
+				case GLStateCache::OpDeleteProgram: dev->DeleteProgram(a[0]); break;
+				case GLStateCache::OpBindFramebuffer: dev->BindFramebuffer((Enum)a[0], a[1]); break;
+				case GLStateCache::OpDeleteFramebuffer: dev->DeleteFramebuffer(a[0]); break;
+				case GLStateCache::OpBindBuffer: dev->BindBuffer((Enum)a[0], a[1]); break;
+				case GLStateCache::OpDeleteBuffer: dev->DeleteBuffer(a[0]); break;
+				case GLStateCache::OpEnable: dev->Enable((Enum)a[0], a[1] != 0); break;
+				case GLStateCache::OpEnableVertexAttribArray:
+					dev->EnableVertexAttribArray(a[0], a[1] != 0);
+					break;
+				case GLStateCache::OpDepthMask: dev->DepthMask(a[0] != 0); break;
+				case GLStateCache::OpColorMask:
+					dev->ColorMask(a[0] != 0, a[1] != 0, a[2] != 0, a[3] != 0);
+					break;
+				case GLStateCache::OpDepthFunc: dev->DepthFunc((Enum)a[0]); break;
+				case GLStateCache::OpFrontFace: dev->FrontFace((Enum)a[0]); break;
+				case GLStateCache::OpBlendFunc:
+					dev->BlendFunc((Enum)a[0], (Enum)a[1], (Enum)a[2], (Enum)a[3]);
+					break;
+				case GLStateCache::OpBlendEquation: dev->BlendEquation((Enum)a[0], (Enum)a[1]); break;
+				case GLStateCache::OpBlendColor: dev->BlendColor(v[0], v[1], v[2], v[3]); break;
+				case GLStateCache::OpViewport: dev->Viewport(a[0], a[1], a[2], a[3]); break;
+				case GLStateCache::OpClearColor: dev->ClearColor(v[0], v[1], v[2], v[3]); break;
+				case GLStateCache::OpUniformFloat:
+					switch(a[1]) {
+						case 1: dev->Uniform(a[0], v[0]); break;
+						case 2: dev->Uniform(a[0], v[0], v[1]); break;
+						case 3: dev->Uniform(a[0], v[0], v[1], v[2]); break;
+						case 4: dev->Uniform(a[0], v[0], v[1], v[2], v[3]); break;
+						default: SPRaise("Invalid uniform size in GL state trace: %d", (int)a[1]);
+					}
+					break;
+				case GLStateCache::OpUniformInteger:
+					switch(a[1]) {
+						case 1: dev->Uniform(a[0], iv[0]); break;
+						case 2: dev->Uniform(a[0], iv[0], iv[1]); break;
+						case 3: dev->Uniform(a[0], iv[0], iv[1], iv[2]); break;
+						case 4: dev->Uniform(a[0], iv[0], iv[1], iv[2], iv[3]); break;
+						default: SPRaise("Invalid uniform size in GL state trace: %d", (int)a[1]);
+					}
+					break;
+				case GLStateCache::OpUniformMatrix: {
+					Matrix4 m;
+					memcpy(m.m, v, sizeof(m.m));
+					dev->Uniform(a[0], a[1] != 0, m);
+					break;
+				}
+				default:
+					SPRaise("Invalid GL state trace command: %d", (int)cmd.op);
+			}
+		}
+		
+		void GLStateCache::RunTraceTest(const std::string &fileName) {
+			SPADES_MARK_FUNCTION();
+			
+			std::unique_ptr<IStream> stream(FileManager::OpenForReading(fileName.c_str()));
+			if(stream->Read(4) != "GLST")
+				SPRaise("%s is not a GL state trace", fileName.c_str());
+			uint32_t numCommands = stream->ReadLittleInt();
+			uint32_t recordedForwarded = stream->ReadLittleInt();
+			uint32_t recordedDropped = stream->ReadLittleInt();
+			
+			std::vector<Command> commands(numCommands);
+			size_t bytes = numCommands * sizeof(Command);
+			if(stream->Read(commands.data(), bytes) < bytes)
+				SPRaise("GL state trace %s is truncated", fileName.c_str());
+			
+			// the trace starts with an invalidated cache, like the
+			// recording did
+			GLStateCache cache;
+			int forwarded[NumOps] = {0}, dropped[NumOps] = {0};
+			
+			// `reference` gets every call and `cached` only the
+			// forwarded ones; dropping a call must not change the
+			// state GL ends up in
+			Handle<GLRecordingDevice> reference(new GLRecordingDevice(), false);
+			Handle<GLRecordingDevice> cached(new GLRecordingDevice(), false);
+			int mismatchIndex = -1;
+			std::string mismatch;
+			
+			for(size_t i = 0; i < commands.size(); i++) {
+				const Command& cmd = commands[i];
+				bool forward = cache.Execute(cmd);
+				if(forward)
+					forwarded[cmd.op]++;
+				else
+					dropped[cmd.op]++;
+				
+				Replay(cmd, reference);
+				if(forward)
+					Replay(cmd, cached);
+				if(mismatchIndex < 0 && cached->GetState() != reference->GetState()) {
+					mismatchIndex = (int)i;
+					mismatch = cached->GetState().Diff(reference->GetState());
+				}
+			}
+			
+			SPLog("GL state trace %s: %u calls", fileName.c_str(), numCommands);
+			for(int i = 0; i < NumOps; i++) {
+				if(forwarded[i] == 0 && dropped[i] == 0)
+					continue;
+				SPLog("  %-24s forwarded: %6d, dropped: %6d",
+					  GetOpName((Op)i), forwarded[i], dropped[i]);
+			}
+			SPLog("  total: forwarded: %llu, dropped: %llu",
+				  (unsigned long long)cache.GetNumForwardedCalls(),
+				  (unsigned long long)cache.GetNumDroppedCalls());
+			
+			bool passed = true;
+			if(cache.GetNumForwardedCalls() != recordedForwarded ||
+			   cache.GetNumDroppedCalls() != recordedDropped) {
+				SPLog("GL state trace test FAILED: the recorded frame "
+					  "forwarded %u and dropped %u",
+					  recordedForwarded, recordedDropped);
+				passed = false;
+			}
+			if(mismatchIndex >= 0) {
+				SPLog("GL state trace test FAILED: after call #%d (%s), "
+					  "%s when only the forwarded calls are made",
+					  mismatchIndex, GetOpName((Op)commands[mismatchIndex].op),
+					  mismatch.c_str());
+				passed = false;
+			}
+			if(passed)
+				SPLog("GL state trace test passed");
+		}
+	}
+}
@@ -0,0 +1,183 @@
+/*
+ Copyright (c) 2013 yvt
+ 
+ This file is part of OpenSpades.
+ 
+ OpenSpades is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+ 
+ OpenSpades is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with OpenSpades.  If not, see <http://www.gnu.org/licenses/>.
+ 
+ */
+
+#pragma once
+
+#include "IGLDevice.h"
+#include <vector>
+#include <unordered_map>
+#include <string>
+#include <stdint.h>
+
+namespace spades {
+	namespace draw {
+		
+		/** Shadow copy of the GL state that IGLDevice callers change
+		 * most often. Each setter updates the shadow state and returns
+		 * false when the call would not change anything, so the caller
+		 * can skip it. State that was never set is unknown and never
+		 * considered redundant. */
+		class GLStateCache {
+		public:
+			typedef IGLDevice::Enum Enum;
+			typedef IGLDevice::UInteger UInteger;
+			typedef IGLDevice::Integer Integer;
+			typedef IGLDevice::Float Float;
+			typedef IGLDevice::Sizei Sizei;
+			
+			enum Op {
+				OpActiveTexture,
+				OpBindTexture,
+				OpDeleteTexture,
+				OpUseProgram,
+				OpLinkProgram,
+				OpDeleteProgram,
+				OpBindFramebuffer,
+				OpDeleteFramebuffer,
+				OpBindBuffer,
+				OpDeleteBuffer,
+				OpEnable,
+				OpEnableVertexAttribArray,
+				OpDepthMask,
+				OpColorMask,
+				OpDepthFunc,
+				OpFrontFace,
+				OpBlendFunc,
+				OpBlendEquation,
+				OpBlendColor,
+				OpViewport,
+				OpClearColor,
+				OpUniformFloat,
+				OpUniformInteger,
+				OpUniformMatrix,
+				NumOps
+			};
+			
+			/** One recorded state call, as stored in a trace. */
+			struct Command {
+				uint32_t op;
+				Integer args[4];
+				Float values[16];
+			};
+			
+		private:
+			/** shadow value of state that was never set. */
+			static const uint32_t Unknown = 0xffffffffU;
+			
+			enum {
+				MaxTextureStages = 32,
+				NumTextureTargets = 2,
+				NumCapabilities = 5,
+				MaxVertexAttribs = 16
+			};
+			
+			struct UniformSlot {
+				uint32_t op; // OpUniform*, or Unknown
+				uint32_t data[16];
+			};
+			
+			uint32_t activeTexture;
+			uint32_t textures[MaxTextureStages][NumTextureTargets];
+			uint32_t program;
+			uint32_t drawFramebuffer, readFramebuffer;
+			uint32_t arrayBuffer, elementArrayBuffer;
+			uint32_t pixelPackBuffer, pixelUnpackBuffer;
+			uint32_t capabilities[NumCapabilities];
+			uint32_t vertexAttribArrays[MaxVertexAttribs];
+			uint32_t depthMask, colorMask;
+			uint32_t depthFunc, frontFace;
+			uint32_t blendFunc[4];
+			uint32_t blendEquation[2];
+			uint32_t blendColor[4];
+			uint32_t viewport[4];
+			uint32_t clearColor[4];
+			
+			std::unordered_map<UInteger, std::vector<UniformSlot>> uniforms;
+			/** uniforms of the current program, or NULL if unknown. */
+			std::vector<UniformSlot> *currentUniforms;
+			
+			uint64_t numForwarded, numDropped;
+			
+			bool Update(uint32_t& shadow, uint32_t value);
+			bool Update(uint32_t *shadow, const uint32_t *values, int count);
+			bool Uniform(Op op, Integer loc, const void *values, int count);
+			
+			uint32_t *GetTextureBinding(Enum target);
+			uint32_t *GetBufferBinding(Enum target);
+			uint32_t *GetCapability(Enum state);
+			
+		public:
+			GLStateCache();
+			
+			/** Forgets everything; following calls are all forwarded. */
+			void Invalidate();
+			
+			bool ActiveTexture(UInteger stage);
+			bool BindTexture(Enum target, UInteger texture);
+			void DeleteTexture(UInteger texture);
+			
+			bool UseProgram(UInteger program);
+			void LinkProgram(UInteger program);
+			void DeleteProgram(UInteger program);
+			
+			bool BindFramebuffer(Enum target, UInteger framebuffer);
+			void DeleteFramebuffer(UInteger framebuffer);
+			
+			bool BindBuffer(Enum target, UInteger buffer);
+			void DeleteBuffer(UInteger buffer);
+			
+			bool Enable(Enum state, bool);
+			bool EnableVertexAttribArray(UInteger index, bool);
+			bool DepthMask(bool);
+			bool ColorMask(bool r, bool g, bool b, bool a);
+			bool DepthFunc(Enum);
+			bool FrontFace(Enum);
+			bool BlendFunc(Enum srcRgb, Enum destRgb,
+						   Enum srcAlpha, Enum destAlpha);
+			bool BlendEquation(Enum rgb, Enum alpha);
+			bool BlendColor(Float r, Float g, Float b, Float a);
+			bool Viewport(Integer x, Integer y, Sizei width, Sizei height);
+			bool ClearColor(Float r, Float g, Float b, Float a);
+			
+			/** Uniforms of the current program. */
+			bool Uniform(Integer loc, const Float *values, int count);
+			bool Uniform(Integer loc, const Integer *values, int count);
+			bool Uniform(Integer loc, bool transpose, const Matrix4&);
+			
+			/** Applies a recorded command. Returns whether it would
+			 * have been forwarded. */
+			bool Execute(const Command&);
+			
+			uint64_t GetNumForwardedCalls() const { return numForwarded; }
+			uint64_t GetNumDroppedCalls() const { return numDropped; }
+			void ResetStatistics() { numForwarded = numDropped = 0; }
+			
+			static const char *GetOpName(Op);
+			
+			/** Replays a trace written by GLStateCachingDevice, logs
+			 * how many calls of each kind are forwarded or dropped and
+			 * checks that the result matches the recorded frame. The
+			 * forwarded calls are also checked against a
+			 * GLRecordingDevice that receives every call: both must
+			 * end up in the same GL state after each call. */
+			static void RunTraceTest(const std::string& fileName);
+		};
+	}
+}
@@ -0,0 +1,662 @@
+/*
+ Copyright (c) 2013 yvt
+ 
+ This file is part of OpenSpades.
+ 
+ OpenSpades is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+ 
+ OpenSpades is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with OpenSpades.  If not, see <http://www.gnu.org/licenses/>.
+ 
+ */
+
+#include "GLStateCachingDevice.h"
+#include "../Core/Debug.h"
+#include "../Core/Settings.h"
+#include "../Core/FileManager.h"
+#include "../Core/IStream.h"
+#include <memory>
+#include <time.h>
+#include <stdio.h>
+#include <string.h>
+
+SPADES_SETTING(r_glStateCacheStats, "0");
+SPADES_SETTING(r_glStateCacheRecord, "0");
+
+namespace spades {
+	namespace draw {
+		GLStateCachingDevice::GLStateCachingDevice(IGLDevice *base):
+		base(base),
+		statFrames(0),
+		recording(false) {
+			SPADES_MARK_FUNCTION();
+		}
+		
+		GLStateCachingDevice::~GLStateCachingDevice() {
+			SPADES_MARK_FUNCTION();
+		}
+		
+#pragma mark - Trace Recording
+		
+		void GLStateCachingDevice::Record(GLStateCache::Op op, Integer a0, Integer a1,
+										  Integer a2, Integer a3) {
+			GLStateCache::Command cmd;
+			memset(&cmd, 0, sizeof(cmd));
+			cmd.op = op;
+			cmd.args[0] = a0; cmd.args[1] = a1;
+			cmd.args[2] = a2; cmd.args[3] = a3;
+			trace.push_back(cmd);
+		}
+		
+		void GLStateCachingDevice::Record(GLStateCache::Op op, Integer a0, Integer a1,
+										  const void *values, int count) {
+			GLStateCache::Command cmd;
+			memset(&cmd, 0, sizeof(cmd));
+			cmd.op = op;
+			cmd.args[0] = a0; cmd.args[1] = a1;
+			memcpy(cmd.values, values, count * sizeof(Float));
+			trace.push_back(cmd);
+		}
+		
+		void GLStateCachingDevice::WriteTrace() {
+			SPADES_MARK_FUNCTION();
+			
+			char name[256];
+			time_t t;
+			time(&t);
+			struct tm tm = *localtime(&t);
+			sprintf(name, "GLStateTraces/%04d%02d%02d%02d%02d%02d.bin",
+					tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday,
+					tm.tm_hour, tm.tm_min, tm.tm_sec);
+			try{
+				std::unique_ptr<IStream> stream(FileManager::OpenForWriting(name));
+				uint32_t header[] = {
+					(uint32_t)trace.size(),
+					(uint32_t)cache.GetNumForwardedCalls(),
+					(uint32_t)cache.GetNumDroppedCalls()
+				};
+				stream->Write("GLST");
+				stream->Write(header, sizeof(header));
+				stream->Write(trace.data(), trace.size() * sizeof(GLStateCache::Command));
+				SPLog("Wrote %d GL state calls to %s (forwarded: %u, dropped: %u)",
+					  (int)trace.size(), name, header[1], header[2]);
+			}catch(const std::exception& ex){
+				SPLog("Failed to write the GL state trace: %s", ex.what());
+			}
+			trace.clear();
+		}
+		
+		void GLStateCachingDevice::Swap() {
+			base->Swap();
+			
+			if(recording) {
+				WriteTrace();
+				recording = false;
+			}
+			
+			if(r_glStateCacheStats) {
+				if(++statFrames >= 60) {
+					SPLog("GL state cache: %.1f calls forwarded, %.1f dropped per frame",
+						  (double)cache.GetNumForwardedCalls() / statFrames,
+						  (double)cache.GetNumDroppedCalls() / statFrames);
+					statFrames = 0;
+					cache.ResetStatistics();
+				}
+			}
+			
+			if(r_glStateCacheRecord) {
+				r_glStateCacheRecord = 0;
+				// start from a clean cache so that replaying the trace
+				// makes the same decisions
+				cache.Invalidate();
+				cache.ResetStatistics();
+				statFrames = 0;
+				recording = true;
+			}
+		}
+		
+#pragma mark - Cached State
+		
+		void GLStateCachingDevice::Viewport(Integer x, Integer y, Sizei width, Sizei height) {
+			if(recording) Record(GLStateCache::OpViewport, x, y, width, height);
+			if(cache.Viewport(x, y, width, height))
+				base->Viewport(x, y, width, height);
+		}
+		
+		void GLStateCachingDevice::ClearColor(Float r, Float g, Float b, Float a) {
+			if(recording) {
+				Float values[] = {r, g, b, a};
+				Record(GLStateCache::OpClearColor, 0, 0, values, 4);
+			}
+			if(cache.ClearColor(r, g, b, a))
+				base->ClearColor(r, g, b, a);
+		}
+		
+		void GLStateCachingDevice::DepthMask(bool b) {
+			if(recording) Record(GLStateCache::OpDepthMask, b);
+			if(cache.DepthMask(b))
+				base->DepthMask(b);
+		}
+		
+		void GLStateCachingDevice::ColorMask(bool r, bool g, bool b, bool a) {
+			if(recording) Record(GLStateCache::OpColorMask, r, g, b, a);
+			if(cache.ColorMask(r, g, b, a))
+				base->ColorMask(r, g, b, a);
+		}
+		
+		void GLStateCachingDevice::FrontFace(Enum mode) {
+			if(recording) Record(GLStateCache::OpFrontFace, mode);
+			if(cache.FrontFace(mode))
+				base->FrontFace(mode);
+		}
+		
+		void GLStateCachingDevice::Enable(Enum state, bool b) {
+			if(recording) Record(GLStateCache::OpEnable, state, b);
+			if(cache.Enable(state, b))
+				base->Enable(state, b);
+		}
+		
+		void GLStateCachingDevice::BlendEquation(Enum mode) {
+			if(recording) Record(GLStateCache::OpBlendEquation, mode, mode);
+			if(cache.BlendEquation(mode, mode))
+				base->BlendEquation(mode);
+		}
+		
+		void GLStateCachingDevice::BlendEquation(Enum rgb, Enum alpha) {
+			if(recording) Record(GLStateCache::OpBlendEquation, rgb, alpha);
+			if(cache.BlendEquation(rgb, alpha))
+				base->BlendEquation(rgb, alpha);
+		}
+		
+		void GLStateCachingDevice::BlendFunc(Enum src, Enum dest) {
+			if(recording) Record(GLStateCache::OpBlendFunc, src, dest, src, dest);
+			if(cache.BlendFunc(src, dest, src, dest))
+				base->BlendFunc(src, dest);
+		}
+		
+		void GLStateCachingDevice::BlendFunc(Enum srcRgb, Enum destRgb,
+											 Enum srcAlpha, Enum destAlpha) {
+			if(recording) Record(GLStateCache::OpBlendFunc, srcRgb, destRgb, srcAlpha, destAlpha);
+			if(cache.BlendFunc(srcRgb, destRgb, srcAlpha, destAlpha))
+				base->BlendFunc(srcRgb, destRgb, srcAlpha, destAlpha);
+		}
+		
+		void GLStateCachingDevice::BlendColor(Float r, Float g, Float b, Float a) {
+			if(recording) {
+				Float values[] = {r, g, b, a};
+				Record(GLStateCache::OpBlendColor, 0, 0, values, 4);
+			}
+			if(cache.BlendColor(r, g, b, a))
+				base->BlendColor(r, g, b, a);
+		}
+		
+		void GLStateCachingDevice::DepthFunc(Enum func) {
+			if(recording) Record(GLStateCache::OpDepthFunc, func);
+			if(cache.DepthFunc(func))
+				base->DepthFunc(func);
+		}
+		
+		void GLStateCachingDevice::BindBuffer(Enum target, UInteger buffer) {
+			if(recording) Record(GLStateCache::OpBindBuffer, target, buffer);
+			if(cache.BindBuffer(target, buffer))
+				base->BindBuffer(target, buffer);
+		}
+		
+		void GLStateCachingDevice::DeleteBuffer(UInteger buffer) {
+			if(recording) Record(GLStateCache::OpDeleteBuffer, buffer);
+			cache.DeleteBuffer(buffer);
+			base->DeleteBuffer(buffer);
+		}
+		
+		void GLStateCachingDevice::ActiveTexture(UInteger stage) {
+			if(recording) Record(GLStateCache::OpActiveTexture, stage);
+			if(cache.ActiveTexture(stage))
+				base->ActiveTexture(stage);
+		}
+		
+		void GLStateCachingDevice::BindTexture(Enum target, UInteger texture) {
+			if(recording) Record(GLStateCache::OpBindTexture, target, texture);
+			if(cache.BindTexture(target, texture))
+				base->BindTexture(target, texture);
+		}
+		
+		void GLStateCachingDevice::DeleteTexture(UInteger texture) {
+			if(recording) Record(GLStateCache::OpDeleteTexture, texture);
+			cache.DeleteTexture(texture);
+			base->DeleteTexture(texture);
+		}
+		
+		void GLStateCachingDevice::EnableVertexAttribArray(UInteger index, bool b) {
+			if(recording) Record(GLStateCache::OpEnableVertexAttribArray, index, b);
+			if(cache.EnableVertexAttribArray(index, b))
+				base->EnableVertexAttribArray(index, b);
+		}
+		
+		void GLStateCachingDevice::LinkProgram(UInteger program) {
+			if(recording) Record(GLStateCache::OpLinkProgram, program);
+			cache.LinkProgram(program);
+			base->LinkProgram(program);
+		}
+		
+		void GLStateCachingDevice::UseProgram(UInteger program) {
+			if(recording) Record(GLStateCache::OpUseProgram, program);
+			if(cache.UseProgram(program))
+				base->UseProgram(program);
+		}
+		
+		void GLStateCachingDevice::DeleteProgram(UInteger program) {
+			if(recording) Record(GLStateCache::OpDeleteProgram, program);
+			cache.DeleteProgram(program);
+			base->DeleteProgram(program);
+		}
+		
+		void GLStateCachingDevice::Uniform(Integer loc, Float x) {
+			Float values[] = {x};
+			if(recording) Record(GLStateCache::OpUniformFloat, loc, 1, values, 1);
+			if(cache.Uniform(loc, values, 1))
+				base->Uniform(loc, x);
+		}
+		
+		void GLStateCachingDevice::Uniform(Integer loc, Float x, Float y) {
+			Float values[] = {x, y};
+			if(recording) Record(GLStateCache::OpUniformFloat, loc, 2, values, 2);
+			if(cache.Uniform(loc, values, 2))
+				base->Uniform(loc, x, y);
+		}
+		
+		void GLStateCachingDevice::Uniform(Integer loc, Float x, Float y, Float z) {
+			Float values[] = {x, y, z};
+			if(recording) Record(GLStateCache::OpUniformFloat, loc, 3, values, 3);
+			if(cache.Uniform(loc, values, 3))
+				base->Uniform(loc, x, y, z);
+		}
+		
+		void GLStateCachingDevice::Uniform(Integer loc, Float x, Float y, Float z, Float w) {
+			Float values[] = {x, y, z, w};
+			if(recording) Record(GLStateCache::OpUniformFloat, loc, 4, values, 4);
+			if(cache.Uniform(loc, values, 4))
+				base->Uniform(loc, x, y, z, w);
+		}
+		
+		void GLStateCachingDevice::Uniform(Integer loc, Integer x) {
+			Integer values[] = {x};
+			if(recording) Record(GLStateCache::OpUniformInteger, loc, 1, values, 1);
+			if(cache.Uniform(loc, values, 1))
+				base->Uniform(loc, x);
+		}
+		
+		void GLStateCachingDevice::Uniform(Integer loc, Integer x, Integer y) {
+			Integer values[] = {x, y};
+			if(recording) Record(GLStateCache::OpUniformInteger, loc, 2, values, 2);
+			if(cache.Uniform(loc, values, 2))
+				base->Uniform(loc, x, y);
+		}
+		
+		void GLStateCachingDevice::Uniform(Integer loc, Integer x, Integer y, Integer z) {
+			Integer values[] = {x, y, z};
+			if(recording) Record(GLStateCache::OpUniformInteger, loc, 3, values, 3);
+			if(cache.Uniform(loc, values, 3))
+				base->Uniform(loc, x, y, z);
+		}
+		
+		void GLStateCachingDevice::Uniform(Integer loc, Integer x, Integer y, Integer z, Integer w) {
+			Integer values[] = {x, y, z, w};
+			if(recording) Record(GLStateCache::OpUniformInteger, loc, 4, values, 4);
+			if(cache.Uniform(loc, values, 4))
+				base->Uniform(loc, x, y, z, w);
+		}
+		
+		void GLStateCachingDevice::Uniform(Integer loc, bool transpose, const Matrix4 &mat) {
+			if(recording) Record(GLStateCache::OpUniformMatrix, loc, transpose, mat.m, 16);
+			if(cache.Uniform(loc, transpose, mat))
+				base->Uniform(loc, transpose, mat);
+		}
+		
+		void GLStateCachingDevice::BindFramebuffer(Enum target, UInteger framebuffer) {
+			if(recording) Record(GLStateCache::OpBindFramebuffer, target, framebuffer);
+			if(cache.BindFramebuffer(target, framebuffer))
+				base->BindFramebuffer(target, framebuffer);
+		}
+		
+		void GLStateCachingDevice::DeleteFramebuffer(UInteger framebuffer) {
+			if(recording) Record(GLStateCache::OpDeleteFramebuffer, framebuffer);
+			cache.DeleteFramebuffer(framebuffer);
+			base->DeleteFramebuffer(framebuffer);
+		}
+		
+#pragma mark - Pass-through
+		
+		void GLStateCachingDevice::DepthRange(Float near, Float far) {
+			base->DepthRange(near, far);
+		}
+		
+		void GLStateCachingDevice::ClearDepth(Float depth) {
+			base->ClearDepth(depth);
+		}
+		
+		void GLStateCachingDevice::Clear(Enum mask) {
+			base->Clear(mask);
+		}
+		
+		void GLStateCachingDevice::Finish() {
+			base->Finish();
+		}
+		
+		void GLStateCachingDevice::Flush() {
+			base->Flush();
+		}
+		
+		IGLDevice::Integer GLStateCachingDevice::GetInteger(Enum type) {
+			return base->GetInteger(type);
+		}
+		
+		const char *GLStateCachingDevice::GetString(Enum type) {
+			return base->GetString(type);
+		}
+		
+		const char *GLStateCachingDevice::GetIndexedString(Enum type, UInteger index) {
+			return base->GetIndexedString(type, index);
+		}
+		
+		void GLStateCachingDevice::LineWidth(Float width) {
+			base->LineWidth(width);
+		}
+		
+		IGLDevice::UInteger GLStateCachingDevice::GenBuffer() {
+			return base->GenBuffer();
+		}
+		
+		void *GLStateCachingDevice::MapBuffer(Enum target, Enum access) {
+			return base->MapBuffer(target, access);
+		}
+		
+		void GLStateCachingDevice::UnmapBuffer(Enum target) {
+			base->UnmapBuffer(target);
+		}
+		
+		void GLStateCachingDevice::BufferData(Enum target, Sizei size, const void *data,
+										Enum usage) {
+			base->BufferData(target, size, data, usage);
+		}
+		
+		void GLStateCachingDevice::BufferSubData(Enum target, Sizei offset, Sizei size,
+										const void *data) {
+			base->BufferSubData(target, offset, size, data);
+		}
+		
+		IGLDevice::UInteger GLStateCachingDevice::GenQuery() {
+			return base->GenQuery();
+		}
+		
+		void GLStateCachingDevice::DeleteQuery(UInteger query) {
+			base->DeleteQuery(query);
+		}
+		
+		void GLStateCachingDevice::BeginQuery(Enum target, UInteger query) {
+			base->BeginQuery(target, query);
+		}
+		
+		void GLStateCachingDevice::EndQuery(Enum target) {
+			base->EndQuery(target);
+		}
+		
+		IGLDevice::UInteger GLStateCachingDevice::GetQueryObjectUInteger(UInteger query,
+										Enum pname) {
+			return base->GetQueryObjectUInteger(query, pname);
+		}
+		
+		void GLStateCachingDevice::BeginConditionalRender(UInteger query, Enum mode) {
+			base->BeginConditionalRender(query, mode);
+		}
+		
+		void GLStateCachingDevice::EndConditionalRender() {
+			base->EndConditionalRender();
+		}
+		
+		IGLDevice::UInteger GLStateCachingDevice::GenTexture() {
+			return base->GenTexture();
+		}
+		
+		void GLStateCachingDevice::TexParamater(Enum target, Enum paramater, Enum value) {
+			base->TexParamater(target, paramater, value);
+		}
+		
+		void GLStateCachingDevice::TexParamater(Enum target, Enum paramater,
+										float value) {
+			base->TexParamater(target, paramater, value);
+		}
+		
+		void GLStateCachingDevice::TexImage2D(Enum target, Integer level,
+										Enum internalFormat, Sizei width, Sizei height,
+										Integer border, Enum format, Enum type,
+										const void *data) {
+			base->TexImage2D(target, level, internalFormat, width, height, border, format,
+								type, data);
+		}
+		
+		void GLStateCachingDevice::TexImage3D(Enum target, Integer level,
+										Enum internalFormat, Sizei width, Sizei height,
+										Sizei depth, Integer border, Enum format,
+										Enum type, const void *data) {
+			base->TexImage3D(target, level, internalFormat, width, height, depth, border,
+								format, type, data);
+		}
+		
+		void GLStateCachingDevice::TexSubImage2D(Enum target, Integer level, Integer x,
+										Integer y, Sizei width, Sizei height, Enum format,
+										Enum type, const void *data) {
+			base->TexSubImage2D(target, level, x, y, width, height, format, type, data);
+		}
+		
+		void GLStateCachingDevice::TexSubImage3D(Enum target, Integer level, Integer x,
+										Integer y, Integer z, Sizei width, Sizei height,
+										Sizei depth, Enum format, Enum type,
+										const void *data) {
+			base->TexSubImage3D(target, level, x, y, z, width, height, depth, format, type,
+								data);
+		}
+		
+		void GLStateCachingDevice::CopyTexSubImage2D(Enum target, Integer level,
+										Integer destinationX, Integer destinationY,
+										Integer srcX, Integer srcY, Sizei width,
+										Sizei height) {
+			base->CopyTexSubImage2D(target, level, destinationX, destinationY, srcX, srcY,
+								width, height);
+		}
+		
+		void GLStateCachingDevice::GenerateMipmap(Enum target) {
+			base->GenerateMipmap(target);
+		}
+		
+		void GLStateCachingDevice::VertexAttrib(UInteger index, Float x) {
+			base->VertexAttrib(index, x);
+		}
+		
+		void GLStateCachingDevice::VertexAttrib(UInteger index, Float x, Float y) {
+			base->VertexAttrib(index, x, y);
+		}
+		
+		void GLStateCachingDevice::VertexAttrib(UInteger index, Float x, Float y,
+										Float z) {
+			base->VertexAttrib(index, x, y, z);
+		}
+		
+		void GLStateCachingDevice::VertexAttrib(UInteger index, Float x, Float y, Float z,
+										Float w) {
+			base->VertexAttrib(index, x, y, z, w);
+		}
+		
+		void GLStateCachingDevice::VertexAttribPointer(UInteger index, Integer size,
+										Enum type, bool normalized, Sizei stride,
+										const void *pointer) {
+			base->VertexAttribPointer(index, size, type, normalized, stride, pointer);
+		}
+		
+		void GLStateCachingDevice::VertexAttribIPointer(UInteger index, Integer size,
+										Enum type, Sizei stride, const void *pointer) {
+			base->VertexAttribIPointer(index, size, type, stride, pointer);
+		}
+		
+		void GLStateCachingDevice::VertexAttribDivisor(UInteger index, UInteger divisor) {
+			base->VertexAttribDivisor(index, divisor);
+		}
+		
+		void GLStateCachingDevice::DrawArrays(Enum mode, Integer first, Sizei count) {
+			base->DrawArrays(mode, first, count);
+		}
+		
+		void GLStateCachingDevice::DrawElements(Enum mode, Sizei count, Enum type,
+										const void *indices) {
+			base->DrawElements(mode, count, type, indices);
+		}
+		
+		void GLStateCachingDevice::DrawArraysInstanced(Enum mode, Integer first,
+										Sizei count, Sizei instances) {
+			base->DrawArraysInstanced(mode, first, count, instances);
+		}
+		
+		void GLStateCachingDevice::DrawElementsInstanced(Enum mode, Sizei count, Enum type,
+										const void *indices, Sizei instances) {
+			base->DrawElementsInstanced(mode, count, type, indices, instances);
+		}
+		
+		IGLDevice::UInteger GLStateCachingDevice::CreateShader(Enum type) {
+			return base->CreateShader(type);
+		}
+		
+		void GLStateCachingDevice::ShaderSource(UInteger shader, Sizei count,
+										const char **string, const int *len) {
+			base->ShaderSource(shader, count, string, len);
+		}
+		
+		void GLStateCachingDevice::CompileShader(UInteger shader) {
+			base->CompileShader(shader);
+		}
+		
+		void GLStateCachingDevice::DeleteShader(UInteger shader) {
+			base->DeleteShader(shader);
+		}
+		
+		IGLDevice::Integer GLStateCachingDevice::GetShaderInteger(UInteger shader,
+										Enum param) {
+			return base->GetShaderInteger(shader, param);
+		}
+		
+		void GLStateCachingDevice::GetShaderInfoLog(UInteger shader, Sizei bufferSize,
+										Sizei *length, char *outString) {
+			base->GetShaderInfoLog(shader, bufferSize, length, outString);
+		}
+		
+		IGLDevice::Integer GLStateCachingDevice::GetProgramInteger(UInteger program,
+										Enum param) {
+			return base->GetProgramInteger(program, param);
+		}
+		
+		void GLStateCachingDevice::GetProgramInfoLog(UInteger program, Sizei bufferSize,
+										Sizei *length, char *outString) {
+			base->GetProgramInfoLog(program, bufferSize, length, outString);
+		}
+		
+		IGLDevice::UInteger GLStateCachingDevice::CreateProgram() {
+			return base->CreateProgram();
+		}
+		
+		void GLStateCachingDevice::AttachShader(UInteger program, UInteger shader) {
+			base->AttachShader(program, shader);
+		}
+		
+		void GLStateCachingDevice::DetachShader(UInteger program, UInteger shader) {
+			base->DetachShader(program, shader);
+		}
+		
+		void GLStateCachingDevice::ValidateProgram(UInteger program) {
+			base->ValidateProgram(program);
+		}
+		
+		IGLDevice::Integer GLStateCachingDevice::GetAttribLocation(UInteger program,
+										const char *name) {
+			return base->GetAttribLocation(program, name);
+		}
+		
+		void GLStateCachingDevice::BindAttribLocation(UInteger program, UInteger index,
+										const char *name) {
+			base->BindAttribLocation(program, index, name);
+		}
+		
+		IGLDevice::Integer GLStateCachingDevice::GetUniformLocation(UInteger program,
+										const char *name) {
+			return base->GetUniformLocation(program, name);
+		}
+		
+		IGLDevice::UInteger GLStateCachingDevice::GenRenderbuffer() {
+			return base->GenRenderbuffer();
+		}
+		
+		void GLStateCachingDevice::DeleteRenderbuffer(UInteger renderbuffer) {
+			base->DeleteRenderbuffer(renderbuffer);
+		}
+		
+		void GLStateCachingDevice::BindRenderbuffer(Enum target, UInteger renderbuffer) {
+			base->BindRenderbuffer(target, renderbuffer);
+		}
+		
+		void GLStateCachingDevice::RenderbufferStorage(Enum target, Enum internalFormat,
+										Sizei width, Sizei height) {
+			base->RenderbufferStorage(target, internalFormat, width, height);
+		}
+		
+		void GLStateCachingDevice::RenderbufferStorage(Enum target, Sizei samples,
+										Enum internalFormat, Sizei width, Sizei height) {
+			base->RenderbufferStorage(target, samples, internalFormat, width, height);
+		}
+		
+		IGLDevice::UInteger GLStateCachingDevice::GenFramebuffer() {
+			return base->GenFramebuffer();
+		}
+		
+		void GLStateCachingDevice::FramebufferTexture2D(Enum target, Enum attachment,
+										Enum texTarget, UInteger texture, Integer level) {
+			base->FramebufferTexture2D(target, attachment, texTarget, texture, level);
+		}
+		
+		void GLStateCachingDevice::FramebufferRenderbuffer(Enum target, Enum attachment,
+										Enum renderbufferTarget, UInteger renderbuffer) {
+			base->FramebufferRenderbuffer(target, attachment, renderbufferTarget,
+								renderbuffer);
+		}
+		
+		void GLStateCachingDevice::BlitFramebuffer(Integer srcX0, Integer srcY0,
+										Integer srcX1, Integer srcY1, Integer dstX0,
+										Integer dstY0, Integer dstX1, Integer dstY1,
+										UInteger mask, Enum filter) {
+			base->BlitFramebuffer(srcX0, srcY0, srcX1, srcY1, dstX0, dstY0, dstX1, dstY1,
+								mask, filter);
+		}
+		
+		IGLDevice::Enum GLStateCachingDevice::CheckFramebufferStatus(Enum target) {
+			return base->CheckFramebufferStatus(target);
+		}
+		
+		void GLStateCachingDevice::ReadPixels(Integer x, Integer y, Sizei width,
+										Sizei height, Enum format, Enum type,
+										void *data) {
+			base->ReadPixels(x, y, width, height, format, type, data);
+		}
+		
+		IGLDevice::Integer GLStateCachingDevice::ScreenWidth() {
+			return base->ScreenWidth();
+		}
+		
+		IGLDevice::Integer GLStateCachingDevice::ScreenHeight() {
+			return base->ScreenHeight();
+		}
+	}
+}
@@ -35,6 +35,7 @@
 #include "../kiss_fft130/kiss_fft.h"
 #include "GLProfiler.h"
 #include "../Core/Settings.h"
+#include "SWFeatureLevel.h"
 
 SPADES_SETTING(r_water, "2");
 SPADES_SETTING(r_maxAnisotropy, "8");
@@ -50,9 +51,15 @@ namespace spades {
 			float dt;
 			int size, samples;
 		private:
-			uint32_t *bitmap;
+			// the simulation writes backBitmap while frontBitmap is
+			// being uploaded
+			uint32_t *frontBitmap;
+			uint32_t *backBitmap;
+			
+			// simulated time that hasn't been handed to the simulation yet
+			float pendingTime;
+			volatile bool done;
 			
-						
 			int Encode8bit(float v){
 				v = (v + 1.f) * .5f * 255.f;
 				v = floorf(v + .5f);
@@ -76,6 +83,18 @@ namespace spades {
 				return out;
 			}
 			
+#if ENABLE_SSE2
+			// same as Encode8bit, four at once
+			static __m128i Encode8bit4(__m128 v) {
+				v = _mm_add_ps(v, _mm_set1_ps(1.f));
+				v = _mm_mul_ps(_mm_mul_ps(v, _mm_set1_ps(.5f)), _mm_set1_ps(255.f));
+				v = _mm_add_ps(v, _mm_set1_ps(.5f));
+				v = _mm_max_ps(v, _mm_setzero_ps());
+				v = _mm_min_ps(v, _mm_set1_ps(255.f));
+				return _mm_cvttps_epi32(v);
+			}
+#endif
+			
 			void MakeBitmapRow(float *h1, float *h2, float *h3,
 							   uint32_t *out) {
 				out[0] = MakeBitmapPixel(h2[1] - h2[size-1],
@@ -84,36 +103,88 @@ namespace spades {
 				out[size-1] = MakeBitmapPixel(h2[0] - h2[size-2],
 										 h3[size-1]-h1[size-1],
 											  h2[size-1]);
-				for(int x = 1; x < size - 1; x++) {
+				int x = 1;
+#if ENABLE_SSE2
+				const float scale = 200.f;
+				__m128i z = _mm_set1_epi32(Encode8bit(0.04f * scale));
+				for(; x + 4 <= size - 1; x += 4) {
+					__m128 dx = _mm_sub_ps(_mm_loadu_ps(h2 + x + 1),
+										   _mm_loadu_ps(h2 + x - 1));
+					__m128 dy = _mm_sub_ps(_mm_loadu_ps(h3 + x),
+										   _mm_loadu_ps(h1 + x));
+					__m128 h = _mm_loadu_ps(h2 + x);
+					
+					__m128i px = z;
+					px = _mm_or_si128(px, _mm_slli_epi32(Encode8bit4(_mm_mul_ps(dy, _mm_set1_ps(scale))), 8));
+					px = _mm_or_si128(px, _mm_slli_epi32(Encode8bit4(_mm_mul_ps(dx, _mm_set1_ps(scale))), 16));
+					px = _mm_or_si128(px, _mm_slli_epi32(Encode8bit4(_mm_mul_ps(h, _mm_set1_ps(-10.f))), 24));
+					_mm_storeu_si128(reinterpret_cast<__m128i *>(out + x), px);
+				}
+#endif
+				for(; x < size - 1; x++) {
 					out[x] = MakeBitmapPixel(h2[x+1]-h2[x-1], h3[x]-h1[x],
 											 h2[x]);
 				}
 			}
 			
+		protected:
+			/** Advances the simulation by dt and writes the result with
+			 * MakeBitmap. Called on a worker thread. */
+			virtual void Simulate() = 0;
+			
 		public:
 			IWaveTank(int size):size(size) {
 				
-				bitmap = new uint32_t[size*size];
+				frontBitmap = new uint32_t[size*size]();
+				backBitmap = new uint32_t[size*size]();
 				
+				pendingTime = 0.f;
+				done = true;
 				
 				samples = size * size;
 			}
 			virtual ~IWaveTank(){
-				delete[] bitmap;
+				delete[] frontBitmap;
+				delete[] backBitmap;
+			}
+			
+			virtual void Run() {
+				Simulate();
+				done = true;
+			}
+			
+			/** Accumulates time to be simulated by the next run. */
+			void AddTimeStep(float dt){
+				pendingTime += dt;
 			}
-			void SetTimeStep(float dt){
-				this->dt = dt;
+			
+			/** If the last run has finished, publishes its result as the
+			 * front bitmap and starts the next run; otherwise returns
+			 * false without waiting. */
+			bool TryRestart(){
+				if(!done)
+					return false;
+				Join();
+				std::swap(frontBitmap, backBitmap);
+				dt = pendingTime;
+				pendingTime = 0.f;
+				done = false;
+				Start();
+				return true;
 			}
 			
 			int GetSize()  const {
 				return size;
 			}
 			
+			/** Result of the last finished run. Stable until the
+			 * next TryRestart. */
 			uint32_t *GetBitmap() const {
-				return bitmap;
+				return frontBitmap;
 			}
 			
 			void MakeBitmap(float *height){
+				uint32_t *bitmap = backBitmap;
 				MakeBitmapRow(height + (size-1) * size,
 							  height,
 							  height + size,
@@ -179,6 +250,41 @@ namespace spades {
 		
 		static SinCosTable sinCosTable;
 		
+#if ENABLE_SSE2
+		/** sin(phase / 2^32 * 2pi) for four phases. */
+		static inline __m128 SinPhase4(__m128i phase) {
+			// fold [pi/2, 3pi/2] onto [-pi/2, pi/2] with sin(pi - a) = sin(a).
+			// done in fixed point so that the wrap-around is exact.
+			__m128i outside = _mm_srai_epi32(_mm_add_epi32(phase, _mm_set1_epi32(0x40000000)), 31);
+			__m128i folded = _mm_sub_epi32(_mm_set1_epi32((int)0x80000000), phase);
+			phase = _mm_or_si128(_mm_and_si128(outside, folded),
+								 _mm_andnot_si128(outside, phase));
+			
+			__m128 x = _mm_mul_ps(_mm_cvtepi32_ps(phase),
+								  _mm_set1_ps((float)M_PI * 2.f / 4294967296.f));
+			__m128 x2 = _mm_mul_ps(x, x);
+			
+			// Taylor series up to x^9; error < 4e-6 on [-pi/2, pi/2]
+			__m128 r = _mm_set1_ps(1.f / 362880.f);
+			r = _mm_add_ps(_mm_mul_ps(r, x2), _mm_set1_ps(-1.f / 5040.f));
+			r = _mm_add_ps(_mm_mul_ps(r, x2), _mm_set1_ps(1.f / 120.f));
+			r = _mm_add_ps(_mm_mul_ps(r, x2), _mm_set1_ps(-1.f / 6.f));
+			r = _mm_add_ps(_mm_mul_ps(r, x2), _mm_set1_ps(1.f));
+			return _mm_mul_ps(r, x);
+		}
+		
+		/** (uint32_t)v modulo 2^32 for non-negative v of any magnitude. */
+		static inline __m128i WrapToPhase4(__m128 v) {
+			const __m128 scale = _mm_set1_ps(4294967296.f);
+			__m128 turns = _mm_cvtepi32_ps(_mm_cvttps_epi32(_mm_mul_ps(v, _mm_set1_ps(1.f / 4294967296.f))));
+			v = _mm_sub_ps(v, _mm_mul_ps(turns, scale));
+			// [2^31, 2^32) doesn't fit in int32; the same bits are v - 2^32
+			__m128 upper = _mm_cmpge_ps(v, _mm_set1_ps(2147483648.f));
+			v = _mm_sub_ps(v, _mm_and_ps(upper, scale));
+			return _mm_cvttps_epi32(v);
+		}
+#endif
+		
 		class GLWaterRenderer::FFTWaveTank: public IWaveTank {
 			enum {
 				SizeBits = 7,
@@ -189,20 +295,20 @@ namespace spades {
 			
 			typedef kiss_fft_cpx Complex;
 			
-			struct Cell {
-				float magnitude;
-				uint32_t phase;
-				float phasePerSecond;
+			// one row of cells, laid out for four-wide evaluation
+			struct CellRow {
+				float magnitude[Size];
+				uint32_t phase[Size];
+				float phasePerSecond[Size];
 				
-				float m00, m01;
-				float m10, m11;
+				float m00[Size], m01[Size];
+				float m10[Size], m11[Size];
 			};
 			
-			Cell cells[SizeHalf+1][Size];
+			CellRow cells[SizeHalf+1];
 			
 			Complex spectrum[SizeHalf+1][Size];
 			
-			Complex temp1[Size];
 			Complex temp2[Size];
 			Complex temp3[Size][Size];
 			
@@ -214,11 +320,11 @@ namespace spades {
 				
 				for(int x = 0; x < Size; x++){
 					for(int y = 0; y <= SizeHalf; y++){
-						Cell& cell = cells[y][x];
+						CellRow& row = cells[y];
 						if(x == 0 && y == 0){
-							cell.magnitude = 0;
-							cell.phasePerSecond = 0.f;
-							cell.phase = 0;
+							row.magnitude[x] = 0;
+							row.phasePerSecond[x] = 0.f;
+							row.phase[x] = 0;
 						}else{
 							int cx = std::min(x, Size-x);
 							float dist = (float)sqrtf(cx*cx+y*y);
@@ -230,15 +336,15 @@ namespace spades {
 							mag *= expf(-scal * 4.f);
 							
 							
-							cell.magnitude = mag;
-							cell.phase = rand() | ((uint32_t)rand() << 16);
-							cell.phasePerSecond = dist * 1.e+9f;
+							row.magnitude[x] = mag;
+							row.phase[x] = rand() | ((uint32_t)rand() << 16);
+							row.phasePerSecond[x] = dist * 1.e+9f;
 						}
 						
-						cell.m00 = GetRandom() - GetRandom();
-						cell.m01 = GetRandom() - GetRandom();
-						cell.m10 = GetRandom() - GetRandom();
-						cell.m11 = GetRandom() - GetRandom();
+						row.m00[x] = GetRandom() - GetRandom();
+						row.m01[x] = GetRandom() - GetRandom();
+						row.m10[x] = GetRandom() - GetRandom();
+						row.m11[x] = GetRandom() - GetRandom();
 					}
 				}
 			}
@@ -246,34 +352,61 @@ namespace spades {
 				kiss_fft_free(fft);
 			}
 			
-			virtual void Run() {
-				// advance cells
+			void AdvanceRow(int y) {
+				CellRow& row = cells[y];
+				Complex *out = spectrum[y];
+#if ENABLE_SSE2
+				__m128 dt4 = _mm_set1_ps(dt);
+				for(int x = 0; x < Size; x += 4){
+					__m128i phase = _mm_loadu_si128(reinterpret_cast<__m128i *>(row.phase + x));
+					__m128 dphase = _mm_mul_ps(_mm_loadu_ps(row.phasePerSecond + x), dt4);
+					phase = _mm_add_epi32(phase, WrapToPhase4(dphase));
+					_mm_storeu_si128(reinterpret_cast<__m128i *>(row.phase + x), phase);
+					
+					__m128 s = SinPhase4(phase);
+					__m128 c = SinPhase4(_mm_add_epi32(phase, _mm_set1_epi32(0x40000000)));
+					
+					__m128 mag = _mm_loadu_ps(row.magnitude + x);
+					__m128 u = _mm_add_ps(_mm_mul_ps(c, _mm_loadu_ps(row.m00 + x)),
+										  _mm_mul_ps(s, _mm_loadu_ps(row.m01 + x)));
+					__m128 v = _mm_add_ps(_mm_mul_ps(c, _mm_loadu_ps(row.m10 + x)),
+										  _mm_mul_ps(s, _mm_loadu_ps(row.m11 + x)));
+					u = _mm_mul_ps(u, mag);
+					v = _mm_mul_ps(v, mag);
+					
+					// interleave into (r, i) pairs
+					float *dest = reinterpret_cast<float *>(out + x);
+					_mm_storeu_ps(dest, _mm_unpacklo_ps(u, v));
+					_mm_storeu_ps(dest + 4, _mm_unpackhi_ps(u, v));
+				}
+#else
 				for(int x = 0; x < Size; x++){
-					for(int y = 0; y <= SizeHalf; y++){
-						Cell& cell = cells[y][x];
-						uint32_t dphase;
-						dphase = (uint32_t)(cell.phasePerSecond * dt);
-						cell.phase += dphase;
-						
-						unsigned int phase = cell.phase >> 16;
-						float c, s;
-						sinCosTable.Compute(phase, s, c);
-						
-						float u, v;
-						u = c * cell.m00 + s * cell.m01;
-						v = c * cell.m10 + s * cell.m11;
-						
-						spectrum[y][x].r = u * cell.magnitude;
-						spectrum[y][x].i = v * cell.magnitude;
-					}
+					uint32_t dphase;
+					dphase = (uint32_t)(int64_t)(row.phasePerSecond[x] * dt);
+					row.phase[x] += dphase;
+					
+					unsigned int phase = row.phase[x] >> 16;
+					float c, s;
+					sinCosTable.Compute(phase, s, c);
+					
+					float u, v;
+					u = c * row.m00[x] + s * row.m01[x];
+					v = c * row.m10[x] + s * row.m11[x];
+					
+					out[x].r = u * row.magnitude[x];
+					out[x].i = v * row.magnitude[x];
 				}
+#endif
+			}
+			
+			virtual void Simulate() {
+				// advance cells
+				for(int y = 0; y <= SizeHalf; y++)
+					AdvanceRow(y);
 				
 				// rfft
 				for(int y = 0; y <= SizeHalf; y++){
-					for(int x = 0; x < Size; x++)
-						temp1[x] = spectrum[y][x];
-					
-					kiss_fft(fft, temp1, temp2);
+					kiss_fft(fft, spectrum[y], temp2);
 					
 					if(y == 0){
 						for(int x = 0; x < Size; x++){
@@ -389,7 +522,7 @@ namespace spades {
 				delete[] velocity;
 			}
 			
-			virtual void Run() {
+			virtual void Simulate() {
 				// advance time
 				for(int i = 0; i < samples; i++)
 					height[i] += velocity[i] * dt;
@@ -916,45 +1049,38 @@ namespace spades {
 			SPADES_MARK_FUNCTION();
 			GLProfiler profiler(device, "Update");
 			
-			// update wavetank simulation
-			{
-				GLProfiler profiler(device, "Waiting for Simulation To Done");
-				for(size_t i = 0; i < waveTanks.size(); i++){
-					waveTanks[i]->Join();
-				}
-			}
-			{
-				{
-					GLProfiler profiler(device, "Upload");
-					for(size_t i = 0; i < waveTanks.size(); i++){
-						device->BindTexture(IGLDevice::Texture2D, waveTextures[i]);
-						device->TexSubImage2D(IGLDevice::Texture2D, 0,
-											  0, 0, waveTanks[i]->GetSize(), waveTanks[i]->GetSize(),
-											  IGLDevice::BGRA, IGLDevice::UnsignedByte,
-											  waveTanks[i]->GetBitmap());
-					}
-				}
-				{
-					GLProfiler profiler(device, "Generate Mipmap");
-					for(size_t i = 0; i < waveTanks.size(); i++){
-						device->BindTexture(IGLDevice::Texture2D, waveTextures[i]);
-						device->GenerateMipmap(IGLDevice::Texture2D);
-					}
-				}
-			}
+			// update wavetank simulation.
+			// a layer whose simulation is still running keeps showing its
+			// previous result; we never wait for it.
 			for(size_t i = 0; i < waveTanks.size(); i++){
 				switch(i){
 					case 0:
-						waveTanks[i]->SetTimeStep(dt);
+						waveTanks[i]->AddTimeStep(dt);
 						break;
 					case 1:
-						waveTanks[i]->SetTimeStep(dt * 0.15704f / .08f);
+						waveTanks[i]->AddTimeStep(dt * 0.15704f / .08f);
 						break;
 					case 2:
-						waveTanks[i]->SetTimeStep(dt * 0.02344f / .08f);
+						waveTanks[i]->AddTimeStep(dt * 0.02344f / .08f);
 						break;
 				}
-				waveTanks[i]->Start();
+				if(!waveTanks[i]->TryRestart())
+					continue;
+				
+				// the finished result is uploaded while the next one is
+				// being simulated into the other buffer
+				{
+					GLProfiler profiler(device, "Upload");
+					device->BindTexture(IGLDevice::Texture2D, waveTextures[i]);
+					device->TexSubImage2D(IGLDevice::Texture2D, 0,
+										  0, 0, waveTanks[i]->GetSize(), waveTanks[i]->GetSize(),
+										  IGLDevice::BGRA, IGLDevice::UnsignedByte,
+										  waveTanks[i]->GetBitmap());
+				}
+				{
+					GLProfiler profiler(device, "Generate Mipmap");
+					device->GenerateMipmap(IGLDevice::Texture2D);
+				}
 			}
 			
 			{
@@ -0,0 +1,300 @@
+/*
+ Copyright (c) 2013 yvt
+ 
+ This file is part of OpenSpades.
+ 
+ OpenSpades is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+ 
+ OpenSpades is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with OpenSpades.  If not, see <http://www.gnu.org/licenses/>.
+ 
+ */
+
+
+#include "SWFrameCapture.h"
+#include <Core/Bitmap.h>
+#include <Core/IStream.h>
+#include <Core/FileManager.h>
+#include <Core/Settings.h>
+#include <Core/Exception.h>
+#include <Core/Debug.h>
+#include <Core/AutoLocker.h>
+#include <Core/Stopwatch.h>
+#include <Core/Strings.h>
+#include <algorithm>
+#include <cstring>
+
+SPADES_SETTING(r_swCaptureInterval, "2");
+SPADES_SETTING(r_swCaptureWidth, "0");
+SPADES_SETTING(r_swCaptureHeight, "0");
+SPADES_SETTING(r_swCaptureFormat, "y4m");
+SPADES_SETTING(r_swCaptureFrameRate, "30");
+SPADES_SETTING(r_swCaptureBuffers, "8");
+
+namespace spades {
+	namespace draw {
+		
+		SWFrameCapture::SWFrameCapture(int screenWidth, int screenHeight):
+		filledSemaphore(0),
+		exiting(false),
+		numFramesSeen(0),
+		numFramesCaptured(0),
+		numFramesDropped(0),
+		numFramesWritten(0),
+		encodeTime(0.) {
+			SPADES_MARK_FUNCTION();
+			
+			width = r_swCaptureWidth;
+			height = r_swCaptureHeight;
+			if(width <= 0) width = screenWidth;
+			if(height <= 0) height = screenHeight;
+			width = std::min(width, screenWidth) & ~1; // Y4M 4:2:0 needs even size
+			height = std::min(height, screenHeight) & ~1;
+			if(width <= 0 || height <= 0) {
+				SPRaise("Invalid capture size: %dx%d", width, height);
+			}
+			interval = std::max((int)r_swCaptureInterval, 1);
+			frameRate = std::max((int)r_swCaptureFrameRate, 1);
+			
+			const char *ext;
+			if(EqualsIgnoringCase(r_swCaptureFormat, "y4m")) {
+				format = Format::Y4M; ext = "y4m";
+			}else if(EqualsIgnoringCase(r_swCaptureFormat, "png")) {
+				format = Format::Png; ext = "png";
+			}else if(EqualsIgnoringCase(r_swCaptureFormat, "targa")) {
+				format = Format::Targa; ext = "tga";
+			}else if(EqualsIgnoringCase(r_swCaptureFormat, "jpeg")) {
+				format = Format::Jpeg; ext = "jpg";
+			}else{
+				SPRaise("Invalid capture format: %s", r_swCaptureFormat.CString());
+			}
+			
+			// find a free name
+			char buf[256];
+			for(int i = 0; ; i++) {
+				if(i >= 10000) {
+					SPRaise("No free file name");
+				}
+				if(format == Format::Y4M) {
+					sprintf(buf, "Captures/capture%04d.y4m", i);
+				}else{
+					sprintf(buf, "Captures/capture%04d/frame000000.%s", i, ext);
+				}
+				if(FileManager::FileExists(buf))
+					continue;
+				if(format == Format::Y4M) {
+					path = buf;
+				}else{
+					sprintf(buf, "Captures/capture%04d/frame%%06d.%s", i, ext);
+					path = buf;
+				}
+				break;
+			}
+			
+			if(format == Format::Y4M) {
+				stream.reset(FileManager::OpenForWriting(path.c_str()));
+				sprintf(buf, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C420jpeg\n",
+						width, height, frameRate);
+				stream->Write(buf, strlen(buf));
+				yuvBuffer.resize(width * height * 3 / 2);
+			}else{
+				outputBitmap.Set(new Bitmap(width, height), false);
+			}
+			
+			int numBuffers = std::max((int)r_swCaptureBuffers, 2);
+			for(int i = 0; i < numBuffers; i++) {
+				ring.push_back(Handle<Bitmap>(new Bitmap(width, height), false));
+				freeSlots.push_back(i);
+			}
+			
+			srcX.resize(width);
+			for(int x = 0; x < width; x++)
+				srcX[x] = x * screenWidth / width;
+			
+			SPLog("Capturing every %d frame(s) at %dx%d into %s (%d buffers)",
+				  interval, width, height, path.c_str(), numBuffers);
+			
+			Start();
+		}
+		
+		SWFrameCapture::~SWFrameCapture() {
+			SPADES_MARK_FUNCTION();
+			
+			exiting = true;
+			filledSemaphore.Post();
+			Join();
+			
+			stream.reset();
+			
+			SPLog("Frame capture finished: %llu frame(s) written, %llu dropped, "
+				  "%.2f ms/frame to encode",
+				  (unsigned long long)numFramesWritten,
+				  (unsigned long long)numFramesDropped,
+				  numFramesWritten > 0 ? encodeTime * 1000. / (double)numFramesWritten : 0.);
+		}
+		
+		void SWFrameCapture::CaptureFrame(Bitmap *framebuffer) {
+			SPADES_MARK_FUNCTION();
+			
+			if((numFramesSeen++) % (uint64_t)interval != 0)
+				return;
+			
+			int slot;
+			{
+				AutoLocker guard(&mutex);
+				if(freeSlots.empty()) {
+					// encoder is lagging behind; don't stall the renderer
+					numFramesDropped++;
+					return;
+				}
+				slot = freeSlots.back();
+				freeSlots.pop_back();
+			}
+			
+			CopyFrame(framebuffer, ring[slot]);
+			
+			{
+				AutoLocker guard(&mutex);
+				filledSlots.push_back(slot);
+				numFramesCaptured++;
+			}
+			filledSemaphore.Post();
+		}
+		
+		void SWFrameCapture::CopyFrame(Bitmap *src, Bitmap *dest) {
+			int sw = src->GetWidth();
+			int sh = src->GetHeight();
+			uint32_t *inPix = src->GetPixels();
+			uint32_t *outPix = dest->GetPixels();
+			
+			// keeps the framebuffer's pixel format and row order;
+			// conversion is done by the encoder thread
+			if(sw == width && sh == height) {
+				std::memcpy(outPix, inPix, sizeof(uint32_t) * width * height);
+				return;
+			}
+			
+			const int *xs = srcX.data();
+			for(int y = 0; y < height; y++) {
+				const uint32_t *srcRow = inPix + (y * sh / height) * sw;
+				for(int x = 0; x < width; x++)
+					*(outPix++) = srcRow[xs[x]];
+			}
+		}
+		
+		void SWFrameCapture::Run() {
+			SPADES_MARK_FUNCTION();
+			
+			while(true) {
+				filledSemaphore.Wait();
+				
+				int slot;
+				{
+					AutoLocker guard(&mutex);
+					if(filledSlots.empty()) {
+						if(exiting)
+							break;
+						continue;
+					}
+					slot = filledSlots.front();
+					filledSlots.pop_front();
+				}
+				
+				Stopwatch sw;
+				try{
+					WriteFrame(ring[slot]);
+					numFramesWritten++;
+				}catch(const std::exception& ex) {
+					SPLog("Failed to write a captured frame: %s", ex.what());
+				}
+				encodeTime += sw.GetTime();
+				
+				AutoLocker guard(&mutex);
+				freeSlots.push_back(slot);
+			}
+		}
+		
+		void SWFrameCapture::WriteFrame(Bitmap *frame) {
+			if(format == Format::Y4M) {
+				WriteY4MFrame(frame);
+			}else{
+				WriteImageFrame(frame);
+			}
+		}
+		
+		// framebuffer pixels are 0x00RRGGBB, top row first.
+		
+		void SWFrameCapture::WriteY4MFrame(Bitmap *frame) {
+			const uint32_t *pix = frame->GetPixels();
+			uint8_t *yPlane = yuvBuffer.data();
+			uint8_t *uPlane = yPlane + width * height;
+			uint8_t *vPlane = uPlane + (width / 2) * (height / 2);
+			
+			// BT.601, limited range
+			for(int y = 0; y < height; y += 2) {
+				const uint32_t *row0 = pix + y * width;
+				const uint32_t *row1 = row0 + width;
+				uint8_t *y0 = yPlane + y * width;
+				uint8_t *y1 = y0 + width;
+				for(int x = 0; x < width; x += 2) {
+					int sr = 0, sg = 0, sb = 0;
+					auto luma = [&](uint32_t c) -> uint8_t {
+						int r = (c >> 16) & 0xff;
+						int g = (c >> 8) & 0xff;
+						int b = c & 0xff;
+						sr += r; sg += g; sb += b;
+						return (uint8_t)(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+					};
+					y0[x]     = luma(row0[x]);
+					y0[x + 1] = luma(row0[x + 1]);
+					y1[x]     = luma(row1[x]);
+					y1[x + 1] = luma(row1[x + 1]);
+					sr >>= 2; sg >>= 2; sb >>= 2;
+					*(uPlane++) = (uint8_t)(((-38 * sr - 74 * sg + 112 * sb + 128) >> 8) + 128);
+					*(vPlane++) = (uint8_t)(((112 * sr - 94 * sg - 18 * sb + 128) >> 8) + 128);
+				}
+			}
+			
+			static const char frameHeader[] = "FRAME\n";
+			stream->Write(frameHeader, sizeof(frameHeader) - 1);
+			stream->Write(yuvBuffer.data(), yuvBuffer.size());
+		}
+		
+		void SWFrameCapture::WriteImageFrame(Bitmap *frame) {
+			// same conversion as SWRenderer::ReadBitmap
+			const uint32_t *inPix = frame->GetPixels();
+			uint32_t *outPix = outputBitmap->GetPixels();
+			for(int y = 0; y < height; y++) {
+				const uint32_t *src = inPix + y * width;
+				uint32_t *dest = outPix + (height - 1 - y) * width;
+				for(int x = width; x != 0; x--) {
+					auto c = *(src++);
+					c = 0xff000000 | (c&0xff00) | ((c&0xff)<<16) | ((c&0xff0000)>>16);
+					*(dest++) = c;
+				}
+			}
+			
+			char buf[256];
+			sprintf(buf, path.c_str(), (int)numFramesWritten);
+			outputBitmap->Save(buf);
+		}
+		
+		uint64_t SWFrameCapture::GetNumFramesCaptured() {
+			AutoLocker guard(&mutex);
+			return numFramesCaptured;
+		}
+		
+		uint64_t SWFrameCapture::GetNumFramesDropped() {
+			AutoLocker guard(&mutex);
+			return numFramesDropped;
+		}
+	}
+}
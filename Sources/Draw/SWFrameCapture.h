@@ -0,0 +1,95 @@
+/*
+ Copyright (c) 2013 yvt
+ 
+ This file is part of OpenSpades.
+ 
+ OpenSpades is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+ 
+ OpenSpades is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with OpenSpades.  If not, see <http://www.gnu.org/licenses/>.
+ 
+ */
+
+
+#pragma once
+
+#include <Core/Thread.h>
+#include <Core/Mutex.h>
+#include <Core/Semaphore.h>
+#include <Core/RefCountedObject.h>
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <stdint.h>
+
+namespace spades {
+	class Bitmap;
+	class IStream;
+	namespace draw {
+		
+		/** Captures every N-th frame of the software renderer and
+		 * writes it as an image sequence or a Y4M stream on a
+		 * background thread. Frames are copied into a ring of
+		 * preallocated bitmaps; when the ring is full the frame is
+		 * dropped instead of blocking the renderer. */
+		class SWFrameCapture: public Thread {
+		public:
+			enum class Format {
+				Y4M, Png, Targa, Jpeg
+			};
+		private:
+			int width, height;
+			int interval;
+			int frameRate;
+			Format format;
+			std::string path;
+			
+			std::vector<Handle<Bitmap>> ring;
+			std::vector<int> srcX;
+			
+			Mutex mutex;
+			std::vector<int> freeSlots;
+			std::deque<int> filledSlots;
+			Semaphore filledSemaphore;
+			volatile bool exiting;
+			
+			std::unique_ptr<IStream> stream;
+			std::vector<uint8_t> yuvBuffer;
+			Handle<Bitmap> outputBitmap;
+			
+			uint64_t numFramesSeen;
+			uint64_t numFramesCaptured;
+			uint64_t numFramesDropped;
+			uint64_t numFramesWritten;
+			double encodeTime;
+			
+			void CopyFrame(Bitmap *src, Bitmap *dest);
+			void WriteFrame(Bitmap *frame);
+			void WriteY4MFrame(Bitmap *frame);
+			void WriteImageFrame(Bitmap *frame);
+		public:
+			/** reads the configuration from r_swCapture* settings. */
+			SWFrameCapture(int screenWidth, int screenHeight);
+			/** writes the remaining frames and closes the output. */
+			virtual ~SWFrameCapture();
+			
+			/** called by the renderer for every frame before
+			 * the framebuffer is presented. never blocks. */
+			void CaptureFrame(Bitmap *framebuffer);
+			
+			uint64_t GetNumFramesCaptured();
+			uint64_t GetNumFramesDropped();
+			
+			virtual void Run();
+		};
+	}
+}
@@ -19,6 +19,7 @@
  */
 
 #include "SWImage.h"
+#include <Core/AssetPreloader.h>
 #include <Core/FileManager.h>
 #include <Core/IStream.h>
 
@@ -84,7 +85,9 @@ namespace spades {
 			auto it = images.find(name);
 			if(it == images.end()) {
 				Handle<Bitmap> vm;
-				vm.Set(Bitmap::Load(name), false);
+				vm.Set(AssetPreloader::GetInstance().TakeBitmap(name), false);
+				if(!vm)
+					vm.Set(Bitmap::Load(name), false);
 				auto *m = CreateImage(vm);
 				images.insert(std::make_pair(name, m));
 				m->AddRef();
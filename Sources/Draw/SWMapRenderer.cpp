@@ -28,10 +28,14 @@
 #include <Core/Settings.h>
 #include <Core/ConcurrentDispatch.h>
 #include <Core/Stopwatch.h>
+#include <Core/Profiler.h>
 #include "SWUtils.h"
 #include <cstdint>
 
 SPADES_SETTING(r_swUndersampling, "0");
+SPADES_SETTING(r_swReprojection, "0");
+SPADES_SETTING(r_swReprojectionThreshold, "0.1");
+SPADES_SETTING(r_swStatistics, "0");
 
 namespace spades {
 	namespace draw {
@@ -111,6 +115,10 @@ namespace spades {
 			float pitchScale;
 			int pitchTanMinI;
 			int pitchScaleI;
+			
+			// used by the temporal reprojection
+			Vector3 origin;
+			bool valid;
 		};
 		
 
@@ -123,7 +131,12 @@ namespace spades {
 		rleHeap(m->Width() * m->Height() * 64),
 		level(level),
 		w(m->Width()), h(m->Height()),
-		renderer(r){
+		renderer(r),
+		reprojecting(false),
+		reprojectionValid(false),
+		reprojectionResolution(0),
+		numLinesBuilt(0),
+		numLinesReused(0){
 			rle.resize(w * h);
 			rleLen.resize(w * h);
 			
@@ -230,9 +243,45 @@ namespace spades {
 			
 			rle[idx] = ref;
 			rleLen[idx] = rleBuf.size() * sizeof(RleData);
+			
+			if(reprojectionValid) {
+				InvalidateLines(x, y);
+			}
 		}
 		
-		
+		void SWMapRenderer::InvalidateLines(int x, int y) {
+			static const float pi = M_PI;
+			
+			// each line is tested against the origin it was built at,
+			// which can be anywhere within the threshold of the camera.
+			// a line covers the wedge between its neighbors, widened a
+			// little for the rounding of the yaw range in Render.
+			const float radius = 0.75f;
+			float margin = pi * 2.f / static_cast<float>(lines.size()) * 1.5f;
+			float tanMargin = tanf(margin);
+			
+			float cx = static_cast<float>(x) + .5f;
+			float cy = static_cast<float>(y) + .5f;
+			for(auto& line: lines) {
+				if(!line.valid)
+					continue;
+				
+				// find the nearest instance of the (wrapped) column
+				float dx = cx - line.origin.x;
+				float dy = cy - line.origin.y;
+				dx -= floorf(dx / static_cast<float>(w) + .5f) * static_cast<float>(w);
+				dy -= floorf(dy / static_cast<float>(h) + .5f) * static_cast<float>(h);
+				
+				float along = dx * line.horizonDir.x + dy * line.horizonDir.y;
+				if(along < -radius || along - radius > 130.f) {
+					// behind the line, or beyond the fog
+					continue;
+				}
+				float across = fabsf(dx * line.horizonDir.y - dy * line.horizonDir.x);
+				if(across <= radius + std::max(along, 0.f) * tanMargin)
+					line.valid = false;
+			}
+		}
 		
 		template<SWFeatureLevel flevel>
 		void SWMapRenderer::BuildLine(Line& line,
@@ -302,10 +351,14 @@ namespace spades {
 					}
 				};
 				
-				clip(frustrum[2].n);
-				clip(frustrum[3].n);
-				clip(frustrum[4].n);
-				clip(frustrum[5].n);
+				// reprojected lines must remain usable after the
+				// camera rotates, so they cover the whole pitch range.
+				if(!reprojecting) {
+					clip(frustrum[2].n);
+					clip(frustrum[3].n);
+					clip(frustrum[4].n);
+					clip(frustrum[5].n);
+				}
 				
 			}
 			
@@ -422,6 +475,13 @@ namespace spades {
 			float heightScale; // Z value -> view Z value factor
 			heightScale = sceneDef.viewAxis[2].z;
 			
+			if(reprojecting) {
+				// store the horizontal distance instead.
+				// RenderFinal converts it to the view Z value.
+				zscale = 1.f;
+				heightScale = 0.f;
+			}
+			
 			std::array<float, 65> heightScaleVal; // precompute (heightScale * z)
 			for(size_t i = 0; i < zval.size(); i++)
 				heightScaleVal[i] = (static_cast<float>(i) * heightScale);
@@ -767,11 +827,12 @@ namespace spades {
 			}
 		}
 		
-		template<SWFeatureLevel flevel, int under>
+		template<SWFeatureLevel flevel, int under, bool reproject>
 		void SWMapRenderer::RenderFinal(float yawMin, float yawMax,
 										unsigned int numLines,
 										unsigned int threadId,
 										unsigned int numThreads) {
+			SPADES_PROFILE_ZONE("SWMapRenderer::RenderFinal");
 			float fovX = tanf(sceneDef.fovX * 0.5f);
 			float fovY = tanf(sceneDef.fovY * 0.5f);
 			Vector3 front = sceneDef.viewAxis[2];
@@ -858,6 +919,11 @@ namespace spades {
 							pitch = ToSpecialTan(pitch);
 							return static_cast<int>(pitch * (65536.f * 8192.f));
 						};
+						auto calcDepthScale = [] (Vector3 vv) {
+							// converts the horizontal distance stored in the
+							// reprojected lines to the view Z value
+							return fastRSqrt(std::max(vv.x*vv.x+vv.y*vv.y, 1.e-8f));
+						};
 						std::int32_t yawIndex1 = calcYawindex(v2);
 						std::int32_t pitch1 = calcPitch(v2);
 						std::int32_t yawIndex2 = calcYawindex(v2 + deltaRightLarge);
@@ -867,16 +933,29 @@ namespace spades {
 						std::int32_t yawIndex4 = calcYawindex(v2 + deltaRightLarge + deltaDownLarge);
 						std::int32_t pitch4 = calcPitch(v2 + deltaRightLarge + deltaDownLarge);
 						
+						float depthScale1 = 1.f, depthScale2 = 1.f;
+						float depthScale3 = 1.f, depthScale4 = 1.f;
+						if(reproject) {
+							depthScale1 = calcDepthScale(v2);
+							depthScale2 = calcDepthScale(v2 + deltaRightLarge);
+							depthScale3 = calcDepthScale(v2 + deltaDownLarge);
+							depthScale4 = calcDepthScale(v2 + deltaRightLarge + deltaDownLarge);
+						}
+						
 						// note: `<<8>>8` is phase unwrapping
 						std::int32_t yawDiff1 = ((yawIndex2 - yawIndex1)<<8>>8) / hBlock;
 						std::int32_t yawDiff2 = ((yawIndex4 - yawIndex3)<<8>>8) / hBlock;
 						std::int32_t pitchDiff1 = (pitch2 - pitch1) / hBlock;
 						std::int32_t pitchDiff2 = (pitch4 - pitch3) / hBlock;
+						float depthScaleDiff1 = (depthScale2 - depthScale1) * (1.f / hBlock);
+						float depthScaleDiff2 = (depthScale4 - depthScale3) * (1.f / hBlock);
 						
 						std::int32_t yawIndexA = yawIndex1;
 						std::int32_t yawIndexB = yawIndex3;
 						std::int32_t pitchA = pitch1;
 						std::int32_t pitchB = pitch3;
+						float depthScaleA = depthScale1;
+						float depthScaleB = depthScale3;
 						
 						for(unsigned int x = 0; x < blockSize; x+=under) {
 							uint32_t *fb3 = fb2 + x;
@@ -886,6 +965,8 @@ namespace spades {
 							std::int32_t yawDelta = ((yawIndexB - yawIndexA)<<8>>8) / blockSize;
 							std::int32_t pitchC = pitchA;
 							std::int32_t pitchDelta = (pitchB - pitchA) / blockSize;
+							float depthScaleC = depthScaleA;
+							float depthScaleDelta = (depthScaleB - depthScaleA) * (1.f / blockSize);
 							
 							for(unsigned int y = 0; y < blockSize; y++) {
 								
@@ -911,7 +992,10 @@ namespace spades {
 									//pitchIndex = std::min(pitchIndex, lineResolution - 1);
 								}
 								
-								auto& pix = pixels[pitchIndex];
+								LinePixel pix = pixels[pitchIndex];
+								if(reproject) {
+									pix.depth *= depthScaleC;
+								}
 								
 								// write color.
 								// NOTE: combined contains both color and other information,
@@ -957,12 +1041,15 @@ namespace spades {
 								
 								yawIndexC += yawDelta;
 								pitchC += pitchDelta;
+								depthScaleC += depthScaleDelta;
 							}
 							
 							yawIndexA += yawDiff1;
 							yawIndexB += yawDiff2;
 							pitchA += pitchDiff1;
 							pitchB += pitchDiff2;
+							depthScaleA += depthScaleDiff1;
+							depthScaleB += depthScaleDiff2;
 						}
 						
 					}
@@ -1011,7 +1098,10 @@ namespace spades {
 									//pitchIndex = std::min(pitchIndex, lineResolution - 1);
 								}
 								
-								auto& pix = pixels[pitchIndex];
+								LinePixel pix = pixels[pitchIndex];
+								if(reproject) {
+									pix.depth *= fastRSqrt(std::max(vv.x*vv.x+vv.y*vv.y, 1.e-8f));
+								}
 								
 								// write color.
 								// NOTE: combined contains both color and other information,
@@ -1147,7 +1237,42 @@ namespace spades {
 				if(numLines > 65536) {
 					numLines = 65536; // SPRaise("Too many lines emit: %d", static_cast<int>(numLines));
 				}
-				lines.resize(std::max(numLines, lines.size()));
+				
+				reprojecting = r_swReprojection;
+				if(reprojecting) {
+					// lines are anchored to the world yaw and cover the whole circle
+					// so that they can be reused after the camera rotates.
+					// they also cover the whole pitch range, so the resolution is
+					// doubled to keep the density.
+					size_t numFullLines = static_cast<size_t>(pi * 2.f / interval) / under;
+					numFullLines = std::max<size_t>(numFullLines, 8);
+					numFullLines = std::min<size_t>(numFullLines, 65536);
+					
+					int resolution = std::min(lineResolution * 2, 4096);
+					
+					if(!reprojectionValid ||
+					   resolution != reprojectionResolution ||
+					   numFullLines != lines.size()) {
+						lines.clear();
+						lines.resize(numFullLines);
+						
+						float scl = pi * 2.f / static_cast<float>(numFullLines);
+						for(size_t i = 0; i < numFullLines; i++) {
+							Line& l = lines[i];
+							float yaw = static_cast<float>(i) * scl;
+							l.horizonDir = Vector3::Make(cosf(yaw), sinf(yaw), 0.f);
+							l.valid = false;
+						}
+						
+						reprojectionResolution = resolution;
+						reprojectionValid = true;
+					}
+					
+					lineResolution = resolution;
+				}else{
+					reprojectionValid = false;
+					lines.resize(std::max(numLines, lines.size()));
+				}
 				/*
 				SPLog("numlines: %d, each %f deg, and %d res",
 					  static_cast<int>(numLines),
@@ -1155,55 +1280,133 @@ namespace spades {
 					  static_cast<int>(lineResolution));*/
 			}
 			
-			// calculate vector for each lines
-			{
-				float scl = (yawMax - yawMin) / numLines;
-				Vector3 horiz = Vector3::Make(cosf(yawMin), sinf(yawMin), 0.f);
-				float c = cosf(scl);
-				float s = sinf(scl);
-				for(size_t i = 0; i < numLines; i++) {
-					Line& l = lines[i];
-					l.horizonDir = horiz;
-					
-					float x = horiz.x * c - horiz.y * s;
-					float y = horiz.x * s + horiz.y * c;
-					horiz.x = x;
-					horiz.y = y;
-				}
-			}
+			Stopwatch buildStopwatch;
 			
-			{
-				unsigned int nlines = static_cast<unsigned int>(numLines);
+			if(reprojecting) {
+				static const float pi = M_PI;
+				float threshold = std::max(static_cast<float>(r_swReprojectionThreshold), 0.f);
+				float thresholdSq = threshold * threshold;
+				
+				// find visible lines that must be rebuilt
+				long numFullLines = static_cast<long>(lines.size());
+				float scale = static_cast<float>(numFullLines) / (pi * 2.f);
+				long first = static_cast<long>(floorf(yawMin * scale)) - 1;
+				long last = static_cast<long>(ceilf(yawMax * scale)) + 1;
+				if(last - first >= numFullLines) {
+					first = 0;
+					last = numFullLines - 1;
+				}
+				
+				linesToBuild.clear();
+				for(long i = first; i <= last; i++) {
+					unsigned int idx = static_cast<unsigned int>
+					(((i % numFullLines) + numFullLines) % numFullLines);
+					const Line& l = lines[idx];
+					if(l.valid &&
+					   (l.origin - def.viewOrigin).GetPoweredLength() <= thresholdSq) {
+						continue;
+					}
+					linesToBuild.push_back(idx);
+				}
+				
+				numLinesBuilt = static_cast<int>(linesToBuild.size());
+				numLinesReused = static_cast<int>(last - first + 1) - numLinesBuilt;
+				
+				unsigned int nlines = static_cast<unsigned int>(linesToBuild.size());
 				InvokeParallel2([&](unsigned int th, unsigned int numThreads) {
 					unsigned int start = th * nlines / numThreads;
 					unsigned int end = (th+1) * nlines / numThreads;
 					
 					for(size_t i = start; i < end; i++) {
-						BuildLine<flevel>(lines[i],  pitchMin, pitchMax);
+						Line& line = lines[linesToBuild[i]];
+						BuildLine<flevel>(line,  pitchMin, pitchMax);
+						line.origin = def.viewOrigin;
+						line.valid = true;
 					}
 				});
+				
+				// RenderFinal looks up the whole circle
+				yawMin = 0.f;
+				yawMax = pi * 2.f;
+				numLines = lines.size();
+			}else{
+				// calculate vector for each lines
+				{
+					float scl = (yawMax - yawMin) / numLines;
+					Vector3 horiz = Vector3::Make(cosf(yawMin), sinf(yawMin), 0.f);
+					float c = cosf(scl);
+					float s = sinf(scl);
+					for(size_t i = 0; i < numLines; i++) {
+						Line& l = lines[i];
+						l.horizonDir = horiz;
+						
+						float x = horiz.x * c - horiz.y * s;
+						float y = horiz.x * s + horiz.y * c;
+						horiz.x = x;
+						horiz.y = y;
+					}
+				}
+				
+				{
+					unsigned int nlines = static_cast<unsigned int>(numLines);
+					InvokeParallel2([&](unsigned int th, unsigned int numThreads) {
+						unsigned int start = th * nlines / numThreads;
+						unsigned int end = (th+1) * nlines / numThreads;
+						
+						for(size_t i = start; i < end; i++) {
+							BuildLine<flevel>(lines[i],  pitchMin, pitchMax);
+						}
+					});
+				}
+				
+				numLinesBuilt = static_cast<int>(numLines);
+				numLinesReused = 0;
 			}
 			
+			double buildTime = buildStopwatch.GetTime();
+			Stopwatch renderStopwatch;
+			
 			int under = r_swUndersampling;
 			
 			InvokeParallel2([&](unsigned int th, unsigned int numThreads) {
 				
-				if(under <= 1){
-					RenderFinal<flevel, 1>(yawMin, yawMax,
-										   static_cast<unsigned int>(numLines),
-										   th, numThreads);
-				}else if(under <= 2){
-					RenderFinal<flevel, 2>(yawMin, yawMax,
-										   static_cast<unsigned int>(numLines),
-										   th, numThreads);
+				if(reprojecting) {
+					if(under <= 1){
+						RenderFinal<flevel, 1, true>(yawMin, yawMax,
+													 static_cast<unsigned int>(numLines),
+													 th, numThreads);
+					}else if(under <= 2){
+						RenderFinal<flevel, 2, true>(yawMin, yawMax,
+													 static_cast<unsigned int>(numLines),
+													 th, numThreads);
+					}else{
+						RenderFinal<flevel, 4, true>(yawMin, yawMax,
+													 static_cast<unsigned int>(numLines),
+													 th, numThreads);
+					}
 				}else{
-					RenderFinal<flevel, 4>(yawMin, yawMax,
-										   static_cast<unsigned int>(numLines),
-										   th, numThreads);
+					if(under <= 1){
+						RenderFinal<flevel, 1, false>(yawMin, yawMax,
+													  static_cast<unsigned int>(numLines),
+													  th, numThreads);
+					}else if(under <= 2){
+						RenderFinal<flevel, 2, false>(yawMin, yawMax,
+													  static_cast<unsigned int>(numLines),
+													  th, numThreads);
+					}else{
+						RenderFinal<flevel, 4, false>(yawMin, yawMax,
+													  static_cast<unsigned int>(numLines),
+													  th, numThreads);
+					}
 				}
 			});
 			
-			
+			if(r_swStatistics) {
+				SPLog("Map lines: %d built, %d reused (build: %.3fus, render: %.3fus)",
+					  numLinesBuilt, numLinesReused,
+					  buildTime * 1000000.0,
+					  renderStopwatch.GetTime() * 1000000.0);
+			}
 			
 			frameBuf = nullptr;
 			depthBuf = nullptr;
@@ -61,12 +61,25 @@ namespace spades {
 			
 			MiniHeap rleHeap;
 			
+			// temporal reprojection (r_swReprojection).
+			// when enabled, `lines` covers the whole circle and each line
+			// is reused until the camera moves away or the map changes.
+			bool reprojecting;
+			bool reprojectionValid;
+			int reprojectionResolution;
+			std::vector<unsigned int> linesToBuild;
+			
+			int numLinesBuilt;
+			int numLinesReused;
+			
 			template<SWFeatureLevel level>
 			void BuildLine(Line& line,
 						   float minPitch, float maxPitch);
 			void BuildRle(int x, int y, std::vector<RleData>&);
 			
-			template<SWFeatureLevel level, int undersamp>
+			void InvalidateLines(int x, int y);
+			
+			template<SWFeatureLevel level, int undersamp, bool reproject>
 			void RenderFinal(float yawMin, float yawMax,
 							 unsigned int numLines,
 							 unsigned int threadId, unsigned int numThreads);
@@ -19,6 +19,7 @@
  */
 
 #include "SWModel.h"
+#include <Core/AssetPreloader.h>
 #include <Core/FileManager.h>
 #include <Core/IStream.h>
 
@@ -99,18 +100,16 @@ namespace spades {
 		SWModel *SWModelManager::RegisterModel(const std::string &name) {
 			auto it = models.find(name);
 			if(it == models.end()) {
-				auto *str = FileManager::OpenForReading(name.c_str());
 				Handle<VoxelModel> vm;
-				try {
-					vm.Set(VoxelModel::LoadKV6(str), false);
-					auto *m = CreateModel(vm);
-					models.insert(std::make_pair(name, m));
-					m->AddRef();
-					return m;
-				} catch (...) {
-					delete str;
-					throw;
+				vm.Set(AssetPreloader::GetInstance().TakeModel(name), false);
+				if(!vm) {
+					std::unique_ptr<IStream> str(FileManager::OpenForReading(name.c_str()));
+					vm.Set(VoxelModel::LoadKV6(str.get()), false);
 				}
+				auto *m = CreateModel(vm);
+				models.insert(std::make_pair(name, m));
+				m->AddRef();
+				return m;
 			}else{
 				auto *model = it->second;
 				model->AddRef();
@@ -29,15 +29,18 @@
 #include <array>
 #include <algorithm>
 #include <Core/Settings.h>
+#include <Core/Profiler.h>
 #include "SWFlatMapRenderer.h"
 #include "SWMapRenderer.h"
 #include <fenv.h>
 #include "SWModelRenderer.h"
+#include "SWFrameCapture.h"
 
 #include "SWUtils.h"
 
 SPADES_SETTING(r_swStatistics, "0");
 SPADES_SETTING(r_swNumThreads, "4");
+SPADES_SETTING(r_swCapture, "0");
 
 namespace spades {
 	namespace draw {
@@ -119,6 +122,11 @@ namespace spades {
 			modelRenderer = std::make_shared<SWModelRenderer>(this, featureLevel);
 			renderStopwatch.Reset();
 			
+			if(r_swCapture) {
+				SPLog("starting frame capture");
+				capture.reset(new SWFrameCapture(fb->GetWidth(), fb->GetHeight()));
+			}
+			
 			SPLog("---- SWRenderer late initialization done ---");
 			
 			inited = true;
@@ -129,6 +137,8 @@ namespace spades {
 			
 			SetGameMap(nullptr);
 			
+			capture.reset();
+			
 			imageRenderer.reset();
 			flatMapRenderer.reset();
 			
@@ -772,6 +782,7 @@ namespace spades {
 		}
 		
 		void SWRenderer::EndScene() {
+			SPADES_PROFILE_ZONE("SWRenderer::EndScene");
 			EnsureInitialized();
 			EnsureSceneStarted();
 			
@@ -1138,6 +1149,11 @@ namespace spades {
 				SPLog("==== SWRenderer Statistics ====");
 				SPLog("Elapsed Time: %.3fus", dur * 1000000.0);
 				SPLog("Polygon pixels drawn: %llu", imageRenderer->GetPixelsDrawn());
+				if(capture) {
+					SPLog("Frames captured: %llu (%llu dropped)",
+						  (unsigned long long)capture->GetNumFramesCaptured(),
+						  (unsigned long long)capture->GetNumFramesDropped());
+				}
 			}
 			
 			imageRenderer->ResetPixelStatistics();
@@ -1155,6 +1171,9 @@ namespace spades {
 				}
 			}
 			*/
+			if(capture)
+				capture->CaptureFrame(fb);
+			
 			port->Swap();
 			
 			// next frame's framebuffer
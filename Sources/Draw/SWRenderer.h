@@ -43,6 +43,7 @@ namespace spades {
 		class SWMapRenderer;
 		class SWImage;
 		class SWModel;
+		class SWFrameCapture;
 		
 		class SWRenderer: public client::IRenderer, public client::IGameMapListener  {
 			friend class SWFlatMapRenderer;
@@ -123,6 +124,8 @@ namespace spades {
 			
 			Stopwatch renderStopwatch;
 			
+			std::unique_ptr<SWFrameCapture> capture;
+			
 			bool duringSceneRendering;
 			
 			void BuildProjectionMatrix();
@@ -0,0 +1,160 @@
+/*
+ Copyright (c) 2013 yvt
+ 
+ This file is part of OpenSpades.
+ 
+ OpenSpades is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+ 
+ OpenSpades is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with OpenSpades.  If not, see <http://www.gnu.org/licenses/>.
+ 
+ */
+
+
+#include "DemoBenchmarkRunner.h"
+#include <Client/Client.h>
+#include <Audio/NullDevice.h>
+#include <Draw/SWRenderer.h>
+#include <Draw/SWPort.h>
+#include <Core/Bitmap.h>
+#include <Core/ConcurrentDispatch.h>
+#include <Core/Debug.h>
+#include <Core/Exception.h>
+#include <Core/FileManager.h>
+#include <Core/IStream.h>
+#include <Core/Profiler.h>
+#include <Core/Settings.h>
+#include <Core/Stopwatch.h>
+#include <Core/Strings.h>
+#include <algorithm>
+#include <stdio.h>
+
+SPADES_SETTING(r_videoWidth, "1024");
+SPADES_SETTING(r_videoHeight, "640");
+SPADES_SETTING(cg_demoBenchmarkFrameRate, "60");
+
+namespace spades {
+	namespace gui {
+		
+		namespace {
+			class OffscreenSWPort: public draw::SWPort {
+				Handle<Bitmap> framebuffer;
+			protected:
+				virtual ~OffscreenSWPort() {}
+			public:
+				OffscreenSWPort(int width, int height):
+				framebuffer(new Bitmap(width, height), false) {}
+				
+				virtual Bitmap *GetFramebuffer() { return framebuffer; }
+				virtual void Swap() {}
+			};
+		}
+		
+		DemoBenchmarkRunner::DemoBenchmarkRunner(const std::string& demoFileName):
+		demoFileName(demoFileName),
+		width(r_videoWidth),
+		height(r_videoHeight) {
+			if(width < 1 || width > 16384)
+				SPRaise("Value of r_videoWidth is invalid.");
+			if(height < 1 || height > 16384)
+				SPRaise("Value of r_videoHeight is invalid.");
+		}
+		
+		DemoBenchmarkRunner::~DemoBenchmarkRunner() {
+		}
+		
+		void DemoBenchmarkRunner::Run() {
+			SPADES_MARK_FUNCTION();
+			
+			float frameRate = cg_demoBenchmarkFrameRate;
+			if(frameRate < 1.f)
+				SPRaise("Value of cg_demoBenchmarkFrameRate is invalid.");
+			const float dt = 1.f / frameRate;
+			
+			SPLog("Benchmarking demo '%s' at %dx%d, %.1f frames per second",
+				  demoFileName.c_str(), width, height, frameRate);
+			
+			Handle<OffscreenSWPort> port(new OffscreenSWPort(width, height), false);
+			Handle<client::IRenderer> renderer(new draw::SWRenderer(port), false);
+			Handle<client::IAudioDevice> audio(new audio::NullDevice(), false);
+			Handle<client::Client> client(new client::Client(renderer, audio,
+															 ServerAddress(),
+															 std::string()), false);
+			client->PlayDemo(demoFileName);
+			
+			// only frames with a world loaded are measured;
+			// the others mostly wait for the map to arrive
+			std::vector<float> frameTimes;
+			int numLoadingFrames = 0;
+			Stopwatch total;
+			total.Reset();
+			while(!client->IsDemoFinished()) {
+				DispatchQueue::GetThreadQueue()->ProcessQueue();
+				Profiler::MarkFrame();
+				
+				Stopwatch sw;
+				sw.Reset();
+				client->RunFrame(dt);
+				float elapsed = (float)sw.GetTime();
+				
+				if(client->GetWorld())
+					frameTimes.push_back(elapsed);
+				else
+					numLoadingFrames++;
+				
+				if(client->WantsToBeClosed())
+					break;
+			}
+			double totalTime = total.GetTime();
+			client->Closing();
+			
+			if(frameTimes.empty()) {
+				SPLog("Demo benchmark: no frames were played (%d loading frames)",
+					  numLoadingFrames);
+				return;
+			}
+			
+			// per-frame timings for further analysis
+			std::string csvFileName = demoFileName + ".frames.csv";
+			try{
+				std::unique_ptr<IStream> csv(FileManager::OpenForWriting(csvFileName.c_str()));
+				csv->Write("frame,milliseconds\n");
+				for(size_t i = 0; i < frameTimes.size(); i++) {
+					char buf[64];
+					sprintf(buf, "%d,%.4f\n", (int)i, frameTimes[i] * 1000.f);
+					csv->Write(std::string(buf));
+				}
+				SPLog("Per-frame timings written to '%s'", csvFileName.c_str());
+			}catch(const std::exception& ex){
+				SPLog("Failed to write '%s' (%s)", csvFileName.c_str(), ex.what());
+			}
+			
+			std::vector<float> sorted = frameTimes;
+			std::sort(sorted.begin(), sorted.end());
+			auto percentile = [&](float p) {
+				size_t idx = (size_t)(p * (float)(sorted.size() - 1) + .5f);
+				return sorted[idx] * 1000.f;
+			};
+			double sum = 0.;
+			for(float t: frameTimes)
+				sum += t;
+			
+			SPLog("Demo benchmark: %d frames (%.1fs of game time, %d loading frames) "
+				  "in %.2fs",
+				  (int)frameTimes.size(), frameTimes.size() * dt,
+				  numLoadingFrames, totalTime);
+			SPLog("Demo benchmark: mean %.3f ms, median %.3f ms, "
+				  "95th %.3f ms, 99th %.3f ms, max %.3f ms",
+				  sum * 1000. / frameTimes.size(), percentile(.5f),
+				  percentile(.95f), percentile(.99f), sorted.back() * 1000.f);
+		}
+	}
+}
@@ -18,33 +18,26 @@
  
  */
 
+
 #pragma once
 
-#include "ParticleSpriteEntity.h"
+#include <string>
 
-namespace spades{
-	namespace client{
-		class IImage;
-		class IRenderer;
-		class SmokeSpriteEntity: public ParticleSpriteEntity{
-		public:
-			enum class Type {
-				Steady,
-				Explosion
-			};
-		private:
-			float frame;
-			float fps;
-			Type type;
-			static IImage *GetSequence(int i, IRenderer *r, Type);
+namespace spades {
+	namespace gui {
+		/** Replays a demo through Client without a window and reports
+		 * how long each frame took. Frames are advanced by a fixed
+		 * time step, so runs on the same demo are reproducible.
+		 * The software renderer draws into an offscreen framebuffer
+		 * and sounds go to the null audio device. */
+		class DemoBenchmarkRunner {
+			std::string demoFileName;
+			int width, height;
 		public:
+			DemoBenchmarkRunner(const std::string& demoFileName);
+			~DemoBenchmarkRunner();
 			
-			SmokeSpriteEntity(Client *cli, Vector4 color,
-							  float fps, Type type = Type::Steady);
-			
-			static void Preload(IRenderer *);
-			
-			virtual bool Update(float dt);
+			void Run();
 		};
 	}
-}
\ No newline at end of file
+}
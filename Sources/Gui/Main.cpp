@@ -31,6 +31,7 @@
 #include <Core/ZipFileSystem.h>
 #include <Core/ServerAddress.h>
 #include "Runner.h"
+#include "DemoBenchmarkRunner.h"
 #include <Client/GameMap.h>
 #include <Client/Client.h>
 #include <Core/CpuID.h>
@@ -39,6 +40,9 @@
 
 #include <Core/VoxelModel.h>
 #include <Draw/GLOptimizedVoxelModel.h>
+#include <Draw/GLStateCache.h>
+#include <Draw/GLSpriteRenderer.h>
+#include <Audio/SoftDevice.h>
 
 #include <ScriptBindings/ScriptManager.h>
 
@@ -67,6 +71,11 @@ static const unsigned char Icon[] = {
 
 
 SPADES_SETTING(cl_showStartupWindow, "1");
+SPADES_SETTING(core_settingsBenchmark, "0");
+SPADES_SETTING(core_zipBenchmark, "0");
+SPADES_SETTING(core_handleBenchmark, "0");
+SPADES_SETTING(r_glStateCacheTrace, "");
+SPADES_SETTING(r_spriteDrawCallTest, "0");
 
 #ifdef WIN32
 #include <windows.h>
@@ -115,6 +124,9 @@ void setIcon( HWND hWnd )
 
 LONG WINAPI UnhandledExceptionProc( LPEXCEPTION_POINTERS lpEx )
 {
+	// get the last messages into the log before anything else can fail
+	spades::FlushLogAfterCrash();
+	
 	typedef BOOL (WINAPI* PDUMPFN)( HANDLE hProcess, DWORD ProcessId, HANDLE hFile, MINIDUMP_TYPE DumpType, PMINIDUMP_EXCEPTION_INFORMATION ExceptionParam, PMINIDUMP_USER_STREAM_INFORMATION UserStreamParam, PMINIDUMP_CALLBACK_INFORMATION CallbackParam );
 	HMODULE hLib = LoadLibrary( "DbgHelp.dll" );
 	PDUMPFN pMiniDumpWriteDump = (PDUMPFN)GetProcAddress(hLib, "MiniDumpWriteDump");
@@ -162,10 +174,13 @@ SPADES_SETTING(cg_playerName, "");
 int cg_autoConnect = 0;
 bool cg_printVersion = false;
 bool cg_printHelp = false;
+std::string cg_demoBenchmarkFile;
+bool cg_mixerBenchmark = false;
+bool cg_logBenchmark = false;
 
 void printHelp( char * binaryName )
 {
-	printf( "usage: %s [server_address] [protocol_version] [-h|--help] [-v|--version] \n", binaryName );
+	printf( "usage: %s [server_address] [protocol_version] [-h|--help] [-v|--version] [--benchmark-demo FILE] [--benchmark-mixer] [--benchmark-log] \n", binaryName );
 }
 
 int argsHandler(int argc, char **argv, int &i)
@@ -195,6 +210,18 @@ int argsHandler(int argc, char **argv, int &i)
 			cg_printHelp = true;
 			return ++i;
 		}
+		if ( !strcasecmp( a, "--benchmark-demo" ) && i + 1 < argc ) {
+			cg_demoBenchmarkFile = argv[i + 1];
+			return i += 2;
+		}
+		if ( !strcasecmp( a, "--benchmark-mixer" ) ) {
+			cg_mixerBenchmark = true;
+			return ++i;
+		}
+		if ( !strcasecmp( a, "--benchmark-log" ) ) {
+			cg_logBenchmark = true;
+			return ++i;
+		}
 		}
 
 	return 0;
@@ -368,11 +395,15 @@ int main(int argc, char ** argv)
 		spades::reflection::Backtrace::StartBacktrace();
 		SPADES_MARK_FUNCTION();
 
-		// show splash window
+		// show splash window (but not for headless benchmarks)
 		// NOTE: splash window uses image loader, which assumes backtrace is already initialized.
-		splashWindow.reset(new SplashWindow());
+		if(cg_demoBenchmarkFile.empty())
+			splashWindow.reset(new SplashWindow());
 		auto showSplashWindowTime = SDL_GetTicks();
-		auto pumpEvents = [&splashWindow] { splashWindow->PumpEvents(); };
+		auto pumpEvents = [&splashWindow] {
+			if(splashWindow)
+				splashWindow->PumpEvents();
+		};
 
 		// initialize threads
 		spades::Thread::InitThreadSystem();
@@ -473,7 +504,7 @@ int main(int argc, char ** argv)
 									  "OpenSpades will continue to run, but any critical events are not logged.", ex.what());
 			if(SDL_ShowSimpleMessageBox(SDL_MESSAGEBOX_WARNING,
 										"OpenSpades Log System Failure",
-										msg.c_str(), splashWindow->GetWindow())) {
+										msg.c_str(), splashWindow ? splashWindow->GetWindow() : nullptr)) {
 				// showing dialog failed.
 			}
 		}
@@ -481,6 +512,18 @@ int main(int argc, char ** argv)
 
 		// load preferences.
 		spades::Settings::GetInstance()->Load();
+		if(core_settingsBenchmark)
+			spades::Settings::RunBenchmark();
+		if(cg_logBenchmark)
+			spades::RunLogBenchmark();
+		if(core_handleBenchmark)
+			spades::RefCountedObject::RunBenchmark();
+		if(cg_mixerBenchmark)
+			spades::audio::SoftDevice::RunBenchmark();
+		if(!((std::string)r_glStateCacheTrace).empty())
+			spades::draw::GLStateCache::RunTraceTest(r_glStateCacheTrace);
+		if(r_spriteDrawCallTest)
+			spades::draw::GLSpriteRenderer::RunDrawCallTest();
 		pumpEvents();
 
 		// dump CPU info (for debugging?)
@@ -514,8 +557,8 @@ int main(int argc, char ** argv)
 
 		// search current file system for .pak files
 		{
-			std::vector<spades::IFileSystem*> fss;
-			std::vector<spades::IFileSystem*> fssImportant;
+			std::vector<spades::ZipFileSystem*> fss;
+			std::vector<spades::ZipFileSystem*> fssImportant;
 
 			std::vector<std::string> files = spades::FileManager::EnumFiles("");
 
@@ -570,6 +613,13 @@ int main(int argc, char ** argv)
 			for(size_t i = 0; i < fssImportant.size(); i++){
 				spades::FileManager::PrependFileSystem(fssImportant[i]);
 			}
+			
+			if(core_zipBenchmark){
+				for(size_t i = 0; i < fss.size(); i++)
+					fss[i]->RunBenchmark();
+				for(size_t i = 0; i < fssImportant.size(); i++)
+					fssImportant[i]->RunBenchmark();
+			}
 		}
 		pumpEvents();
 
@@ -594,13 +644,17 @@ int main(int argc, char ** argv)
 		// we want to show splash window at least for some time...
 		pumpEvents();
 		auto ticks = SDL_GetTicks();
-		if(ticks < showSplashWindowTime + 1500) {
+		if(splashWindow && ticks < showSplashWindowTime + 1500) {
 			SDL_Delay(showSplashWindowTime + 1500 - ticks);
 		}
 		pumpEvents();
 
 		// everything is now ready!
-		if( !cg_autoConnect ) {
+		if( !cg_demoBenchmarkFile.empty() ) {
+			SPLog("Starting demo benchmark");
+			spades::gui::DemoBenchmarkRunner runner(cg_demoBenchmarkFile);
+			runner.Run();
+		} else if( !cg_autoConnect ) {
 			if(!((int)cl_showStartupWindow != 0 ||
 				 splashWindow->IsStartupScreenRequested())) {
 				splashWindow.reset();
@@ -635,6 +689,7 @@ int main(int argc, char ** argv)
 		msg = _Tr("Main", "A serious error caused OpenSpades to stop working:\n\n{0}\n\nSee SystemMessages.log for more details.", msg);
 
 		SPLog("[!] Terminating due to the fatal error: %s", ex.what());
+		spades::FlushLog();
 
 		SDL_InitSubSystem(SDL_INIT_VIDEO);
 		if(SDL_ShowSimpleMessageBox(SDL_MESSAGEBOX_ERROR, _Tr("Main", "OpenSpades Fatal Error").c_str(), msg.c_str(), nullptr)) {
@@ -148,8 +148,10 @@ namespace spades {
 					CURL* cHandle = curl_easy_init();
 					if( cHandle ) {
 						try{
+							// this runs on a worker thread; take a copy
+							std::string url = cl_serverListUrl;
 							curl_easy_setopt( cHandle, CURLOPT_USERAGENT, OpenSpades_VER_STR );
-							curl_easy_setopt( cHandle, CURLOPT_URL, cl_serverListUrl.CString() );
+							curl_easy_setopt( cHandle, CURLOPT_URL, url.c_str() );
 							curl_easy_setopt( cHandle, CURLOPT_WRITEFUNCTION, &ServerListQuery::curlWriteCallback );
 							curl_easy_setopt( cHandle, CURLOPT_WRITEDATA, this );
 							if( 0 == curl_easy_perform( cHandle ) ) {
@@ -26,10 +26,12 @@
 #include "SDLRunner.h"
 
 #include <Draw/GLRenderer.h>
+#include <Draw/GLStateCachingDevice.h>
 #include <Client/Client.h>
 #include <Audio/ALDevice.h>
 #include <Audio/YsrDevice.h>
 #include <Audio/NullDevice.h>
+#include <Audio/SoftDevice.h>
 #include <ctype.h>
 #include <Core/FileManager.h>
 #include <Core/IStream.h>
@@ -37,6 +39,7 @@
 #include <Core/Settings.h>
 #include <Core/ConcurrentDispatch.h>
 #include <Core/Math.h>
+#include <Core/Profiler.h>
 #include <Draw/SWRenderer.h>
 #include <Draw/SWPort.h>
 
@@ -53,6 +56,7 @@ SPADES_SETTING(r_depthBits, "16");
 SPADES_SETTING(r_vsync, "1");
 SPADES_SETTING(r_allowSoftwareRendering, "0");
 SPADES_SETTING(r_renderer, "gl");
+SPADES_SETTING(r_glStateCache, "1");
 #ifdef __APPLE__
 SPADES_SETTING(s_audioDriver, "ysr");
 #else
@@ -75,10 +79,12 @@ namespace spades {
 				return new audio::ALDevice();
 			}else if(EqualsIgnoringCase(s_audioDriver, "ysr")) {
 				return new audio::YsrDevice();
+			}else if(EqualsIgnoringCase(s_audioDriver, "soft")) {
+				return new audio::SoftDevice();
 			}else if(EqualsIgnoringCase(s_audioDriver, "null")) {
 				return new audio::NullDevice();
 			}else{
-				SPRaise("Unknown audio driver name: %s (openal or ysr expected)", s_audioDriver.CString());
+				SPRaise("Unknown audio driver name: %s (openal, ysr, soft or null expected)", s_audioDriver.CString());
 			}
 		}
 		
@@ -209,6 +215,7 @@ namespace spades {
 					
 					
 					DispatchQueue::GetThreadQueue()->ProcessQueue();
+					Profiler::MarkFrame();
 					
 					Uint32 dt = SDL_GetTicks() - ot;
 					ot += dt;
@@ -397,7 +404,9 @@ namespace spades {
 			switch(GetRendererType()) {
 				case RendererType::GL:
 				{
-					Handle<SDLGLDevice> glDevice(new SDLGLDevice(wnd), false);
+					Handle<draw::IGLDevice> glDevice(new SDLGLDevice(wnd), false);
+					if(r_glStateCache)
+						glDevice.Set(new draw::GLStateCachingDevice(glDevice), false);
 					return new draw::GLRenderer(glDevice);
 				}
 				case RendererType::SW:
@@ -0,0 +1,168 @@
+/*
+ Copyright (c) 2013 yvt
+ 
+ This file is part of OpenSpades.
+ 
+ OpenSpades is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+ 
+ OpenSpades is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with OpenSpades.  If not, see <http://www.gnu.org/licenses/>.
+ 
+ */
+
+
+#include "ScriptManager.h"
+#include "IBatchedToolSkin.h"
+#include <Core/Debug.h>
+
+namespace spades{
+	namespace client {
+		
+		SkinParameters::SkinParameters():
+		sprintState(0.f),
+		raiseState(0.f),
+		isMuted(false),
+		readyState(0.f),
+		aimDownSightState(0.f),
+		isReloading(false),
+		reloadProgress(0.f),
+		ammo(0),
+		clipSize(0),
+		blockColor(MakeVector3(0, 0, 0)),
+		cookTime(0.f),
+		actionType(0),
+		actionProgress(0.f) {}
+		
+		ScriptIBatchedToolSkin::ScriptIBatchedToolSkin(asIScriptObject *obj):
+		obj(obj){}
+		
+		bool ScriptIBatchedToolSkin::IsImplemented() {
+			SPADES_MARK_FUNCTION_DEBUG();
+			static asIScriptEngine *lastEngine = nullptr;
+			static asIObjectType *type = nullptr;
+			
+			asIScriptEngine *eng = ScriptManager::GetInstance()->GetEngine();
+			if(eng != lastEngine) {
+				eng->SetDefaultNamespace("spades");
+				type = eng->GetObjectTypeByName("IBatchedToolSkin");
+				lastEngine = eng;
+			}
+			return type && obj->GetObjectType()->Implements(type);
+		}
+		
+		void ScriptIBatchedToolSkin::SetParameters(const SkinParameters& params) {
+			SPADES_MARK_FUNCTION_DEBUG();
+			static ScriptFunction func("IBatchedToolSkin",
+									   "void SetParameters(const SkinParameters&in)");
+			ScriptContextHandle ctx = func.Prepare();
+			int r;
+			r = ctx->SetObject((void *)obj);
+			ScriptManager::CheckError(r);
+			r = ctx->SetArgAddress(0, const_cast<SkinParameters *>(&params));
+			ScriptManager::CheckError(r);
+			ctx.ExecuteChecked();
+		}
+		
+		class IBatchedToolSkinRegistrar: public ScriptObjectRegistrar {
+			static void SkinParametersFactory(SkinParameters *p) {
+				new(p) SkinParameters();
+			}
+		public:
+			IBatchedToolSkinRegistrar():
+			ScriptObjectRegistrar("IBatchedToolSkin"){
+				
+			}
+			virtual void Register(ScriptManager *manager, Phase phase) {
+				asIScriptEngine *eng = manager->GetEngine();
+				int r;
+				eng->SetDefaultNamespace("spades");
+				switch(phase){
+					case PhaseObjectType:
+						r = eng->RegisterInterface("IBatchedToolSkin");
+						manager->CheckError(r);
+						r = eng->RegisterObjectType("SkinParameters",
+													sizeof(SkinParameters), asOBJ_VALUE|asOBJ_POD|asOBJ_APP_CLASS_CDAK);
+						manager->CheckError(r);
+						break;
+					case PhaseObjectMember:
+						r = eng->RegisterObjectBehaviour("SkinParameters",
+														 asBEHAVE_CONSTRUCT,
+														 "void f()",
+														 asFUNCTION(SkinParametersFactory),
+														 asCALL_CDECL_OBJLAST);
+						manager->CheckError(r);
+						r = eng->RegisterObjectProperty("SkinParameters",
+														"float sprintState",
+														asOFFSET(SkinParameters, sprintState));
+						manager->CheckError(r);
+						r = eng->RegisterObjectProperty("SkinParameters",
+														"float raiseState",
+														asOFFSET(SkinParameters, raiseState));
+						manager->CheckError(r);
+						r = eng->RegisterObjectProperty("SkinParameters",
+														"bool isMuted",
+														asOFFSET(SkinParameters, isMuted));
+						manager->CheckError(r);
+						r = eng->RegisterObjectProperty("SkinParameters",
+														"float readyState",
+														asOFFSET(SkinParameters, readyState));
+						manager->CheckError(r);
+						r = eng->RegisterObjectProperty("SkinParameters",
+														"float aimDownSightState",
+														asOFFSET(SkinParameters, aimDownSightState));
+						manager->CheckError(r);
+						r = eng->RegisterObjectProperty("SkinParameters",
+														"bool isReloading",
+														asOFFSET(SkinParameters, isReloading));
+						manager->CheckError(r);
+						r = eng->RegisterObjectProperty("SkinParameters",
+														"float reloadProgress",
+														asOFFSET(SkinParameters, reloadProgress));
+						manager->CheckError(r);
+						r = eng->RegisterObjectProperty("SkinParameters",
+														"int ammo",
+														asOFFSET(SkinParameters, ammo));
+						manager->CheckError(r);
+						r = eng->RegisterObjectProperty("SkinParameters",
+														"int clipSize",
+														asOFFSET(SkinParameters, clipSize));
+						manager->CheckError(r);
+						r = eng->RegisterObjectProperty("SkinParameters",
+														"Vector3 blockColor",
+														asOFFSET(SkinParameters, blockColor));
+						manager->CheckError(r);
+						r = eng->RegisterObjectProperty("SkinParameters",
+														"float cookTime",
+														asOFFSET(SkinParameters, cookTime));
+						manager->CheckError(r);
+						r = eng->RegisterObjectProperty("SkinParameters",
+														"SpadeActionType actionType",
+														asOFFSET(SkinParameters, actionType));
+						manager->CheckError(r);
+						r = eng->RegisterObjectProperty("SkinParameters",
+														"float actionProgress",
+														asOFFSET(SkinParameters, actionProgress));
+						manager->CheckError(r);
+						
+						r = eng->RegisterInterfaceMethod("IBatchedToolSkin",
+														 "void SetParameters(const SkinParameters&in)");
+						manager->CheckError(r);
+						break;
+					default:
+						
+						break;
+				}
+			}
+		};
+		
+		static IBatchedToolSkinRegistrar registrar;
+	}
+}
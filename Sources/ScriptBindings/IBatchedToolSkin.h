@@ -0,0 +1,72 @@
+/*
+ Copyright (c) 2013 yvt
+ 
+ This file is part of OpenSpades.
+ 
+ OpenSpades is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+ 
+ OpenSpades is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with OpenSpades.  If not, see <http://www.gnu.org/licenses/>.
+ 
+ */
+
+
+#pragma once
+
+#include "ScriptFunction.h"
+#include <Core/Math.h>
+
+namespace spades {
+	namespace client {
+		
+		/** Parameters of a tool skin. Filled by the client once per frame
+		 * and passed to skins that implement IBatchedToolSkin. */
+		struct SkinParameters {
+			// IToolSkin
+			float sprintState;
+			float raiseState;
+			bool isMuted;
+			
+			// IWeaponSkin, IBlockSkin, IGrenadeSkin
+			float readyState;
+			
+			// IWeaponSkin
+			float aimDownSightState;
+			bool isReloading;
+			float reloadProgress;
+			int ammo;
+			int clipSize;
+			
+			// IBlockSkin
+			Vector3 blockColor;
+			
+			// IGrenadeSkin
+			float cookTime;
+			
+			// ISpadeSkin
+			int actionType; // SpadeActionType
+			float actionProgress;
+			
+			SkinParameters();
+		};
+		
+		class ScriptIBatchedToolSkin {
+			asIScriptObject *obj;
+		public:
+			ScriptIBatchedToolSkin(asIScriptObject *obj);
+			
+			/** Returns whether the skin implements IBatchedToolSkin. */
+			bool IsImplemented();
+			
+			void SetParameters(const SkinParameters&);
+		};
+	}
+}
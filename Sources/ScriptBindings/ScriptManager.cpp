@@ -21,14 +21,41 @@
 #include "ScriptManager.h"
 #include <Core/Debug.h>
 #include <vector>
+#include <algorithm>
 #include <sstream>
 #include <Core/Exception.h>
 #include <Core/AutoLocker.h>
 #include <Core/FileManager.h>
 #include <Core/IStream.h>
+#include <Core/Math.h>
+#include <Core/Settings.h>
+#include <Core/Stopwatch.h>
+#include <Core/ThreadLocalStorage.h>
+#include <atomic>
+#include <memory>
+#include <string.h>
+
+SPADES_SETTING(core_scriptCache, "1");
+SPADES_SETTING(core_scriptBenchmark, "0");
 
 namespace spades {
 	
+	static std::atomic<uint64_t> numScriptCalls(0);
+	static std::atomic<uint64_t> numContextAcquisitions(0);
+	
+	static const char *scriptCacheFileName = "Cache/ScriptModule.bin";
+	static const char *clientModuleName = "Client";
+	
+	static uint64_t HashString(uint64_t h, const char *str) {
+		if(str == NULL) str = "";
+		// include the terminator so that "ab"+"c" differs from "a"+"bc"
+		return HashBytes(h, str, strlen(str) + 1);
+	}
+	
+	static uint64_t HashInt(uint64_t h, int64_t v) {
+		return HashBytes(h, &v, sizeof(v));
+	}
+	
 	ScriptManager *ScriptManager::GetInstance() {
 		SPADES_MARK_FUNCTION_DEBUG();
 		static ScriptManager *m = new ScriptManager();
@@ -46,10 +73,20 @@ namespace spades {
 	}
 	
 	class ScriptBuilder: public CScriptBuilder {
+		uint64_t sourceHash;
 	public:
-		ScriptBuilder(){
+		ScriptBuilder():
+		sourceHash(HashSeed){
 			
 		}
+		
+		/** Returns a hash of the all script sections loaded so far. */
+		uint64_t GetSourceHash() const { return sourceHash; }
+		
+		void DefineWord(const char *word) {
+			sourceHash = HashString(sourceHash, word);
+			CScriptBuilder::DefineWord(word);
+		}
 	protected:
 		virtual int  LoadScriptSection(const char *filename) {
 			if(filename[0] != '/') {
@@ -69,11 +106,200 @@ namespace spades {
 			}
 			
 			SPLog("Loading script '%s'", filename);
+			sourceHash = HashString(sourceHash, filename);
+			sourceHash = HashInt(sourceHash, (int64_t)data.size());
+			sourceHash = HashBytes(sourceHash, data.data(), data.size());
 			return ProcessScriptSection(data.c_str(), (unsigned int)(data.length()), filename);
 		}
 	};
 	
 	
+	/** Computes a hash of every declaration registered by the application.
+	 * A saved bytecode refers to the application API by declaration, so
+	 * the bytecode cannot be reused once any of them changes. */
+	static uint64_t HashRegisteredInterface(asIScriptEngine *engine) {
+		SPADES_MARK_FUNCTION();
+		uint64_t h = HashSeed;
+		h = HashString(h, ANGELSCRIPT_VERSION_STRING);
+		h = HashInt(h, sizeof(void *));
+		
+		for(asUINT i = 0; i < engine->GetObjectTypeCount(); i++) {
+			asIObjectType *type = engine->GetObjectTypeByIndex(i);
+			h = HashString(h, type->GetNamespace());
+			h = HashString(h, type->GetName());
+			h = HashInt(h, type->GetFlags());
+			h = HashInt(h, type->GetSize());
+			for(asUINT j = 0; j < type->GetFactoryCount(); j++)
+				h = HashString(h, type->GetFactoryByIndex(j)->GetDeclaration(true, true));
+			for(asUINT j = 0; j < type->GetBehaviourCount(); j++) {
+				asEBehaviours beh;
+				asIScriptFunction *func = type->GetBehaviourByIndex(j, &beh);
+				h = HashInt(h, beh);
+				h = HashString(h, func->GetDeclaration(true, true));
+			}
+			for(asUINT j = 0; j < type->GetMethodCount(); j++)
+				h = HashString(h, type->GetMethodByIndex(j)->GetDeclaration(true, true));
+			for(asUINT j = 0; j < type->GetPropertyCount(); j++)
+				h = HashString(h, type->GetPropertyDeclaration(j));
+		}
+		
+		for(asUINT i = 0; i < engine->GetGlobalFunctionCount(); i++)
+			h = HashString(h, engine->GetGlobalFunctionByIndex(i)->GetDeclaration(true, true));
+		
+		for(asUINT i = 0; i < engine->GetGlobalPropertyCount(); i++) {
+			const char *name, *ns;
+			int typeId;
+			bool isConst;
+			engine->GetGlobalPropertyByIndex(i, &name, &ns, &typeId, &isConst);
+			h = HashString(h, ns);
+			h = HashString(h, name);
+			h = HashString(h, engine->GetTypeDeclaration(typeId, true));
+			h = HashInt(h, isConst ? 1 : 0);
+		}
+		
+		for(asUINT i = 0; i < engine->GetEnumCount(); i++) {
+			int typeId;
+			const char *ns;
+			h = HashString(h, engine->GetEnumByIndex(i, &typeId, &ns));
+			h = HashString(h, ns);
+			for(int j = 0; j < engine->GetEnumValueCount(typeId); j++) {
+				int value;
+				h = HashString(h, engine->GetEnumValueByIndex(typeId, j, &value));
+				h = HashInt(h, value);
+			}
+		}
+		
+		for(asUINT i = 0; i < engine->GetFuncdefCount(); i++)
+			h = HashString(h, engine->GetFuncdefByIndex(i)->GetDeclaration(true, true));
+		
+		for(asUINT i = 0; i < engine->GetTypedefCount(); i++) {
+			int typeId;
+			const char *ns;
+			h = HashString(h, engine->GetTypedefByIndex(i, &typeId, &ns));
+			h = HashString(h, ns);
+			h = HashString(h, engine->GetTypeDeclaration(typeId, true));
+		}
+		
+		return h;
+	}
+	
+	/** asIBinaryStream on a memory buffer. Reading past the end yields
+	 * zeros and sets a flag instead of crashing the bytecode loader. */
+	class ByteCodeBuffer: public asIBinaryStream {
+		std::string& buffer;
+		size_t position;
+		bool overrun;
+	public:
+		ByteCodeBuffer(std::string& buffer, size_t position = 0):
+		buffer(buffer), position(position), overrun(false) {}
+		
+		bool IsOverrun() const { return overrun; }
+		
+		virtual void Read(void *ptr, asUINT size) {
+			size_t avail = buffer.size() - std::min(buffer.size(), position);
+			if(size > avail) {
+				memset(ptr, 0, size);
+				overrun = true;
+				position = buffer.size();
+				return;
+			}
+			memcpy(ptr, buffer.data() + position, size);
+			position += size;
+		}
+		
+		virtual void Write(const void *ptr, asUINT size) {
+			buffer.append(reinterpret_cast<const char *>(ptr), size);
+		}
+	};
+	
+	struct ScriptCacheHeader {
+		char magic[8];
+		uint64_t key;
+		uint64_t payloadLength;
+		uint64_t payloadHash;
+	};
+	
+	static const char scriptCacheMagic[8] = {'O', 'S', 'S', 'C', 'R', 'B', 'C', '1'};
+	
+	/** Tries to load the client module from the bytecode cache.
+	 * @return true if the module was loaded. */
+	static bool LoadCachedModule(asIScriptEngine *engine, uint64_t key) {
+		SPADES_MARK_FUNCTION();
+		if(!FileManager::FileExists(scriptCacheFileName))
+			return false;
+		
+		std::string data;
+		try{
+			data = FileManager::ReadAllBytes(scriptCacheFileName);
+		}catch(const std::exception& ex) {
+			SPLog("Failed to read the script cache: %s", ex.what());
+			return false;
+		}
+		
+		ScriptCacheHeader header;
+		if(data.size() < sizeof(header)) {
+			SPLog("Script cache is corrupted; rebuilding");
+			return false;
+		}
+		memcpy(&header, data.data(), sizeof(header));
+		if(memcmp(header.magic, scriptCacheMagic, sizeof(scriptCacheMagic)) != 0 ||
+		   header.payloadLength != data.size() - sizeof(header) ||
+		   header.payloadHash != HashBytes(HashSeed, data.data() + sizeof(header),
+										   data.size() - sizeof(header))) {
+			SPLog("Script cache is corrupted; rebuilding");
+			return false;
+		}
+		if(header.key != key) {
+			SPLog("Script cache is outdated; rebuilding");
+			return false;
+		}
+		
+		// load into a separate module so that the sections added to the
+		// client module can still be built if loading fails
+		static const char *tempModuleName = "ClientCached";
+		asIScriptModule *module = engine->GetModule(tempModuleName, asGM_ALWAYS_CREATE);
+		ByteCodeBuffer stream(data, sizeof(header));
+		int r = module->LoadByteCode(&stream);
+		if(r < 0 || stream.IsOverrun()) {
+			SPLog("Failed to load the script cache (error %d); rebuilding", r);
+			engine->DiscardModule(tempModuleName);
+			return false;
+		}
+		
+		engine->DiscardModule(clientModuleName);
+		module->SetName(clientModuleName);
+		return true;
+	}
+	
+	static void SaveCachedModule(asIScriptEngine *engine, uint64_t key) {
+		SPADES_MARK_FUNCTION();
+		asIScriptModule *module = engine->GetModule(clientModuleName);
+		SPAssert(module);
+		
+		std::string payload;
+		ByteCodeBuffer stream(payload);
+		int r = module->SaveByteCode(&stream);
+		if(r < 0) {
+			SPLog("Failed to serialize the script module (error %d)", r);
+			return;
+		}
+		
+		ScriptCacheHeader header;
+		memcpy(header.magic, scriptCacheMagic, sizeof(scriptCacheMagic));
+		header.key = key;
+		header.payloadLength = payload.size();
+		header.payloadHash = HashBytes(HashSeed, payload.data(), payload.size());
+		
+		try{
+			std::unique_ptr<IStream> s(FileManager::OpenForWriting(scriptCacheFileName));
+			s->Write(&header, sizeof(header));
+			s->Write(payload);
+			SPLog("Script cache saved (%d bytes)", (int)(payload.size() + sizeof(header)));
+		}catch(const std::exception& ex) {
+			SPLog("Failed to save the script cache: %s", ex.what());
+		}
+	}
+	
 	ScriptManager::ScriptManager() {
 		SPADES_MARK_FUNCTION();
 		
@@ -103,18 +329,37 @@ namespace spades {
 			ScriptObjectRegistrar::RegisterAll(this, ScriptObjectRegistrar::PhaseObjectMember);
 			
 			SPLog("Loading scripts");
+			Stopwatch sw;
 			engine->SetDefaultNamespace("");
 			ScriptBuilder builder;
-			if(builder.StartNewModule(engine, "Client") < 0){
+			if(builder.StartNewModule(engine, clientModuleName) < 0){
 				SPRaise("Failed to create script module.");
 			}
 			builder.DefineWord("CLIENT");
 			if(builder.AddSectionFromFile("/Main.as") < 0){
 				SPRaise("Failed to load '/Main.as'.");
 			}
-			SPLog("Building");
-			if(builder.BuildModule() < 0){
-				SPRaise("Failed to build at least one of the scripts.");
+			
+			// the cache is valid only for the same sources compiled against
+			// the same application interface
+			uint64_t cacheKey = builder.GetSourceHash();
+			cacheKey = HashInt(cacheKey, (int64_t)HashRegisteredInterface(engine));
+			
+			bool cached = core_scriptCache && LoadCachedModule(engine, cacheKey);
+			if(!cached) {
+				SPLog("Building");
+				if(builder.BuildModule() < 0){
+					SPRaise("Failed to build at least one of the scripts.");
+				}
+				if(core_scriptCache) {
+					SaveCachedModule(engine, cacheKey);
+				}
+			}
+			SPLog("Scripts ready in %.3f seconds (%s)", sw.GetTime(),
+				  cached ? "loaded from bytecode cache" : "compiled");
+			
+			if(core_scriptBenchmark) {
+				RunCallBenchmark();
 			}
 			
 		}catch(...){
@@ -185,6 +430,14 @@ namespace spades {
 		}
 	}
 	
+	uint64_t ScriptManager::GetNumScriptCalls() {
+		return numScriptCalls;
+	}
+	
+	uint64_t ScriptManager::GetNumContextAcquisitions() {
+		return numContextAcquisitions;
+	}
+	
 	void ScriptManager::CheckError(int ret){
 		if(ret < 0){
 			SPADES_MARK_FUNCTION();
@@ -197,22 +450,110 @@ namespace spades {
 		engine->Release();
 	}
 	
+	struct ScriptManager::ContextCache {
+		std::vector<Context *> freeContexts;
+		std::vector<Context *> freeNestedStates;
+		
+		~ContextCache() {
+			for(size_t i = 0; i < freeContexts.size(); i++) {
+				freeContexts[i]->obj->Release();
+				delete freeContexts[i];
+			}
+			for(size_t i = 0; i < freeNestedStates.size(); i++)
+				delete freeNestedStates[i];
+		}
+	};
+	
+	ScriptManager::ContextCache& ScriptManager::GetContextCache() {
+		static AutoDeletedThreadLocalStorage<ContextCache> cacheTls("scriptContextCache");
+		ContextCache *cache = cacheTls;
+		if(!cache) {
+			cache = new ContextCache();
+			cacheTls = cache;
+		}
+		return *cache;
+	}
+	
 	ScriptContextHandle ScriptManager::GetContext() {
 		SPADES_MARK_FUNCTION_DEBUG();
-		AutoLocker locker(&contextMutex);
-		if(contextFreeList.empty()){
-			// no free context; create one
-			Context *ctx = new Context();
-			ctx->obj = engine->CreateContext();
-			ctx->refCount = 0;
-			return ScriptContextHandle(ctx, this);
-		}else{
+		numContextAcquisitions++;
+		
+		ContextCache& cache = GetContextCache();
+		if(!cache.freeContexts.empty()){
 			// get one
-			Context *ctx = contextFreeList.front();
-			contextFreeList.pop_front();
+			Context *ctx = cache.freeContexts.back();
+			cache.freeContexts.pop_back();
 			SPAssert(ctx->refCount == 0);
 			return ScriptContextHandle(ctx, this);
 		}
+		
+		// every context of this thread is in use, which usually means
+		// we are called by a script. the executing context can run
+		// the nested call without creating a new one.
+		asIScriptContext *active = asGetActiveContext();
+		if(active && active->GetEngine() == engine &&
+		   active->GetState() == asEXECUTION_ACTIVE &&
+		   active->PushState() >= 0){
+			Context *ctx;
+			if(cache.freeNestedStates.empty()){
+				ctx = new Context();
+				ctx->nested = true;
+			}else{
+				ctx = cache.freeNestedStates.back();
+				cache.freeNestedStates.pop_back();
+			}
+			ctx->obj = active;
+			ctx->refCount = 0;
+			return ScriptContextHandle(ctx, this);
+		}
+		
+		// no free context; create one
+		Context *ctx = new Context();
+		ctx->obj = engine->CreateContext();
+		ctx->refCount = 0;
+		ctx->nested = false;
+		return ScriptContextHandle(ctx, this);
+	}
+	
+	void ScriptManager::ReleaseContext(Context *ctx) {
+		SPAssert(ctx->refCount == 0);
+		ContextCache& cache = GetContextCache();
+		if(ctx->nested){
+			// handles are scoped, so nested states are released
+			// in the reverse order of creation
+			int r = ctx->obj->PopState();
+			if(r < 0){
+				SPLog("WARNING: failed to pop a nested script context state: %s",
+					  ASErrorToString(r).c_str());
+			}
+			ctx->obj = NULL;
+			cache.freeNestedStates.push_back(ctx);
+		}else{
+			cache.freeContexts.push_back(ctx);
+		}
+	}
+	
+	void ScriptManager::RunCallBenchmark() {
+		SPADES_MARK_FUNCTION();
+		asIScriptModule *module = engine->GetModule("Benchmark", asGM_ALWAYS_CREATE);
+		asIScriptFunction *func = NULL;
+		int r = module->CompileFunction("benchmark", "void Nop(int a) {}", 0, 0, &func);
+		CheckError(r);
+		
+		const int numCalls = 100000;
+		Stopwatch sw;
+		for(int i = 0; i < numCalls; i++){
+			ScriptContextHandle ctx = GetContext();
+			ctx->Prepare(func);
+			ctx->SetArgDWord(0, (asDWORD)i);
+			ctx.ExecuteChecked();
+		}
+		double dt = sw.GetTime();
+		SPLog("Script call benchmark: %d calls in %.3f seconds (%.0f calls/s)",
+			  numCalls, dt, (double)numCalls / std::max(dt, 1.e-6));
+		
+		func->Release();
+		engine->DiscardModule("Benchmark");
 	}
 	
 	ScriptContextHandle::ScriptContextHandle():
@@ -223,14 +564,13 @@ namespace spades {
 	ScriptContextHandle::ScriptContextHandle(ScriptManager::Context *ctx,
 											 ScriptManager *manager):
 	manager(manager), obj(ctx){
-		AutoLocker locker(&manager->contextMutex);
 		ctx->refCount++;
 	}
 	
 	ScriptContextHandle::ScriptContextHandle(const ScriptContextHandle& h) :
 	manager(h.manager), obj(h.obj){
-		AutoLocker locker(&manager->contextMutex);
-		obj->refCount++;
+		if(obj)
+			obj->refCount++;
 	}
 	
 	ScriptContextHandle::~ScriptContextHandle() {
@@ -239,12 +579,11 @@ namespace spades {
 	
 	void ScriptContextHandle::Release() {
 		if(obj){
-			AutoLocker locker(&manager->contextMutex);
 			obj->refCount--;
 			if(obj->refCount == 0){
 				// this context is no longer used;
-				// add to freelist
-				manager->contextFreeList.push_back(obj);
+				// return to the pool
+				manager->ReleaseContext(obj);
 			}
 			
 			obj = NULL;
@@ -258,8 +597,8 @@ namespace spades {
 		
 		manager = h.manager;
 		obj = h.obj;
-		AutoLocker locker(&manager->contextMutex);
-		obj->refCount++;
+		if(obj)
+			obj->refCount++;
 	}
 	
 	asIScriptContext *ScriptContextHandle::GetContext() const {
@@ -336,6 +675,7 @@ namespace spades {
 
 	void ScriptContextUtils::ExecuteChecked() {
 		SPADES_MARK_FUNCTION();
+		numScriptCalls++;
 		int r = context->Execute();
 		ScriptManager::CheckError(r);
 		if(r == asEXECUTION_ABORTED) {
@@ -43,19 +43,35 @@ namespace spades {
 		struct Context {
 			asIScriptContext *obj;
 			int refCount;
+			/** true if this refers to a state pushed onto a context
+			 * which is executing a script that called the native code. */
+			bool nested;
 		};
-		Mutex contextMutex;
-		std::list<Context *> contextFreeList;
+		
+		/** Contexts are pooled per thread, so handles must not be
+		 * passed to another thread. */
+		struct ContextCache;
 		
 		asIScriptEngine *engine;
 		
 		ScriptManager();
 		~ScriptManager();
+		
+		ContextCache& GetContextCache();
+		void ReleaseContext(Context *);
+		void RunCallBenchmark();
 	public:
 		static ScriptManager *GetInstance();
 		
 		static void CheckError(int);
 		
+		/** Returns the number of script executions started by
+		 * the native code so far. */
+		static uint64_t GetNumScriptCalls();
+		
+		/** Returns the number of contexts acquired by GetContext so far. */
+		static uint64_t GetNumContextAcquisitions();
+		
 		asIScriptEngine *GetEngine() const { return engine; }
 		
 		ScriptContextHandle GetContext();